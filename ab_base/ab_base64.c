@@ -0,0 +1,49 @@
+/*
+ * ab_base64.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_base64.h"
+
+#include "ab_assert.h"
+
+#include <stddef.h>
+
+static const char g_alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+int ab_base64_encode(const unsigned char *data, unsigned int data_len,
+    char *buf, unsigned int buf_size) {
+    assert(data || 0 == data_len);
+    assert(buf);
+
+    unsigned int len = AB_BASE64_ENCODED_SIZE(data_len);
+    if (len + 1 > buf_size)
+        return -1;
+
+    char *out = buf;
+    unsigned int i = 0;
+    for (; i + 3 <= data_len; i += 3) {
+        unsigned int v = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+        *out++ = g_alphabet[(v >> 18) & 0x3f];
+        *out++ = g_alphabet[(v >> 12) & 0x3f];
+        *out++ = g_alphabet[(v >> 6) & 0x3f];
+        *out++ = g_alphabet[v & 0x3f];
+    }
+
+    if (i < data_len) {
+        unsigned int v = data[i] << 16;
+        if (i + 1 < data_len)
+            v |= data[i + 1] << 8;
+
+        *out++ = g_alphabet[(v >> 18) & 0x3f];
+        *out++ = g_alphabet[(v >> 12) & 0x3f];
+        *out++ = i + 1 < data_len ? g_alphabet[(v >> 6) & 0x3f] : '=';
+        *out++ = '=';
+    }
+
+    *out = '\0';
+    return len;
+}
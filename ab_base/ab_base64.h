@@ -0,0 +1,31 @@
+/*
+ * ab_base64.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_BASE_AB_BASE64_H_
+#define AB_BASE_AB_BASE64_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 编码后的长度，不含'\0'
+ */
+#define AB_BASE64_ENCODED_SIZE(len) ((((len) + 2) / 3) * 4)
+
+/*
+ * RFC 4648标准字母表，带'='填充，以'\0'结尾
+ * return: 编码后的长度，缓冲区不足返回-1
+ */
+extern int ab_base64_encode(const unsigned char *data, unsigned int data_len,
+    char *buf, unsigned int buf_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AB_BASE_AB_BASE64_H_ */
@@ -0,0 +1,101 @@
+/*
+ * ab_counter.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_counter.h"
+
+#include "ab_mem.h"
+#include "ab_assert.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define CACHE_LINE_SIZE 64
+
+// the last shard is shared by the threads past AB_COUNTER_MAX_THREADS
+#define SHARED_SHARD    AB_COUNTER_MAX_THREADS
+
+#define T ab_counter_t
+
+struct T {
+    unsigned int    count;
+    unsigned int    stride;             // uint64_t per shard, whole cache lines
+    void           *memory;
+    uint64_t       *shards;             // cache line aligned
+};
+
+// process wide, a thread keeps its slot for every counter set
+static unsigned int next_slot = 0;
+static __thread int thread_slot = -1;
+
+static int current_slot(void) {
+    if (thread_slot < 0) {
+        unsigned int slot = __atomic_fetch_add(&next_slot, 1, __ATOMIC_RELAXED);
+        thread_slot = slot < AB_COUNTER_MAX_THREADS ? (int) slot : SHARED_SHARD;
+    }
+    return thread_slot;
+}
+
+T ab_counter_new(unsigned int count) {
+    assert(count > 0);
+
+    T counter;
+    NEW(counter);
+
+    const unsigned int per_line = CACHE_LINE_SIZE / sizeof(uint64_t);
+    counter->count  = count;
+    counter->stride = (count + per_line - 1) / per_line * per_line;
+
+    size_t size = (size_t) counter->stride * sizeof(uint64_t) *
+        (AB_COUNTER_MAX_THREADS + 1);
+    counter->memory = CALLOC(1, size + CACHE_LINE_SIZE);
+    counter->shards = (uint64_t *) (((uintptr_t) counter->memory +
+        CACHE_LINE_SIZE - 1) & ~(uintptr_t) (CACHE_LINE_SIZE - 1));
+
+    return counter;
+}
+
+void ab_counter_free(T *counter) {
+    assert(counter && *counter);
+
+    FREE((*counter)->memory);
+    FREE(*counter);
+}
+
+void ab_counter_add(T counter, unsigned int index, uint64_t n) {
+    assert(counter);
+    assert(index < counter->count);
+
+    int slot = current_slot();
+    uint64_t *value = counter->shards + (size_t) slot * counter->stride + index;
+    if (SHARED_SHARD == slot) {
+        __atomic_fetch_add(value, n, __ATOMIC_RELAXED);
+    } else {
+        // single writer: a plain add, atomic only so readers never see a torn value
+        __atomic_store_n(value, __atomic_load_n(value, __ATOMIC_RELAXED) + n,
+            __ATOMIC_RELAXED);
+    }
+}
+
+void ab_counter_snapshot(T counter, uint64_t *values, unsigned int count) {
+    assert(counter);
+    assert(values);
+
+    if (count > counter->count)
+        count = counter->count;
+    memset(values, 0, count * sizeof(uint64_t));
+
+    for (unsigned int slot = 0; slot <= SHARED_SHARD; ++slot) {
+        const uint64_t *shard = counter->shards + (size_t) slot * counter->stride;
+        for (unsigned int i = 0; i < count; ++i)
+            values[i] += __atomic_load_n(&shard[i], __ATOMIC_RELAXED);
+    }
+}
+
+unsigned int ab_counter_count(T counter) {
+    assert(counter);
+    return counter->count;
+}
@@ -0,0 +1,45 @@
+/*
+ * ab_counter.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_BASE_AB_COUNTER_H_
+#define AB_BASE_AB_COUNTER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * 一组64位累加计数器，每个线程写自己按缓存行对齐的分片，热点路径上
+ * 没有锁也没有原子读改写；快照时把各分片相加
+ * 前AB_COUNTER_MAX_THREADS个写过计数的线程各占一片，之后的线程共用一片(原子加)
+ */
+#define T ab_counter_t
+typedef struct T *T;
+
+#define AB_COUNTER_MAX_THREADS  16
+
+extern T    ab_counter_new(unsigned int count);
+extern void ab_counter_free(T *counter);
+
+extern void ab_counter_add(T counter, unsigned int index, uint64_t n);
+
+/*
+ * 各线程的和，与并发的add之间不是原子快照，但每个值都单调不减
+ */
+extern void ab_counter_snapshot(T counter, uint64_t *values, unsigned int count);
+
+extern unsigned int ab_counter_count(T counter);
+
+#undef T
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AB_BASE_AB_COUNTER_H_ */
@@ -0,0 +1,148 @@
+/*
+ * ab_histogram.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_histogram.h"
+
+#include "ab_mem.h"
+#include "ab_assert.h"
+
+#include <stdbool.h>
+
+// values below 2^SUB_BITS get a bucket each, above that every power of two
+// is split into HALF_COUNT buckets
+#define SUB_BITS        7
+#define SUB_COUNT       (1u << SUB_BITS)
+#define HALF_COUNT      (SUB_COUNT / 2)
+#define MAX_BITS        40
+#define MAX_VALUE       ((UINT64_C(1) << MAX_BITS) - 1)
+#define BUCKET_COUNT    ((MAX_BITS - SUB_BITS + 1) * HALF_COUNT + HALF_COUNT)
+
+#define T ab_histogram_t
+
+struct T {
+    uint64_t        count;
+    uint64_t        sum;
+    uint64_t        min;
+    uint64_t        max;
+    uint64_t        buckets[BUCKET_COUNT];
+};
+
+static unsigned int bucket_index(uint64_t value) {
+    if (value < SUB_COUNT)
+        return value;
+    if (value > MAX_VALUE)
+        value = MAX_VALUE;
+
+    // value >> shift lands in [HALF_COUNT, SUB_COUNT)
+    unsigned int shift = 63 - __builtin_clzll(value) - (SUB_BITS - 1);
+    return shift * HALF_COUNT + (value >> shift);
+}
+
+static uint64_t bucket_upper(unsigned int index) {
+    if (index < SUB_COUNT)
+        return index;
+
+    unsigned int shift = index / HALF_COUNT - 1;
+    uint64_t lower = (uint64_t) (index - shift * HALF_COUNT) << shift;
+    return lower + (UINT64_C(1) << shift) - 1;
+}
+
+T ab_histogram_new(void) {
+    T histogram;
+    NEW0(histogram);
+    histogram->min = UINT64_MAX;
+    return histogram;
+}
+
+void ab_histogram_free(T *histogram) {
+    assert(histogram && *histogram);
+    FREE(*histogram);
+}
+
+void ab_histogram_record(T histogram, uint64_t value) {
+    assert(histogram);
+
+    __atomic_fetch_add(&histogram->buckets[bucket_index(value)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->sum, value, __ATOMIC_RELAXED);
+
+    uint64_t max = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+    while (value > max && !__atomic_compare_exchange_n(&histogram->max, &max, value,
+        true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+    uint64_t min = __atomic_load_n(&histogram->min, __ATOMIC_RELAXED);
+    while (value < min && !__atomic_compare_exchange_n(&histogram->min, &min, value,
+        true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+/*
+ * 各百分位按从小到大给出，一次遍历
+ */
+static void percentiles(T histogram, const double *percents, uint64_t *values,
+    unsigned int count) {
+    uint64_t counts[BUCKET_COUNT];
+    uint64_t total = 0;
+    for (unsigned int i = 0; i < BUCKET_COUNT; ++i) {
+        counts[i] = __atomic_load_n(&histogram->buckets[i], __ATOMIC_RELAXED);
+        total += counts[i];
+    }
+
+    uint64_t max = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+    uint64_t seen = 0;
+    unsigned int bucket = 0;
+    for (unsigned int i = 0; i < count; ++i) {
+        if (0 == total) {
+            values[i] = 0;
+            continue;
+        }
+
+        // the smallest value with at least percent of the samples at or below it
+        double exact = percents[i] / 100.0 * total;
+        uint64_t rank = (uint64_t) exact;
+        if (rank < exact)
+            ++rank;
+        if (rank < 1)
+            rank = 1;
+        if (rank > total)
+            rank = total;
+
+        while (bucket < BUCKET_COUNT && seen + counts[bucket] < rank)
+            seen += counts[bucket++];
+
+        uint64_t upper = bucket_upper(bucket < BUCKET_COUNT ? bucket : BUCKET_COUNT - 1);
+        values[i] = upper < max ? upper : max;
+    }
+}
+
+uint64_t ab_histogram_percentile(T histogram, double percentile) {
+    assert(histogram);
+    assert(percentile >= 0 && percentile <= 100);
+
+    uint64_t value;
+    percentiles(histogram, &percentile, &value, 1);
+    return value;
+}
+
+void ab_histogram_summary(T histogram, ab_histogram_summary_t *summary) {
+    assert(histogram);
+    assert(summary);
+
+    static const double percents[] = { 50, 99, 99.9 };
+    uint64_t values[3];
+    percentiles(histogram, percents, values, 3);
+
+    summary->count  = __atomic_load_n(&histogram->count, __ATOMIC_RELAXED);
+    summary->sum    = __atomic_load_n(&histogram->sum, __ATOMIC_RELAXED);
+    summary->min    = __atomic_load_n(&histogram->min, __ATOMIC_RELAXED);
+    summary->max    = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+    if (0 == summary->count)
+        summary->min = 0;
+    summary->p50    = values[0];
+    summary->p99    = values[1];
+    summary->p999   = values[2];
+}
@@ -0,0 +1,56 @@
+/*
+ * ab_histogram.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_BASE_AB_HISTOGRAM_H_
+#define AB_BASE_AB_HISTOGRAM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * HDR风格的对数线性直方图：每个2的幂区间分成64个桶，相对误差不超过1/64
+ * 记录范围0~2^40-1，更大的值记在最后一个桶
+ * 记录只有原子加，多个线程可以并发记录和读取，没有锁
+ */
+#define T ab_histogram_t
+typedef struct T *T;
+
+typedef struct ab_histogram_summary_t {
+    uint64_t        count;
+    uint64_t        sum;
+    uint64_t        min;                // count为0时min、max、分位数都为0
+    uint64_t        max;
+    uint64_t        p50;                // 所在桶的上界，不超过max
+    uint64_t        p99;
+    uint64_t        p999;
+} ab_histogram_summary_t;
+
+extern T    ab_histogram_new(void);
+extern void ab_histogram_free(T *histogram);
+
+extern void ab_histogram_record(T histogram, uint64_t value);
+
+/*
+ * percentile: 0~100
+ */
+extern uint64_t ab_histogram_percentile(T histogram, double percentile);
+
+/*
+ * 各桶读一遍后计算，与并发的record之间不是原子快照
+ */
+extern void ab_histogram_summary(T histogram, ab_histogram_summary_t *summary);
+
+#undef T
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AB_BASE_AB_HISTOGRAM_H_ */
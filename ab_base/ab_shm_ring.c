@@ -0,0 +1,446 @@
+/*
+ * ab_shm_ring.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_shm_ring.h"
+
+#include "ab_mem.h"
+#include "ab_assert.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define SHM_RING_MAGIC          0x61627368      // "absh"
+#define SHM_RING_VERSION        1
+#define SHM_RING_MIN_SIZE       (64 * 1024)
+#define SHM_RING_MAX_SIZE       (1U << 30)
+#define SHM_RING_HEADER_SIZE    256             // data area starts here
+#define SHM_RING_PADDING        0x80000000      // record flag, skip to the wrap
+
+#define SHM_RING_ALIGN(n)       (((n) + 7) & ~(uint64_t) 7)
+
+/*
+ * Positions are bytes written since the ring was created and never wrap,
+ * a position's offset in the data area is pos & (size - 1).
+ */
+typedef struct ab_shm_ring_header_t {
+    uint32_t        magic;              // stored last, once the rest is set
+    uint32_t        version;
+    uint64_t        size;
+    uint32_t        generation;         // bumped by every writer that attaches
+    uint32_t        unlinked;           // readers reopen by name
+    int32_t         writer_pid;
+
+    // written by the writer only
+    uint64_t        write_pos __attribute__((aligned(64)));    // published
+    uint64_t        reserve_pos;        // being written, bytes below minus size are gone
+    uint64_t        key_pos;            // latest AB_SHM_RING_KEY record
+    uint64_t        restart_pos;        // where the current writer started
+
+    // futex word, bumped after every publish; readers count themselves in waiters
+    uint32_t        notify __attribute__((aligned(64)));
+    uint32_t        waiters;
+} ab_shm_ring_header_t;
+
+typedef struct ab_shm_ring_record_header_t {
+    uint32_t        len;
+    uint32_t        flags;
+    uint64_t        timestamp;
+} ab_shm_ring_record_header_t;
+
+#define T ab_shm_ring_t
+
+struct T {
+    int             fd;
+    bool            writer;
+    ab_shm_ring_header_t *header;
+    unsigned char  *data;
+    uint64_t        size;
+    uint64_t        map_size;
+
+    uint64_t        pos;                // writer: published, reader: next record
+    // writer: the reserved record; reader: the record being read
+    uint64_t        record_pos;
+    uint64_t        next_pos;
+    unsigned int    record_len;
+
+    uint32_t        generation;         // reader, the writer last seen
+    bool            discontinuity;
+    bool            restart_pending;    // flag the record at restart_pos
+    uint64_t        restart_pos;
+};
+
+static int futex(uint32_t *addr, int op, uint32_t val, const struct timespec *timeout) {
+    // not FUTEX_PRIVATE_FLAG, the word is shared between processes
+    return syscall(SYS_futex, addr, op, val, timeout, NULL, 0);
+}
+
+static uint64_t round_size(unsigned int size) {
+    uint64_t result = SHM_RING_MIN_SIZE;
+    while (result < size && result < SHM_RING_MAX_SIZE)
+        result <<= 1;
+    return result;
+}
+
+static T map_ring(int fd, uint64_t map_size, bool writer) {
+    void *addr = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == addr) {
+        close(fd);
+        return NULL;
+    }
+
+    T ring;
+    NEW0(ring);
+    ring->fd        = fd;
+    ring->writer    = writer;
+    ring->header    = (ab_shm_ring_header_t *) addr;
+    ring->data      = (unsigned char *) addr + SHM_RING_HEADER_SIZE;
+    ring->size      = map_size - SHM_RING_HEADER_SIZE;
+    ring->map_size  = map_size;
+    return ring;
+}
+
+static bool header_valid(const ab_shm_ring_header_t *header, uint64_t map_size) {
+    return SHM_RING_MAGIC == __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) &&
+           SHM_RING_VERSION == header->version &&
+           header->size + SHM_RING_HEADER_SIZE == map_size;
+}
+
+/*
+ * 让旧的读者重新打开
+ */
+static void mark_unlinked(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < SHM_RING_HEADER_SIZE)
+        return;
+
+    ab_shm_ring_header_t *header = mmap(NULL, SHM_RING_HEADER_SIZE,
+        PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == header)
+        return;
+    __atomic_store_n(&header->unlinked, 1, __ATOMIC_RELEASE);
+    // waiting readers see it now rather than at their timeout
+    __atomic_add_fetch(&header->notify, 1, __ATOMIC_SEQ_CST);
+    futex(&header->notify, FUTEX_WAKE, INT32_MAX, NULL);
+    munmap(header, SHM_RING_HEADER_SIZE);
+}
+
+T ab_shm_ring_create(const char *name, unsigned int size) {
+    assert(name);
+
+    uint64_t map_size = SHM_RING_HEADER_SIZE + round_size(size);
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    // a restarted writer continues where the previous one stopped
+    if ((uint64_t) st.st_size == map_size) {
+        T ring = map_ring(fd, map_size, true);
+        if (NULL == ring)
+            return NULL;
+        ab_shm_ring_header_t *header = ring->header;
+        if (header_valid(header, map_size)) {
+            // whatever the previous writer reserved but never published is dropped
+            ring->pos = __atomic_load_n(&header->write_pos, __ATOMIC_ACQUIRE);
+            __atomic_store_n(&header->reserve_pos, ring->pos, __ATOMIC_RELAXED);
+            __atomic_store_n(&header->restart_pos, ring->pos, __ATOMIC_RELAXED);
+            header->writer_pid = getpid();
+            __atomic_add_fetch(&header->generation, 1, __ATOMIC_RELEASE);
+            return ring;
+        }
+        ab_shm_ring_close(&ring);
+        fd = shm_open(name, O_RDWR, 0644);
+        if (fd < 0)
+            return NULL;
+    }
+
+    // a different size: let the readers of the old one go and start over
+    mark_unlinked(fd);
+    close(fd);
+    shm_unlink(name);
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+        return NULL;
+    if (ftruncate(fd, map_size) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+
+    T ring = map_ring(fd, map_size, true);
+    if (NULL == ring)
+        return NULL;
+    ab_shm_ring_header_t *header = ring->header;
+    header->version     = SHM_RING_VERSION;
+    header->size        = ring->size;
+    header->generation  = 1;
+    header->writer_pid  = getpid();
+    __atomic_store_n(&header->magic, SHM_RING_MAGIC, __ATOMIC_RELEASE);
+    return ring;
+}
+
+/*
+ * 从最近的关键帧开始，太旧(可能很快被覆盖)时从最新的位置开始
+ */
+static uint64_t start_pos(T ring) {
+    uint64_t write_pos = __atomic_load_n(&ring->header->write_pos, __ATOMIC_ACQUIRE);
+    uint64_t key_pos = __atomic_load_n(&ring->header->key_pos, __ATOMIC_RELAXED);
+    if (key_pos <= write_pos && write_pos - key_pos <= ring->size / 2)
+        return key_pos;
+    return write_pos;
+}
+
+T ab_shm_ring_open(const char *name) {
+    assert(name);
+
+    // read-write: waiting readers register in the header
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= SHM_RING_HEADER_SIZE) {
+        close(fd);
+        return NULL;
+    }
+
+    T ring = map_ring(fd, st.st_size, false);
+    if (NULL == ring)
+        return NULL;
+    if (!header_valid(ring->header, ring->map_size) ||
+        __atomic_load_n(&ring->header->unlinked, __ATOMIC_ACQUIRE)) {
+        ab_shm_ring_close(&ring);
+        return NULL;
+    }
+
+    ring->generation    = __atomic_load_n(&ring->header->generation, __ATOMIC_ACQUIRE);
+    ring->pos           = start_pos(ring);
+    ring->discontinuity = true;
+    return ring;
+}
+
+void ab_shm_ring_close(T *ring) {
+    assert(ring && *ring);
+
+    munmap((*ring)->header, (*ring)->map_size);
+    close((*ring)->fd);
+    FREE(*ring);
+}
+
+int ab_shm_ring_unlink(const char *name) {
+    assert(name);
+
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+        return -1;
+
+    mark_unlinked(fd);
+    close(fd);
+
+    return shm_unlink(name);
+}
+
+unsigned char *ab_shm_ring_reserve(T ring, unsigned int len) {
+    assert(ring && ring->writer);
+
+    if (len > ring->size / 4)
+        return NULL;
+
+    uint64_t need = SHM_RING_ALIGN(sizeof(ab_shm_ring_record_header_t) + len);
+    uint64_t offset = ring->pos & (ring->size - 1);
+    uint64_t record_pos = ring->pos;
+    if (ring->size - offset < need)
+        record_pos += ring->size - offset;
+
+    // readers check reserve_pos after reading, it must be visible before any
+    // byte it covers is overwritten
+    __atomic_store_n(&ring->header->reserve_pos, record_pos + need, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (record_pos != ring->pos &&
+        ring->size - offset >= sizeof(ab_shm_ring_record_header_t)) {
+        ab_shm_ring_record_header_t *padding =
+            (ab_shm_ring_record_header_t *) (ring->data + offset);
+        padding->len    = 0;
+        padding->flags  = SHM_RING_PADDING;
+    }
+
+    ring->record_pos    = record_pos;
+    ring->next_pos      = record_pos + need;
+    ring->record_len    = len;
+    return ring->data + (record_pos & (ring->size - 1)) +
+        sizeof(ab_shm_ring_record_header_t);
+}
+
+void ab_shm_ring_commit(T ring, uint64_t timestamp, unsigned int flags) {
+    assert(ring && ring->writer);
+    assert(ring->next_pos > ring->pos);
+
+    ab_shm_ring_header_t *header = ring->header;
+    ab_shm_ring_record_header_t *record = (ab_shm_ring_record_header_t *)
+        (ring->data + (ring->record_pos & (ring->size - 1)));
+    record->len         = ring->record_len;
+    record->flags       = flags & ~SHM_RING_PADDING;
+    record->timestamp   = timestamp;
+
+    if (flags & AB_SHM_RING_KEY)
+        __atomic_store_n(&header->key_pos, ring->record_pos, __ATOMIC_RELAXED);
+    ring->pos = ring->next_pos;
+    __atomic_store_n(&header->write_pos, ring->pos, __ATOMIC_RELEASE);
+
+    // a reader about to sleep has registered before its last look at write_pos
+    __atomic_add_fetch(&header->notify, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&header->waiters, __ATOMIC_SEQ_CST) > 0)
+        futex(&header->notify, FUTEX_WAKE, INT32_MAX, NULL);
+}
+
+int ab_shm_ring_write(T ring, const unsigned char *data, unsigned int len,
+    uint64_t timestamp, unsigned int flags) {
+    assert(ring);
+
+    unsigned char *dst = ab_shm_ring_reserve(ring, len);
+    if (NULL == dst)
+        return -1;
+    if (len > 0)
+        memcpy(dst, data, len);
+    ab_shm_ring_commit(ring, timestamp, flags);
+
+    return len;
+}
+
+/*
+ * return: pos之后的字节还没有被覆盖
+ */
+static bool intact(T ring, uint64_t pos) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    uint64_t reserve_pos = __atomic_load_n(&ring->header->reserve_pos, __ATOMIC_RELAXED);
+    return reserve_pos <= pos + ring->size;
+}
+
+/*
+ * return: 0超时，1有新数据或被唤醒
+ */
+static int wait_data(T ring, int timeout_ms) {
+    ab_shm_ring_header_t *header = ring->header;
+
+    __atomic_add_fetch(&header->waiters, 1, __ATOMIC_SEQ_CST);
+    uint32_t notify = __atomic_load_n(&header->notify, __ATOMIC_SEQ_CST);
+    int result = 1;
+    if (__atomic_load_n(&header->write_pos, __ATOMIC_SEQ_CST) == ring->pos) {
+        struct timespec timeout;
+        timeout.tv_sec  = timeout_ms / 1000;
+        timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+        if (futex(&header->notify, FUTEX_WAIT, notify, &timeout) != 0 &&
+            ETIMEDOUT == errno)
+            result = 0;
+    }
+    __atomic_sub_fetch(&header->waiters, 1, __ATOMIC_SEQ_CST);
+
+    return result;
+}
+
+static void resync(T ring) {
+    ring->pos               = start_pos(ring);
+    ring->discontinuity     = true;
+    ring->restart_pending   = false;
+}
+
+int ab_shm_ring_read(T ring, ab_shm_ring_record_t *record, int timeout_ms) {
+    assert(ring && !ring->writer);
+    assert(record);
+
+    ab_shm_ring_header_t *header = ring->header;
+    for (;;) {
+        if (__atomic_load_n(&header->unlinked, __ATOMIC_ACQUIRE))
+            return -1;
+
+        // a restarted writer continues from write_pos, what we had not read
+        // yet is still there unless it was overrun
+        uint32_t generation = __atomic_load_n(&header->generation, __ATOMIC_ACQUIRE);
+        if (generation != ring->generation) {
+            ring->generation        = generation;
+            ring->restart_pos       = __atomic_load_n(&header->restart_pos, __ATOMIC_RELAXED);
+            ring->restart_pending   = true;
+        }
+
+        uint64_t write_pos = __atomic_load_n(&header->write_pos, __ATOMIC_ACQUIRE);
+        if (write_pos == ring->pos) {
+            if (0 == wait_data(ring, timeout_ms))
+                return 0;
+            continue;
+        }
+        // overrun, or a restarted writer gave up a record we were reading
+        if (write_pos - ring->pos > ring->size) {
+            resync(ring);
+            continue;
+        }
+
+        uint64_t offset = ring->pos & (ring->size - 1);
+        if (ring->size - offset < sizeof(ab_shm_ring_record_header_t)) {
+            ring->pos += ring->size - offset;
+            continue;
+        }
+
+        const ab_shm_ring_record_header_t *header_data =
+            (const ab_shm_ring_record_header_t *) (ring->data + offset);
+        ab_shm_ring_record_header_t copy = *header_data;
+        if (!intact(ring, ring->pos)) {
+            resync(ring);
+            continue;
+        }
+
+        if (copy.flags & SHM_RING_PADDING) {
+            ring->pos += ring->size - offset;
+            continue;
+        }
+        if (copy.len > ring->size / 4 ||
+            SHM_RING_ALIGN(sizeof(copy) + copy.len) > write_pos - ring->pos) {
+            resync(ring);
+            continue;
+        }
+
+        if (ring->restart_pending && ring->pos >= ring->restart_pos) {
+            ring->restart_pending   = false;
+            ring->discontinuity     = true;
+        }
+
+        record->data            = ring->data + offset + sizeof(copy);
+        record->len             = copy.len;
+        record->flags           = copy.flags;
+        record->timestamp       = copy.timestamp;
+        record->discontinuity   = ring->discontinuity;
+        ring->discontinuity     = false;
+        ring->record_pos        = ring->pos;
+        ring->next_pos          = ring->pos + SHM_RING_ALIGN(sizeof(copy) + copy.len);
+        return 1;
+    }
+}
+
+bool ab_shm_ring_release(T ring) {
+    assert(ring && !ring->writer);
+    assert(ring->next_pos > ring->record_pos);
+
+    bool result = intact(ring, ring->record_pos);
+    ring->pos = ring->next_pos;
+    if (!result)
+        ring->discontinuity = true;
+
+    return result;
+}
@@ -0,0 +1,94 @@
+/*
+ * ab_shm_ring.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_BASE_AB_SHM_RING_H_
+#define AB_BASE_AB_SHM_RING_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum ab_shm_ring_flag_t {
+    AB_SHM_RING_KEY         = 0x01,     // 关键帧的第一条记录(参数集或IDR)，新的读者从这里开始
+    AB_SHM_RING_FRAME_END   = 0x02,     // 一帧的最后一条记录
+} ab_shm_ring_flag_t;
+
+typedef struct ab_shm_ring_record_t {
+    const unsigned char *data;          // 指向共享内存，ab_shm_ring_release前有效
+    unsigned int    len;
+    unsigned int    flags;              // @ab_shm_ring_flag_t
+    uint64_t        timestamp;
+    bool            discontinuity;      // 写者重启或读者被覆盖，之前的记录有丢失
+} ab_shm_ring_record_t;
+
+/*
+ * 共享内存(shm_open)环形缓冲：一个写者，任意多个读者
+ * 写者从不等待读者，读得太慢的读者被覆盖后跳到最近的关键帧；
+ * 读者在记录上原地读，没有数据时在futex上等待，写者只在有人等待时唤醒
+ * 写者重启后从原来的位置继续写，读者看到discontinuity；
+ * 换了大小的写者会重建共享内存，旧的读者ab_shm_ring_read返回-1后重新打开
+ */
+#define T ab_shm_ring_t
+typedef struct T *T;
+
+/*
+ * 写者
+ * name: shm_open的名字，如"/ab_rtsp"
+ * size: 数据区字节数，向上取2的幂，单条记录最多size的1/4
+ * return: 失败返回NULL
+ */
+extern T    ab_shm_ring_create(const char *name, unsigned int size);
+/*
+ * 读者，从最近的关键帧开始读，没有时从最新的位置开始
+ * return: 不存在或写者还没初始化完返回NULL
+ */
+extern T    ab_shm_ring_open(const char *name);
+/*
+ * 只解除映射，共享内存留给重启的写者和其他读者
+ */
+extern void ab_shm_ring_close(T *ring);
+/*
+ * 删除共享内存，已打开的读者读到-1
+ */
+extern int  ab_shm_ring_unlink(const char *name);
+
+/*
+ * 写者：在共享内存中预留len字节，写入后用ab_shm_ring_commit发布，不需要另外拷贝
+ * return: len太大返回NULL
+ */
+extern unsigned char *ab_shm_ring_reserve(T ring, unsigned int len);
+/*
+ * flags: @ab_shm_ring_flag_t
+ */
+extern void ab_shm_ring_commit(T ring, uint64_t timestamp, unsigned int flags);
+/*
+ * reserve + memcpy + commit
+ */
+extern int  ab_shm_ring_write(T ring, const unsigned char *data, unsigned int len,
+    uint64_t timestamp, unsigned int flags);
+
+/*
+ * 读者：取下一条记录，处理完后调用ab_shm_ring_release
+ * timeout_ms: 没有数据时最多等待的时间
+ * return: 1有记录，0超时，-1共享内存已被删除或重建
+ */
+extern int  ab_shm_ring_read(T ring, ab_shm_ring_record_t *record, int timeout_ms);
+/*
+ * return: 读的过程中记录被写者覆盖返回false，下一条记录带discontinuity
+ */
+extern bool ab_shm_ring_release(T ring);
+
+#undef T
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AB_BASE_AB_SHM_RING_H_ */
@@ -0,0 +1,219 @@
+/*
+ * ab_timer_wheel.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_timer_wheel.h"
+
+#include "ab_mem.h"
+#include "ab_assert.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+#define WHEEL_LEVELS    4
+#define WHEEL_BITS      6
+#define WHEEL_SLOTS     (1 << WHEEL_BITS)
+#define WHEEL_MASK      (WHEEL_SLOTS - 1)
+#define WHEEL_MAX_TICKS ((1ULL << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+
+#define T ab_timer_wheel_t
+
+struct ab_timer_t {
+    struct ab_timer_t *prev;
+    struct ab_timer_t *next;
+    uint64_t        expires;            // in ticks
+    void          (*callback)(void *);
+    void           *arg;
+};
+
+struct T {
+    unsigned int    tick_ms;
+    uint64_t        start_ms;
+    uint64_t        now;                // in ticks since start_ms
+    unsigned int    count;
+
+    // circular lists, the slot itself is the sentinel
+    struct ab_timer_t slots[WHEEL_LEVELS][WHEEL_SLOTS];
+};
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void list_init(struct ab_timer_t *head) {
+    head->prev = head;
+    head->next = head;
+}
+
+static void list_unlink(struct ab_timer_t *timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->prev = timer;
+    timer->next = timer;
+}
+
+static void list_insert(struct ab_timer_t *head, struct ab_timer_t *timer) {
+    timer->prev         = head->prev;
+    timer->next         = head;
+    head->prev->next    = timer;
+    head->prev          = timer;
+}
+
+/*
+ * 越远的定时器放在越高的层，低层转完一圈时再逐级下放
+ */
+static void wheel_insert(T wheel, struct ab_timer_t *timer) {
+    uint64_t delta = timer->expires - wheel->now;
+
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 &&
+        delta >= (1ULL << (WHEEL_BITS * (level + 1))))
+        ++level;
+
+    unsigned int slot = (timer->expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    list_insert(&wheel->slots[level][slot], timer);
+}
+
+static uint64_t to_ticks(T wheel, unsigned int timeout_ms) {
+    uint64_t ticks = (timeout_ms + wheel->tick_ms - 1) / wheel->tick_ms;
+    if (0 == ticks)
+        ticks = 1;
+    else if (ticks > WHEEL_MAX_TICKS)
+        ticks = WHEEL_MAX_TICKS;
+    return ticks;
+}
+
+T ab_timer_wheel_new(unsigned int tick_ms) {
+    assert(tick_ms > 0);
+
+    T wheel;
+    NEW(wheel);
+
+    wheel->tick_ms  = tick_ms;
+    wheel->start_ms = now_ms();
+    wheel->now      = 0;
+    wheel->count    = 0;
+
+    for (int l = 0; l < WHEEL_LEVELS; ++l) {
+        for (int s = 0; s < WHEEL_SLOTS; ++s)
+            list_init(&wheel->slots[l][s]);
+    }
+
+    return wheel;
+}
+
+void ab_timer_wheel_free(T *wheel) {
+    assert(wheel && *wheel);
+
+    for (int l = 0; l < WHEEL_LEVELS; ++l) {
+        for (int s = 0; s < WHEEL_SLOTS; ++s) {
+            struct ab_timer_t *head = &(*wheel)->slots[l][s];
+            while (head->next != head) {
+                struct ab_timer_t *timer = head->next;
+                list_unlink(timer);
+                FREE(timer);
+            }
+        }
+    }
+
+    FREE(*wheel);
+}
+
+ab_timer_t ab_timer_wheel_add(T wheel, unsigned int timeout_ms,
+    void (*cb)(void *), void *arg) {
+    assert(wheel);
+    assert(cb);
+
+    struct ab_timer_t *timer;
+    NEW(timer);
+
+    timer->callback = cb;
+    timer->arg      = arg;
+    timer->expires  = wheel->now + to_ticks(wheel, timeout_ms);
+    wheel_insert(wheel, timer);
+    ++wheel->count;
+
+    return timer;
+}
+
+void ab_timer_wheel_cancel(T wheel, ab_timer_t *timer) {
+    assert(wheel);
+    assert(timer && *timer);
+
+    list_unlink(*timer);
+    --wheel->count;
+    FREE(*timer);
+}
+
+void ab_timer_wheel_restart(T wheel, ab_timer_t timer, unsigned int timeout_ms) {
+    assert(wheel);
+    assert(timer);
+
+    list_unlink(timer);
+    timer->expires = wheel->now + to_ticks(wheel, timeout_ms);
+    wheel_insert(wheel, timer);
+}
+
+/*
+ * 把第level层当前槽中的定时器重新放到低层
+ */
+static void cascade(T wheel, int level) {
+    unsigned int slot = (wheel->now >> (WHEEL_BITS * level)) & WHEEL_MASK;
+
+    struct ab_timer_t *head = &wheel->slots[level][slot];
+    while (head->next != head) {
+        struct ab_timer_t *timer = head->next;
+        list_unlink(timer);
+        wheel_insert(wheel, timer);
+    }
+}
+
+int ab_timer_wheel_advance(T wheel) {
+    assert(wheel);
+
+    uint64_t target = (now_ms() - wheel->start_ms) / wheel->tick_ms;
+    int fired = 0;
+
+    while (wheel->now < target) {
+        ++wheel->now;
+
+        for (int level = 1; level < WHEEL_LEVELS; ++level) {
+            if (wheel->now & ((1ULL << (WHEEL_BITS * level)) - 1))
+                break;
+            cascade(wheel, level);
+        }
+
+        // detach first: callbacks may add or cancel timers
+        struct ab_timer_t expired;
+        list_init(&expired);
+
+        struct ab_timer_t *head = &wheel->slots[0][wheel->now & WHEEL_MASK];
+        while (head->next != head) {
+            struct ab_timer_t *timer = head->next;
+            list_unlink(timer);
+            list_insert(&expired, timer);
+        }
+
+        while (expired.next != &expired) {
+            struct ab_timer_t *timer = expired.next;
+            list_unlink(timer);
+            --wheel->count;
+            timer->callback(timer->arg);
+            FREE(timer);
+            ++fired;
+        }
+    }
+
+    return fired;
+}
+
+unsigned int ab_timer_wheel_count(T wheel) {
+    assert(wheel);
+    return wheel->count;
+}
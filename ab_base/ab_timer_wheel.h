@@ -0,0 +1,59 @@
+/*
+ * ab_timer_wheel.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_BASE_AB_TIMER_WHEEL_H_
+#define AB_BASE_AB_TIMER_WHEEL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 分层时间轮，4层x64槽，添加/取消O(1)
+ * 非线程安全，由调用者所在的事件循环驱动
+ */
+#define T ab_timer_wheel_t
+typedef struct T *T;
+
+typedef struct ab_timer_t *ab_timer_t;
+
+/*
+ * tick_ms: 精度，最长定时tick_ms * 64^4
+ */
+extern T    ab_timer_wheel_new(unsigned int tick_ms);
+/*
+ * 未到期的定时器直接释放，不回调
+ */
+extern void ab_timer_wheel_free(T *wheel);
+
+/*
+ * 到期后在ab_timer_wheel_advance中回调一次，回调返回后定时器自动释放
+ */
+extern ab_timer_t ab_timer_wheel_add(T wheel, unsigned int timeout_ms,
+    void (*cb)(void *), void *arg);
+extern void ab_timer_wheel_cancel(T wheel, ab_timer_t *timer);
+/*
+ * 从现在起重新计时，只能用于未到期的定时器
+ */
+extern void ab_timer_wheel_restart(T wheel, ab_timer_t timer,
+    unsigned int timeout_ms);
+
+/*
+ * 推进到当前时间(CLOCK_MONOTONIC)并回调到期的定时器
+ * return: 回调的个数
+ */
+extern int  ab_timer_wheel_advance(T wheel);
+
+extern unsigned int ab_timer_wheel_count(T wheel);
+
+#undef T
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AB_BASE_AB_TIMER_WHEEL_H_ */
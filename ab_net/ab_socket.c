@@ -5,6 +5,10 @@
  *      Author: ljm
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE                     // accept4
+#endif
+
 #include "ab_socket.h"
 
 #include "ab_base/ab_assert.h"
@@ -19,7 +23,13 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#ifdef __linux__
+#include <linux/sockios.h>
+#endif
 #endif
 
 #define T ab_socket_t
@@ -38,6 +48,7 @@ static int ab_socket_set_addr(int type, struct sockaddr *sock_addr,
         const char *addr, unsigned short port);
 static int ab_socket_get_addr(int type, const struct sockaddr *sock_addr,
         char *addr_buf, unsigned int buf_size, unsigned short *port);
+static int ab_socket_set_int(T sock, int level, int name, int value);
 
 T ab_socket_new(int sock_type) {
     int af = 0, type = 0;
@@ -132,7 +143,7 @@ int ab_socket_connect(T sock,
     return connect(sock->fd, &sock->addr, sizeof(sock->addr));
 }
 
-T ab_socket_accept(T sock) {
+T ab_socket_accept(T sock, bool nonblock) {
     assert(sock);
     assert(sock->fd > 0);
 
@@ -144,7 +155,13 @@ T ab_socket_accept(T sock) {
     socklen_t len = sizeof(conn_addr);
 #endif
 
+#ifdef __linux__
+    // one syscall, and no window where the fd leaks into a forked child
+    int conn_fd = accept4(sock->fd, &conn_addr, &len,
+        SOCK_CLOEXEC | (nonblock ? SOCK_NONBLOCK : 0));
+#else
     int conn_fd = accept(sock->fd, &conn_addr, &len);
+#endif
     if (conn_fd > 0) {
         T new_sock;
         NEW(new_sock);
@@ -154,6 +171,11 @@ T ab_socket_accept(T sock) {
         new_sock->type = sock->type;
         memcpy(&new_sock->addr, &conn_addr, len);
 
+#ifndef __linux__
+        if (nonblock)
+            ab_socket_set_nonblock(new_sock, true);
+#endif
+
         return new_sock;
     }
 
@@ -174,6 +196,20 @@ int ab_socket_send(T sock, const unsigned char *data, unsigned int data_len) {
     return -1;
 }
 
+int ab_socket_try_send(T sock, const unsigned char *data, unsigned int data_len) {
+    assert(sock);
+    if (sock->fd <= 0)
+        return -1;
+
+    if (NULL == data || 0 == data_len)
+        return -1;
+
+    if (AB_SOCKET_TCP_INET == sock->type ||
+        AB_SOCKET_TCP_INET6 == sock->type)
+        return send(sock->fd, data, data_len, MSG_DONTWAIT);
+    return -1;
+}
+
 int ab_socket_recv(T sock, unsigned char *buf, unsigned int buf_size) {
     assert(sock);
     assert(sock->fd > 0);
@@ -331,10 +367,219 @@ int ab_socket_reuse_port(T sock) {
     assert(sock->fd > 0);
 
     int opt_val = 0x1;
-#ifdef __APPLE_CC__
+#ifdef SO_REUSEPORT
+    // Linux 3.9+: the kernel spreads new connections over all the sockets
     if (setsockopt(sock->fd, SOL_SOCKET, SO_REUSEPORT,
                    &opt_val, sizeof(opt_val)) == -1)
         return -1;
+    return 0;
+#else
+    (void) opt_val;
+    return -1;
 #endif
+}
+
+int ab_socket_set_nonblock(T sock, bool nonblock) {
+    assert(sock);
+    assert(sock->fd > 0);
+
+#ifdef __MINGW32__
+    u_long mode = nonblock ? 1 : 0;
+    if (ioctlsocket(sock->fd, FIONBIO, &mode) != 0)
+        return -1;
+#else
+    int flags = fcntl(sock->fd, F_GETFL, 0);
+    if (-1 == flags)
+        return -1;
+    flags = nonblock ? flags | O_NONBLOCK : flags & ~O_NONBLOCK;
+    if (fcntl(sock->fd, F_SETFL, flags) == -1)
+        return -1;
+#endif
+    return 0;
+}
+
+int ab_socket_send_queue(T sock) {
+    assert(sock);
+    assert(sock->fd > 0);
+
+#ifdef SIOCOUTQ
+    int queued = 0;
+    if (ioctl(sock->fd, SIOCOUTQ, &queued) == -1)
+        return -1;
+    return queued;
+#else
+    return -1;
+#endif
+}
+
+int ab_socket_send_buffer(T sock) {
+    assert(sock);
+    assert(sock->fd > 0);
+
+    int size = 0;
+#ifdef __MINGW32__
+    int len = sizeof(size);
+    if (getsockopt(sock->fd, SOL_SOCKET, SO_SNDBUF, (char *) &size, &len) == -1)
+#else
+    socklen_t len = sizeof(size);
+    if (getsockopt(sock->fd, SOL_SOCKET, SO_SNDBUF, &size, &len) == -1)
+#endif
+        return -1;
+
+    return size;
+}
+
+int ab_socket_recv_buffer(T sock) {
+    assert(sock);
+    assert(sock->fd > 0);
+
+    int size = 0;
+#ifdef __MINGW32__
+    int len = sizeof(size);
+    if (getsockopt(sock->fd, SOL_SOCKET, SO_RCVBUF, (char *) &size, &len) == -1)
+#else
+    socklen_t len = sizeof(size);
+    if (getsockopt(sock->fd, SOL_SOCKET, SO_RCVBUF, &size, &len) == -1)
+#endif
+        return -1;
+
+    return size;
+}
+
+int ab_socket_set_nodelay(T sock, bool nodelay) {
+    assert(sock);
+    assert(sock->fd > 0);
+
+    if (sock->type != AB_SOCKET_TCP_INET && sock->type != AB_SOCKET_TCP_INET6)
+        return -1;
+    return ab_socket_set_int(sock, IPPROTO_TCP, TCP_NODELAY, nodelay ? 1 : 0);
+}
+
+int ab_socket_set_send_buffer(T sock, int size) {
+    assert(sock);
+    assert(sock->fd > 0);
+    assert(size > 0);
+
+#ifdef SO_SNDBUFFORCE
+    // CAP_NET_ADMIN may go past net.core.wmem_max
+    if (ab_socket_set_int(sock, SOL_SOCKET, SO_SNDBUFFORCE, size) == 0)
+        return 0;
+#endif
+    return ab_socket_set_int(sock, SOL_SOCKET, SO_SNDBUF, size);
+}
+
+int ab_socket_set_recv_buffer(T sock, int size) {
+    assert(sock);
+    assert(sock->fd > 0);
+    assert(size > 0);
+
+#ifdef SO_RCVBUFFORCE
+    if (ab_socket_set_int(sock, SOL_SOCKET, SO_RCVBUFFORCE, size) == 0)
+        return 0;
+#endif
+    return ab_socket_set_int(sock, SOL_SOCKET, SO_RCVBUF, size);
+}
+
+int ab_socket_set_send_timeout(T sock, unsigned int timeout_ms) {
+    assert(sock);
+    assert(sock->fd > 0);
+
+#ifdef __MINGW32__
+    DWORD timeout = timeout_ms;
+    if (setsockopt(sock->fd, SOL_SOCKET, SO_SNDTIMEO,
+            (const char *) &timeout, sizeof(timeout)) == -1)
+#else
+    struct timeval timeout;
+    timeout.tv_sec  = timeout_ms / 1000;
+    timeout.tv_usec = (timeout_ms % 1000) * 1000;
+    if (setsockopt(sock->fd, SOL_SOCKET, SO_SNDTIMEO,
+                   &timeout, sizeof(timeout)) == -1)
+#endif
+        return -1;
+
+    return 0;
+}
+
+int ab_socket_set_user_timeout(T sock, unsigned int timeout_ms) {
+    assert(sock);
+    assert(sock->fd > 0);
+
+#ifdef TCP_USER_TIMEOUT
+    if (sock->type != AB_SOCKET_TCP_INET && sock->type != AB_SOCKET_TCP_INET6)
+        return -1;
+    return ab_socket_set_int(sock, IPPROTO_TCP, TCP_USER_TIMEOUT, timeout_ms);
+#else
+    (void) timeout_ms;
+    return -1;
+#endif
+}
+
+int ab_socket_set_tos(T sock, int tos) {
+    assert(sock);
+    assert(sock->fd > 0);
+    assert(tos >= 0 && tos <= 0xff);
+
+#ifndef __MINGW32__
+    if (AB_SOCKET_TCP_INET6 == sock->type || AB_SOCKET_UDP_INET6 == sock->type)
+        return ab_socket_set_int(sock, IPPROTO_IPV6, IPV6_TCLASS, tos);
+#endif
+    return ab_socket_set_int(sock, IPPROTO_IP, IP_TOS, tos);
+}
+
+int ab_socket_set_priority(T sock, int priority) {
+    assert(sock);
+    assert(sock->fd > 0);
+
+#ifdef SO_PRIORITY
+    return ab_socket_set_int(sock, SOL_SOCKET, SO_PRIORITY, priority);
+#else
+    (void) priority;
+    return -1;
+#endif
+}
+
+int ab_socket_set_options(T sock, const ab_socket_options_t *options) {
+    assert(sock);
+    assert(options);
+
+    // apply everything that was asked for, report if anything failed
+    int result = 0;
+    if ((options->mask & AB_SOCKET_OPT_NONBLOCK) &&
+        ab_socket_set_nonblock(sock, options->nonblock) != 0)
+        result = -1;
+    if ((options->mask & AB_SOCKET_OPT_NODELAY) &&
+        ab_socket_set_nodelay(sock, options->nodelay) != 0)
+        result = -1;
+    if ((options->mask & AB_SOCKET_OPT_SEND_BUFFER) &&
+        ab_socket_set_send_buffer(sock, options->send_buffer) != 0)
+        result = -1;
+    if ((options->mask & AB_SOCKET_OPT_RECV_BUFFER) &&
+        ab_socket_set_recv_buffer(sock, options->recv_buffer) != 0)
+        result = -1;
+    if ((options->mask & AB_SOCKET_OPT_SEND_TIMEOUT) &&
+        ab_socket_set_send_timeout(sock, options->send_timeout_ms) != 0)
+        result = -1;
+    if ((options->mask & AB_SOCKET_OPT_USER_TIMEOUT) &&
+        ab_socket_set_user_timeout(sock, options->user_timeout_ms) != 0)
+        result = -1;
+    if ((options->mask & AB_SOCKET_OPT_TOS) &&
+        ab_socket_set_tos(sock, options->tos) != 0)
+        result = -1;
+    if ((options->mask & AB_SOCKET_OPT_PRIORITY) &&
+        ab_socket_set_priority(sock, options->priority) != 0)
+        result = -1;
+
+    return result;
+}
+
+int ab_socket_set_int(T sock, int level, int name, int value) {
+#ifdef __MINGW32__
+    if (setsockopt(sock->fd, level, name,
+            (const char *) &value, sizeof(value)) == -1)
+#else
+    if (setsockopt(sock->fd, level, name, &value, sizeof(value)) == -1)
+#endif
+        return -1;
+
     return 0;
 }
@@ -12,6 +12,8 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
+
 #define T ab_socket_t
 typedef struct T *T;
 
@@ -29,9 +31,18 @@ extern void ab_socket_free(T *sock);
 extern int  ab_socket_bind(T sock, const char *bind_addr, unsigned short bind_port);
 extern int  ab_socket_listen(T sock, int back_log);
 extern int  ab_socket_connect(T sock, const char *conn_addr, unsigned short conn_port);
-extern T    ab_socket_accept(T sock);
+/*
+ * nonblock: 新连接设为非阻塞；Linux上用accept4，同时设置close-on-exec
+ * return: 没有待接受的连接或出错返回NULL，errno说明原因
+ */
+extern T    ab_socket_accept(T sock, bool nonblock);
 
 extern int  ab_socket_send(T sock, const unsigned char *data, unsigned int data_len);
+/*
+ * MSG_DONTWAIT，阻塞socket也不等待，可能只发出一部分
+ * return: 发送缓冲区满时返回-1，errno为EAGAIN
+ */
+extern int  ab_socket_try_send(T sock, const unsigned char *data, unsigned int data_len);
 extern int  ab_socket_recv(T sock, unsigned char *buf, unsigned int buf_size);
 extern int  ab_socket_udp_send(T sock, const char *to_addr, unsigned short to_port,
                                const unsigned char *data, unsigned int data_len);
@@ -43,7 +54,95 @@ extern int  ab_socket_addr(T sock, char *buf, unsigned int buf_size);
 extern int  ab_socket_port(T sock, unsigned short *port);
 
 extern int  ab_socket_reuse_addr(T sock);
+/*
+ * SO_REUSEPORT，必须在bind之前；不支持时返回-1
+ */
 extern int  ab_socket_reuse_port(T sock);
+extern int  ab_socket_set_nonblock(T sock, bool nonblock);
+
+/*
+ * 发送队列中未被确认的字节数，不支持时返回-1
+ */
+extern int  ab_socket_send_queue(T sock);
+extern int  ab_socket_send_buffer(T sock);
+extern int  ab_socket_recv_buffer(T sock);
+
+/*
+ * TCP_NODELAY，只对TCP有效
+ */
+extern int  ab_socket_set_nodelay(T sock, bool nodelay);
+/*
+ * SO_SNDBUF/SO_RCVBUF，有权限时用*BUFFORCE越过系统上限
+ * 内核实际分配的是size的两倍，可用ab_socket_send_buffer/ab_socket_recv_buffer读回
+ */
+extern int  ab_socket_set_send_buffer(T sock, int size);
+extern int  ab_socket_set_recv_buffer(T sock, int size);
+/*
+ * SO_SNDTIMEO，阻塞发送最多等待timeout_ms，超时后可能只发出一部分；0表示一直等
+ */
+extern int  ab_socket_set_send_timeout(T sock, unsigned int timeout_ms);
+/*
+ * TCP_USER_TIMEOUT，已发送数据超过timeout_ms未被确认时断开；不支持时返回-1
+ */
+extern int  ab_socket_set_user_timeout(T sock, unsigned int timeout_ms);
+/*
+ * IP_TOS，IPv6为IPV6_TCLASS；DSCP用AB_SOCKET_DSCP()换算
+ */
+extern int  ab_socket_set_tos(T sock, int tos);
+/*
+ * SO_PRIORITY，本机排队规则用的优先级(0~6)；不支持时返回-1
+ */
+extern int  ab_socket_set_priority(T sock, int priority);
+
+#define AB_SOCKET_DSCP(dscp)    ((dscp) << 2)   // DSCP is the upper 6 bits of TOS
+
+// RFC 4594 service classes
+#define AB_SOCKET_DSCP_CS0      0
+#define AB_SOCKET_DSCP_AF41     34      // multimedia conferencing
+#define AB_SOCKET_DSCP_CS4      32      // real-time interactive
+#define AB_SOCKET_DSCP_EF       46      // telephony
+
+enum {
+    AB_SOCKET_OPT_NONBLOCK      = 0x01,
+    AB_SOCKET_OPT_NODELAY       = 0x02,
+    AB_SOCKET_OPT_SEND_BUFFER   = 0x04,
+    AB_SOCKET_OPT_RECV_BUFFER   = 0x08,
+    AB_SOCKET_OPT_SEND_TIMEOUT  = 0x10,
+    AB_SOCKET_OPT_USER_TIMEOUT  = 0x20,
+    AB_SOCKET_OPT_TOS           = 0x40,
+    AB_SOCKET_OPT_PRIORITY      = 0x80
+};
+
+/*
+ * 一组套接字选项，只设置mask中列出的项
+ */
+typedef struct ab_socket_options_t {
+    unsigned int    mask;               // AB_SOCKET_OPT_*
+    bool            nonblock;
+    bool            nodelay;
+    int             send_buffer;        // bytes
+    int             recv_buffer;        // bytes
+    unsigned int    send_timeout_ms;
+    unsigned int    user_timeout_ms;
+    int             tos;
+    int             priority;
+} ab_socket_options_t;
+
+/*
+ * return: 全部成功返回0；某项失败时其余项照常设置，返回-1
+ * TOS在PRIORITY之前设置：Linux设置IP_TOS时会按TOS改写SO_PRIORITY
+ */
+extern int  ab_socket_set_options(T sock, const ab_socket_options_t *options);
+
+/*
+ * 流媒体中套接字的用途，各自有一组默认选项
+ */
+enum {
+    AB_SOCKET_ROLE_CONTROL      = 0,    // RTSP连接，RTP over TCP时也承载媒体
+    AB_SOCKET_ROLE_RTP,
+    AB_SOCKET_ROLE_RTCP,
+    AB_SOCKET_ROLE_COUNT
+};
 
 #undef T
 
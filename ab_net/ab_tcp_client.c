@@ -73,4 +73,10 @@ int ab_tcp_client_recv(T t, unsigned char *buf, unsigned int buf_size, int timeo
 int  ab_tcp_client_send(T t, const unsigned char *data, unsigned int data_len) {
     assert(t);
     return ab_socket_send(t->sock, data, data_len);
-}
\ No newline at end of file
+}
+
+ab_socket_t ab_tcp_client_socket(T t) {
+    assert(t);
+
+    return t->sock;
+}
@@ -12,6 +12,8 @@
 extern "C" {
 #endif
 
+#include "ab_socket.h"
+
 #define T ab_tcp_client_t
 typedef struct T *T;
 
@@ -21,6 +23,11 @@ extern void ab_tcp_client_free(T *t);
 extern int  ab_tcp_client_recv(T t, unsigned char *buf, unsigned int buf_size, int timeout);
 extern int  ab_tcp_client_send(T t, const unsigned char *data, unsigned int data_len);
 
+/*
+ * 底层套接字，用于设置套接字选项
+ */
+extern ab_socket_t ab_tcp_client_socket(T t);
+
 #undef T
 
 #ifdef __cplusplus
@@ -14,11 +14,15 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <errno.h>
 #include <pthread.h>
 
 #ifdef WIN32
 #else
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/select.h>
+#include <sys/socket.h>
 #endif
 
 #define T   ab_tcp_server_t
@@ -27,6 +31,12 @@ struct T {
     ab_socket_t sock;
     void (*new_conn_cb)(void *sock, void *user_data);
     void *user_data;
+    bool nonblock;                      // for the accepted connections
+
+    // spare descriptor, given up to drain the queue when out of fds
+    int reserve_fd;
+
+    bool own_thread;
     bool quit;
     pthread_t acceptor_thd;
 
@@ -35,30 +45,50 @@ struct T {
 
 static void *accept_event_loop_func(void *arg);
 
-T ab_tcp_server_new(unsigned short port,
+T ab_tcp_server_listen(unsigned short port, int backlog, bool reuse_port,
     void new_conn_cb(void *sock, void *user_data), void *user_data) {
     assert(port != 0);
 
-    T tcp_server;
-    NEW(tcp_server);
-    assert(tcp_server);
-    tcp_server->sock = ab_socket_new(AB_SOCKET_TCP_INET);
-    assert(tcp_server->sock);
+    ab_socket_t sock = ab_socket_new(AB_SOCKET_TCP_INET);
+    if (NULL == sock)
+        return NULL;
 
-    ab_socket_reuse_addr(tcp_server->sock);
+    ab_socket_reuse_addr(sock);
+    if (reuse_port && ab_socket_reuse_port(sock) != 0) {
+        ab_socket_free(&sock);
+        return NULL;
+    }
 
-    int ret = ab_socket_bind(tcp_server->sock, NULL, port);
-    assert(0 == ret);
+    // accept loops until EAGAIN
+    if (ab_socket_bind(sock, NULL, port) != 0 ||
+        ab_socket_set_nonblock(sock, true) != 0 ||
+        ab_socket_listen(sock, backlog > 0 ? backlog : SOMAXCONN) != 0) {
+        ab_socket_free(&sock);
+        return NULL;
+    }
 
-    ret = ab_socket_listen(tcp_server->sock, 10);
-    assert(0 == ret);
+    T tcp_server;
+    NEW(tcp_server);
+    assert(tcp_server);
 
+    tcp_server->sock        = sock;
     tcp_server->new_conn_cb = new_conn_cb;
-    tcp_server->user_data = user_data;
+    tcp_server->user_data   = user_data;
+    tcp_server->nonblock    = false;
+    tcp_server->reserve_fd  = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    tcp_server->own_thread  = false;
+    tcp_server->quit        = false;
+    tcp_server->error_num   = 0;
 
-    tcp_server->error_num = 0;
+    return tcp_server;
+}
+
+T ab_tcp_server_new(unsigned short port,
+    void new_conn_cb(void *sock, void *user_data), void *user_data) {
+    T tcp_server = ab_tcp_server_listen(port, 0, false, new_conn_cb, user_data);
+    assert(tcp_server);
 
-    tcp_server->quit = false;
+    tcp_server->own_thread = true;
     pthread_create(&tcp_server->acceptor_thd, NULL,
                    accept_event_loop_func, tcp_server);
 
@@ -68,17 +98,77 @@ T ab_tcp_server_new(unsigned short port,
 void ab_tcp_server_free(T *tcp_server) {
     assert(tcp_server && *tcp_server);
 
-    (*tcp_server)->quit = true;
-    pthread_join((*tcp_server)->acceptor_thd, NULL);
+    if ((*tcp_server)->own_thread) {
+        (*tcp_server)->quit = true;
+        pthread_join((*tcp_server)->acceptor_thd, NULL);
+    }
 
     if ((*tcp_server)->error_num != 0) {
         // TODO TCP Server acceptor isn't normal exit.
     }
 
+    if ((*tcp_server)->reserve_fd >= 0)
+        close((*tcp_server)->reserve_fd);
     ab_socket_free(&(*tcp_server)->sock);
     FREE(*tcp_server);
 }
 
+int ab_tcp_server_fd(T tcp_server) {
+    assert(tcp_server);
+    return ab_socket_fd(tcp_server->sock);
+}
+
+void ab_tcp_server_set_nonblock(T tcp_server, bool nonblock) {
+    assert(tcp_server);
+    tcp_server->nonblock = nonblock;
+}
+
+int ab_tcp_server_set_backlog(T tcp_server, int backlog) {
+    assert(tcp_server);
+    return ab_socket_listen(tcp_server->sock, backlog > 0 ? backlog : SOMAXCONN);
+}
+
+/*
+ * fd用完时队列里的连接永远接受不了，监听socket会一直可读：
+ * 用备用fd接受后立即关闭，客户端收到的是关闭而不是无限等待
+ */
+static void reject_pending(T tcp_server) {
+    if (tcp_server->reserve_fd < 0)
+        return;
+
+    close(tcp_server->reserve_fd);
+    int fd = accept(ab_socket_fd(tcp_server->sock), NULL, NULL);
+    if (fd >= 0)
+        close(fd);
+    tcp_server->reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
+
+int ab_tcp_server_accept(T tcp_server) {
+    assert(tcp_server);
+
+    int count = 0;
+    for (;;) {
+        ab_socket_t conn_sock = ab_socket_accept(tcp_server->sock,
+            tcp_server->nonblock);
+        if (NULL == conn_sock) {
+            if (EINTR == errno || ECONNABORTED == errno)
+                continue;
+            if (EMFILE == errno || ENFILE == errno)
+                reject_pending(tcp_server);
+            break;
+        }
+
+        ++count;
+        if (tcp_server->new_conn_cb != NULL) {
+            tcp_server->new_conn_cb(conn_sock, tcp_server->user_data);
+        } else {
+            ab_socket_free(&conn_sock);
+        }
+    }
+
+    return count;
+}
+
 void *accept_event_loop_func(void *arg) {
     assert(arg);
 
@@ -101,10 +191,7 @@ void *accept_event_loop_func(void *arg) {
         } else if (0 == num) {
             continue;
         } else {
-            ab_socket_t conn_sock = ab_socket_accept(tcp_server->sock);
-            if (tcp_server->new_conn_cb != NULL) {
-                tcp_server->new_conn_cb(conn_sock, tcp_server->user_data);
-            }
+            ab_tcp_server_accept(tcp_server);
         }
     }
 
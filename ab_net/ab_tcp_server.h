@@ -12,14 +12,46 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
+
 #define T ab_tcp_server_t
 typedef struct T *T;
 
+/*
+ * 自带accept线程，backlog为SOMAXCONN
+ */
 extern T    ab_tcp_server_new(unsigned short port, 
     void new_conn_cb(void *sock, void *user_data), void *user_data);
 
+/*
+ * 不带线程，由调用者的事件循环在ab_tcp_server_fd可读时调用ab_tcp_server_accept
+ * backlog: <=0时为SOMAXCONN(受net.core.somaxconn限制)
+ * reuse_port: SO_REUSEPORT，多个监听socket(可在不同进程)分担同一端口的连接
+ * return: 端口被占用等失败时返回NULL
+ */
+extern T    ab_tcp_server_listen(unsigned short port, int backlog, bool reuse_port,
+    void new_conn_cb(void *sock, void *user_data), void *user_data);
+
 extern void ab_tcp_server_free(T *tcp_server);
 
+extern int  ab_tcp_server_fd(T tcp_server);
+
+/*
+ * 接受所有待处理的连接直到EAGAIN，每个连接回调一次new_conn_cb
+ * return: 接受的连接数
+ */
+extern int  ab_tcp_server_accept(T tcp_server);
+
+/*
+ * 新连接是否为非阻塞，默认阻塞
+ */
+extern void ab_tcp_server_set_nonblock(T tcp_server, bool nonblock);
+
+/*
+ * 对正在监听的socket再次listen，修改backlog
+ */
+extern int  ab_tcp_server_set_backlog(T tcp_server, int backlog);
+
 #undef T
 
 #ifdef __cplusplus
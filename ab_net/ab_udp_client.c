@@ -82,3 +82,15 @@ int  ab_udp_client_send(T t,
     return ab_socket_udp_send(t->sock, 
         addr, port, data, data_len);
 }
+
+int ab_udp_client_fd(T t) {
+    assert(t);
+
+    return ab_socket_fd(t->sock);
+}
+
+ab_socket_t ab_udp_client_socket(T t) {
+    assert(t);
+
+    return t->sock;
+}
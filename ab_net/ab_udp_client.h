@@ -12,6 +12,8 @@
 extern "C" {
 #endif
 
+#include "ab_socket.h"
+
 #define T ab_udp_client_t
 typedef struct T *T;
 
@@ -25,6 +27,12 @@ extern int  ab_udp_client_send(T t,
     const char *addr, unsigned short port,
     const unsigned char *data, unsigned int data_len);
 
+extern int  ab_udp_client_fd(T t);
+/*
+ * 底层套接字，用于设置套接字选项
+ */
+extern ab_socket_t ab_udp_client_socket(T t);
+
 #undef T
 
 #ifdef __cplusplus
@@ -0,0 +1,95 @@
+/*
+ * ab_aac.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_aac.h"
+
+#include "ab_base/ab_assert.h"
+
+#include <stddef.h>
+
+// ISO/IEC 14496-3 Table 1.18, samplingFrequencyIndex
+static const unsigned int sample_rates[] = {
+    96000, 88200, 64000, 48000, 44100, 32000,
+    24000, 22050, 16000, 12000, 11025, 8000, 7350
+};
+
+#define SAMPLE_RATE_COUNT   (sizeof(sample_rates) / sizeof(sample_rates[0]))
+
+int ab_aac_sample_rate_index(unsigned int sample_rate) {
+    for (unsigned int i = 0; i < SAMPLE_RATE_COUNT; ++i) {
+        if (sample_rates[i] == sample_rate)
+            return i;
+    }
+    return -1;
+}
+
+int ab_aac_adts_parse(const unsigned char *data, unsigned int data_len,
+    ab_aac_adts_header_t *header) {
+    assert(data || 0 == data_len);
+    assert(header);
+
+    if (data_len < AB_AAC_ADTS_HEADER_SIZE ||
+        data[0] != 0xff || (data[1] & 0xf6) != 0xf0)   // syncword, layer 0
+        return -1;
+
+    bool protection_absent      = data[1] & 0x01;
+    unsigned int profile        = data[2] >> 6;
+    unsigned int sf_index       = (data[2] >> 2) & 0x0f;
+    unsigned int channels       = ((data[2] & 0x01) << 2) | (data[3] >> 6);
+    unsigned int frame_len      = ((data[3] & 0x03) << 11) | (data[4] << 3) |
+        (data[5] >> 5);
+    unsigned int raw_blocks     = (data[6] & 0x03) + 1;
+
+    if (sf_index >= SAMPLE_RATE_COUNT)
+        return -1;
+
+    header->config.object_type  = profile + 1;
+    header->config.sample_rate  = sample_rates[sf_index];
+    header->config.channels     = channels;
+    header->header_len          = protection_absent ? 7 : 9;
+    header->frame_len           = frame_len;
+    header->raw_data_blocks     = raw_blocks;
+
+    if (frame_len <= header->header_len)
+        return -1;
+    return 0;
+}
+
+int ab_aac_adts_find_sync(const unsigned char *data, unsigned int data_len) {
+    assert(data || 0 == data_len);
+
+    for (unsigned int i = 0; i + 1 < data_len; ++i) {
+        if (0xff == data[i] && 0xf0 == (data[i + 1] & 0xf6))
+            return i;
+    }
+    return -1;
+}
+
+int ab_aac_audio_specific_config(const ab_aac_config_t *config,
+    unsigned char *buf, unsigned int buf_size) {
+    assert(config);
+    assert(buf);
+
+    int sf_index = ab_aac_sample_rate_index(config->sample_rate);
+    if (buf_size < 2 || sf_index < 0 ||
+        config->object_type < 1 || config->object_type > 30 ||
+        config->channels > 7)
+        return -1;
+
+    // audioObjectType(5) | samplingFrequencyIndex(4) | channelConfiguration(4) |
+    // GASpecificConfig: frameLengthFlag, dependsOnCoreCoder, extensionFlag
+    buf[0] = (config->object_type << 3) | (sf_index >> 1);
+    buf[1] = ((sf_index & 0x01) << 7) | (config->channels << 3);
+    return 2;
+}
+
+bool ab_aac_config_equal(const ab_aac_config_t *a, const ab_aac_config_t *b) {
+    assert(a && b);
+
+    return a->object_type == b->object_type &&
+        a->sample_rate == b->sample_rate && a->channels == b->channels;
+}
@@ -0,0 +1,73 @@
+/*
+ * ab_aac.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_AAC_H_
+#define AB_AAC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define AB_AAC_OBJECT_TYPE_LC       2
+#define AB_AAC_FRAME_SAMPLES        1024    // samples per access unit
+#define AB_AAC_ADTS_HEADER_SIZE     7       // without CRC
+#define AB_AAC_ADTS_MAX_FRAME_SIZE  8191    // 13-bit frame_length
+
+/*
+ * AudioSpecificConfig(ISO/IEC 14496-3 1.6.2.1)中的基本参数
+ */
+typedef struct ab_aac_config_t {
+    unsigned int    object_type;        // 2: AAC-LC
+    unsigned int    sample_rate;
+    unsigned int    channels;           // channelConfiguration 1~7
+} ab_aac_config_t;
+
+/*
+ * ADTS头(ISO/IEC 13818-7 6.2)
+ */
+typedef struct ab_aac_adts_header_t {
+    ab_aac_config_t config;
+    unsigned int    header_len;         // 7，带CRC时为9
+    unsigned int    frame_len;          // 含头
+    unsigned int    raw_data_blocks;    // number_of_raw_data_blocks_in_frame + 1
+} ab_aac_adts_header_t;
+
+/*
+ * return: 采样率索引，不是标准采样率返回-1
+ */
+extern int  ab_aac_sample_rate_index(unsigned int sample_rate);
+
+/*
+ * data: 从syncword开始
+ * return: 0成功，不是ADTS头或长度不足返回-1
+ */
+extern int  ab_aac_adts_parse(const unsigned char *data, unsigned int data_len,
+    ab_aac_adts_header_t *header);
+
+/*
+ * 在data中查找下一个syncword
+ * return: 偏移，找不到返回-1
+ */
+extern int  ab_aac_adts_find_sync(const unsigned char *data, unsigned int data_len);
+
+/*
+ * 写2字节的AudioSpecificConfig
+ * return: 写入的长度，参数不合法返回-1
+ */
+extern int  ab_aac_audio_specific_config(const ab_aac_config_t *config,
+    unsigned char *buf, unsigned int buf_size);
+
+extern bool ab_aac_config_equal(const ab_aac_config_t *a, const ab_aac_config_t *b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_AAC_H_
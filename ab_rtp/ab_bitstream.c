@@ -0,0 +1,115 @@
+/*
+ * ab_bitstream.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_bitstream.h"
+
+#include "ab_base/ab_assert.h"
+
+#include <stddef.h>
+
+void ab_bitstream_init(ab_bitstream_t *bs,
+    const unsigned char *data, unsigned int size) {
+    assert(bs);
+    assert(data || 0 == size);
+
+    bs->data    = data;
+    bs->size    = size;
+    bs->pos     = 0;
+    bs->error   = false;
+}
+
+/*
+ * 当前位置起的32位，越过末尾的部分补0
+ */
+static inline uint32_t peek_bits32(const ab_bitstream_t *bs) {
+    unsigned int byte = bs->pos >> 3;
+    uint64_t value = 0;
+    for (unsigned int i = 0; i < 5; ++i)
+        value = (value << 8) | (byte + i < bs->size ? bs->data[byte + i] : 0);
+
+    return (uint32_t) (value >> (8 - (bs->pos & 7)));
+}
+
+uint32_t ab_bitstream_read_bits(ab_bitstream_t *bs, unsigned int n) {
+    assert(n <= 32);
+
+    if (bs->error || n > ab_bitstream_bits_left(bs)) {
+        bs->error = true;
+        return 0;
+    }
+    if (0 == n)
+        return 0;
+
+    uint32_t value = peek_bits32(bs) >> (32 - n);
+    bs->pos += n;
+    return value;
+}
+
+void ab_bitstream_skip_bits(ab_bitstream_t *bs, unsigned int n) {
+    if (bs->error || n > ab_bitstream_bits_left(bs)) {
+        bs->error = true;
+        return;
+    }
+
+    bs->pos += n;
+}
+
+uint32_t ab_bitstream_read_ue(ab_bitstream_t *bs) {
+    if (bs->error)
+        return 0;
+
+    // codeNum fits in 32 bits only up to 31 leading zeros
+    uint32_t bits = peek_bits32(bs);
+    if (0 == bits) {
+        bs->error = true;
+        return 0;
+    }
+
+    unsigned int leading_zeros = __builtin_clz(bits);
+    unsigned int length = 2 * leading_zeros + 1;
+    if (length > ab_bitstream_bits_left(bs)) {
+        bs->error = true;
+        return 0;
+    }
+
+    if (length <= 32) {
+        bs->pos += length;
+        return (bits >> (32 - length)) - 1;
+    }
+
+    bs->pos += leading_zeros + 1;
+    return (uint32_t) ((1ULL << leading_zeros) - 1) +
+        ab_bitstream_read_bits(bs, leading_zeros);
+}
+
+int32_t ab_bitstream_read_se(ab_bitstream_t *bs) {
+    uint32_t code = ab_bitstream_read_ue(bs);
+    // 1, -1, 2, -2, ...
+    if (code & 1)
+        return (int32_t) ((code >> 1) + 1);
+    return -(int32_t) (code >> 1);
+}
+
+unsigned int ab_bitstream_unescape(const unsigned char *nalu,
+    unsigned int nalu_len, unsigned char *rbsp, unsigned int rbsp_size) {
+    assert(nalu || 0 == nalu_len);
+    assert(rbsp);
+
+    unsigned int len = 0;
+    unsigned int zeros = 0;
+    for (unsigned int i = 0; i < nalu_len && len < rbsp_size; ++i) {
+        if (2 == zeros && 0x03 == nalu[i]) {
+            zeros = 0;
+            continue;
+        }
+
+        zeros = 0 == nalu[i] ? zeros + 1 : 0;
+        rbsp[len++] = nalu[i];
+    }
+
+    return len;
+}
@@ -0,0 +1,59 @@
+/*
+ * ab_bitstream.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_BITSTREAM_H_
+#define AB_BITSTREAM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * 按位读取RBSP，H.264/H.265 7.2的u(n)、ue(v)、se(v)
+ * 读越界后error置位，之后的读取都返回0
+ */
+typedef struct ab_bitstream_t {
+    const unsigned char *data;
+    unsigned int    size;               // bytes
+    unsigned int    pos;                // bits
+    bool            error;
+} ab_bitstream_t;
+
+extern void     ab_bitstream_init(ab_bitstream_t *bs,
+    const unsigned char *data, unsigned int size);
+
+/*
+ * n: 0~32
+ */
+extern uint32_t ab_bitstream_read_bits(ab_bitstream_t *bs, unsigned int n);
+extern void     ab_bitstream_skip_bits(ab_bitstream_t *bs, unsigned int n);
+extern uint32_t ab_bitstream_read_ue(ab_bitstream_t *bs);
+extern int32_t  ab_bitstream_read_se(ab_bitstream_t *bs);
+
+static inline bool ab_bitstream_read_flag(ab_bitstream_t *bs) {
+    return ab_bitstream_read_bits(bs, 1) != 0;
+}
+
+static inline unsigned int ab_bitstream_bits_left(const ab_bitstream_t *bs) {
+    return bs->pos < bs->size * 8 ? bs->size * 8 - bs->pos : 0;
+}
+
+/*
+ * 去掉emulation_prevention_three_byte(00 00 03)，NALU转为RBSP
+ * return: RBSP长度，最多rbsp_size字节
+ */
+extern unsigned int ab_bitstream_unescape(const unsigned char *nalu,
+    unsigned int nalu_len, unsigned char *rbsp, unsigned int rbsp_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_BITSTREAM_H_
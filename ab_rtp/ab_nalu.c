@@ -0,0 +1,221 @@
+/*
+ * ab_nalu.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_nalu.h"
+
+#include "ab_base/ab_assert.h"
+
+#include <stddef.h>
+
+int ab_h264_nalu_header_parse(const unsigned char *data,
+    unsigned int data_len, ab_h264_nalu_header_t *header) {
+    assert(header);
+
+    if (NULL == data || data_len < 1)
+        return -1;
+
+    header->forbidden_zero_bit  = data[0] >> 7;
+    header->nal_ref_idc         = (data[0] >> 5) & 0x03;
+    header->nal_unit_type       = data[0] & 0x1f;
+
+    return 0;
+}
+
+void ab_h264_nalu_header_write(const ab_h264_nalu_header_t *header,
+    unsigned char *buf) {
+    assert(header);
+    assert(buf);
+
+    buf[0] = ((header->forbidden_zero_bit & 0x01) << 7) |
+             ((header->nal_ref_idc & 0x03) << 5) |
+             (header->nal_unit_type & 0x1f);
+}
+
+int ab_h265_nalu_header_parse(const unsigned char *data,
+    unsigned int data_len, ab_h265_nalu_header_t *header) {
+    assert(header);
+
+    if (NULL == data || data_len < 2)
+        return -1;
+
+    header->forbidden_zero_bit      = data[0] >> 7;
+    header->nal_unit_type           = (data[0] >> 1) & 0x3f;
+    header->nuh_layer_id            = ((data[0] & 0x01) << 5) | (data[1] >> 3);
+    header->nuh_temporal_id_plus1   = data[1] & 0x07;
+
+    return 0;
+}
+
+void ab_h265_nalu_header_write(const ab_h265_nalu_header_t *header,
+    unsigned char *buf) {
+    assert(header);
+    assert(buf);
+
+    buf[0] = ((header->forbidden_zero_bit & 0x01) << 7) |
+             ((header->nal_unit_type & 0x3f) << 1) |
+             ((header->nuh_layer_id >> 5) & 0x01);
+    buf[1] = ((header->nuh_layer_id & 0x1f) << 3) |
+             (header->nuh_temporal_id_plus1 & 0x07);
+}
+
+int ab_nalu_find_start_code(const unsigned char *data, unsigned int data_len,
+    unsigned int *start_code_len) {
+    for (unsigned int i = 0; i + 3 <= data_len; ++i) {
+        // no start code begins at i, i + 1 or i + 2 unless data[i + 2] <= 1
+        if (data[i + 2] > 1) {
+            i += 2;
+            continue;
+        }
+        if (data[i] != 0x00 || data[i + 1] != 0x00)
+            continue;
+
+        if (0x01 == data[i + 2]) {
+            if (start_code_len)
+                *start_code_len = 3;
+            return i;
+        }
+        if (i + 4 <= data_len && 0x00 == data[i + 2] && 0x01 == data[i + 3]) {
+            if (start_code_len)
+                *start_code_len = 4;
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+unsigned int ab_nalu_header_size(int codec) {
+    if (AB_NALU_CODEC_H264 == codec)
+        return 1;
+    else if (AB_NALU_CODEC_H265 == codec)
+        return 2;
+
+    return 0;
+}
+
+bool ab_nalu_is_key(int codec, const unsigned char *nalu, unsigned int nalu_len) {
+    if (AB_NALU_CODEC_H264 == codec) {
+        ab_h264_nalu_header_t header;
+        if (ab_h264_nalu_header_parse(nalu, nalu_len, &header) < 0)
+            return false;
+        return 5 == header.nal_unit_type || 7 == header.nal_unit_type ||
+               8 == header.nal_unit_type;
+    } else if (AB_NALU_CODEC_H265 == codec) {
+        ab_h265_nalu_header_t header;
+        if (ab_h265_nalu_header_parse(nalu, nalu_len, &header) < 0)
+            return false;
+        return (header.nal_unit_type >= 16 && header.nal_unit_type <= 21) ||
+               (header.nal_unit_type >= 32 && header.nal_unit_type <= 34);
+    }
+
+    return false;
+}
+
+int ab_nalu_parameter_set(int codec,
+    const unsigned char *nalu, unsigned int nalu_len) {
+    if (AB_NALU_CODEC_H264 == codec) {
+        ab_h264_nalu_header_t header;
+        if (ab_h264_nalu_header_parse(nalu, nalu_len, &header) < 0)
+            return AB_NALU_PARAMETER_SET_NONE;
+        if (7 == header.nal_unit_type)
+            return AB_NALU_PARAMETER_SET_SPS;
+        if (8 == header.nal_unit_type)
+            return AB_NALU_PARAMETER_SET_PPS;
+    } else if (AB_NALU_CODEC_H265 == codec) {
+        ab_h265_nalu_header_t header;
+        if (ab_h265_nalu_header_parse(nalu, nalu_len, &header) < 0)
+            return AB_NALU_PARAMETER_SET_NONE;
+        if (header.nal_unit_type >= 32 && header.nal_unit_type <= 34)
+            return AB_NALU_PARAMETER_SET_VPS + header.nal_unit_type - 32;
+    }
+
+    return AB_NALU_PARAMETER_SET_NONE;
+}
+
+bool ab_nalu_is_reference(int codec,
+    const unsigned char *nalu, unsigned int nalu_len) {
+    if (AB_NALU_CODEC_H264 == codec) {
+        ab_h264_nalu_header_t header;
+        if (ab_h264_nalu_header_parse(nalu, nalu_len, &header) < 0)
+            return false;
+        return header.nal_ref_idc != 0;
+    } else if (AB_NALU_CODEC_H265 == codec) {
+        ab_h265_nalu_header_t header;
+        if (ab_h265_nalu_header_parse(nalu, nalu_len, &header) < 0)
+            return false;
+        // TRAIL_N, TSA_N, STSA_N, RADL_N, RASL_N, RSV_VCL_N10/12/14
+        return !(header.nal_unit_type <= 14 && 0 == header.nal_unit_type % 2);
+    }
+
+    return false;
+}
+
+int ab_nalu_temporal_id(int codec,
+    const unsigned char *nalu, unsigned int nalu_len) {
+    if (AB_NALU_CODEC_H265 == codec) {
+        ab_h265_nalu_header_t header;
+        if (ab_h265_nalu_header_parse(nalu, nalu_len, &header) < 0 ||
+            0 == header.nuh_temporal_id_plus1)
+            return 0;
+        return header.nuh_temporal_id_plus1 - 1;
+    }
+
+    return 0;
+}
+
+int ab_nalu_switch_point(int codec,
+    const unsigned char *nalu, unsigned int nalu_len) {
+    if (AB_NALU_CODEC_H265 == codec) {
+        ab_h265_nalu_header_t header;
+        if (ab_h265_nalu_header_parse(nalu, nalu_len, &header) < 0)
+            return AB_NALU_SWITCH_NONE;
+        // TSA_N, TSA_R
+        if (2 == header.nal_unit_type || 3 == header.nal_unit_type)
+            return AB_NALU_SWITCH_TSA;
+        // STSA_N, STSA_R
+        if (4 == header.nal_unit_type || 5 == header.nal_unit_type)
+            return AB_NALU_SWITCH_STSA;
+    }
+
+    return AB_NALU_SWITCH_NONE;
+}
+
+bool ab_nalu_starts_access_unit(int codec,
+    const unsigned char *nalu, unsigned int nalu_len, bool *vcl) {
+    bool is_vcl = false, result = false;
+
+    if (AB_NALU_CODEC_H264 == codec) {
+        ab_h264_nalu_header_t header;
+        if (0 == ab_h264_nalu_header_parse(nalu, nalu_len, &header)) {
+            int type = header.nal_unit_type;
+            if (type >= 1 && type <= 5) {
+                is_vcl = true;
+                // first_mb_in_slice == 0
+                result = nalu_len > 1 && (nalu[1] & 0x80);
+            } else {
+                result = (type >= 6 && type <= 9) || (type >= 14 && type <= 18);
+            }
+        }
+    } else if (AB_NALU_CODEC_H265 == codec) {
+        ab_h265_nalu_header_t header;
+        if (0 == ab_h265_nalu_header_parse(nalu, nalu_len, &header)) {
+            int type = header.nal_unit_type;
+            if (type <= 31) {
+                is_vcl = true;
+                // first_slice_segment_in_pic_flag
+                result = nalu_len > 2 && (nalu[2] & 0x80);
+            } else {
+                result = (type >= 32 && type <= 35) || 39 == type ||
+                         (type >= 41 && type <= 44) || (type >= 48 && type <= 55);
+            }
+        }
+    }
+
+    if (vcl)
+        *vcl = is_vcl;
+    return result;
+}
@@ -0,0 +1,133 @@
+/*
+ * ab_nalu.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_NALU_H_
+#define AB_NALU_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum ab_nalu_codec_t {
+    AB_NALU_CODEC_NONE = 0,
+    AB_NALU_CODEC_H264,
+    AB_NALU_CODEC_H265
+};
+
+#define AB_H264_NALU_STAP_A     24
+#define AB_H264_NALU_FU_A       28
+#define AB_H265_NALU_AP         48
+#define AB_H265_NALU_FU         49
+
+/*
+ * H.265 7.4.2.2：从下一个sub-layer切换上来的点
+ */
+enum ab_nalu_switch_point_t {
+    AB_NALU_SWITCH_NONE = 0,
+    AB_NALU_SWITCH_STSA,                // 可切换到该图像所在的sub-layer
+    AB_NALU_SWITCH_TSA                  // 可切换到该sub-layer及以上各层
+};
+
+enum ab_nalu_parameter_set_t {
+    AB_NALU_PARAMETER_SET_NONE = -1,
+    AB_NALU_PARAMETER_SET_VPS = 0,      // H.265 only
+    AB_NALU_PARAMETER_SET_SPS,
+    AB_NALU_PARAMETER_SET_PPS,
+    AB_NALU_PARAMETER_SET_COUNT
+};
+
+/*
+ * H.264 7.3.1: F(1) | NRI(2) | Type(5)
+ */
+typedef struct ab_h264_nalu_header_t {
+    uint8_t         forbidden_zero_bit;
+    uint8_t         nal_ref_idc;
+    uint8_t         nal_unit_type;
+} ab_h264_nalu_header_t;
+
+/*
+ * H.265 7.3.1.2: F(1) | Type(6) | LayerId(6) | TID(3)
+ */
+typedef struct ab_h265_nalu_header_t {
+    uint8_t         forbidden_zero_bit;
+    uint8_t         nal_unit_type;
+    uint8_t         nuh_layer_id;
+    uint8_t         nuh_temporal_id_plus1;
+} ab_h265_nalu_header_t;
+
+/*
+ * 解析/写入NALU头，解析时长度不足返回-1
+ */
+extern int  ab_h264_nalu_header_parse(const unsigned char *data,
+    unsigned int data_len, ab_h264_nalu_header_t *header);
+extern void ab_h264_nalu_header_write(const ab_h264_nalu_header_t *header,
+    unsigned char *buf);
+
+extern int  ab_h265_nalu_header_parse(const unsigned char *data,
+    unsigned int data_len, ab_h265_nalu_header_t *header);
+extern void ab_h265_nalu_header_write(const ab_h265_nalu_header_t *header,
+    unsigned char *buf);
+
+/*
+ * 查找Annex B起始码(00 00 01或00 00 00 01)
+ * start_code_len: 起始码长度3或4，可为NULL
+ * return: 起始码的偏移，没有返回-1
+ */
+extern int  ab_nalu_find_start_code(const unsigned char *data, unsigned int data_len,
+    unsigned int *start_code_len);
+
+/*
+ * NALU头长度，H.264为1，H.265为2
+ */
+extern unsigned int ab_nalu_header_size(int codec);
+
+/*
+ * IDR/IRAP及参数集
+ */
+extern bool ab_nalu_is_key(int codec,
+    const unsigned char *nalu, unsigned int nalu_len);
+
+/*
+ * return: @ab_nalu_parameter_set_t，不是参数集返回AB_NALU_PARAMETER_SET_NONE
+ */
+extern int  ab_nalu_parameter_set(int codec,
+    const unsigned char *nalu, unsigned int nalu_len);
+
+/*
+ * 解码其他帧时可能被参考：H.264 nal_ref_idc != 0，
+ * H.265除sub-layer non-reference图像(TRAIL_N、RASL_N等)以外的NALU
+ */
+extern bool ab_nalu_is_reference(int codec,
+    const unsigned char *nalu, unsigned int nalu_len);
+
+/*
+ * H.265为TemporalId(TID - 1)，H.264为0
+ */
+extern int  ab_nalu_temporal_id(int codec,
+    const unsigned char *nalu, unsigned int nalu_len);
+
+/*
+ * return: @ab_nalu_switch_point_t，H.264总是AB_NALU_SWITCH_NONE
+ */
+extern int  ab_nalu_switch_point(int codec,
+    const unsigned char *nalu, unsigned int nalu_len);
+
+/*
+ * 判断NALU是否开始一个新的access unit(H.264 7.4.1.2.3, H.265 7.4.2.4.4)
+ * vcl: 可为NULL
+ */
+extern bool ab_nalu_starts_access_unit(int codec,
+    const unsigned char *nalu, unsigned int nalu_len, bool *vcl);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_NALU_H_
@@ -0,0 +1,141 @@
+/*
+ * ab_rtcp.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_rtcp.h"
+
+#include "ab_base/ab_assert.h"
+
+#include <stddef.h>
+#include <time.h>
+
+// seconds from 1900-01-01 to 1970-01-01
+#define NTP_UNIX_OFFSET     2208988800ULL
+
+#define RTCP_HEADER_SIZE    4
+#define REPORT_BLOCK_SIZE   24
+
+static uint32_t read32(const unsigned char *p) {
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) |
+        ((uint32_t) p[2] << 8) | p[3];
+}
+
+static void write32(unsigned char *p, uint32_t value) {
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+uint64_t ab_rtcp_ntp_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    uint64_t fraction = ((uint64_t) ts.tv_nsec << 32) / 1000000000;
+    return ((ts.tv_sec + NTP_UNIX_OFFSET) << 32) | fraction;
+}
+
+int ab_rtcp_sender_report(uint32_t ssrc, uint64_t ntp, uint32_t rtp_timestamp,
+    uint32_t packets, uint32_t octets, unsigned char *buf, unsigned int buf_size) {
+    assert(buf);
+
+    if (buf_size < AB_RTCP_SR_SIZE)
+        return -1;
+
+    // V=2 RC=0 PT=200 length=6 (32-bit words minus one)
+    buf[0] = 0x80;
+    buf[1] = AB_RTCP_SR;
+    buf[2] = 0;
+    buf[3] = AB_RTCP_SR_SIZE / 4 - 1;
+    write32(buf + 4, ssrc);
+    write32(buf + 8, ntp >> 32);
+    write32(buf + 12, (uint32_t) ntp);
+    write32(buf + 16, rtp_timestamp);
+    write32(buf + 20, packets);
+    write32(buf + 24, octets);
+
+    return AB_RTCP_SR_SIZE;
+}
+
+int ab_rtcp_bye(uint32_t ssrc, unsigned char *buf, unsigned int buf_size) {
+    assert(buf);
+
+    if (buf_size < AB_RTCP_BYE_SIZE)
+        return -1;
+
+    // V=2 SC=1 PT=203 length=1
+    buf[0] = 0x81;
+    buf[1] = AB_RTCP_BYE;
+    buf[2] = 0;
+    buf[3] = AB_RTCP_BYE_SIZE / 4 - 1;
+    write32(buf + 4, ssrc);
+
+    return AB_RTCP_BYE_SIZE;
+}
+
+static void parse_block(const unsigned char *p, ab_rtcp_report_block_t *block) {
+    block->ssrc             = read32(p);
+    block->fraction_lost    = p[4];
+    // sign-extend the 24-bit count
+    int32_t lost = ((int32_t) p[5] << 16) | (p[6] << 8) | p[7];
+    block->cumulative_lost  = lost & 0x800000 ? lost - 0x1000000 : lost;
+    block->highest_seq      = read32(p + 8);
+    block->jitter           = read32(p + 12);
+    block->lsr              = read32(p + 16);
+    block->dlsr             = read32(p + 20);
+}
+
+int ab_rtcp_report_blocks(const unsigned char *data, unsigned int len,
+    ab_rtcp_report_block_t *blocks, unsigned int max_blocks) {
+    assert(data || 0 == len);
+    assert(blocks || 0 == max_blocks);
+
+    unsigned int count = 0;
+    unsigned int pos = 0;
+    while (pos + RTCP_HEADER_SIZE <= len) {
+        const unsigned char *packet = data + pos;
+        if ((packet[0] >> 6) != 2)
+            return 0 == pos ? -1 : (int) count;
+
+        unsigned int packet_len = ((packet[2] << 8) | packet[3]) * 4 + 4;
+        if (pos + packet_len > len)
+            break;
+
+        unsigned int rc = packet[0] & 0x1f;
+        unsigned int offset = 0;
+        if (AB_RTCP_SR == packet[1])
+            offset = AB_RTCP_SR_SIZE;
+        else if (AB_RTCP_RR == packet[1])
+            offset = 8;                 // header + reporter SSRC
+        else if (0 == pos)
+            return -1;                  // a compound packet starts with SR/RR
+
+        for (unsigned int i = 0; offset > 0 && i < rc; ++i) {
+            unsigned int block_pos = offset + i * REPORT_BLOCK_SIZE;
+            if (block_pos + REPORT_BLOCK_SIZE > packet_len || count >= max_blocks)
+                break;
+            parse_block(packet + block_pos, &blocks[count++]);
+        }
+
+        pos += packet_len;
+    }
+
+    return count;
+}
+
+unsigned int ab_rtcp_rtt_us(uint64_t ntp_now, const ab_rtcp_report_block_t *block) {
+    assert(block);
+
+    if (0 == block->lsr)
+        return 0;
+
+    uint32_t now = (uint32_t) (ntp_now >> 16);
+    uint32_t rtt = now - block->lsr - block->dlsr;
+    // a clock step or a bogus DLSR, not a real round trip
+    if (rtt > (60u << 16))
+        return 0;
+    return (unsigned int) (((uint64_t) rtt * 1000000) >> 16);
+}
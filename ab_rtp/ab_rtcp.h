@@ -0,0 +1,72 @@
+/*
+ * ab_rtcp.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_RTCP_H_
+#define AB_RTCP_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define AB_RTCP_SR                  200
+#define AB_RTCP_RR                  201
+#define AB_RTCP_BYE                 203
+#define AB_RTCP_SR_SIZE             28      // without report blocks
+#define AB_RTCP_BYE_SIZE            8       // one SSRC, no reason
+
+/*
+ * RFC 3550 6.4.1 report block
+ */
+typedef struct ab_rtcp_report_block_t {
+    uint32_t        ssrc;               // source this block is about
+    unsigned int    fraction_lost;      // x/256 since the previous report
+    int32_t         cumulative_lost;    // 24-bit signed
+    uint32_t        highest_seq;        // extended
+    uint32_t        jitter;             // RTP timestamp units
+    uint32_t        lsr;                // middle 32 bits of the last SR NTP time
+    uint32_t        dlsr;               // 1/65536 s since that SR
+} ab_rtcp_report_block_t;
+
+/*
+ * NTP时间(1900年起)，高32位秒，低32位秒的小数
+ */
+extern uint64_t ab_rtcp_ntp_now(void);
+
+/*
+ * 不带报告块的SR
+ * return: 写入长度AB_RTCP_SR_SIZE，buf不够时返回-1
+ */
+extern int  ab_rtcp_sender_report(uint32_t ssrc, uint64_t ntp, uint32_t rtp_timestamp,
+    uint32_t packets, uint32_t octets, unsigned char *buf, unsigned int buf_size);
+
+/*
+ * 一个SSRC的BYE，需跟在SR/RR之后组成复合包
+ * return: 写入长度AB_RTCP_BYE_SIZE，buf不够时返回-1
+ */
+extern int  ab_rtcp_bye(uint32_t ssrc, unsigned char *buf, unsigned int buf_size);
+
+/*
+ * 取出复合包中所有SR/RR的报告块
+ * return: 报告块个数(最多max_blocks)，不是RTCP返回-1
+ */
+extern int  ab_rtcp_report_blocks(const unsigned char *data, unsigned int len,
+    ab_rtcp_report_block_t *blocks, unsigned int max_blocks);
+
+/*
+ * RFC 3550 6.4.1: RTT = A - LSR - DLSR
+ * return: 微秒，lsr为0(还没有收到过SR)时返回0
+ */
+extern unsigned int ab_rtcp_rtt_us(uint64_t ntp_now,
+    const ab_rtcp_report_block_t *block);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_RTCP_H_
@@ -0,0 +1,187 @@
+/*
+ * ab_rtp_aac_packetizer.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_rtp_aac_packetizer.h"
+#include "ab_rtp_def.h"
+#include "ab_aac.h"
+
+#include "ab_base/ab_mem.h"
+#include "ab_base/ab_assert.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include <arpa/inet.h>
+
+#define T ab_rtp_aac_packetizer_t
+
+// AU-headers-length(16) + one AU-header(13-bit size, 3-bit index)
+#define AU_HEADERS_LENGTH_SIZE  2
+#define AU_HEADER_SIZE          2
+#define AU_MAX_SIZE             8191
+
+struct T {
+    int             payload_type;
+    uint32_t        ssrc;
+    uint16_t        sequence;
+    unsigned int    max_payload;
+    unsigned int    max_aus;
+
+    void           *user_data;
+    void          (*callback)(unsigned char *, unsigned int, void *);
+
+    unsigned char  *packet;             // headroom + RTP header + payload
+
+    // AUs waiting to be aggregated
+    unsigned char  *data;
+    unsigned int    used;
+    unsigned int   *sizes;
+    unsigned int    count;
+    uint32_t        timestamp;          // of the first AU
+    uint32_t        next_timestamp;
+};
+
+T ab_rtp_aac_packetizer_new(int payload_type, uint32_t ssrc,
+    unsigned int max_payload, unsigned int max_aus,
+    void (*cb)(unsigned char *, unsigned int, void *), void *user_data) {
+    // room for at least one byte behind the AU headers
+    assert(max_payload > AU_HEADERS_LENGTH_SIZE + AU_HEADER_SIZE);
+    assert(max_aus > 0);
+
+    T packetizer;
+    NEW0(packetizer);
+
+    packetizer->payload_type    = payload_type;
+    packetizer->ssrc            = ssrc;
+    packetizer->sequence        = 0;
+    packetizer->max_payload     = max_payload;
+    packetizer->max_aus         = max_aus;
+    packetizer->callback        = cb;
+    packetizer->user_data       = user_data;
+
+    packetizer->packet = ALLOC(AB_RTP_PACKETIZER_HEADROOM +
+        sizeof(ab_rtp_header_t) + max_payload);
+    packetizer->data   = ALLOC(max_payload);
+    packetizer->sizes  = CALLOC(max_aus, sizeof(unsigned int));
+    packetizer->used   = 0;
+    packetizer->count  = 0;
+
+    return packetizer;
+}
+
+void ab_rtp_aac_packetizer_free(T *packetizer) {
+    assert(packetizer && *packetizer);
+
+    FREE((*packetizer)->sizes);
+    FREE((*packetizer)->data);
+    FREE((*packetizer)->packet);
+    FREE(*packetizer);
+}
+
+uint16_t ab_rtp_aac_packetizer_sequence(T packetizer) {
+    assert(packetizer);
+    return packetizer->sequence;
+}
+
+/*
+ * AU-headers-length(bits) | AU-header * count | data
+ */
+static void send_packet(T packetizer, uint32_t timestamp, bool marker,
+    const unsigned int *sizes, unsigned int count,
+    const unsigned char *data, unsigned int data_len) {
+    unsigned char *rtp = packetizer->packet + AB_RTP_PACKETIZER_HEADROOM;
+
+    ab_rtp_header_t *rtp_header = (ab_rtp_header_t *) rtp;
+    rtp_header->csrc_len        = 0;
+    rtp_header->extension       = 0;
+    rtp_header->padding         = 0;
+    rtp_header->version         = RTP_VERSION;
+    rtp_header->payload_type    = packetizer->payload_type;
+    rtp_header->marker          = marker;
+    rtp_header->seq             = htons(packetizer->sequence);
+    rtp_header->timestamp       = htonl(timestamp);
+    rtp_header->ssrc            = htonl(packetizer->ssrc);
+
+    unsigned char *pos = rtp + sizeof(ab_rtp_header_t);
+    unsigned int headers_bits = count * AU_HEADER_SIZE * 8;
+    *pos++ = headers_bits >> 8;
+    *pos++ = headers_bits & 0xff;
+    for (unsigned int i = 0; i < count; ++i) {
+        // AU-Index and AU-Index-delta are 0: consecutive AUs
+        *pos++ = sizes[i] >> 5;
+        *pos++ = (sizes[i] & 0x1f) << 3;
+    }
+    memcpy(pos, data, data_len);
+    pos += data_len;
+
+    if (packetizer->callback)
+        packetizer->callback(rtp, pos - rtp, packetizer->user_data);
+
+    ++packetizer->sequence;
+}
+
+void ab_rtp_aac_packetizer_flush(T packetizer) {
+    assert(packetizer);
+
+    if (0 == packetizer->count)
+        return;
+
+    send_packet(packetizer, packetizer->timestamp, true,
+        packetizer->sizes, packetizer->count, packetizer->data, packetizer->used);
+    packetizer->used  = 0;
+    packetizer->count = 0;
+}
+
+/*
+ * RFC 3640 3.2.3: 每个分片都带完整AU的长度，最后一个分片置M位
+ */
+static void fragment_au(T packetizer,
+    const unsigned char *au, unsigned int au_len, uint32_t timestamp) {
+    unsigned int room = packetizer->max_payload -
+        AU_HEADERS_LENGTH_SIZE - AU_HEADER_SIZE;
+
+    unsigned int offset = 0;
+    while (offset < au_len) {
+        unsigned int len = au_len - offset < room ? au_len - offset : room;
+        send_packet(packetizer, timestamp, offset + len == au_len,
+            &au_len, 1, au + offset, len);
+        offset += len;
+    }
+}
+
+int ab_rtp_aac_packetizer_push(T packetizer,
+    const unsigned char *au, unsigned int au_len, uint32_t timestamp) {
+    assert(packetizer);
+    assert(au && au_len > 0);
+
+    if (au_len > AU_MAX_SIZE)
+        return -1;
+
+    unsigned int header_len = AU_HEADERS_LENGTH_SIZE +
+        (packetizer->count + 1) * AU_HEADER_SIZE;
+    if (packetizer->count > 0 &&
+        (timestamp != packetizer->next_timestamp ||
+         header_len + packetizer->used + au_len > packetizer->max_payload))
+        ab_rtp_aac_packetizer_flush(packetizer);
+
+    if (AU_HEADERS_LENGTH_SIZE + AU_HEADER_SIZE + au_len > packetizer->max_payload) {
+        fragment_au(packetizer, au, au_len, timestamp);
+        return 0;
+    }
+
+    if (0 == packetizer->count)
+        packetizer->timestamp = timestamp;
+    memcpy(packetizer->data + packetizer->used, au, au_len);
+    packetizer->used += au_len;
+    packetizer->sizes[packetizer->count++] = au_len;
+    packetizer->next_timestamp = timestamp + AB_AAC_FRAME_SAMPLES;
+
+    if (packetizer->count == packetizer->max_aus)
+        ab_rtp_aac_packetizer_flush(packetizer);
+
+    return 0;
+}
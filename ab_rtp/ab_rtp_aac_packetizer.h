@@ -0,0 +1,57 @@
+/*
+ * ab_rtp_aac_packetizer.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_RTP_AAC_PACKETIZER_H_
+#define AB_RTP_AAC_PACKETIZER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ab_rtp_packetizer.h"
+
+#include <stdint.h>
+
+/*
+ * AAC打包(RFC 3640 mpeg4-generic, mode=AAC-hbr)
+ * sizelength=13, indexlength=3, indexdeltalength=3
+ * 连续的AU聚合在一个包里，超过一个包的AU分片发送
+ */
+#define T ab_rtp_aac_packetizer_t
+typedef struct T *T;
+
+/*
+ * max_payload: 每个RTP包的最大负载长度
+ * max_aus: 每个包最多聚合的AU数，每多一个AU多一帧(1024个采样)的延时
+ * cb: rtp前有AB_RTP_PACKETIZER_HEADROOM字节可写
+ */
+extern T    ab_rtp_aac_packetizer_new(int payload_type, uint32_t ssrc,
+    unsigned int max_payload, unsigned int max_aus,
+    void (*cb)(unsigned char *, unsigned int, void *), void *user_data);
+extern void ab_rtp_aac_packetizer_free(T *packetizer);
+
+/*
+ * au: 不含ADTS头的raw_data_block
+ * timestamp: 与上一个AU不连续时先发送已聚合的AU
+ * return: AU超过13位长度返回-1
+ */
+extern int  ab_rtp_aac_packetizer_push(T packetizer,
+    const unsigned char *au, unsigned int au_len, uint32_t timestamp);
+/*
+ * 发送已聚合的AU
+ */
+extern void ab_rtp_aac_packetizer_flush(T packetizer);
+
+extern uint16_t ab_rtp_aac_packetizer_sequence(T packetizer);
+
+#undef T
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_RTP_AAC_PACKETIZER_H_
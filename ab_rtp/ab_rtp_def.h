@@ -17,6 +17,7 @@ extern "C" {
 #define RTP_VERSION             2
 #define RTP_PAYLOAD_TYPE_H264   96
 #define RTP_PAYLOAD_TYPE_AAC    97
+#define RTP_PAYLOAD_TYPE_ULPFEC 127
 #define RTP_MAX_SIZE            1370
 
 #define RTP_SERVER_PORT         20001
@@ -0,0 +1,215 @@
+/*
+ * ab_rtp_depacketizer.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_rtp_depacketizer.h"
+#include "ab_nalu.h"
+
+#include "ab_base/ab_mem.h"
+#include "ab_base/ab_assert.h"
+
+#include <stddef.h>
+
+#define T ab_rtp_depacketizer_t
+
+static const unsigned char start_code[4] = { 0x00, 0x00, 0x00, 0x01 };
+
+struct T {
+    int             codec;              // @ab_nalu_codec_t
+
+    void           *user_data;
+    void          (*callback)(const unsigned char *, unsigned int, void *);
+};
+
+T ab_rtp_depacketizer_new(int codec,
+    void (*cb)(const unsigned char *, unsigned int, void *), void *user_data) {
+    assert(AB_NALU_CODEC_H264 == codec || AB_NALU_CODEC_H265 == codec);
+    assert(cb);
+
+    T depacketizer;
+    NEW0(depacketizer);
+    depacketizer->codec         = codec;
+    depacketizer->callback      = cb;
+    depacketizer->user_data     = user_data;
+
+    return depacketizer;
+}
+
+void ab_rtp_depacketizer_free(T *depacketizer) {
+    assert(depacketizer && *depacketizer);
+    FREE(*depacketizer);
+}
+
+static void output_nalu(T depacketizer,
+    const unsigned char *nalu, unsigned int nalu_len) {
+    depacketizer->callback(start_code, sizeof(start_code), depacketizer->user_data);
+    depacketizer->callback(nalu, nalu_len, depacketizer->user_data);
+}
+
+/*
+ * STAP-A(H.264)/AP(H.265): 16-bit size + NAL unit, ...
+ */
+static void process_aggregation_packet(T depacketizer,
+    const unsigned char *data, unsigned int data_len) {
+    unsigned int pos = 0;
+    while (pos + 2 < data_len) {
+        unsigned int nalu_len = (data[pos] << 8) | data[pos + 1];
+        pos += 2;
+        if (0 == nalu_len || pos + nalu_len > data_len) {
+            break;
+        }
+
+        output_nalu(depacketizer, data + pos, nalu_len);
+        pos += nalu_len;
+    }
+}
+
+static void process_h264(T depacketizer,
+    const unsigned char *rtp, unsigned int rtp_len) {
+    unsigned char nal_type = rtp[12] & 0x1f;
+    if (AB_H264_NALU_STAP_A == nal_type) {
+        process_aggregation_packet(depacketizer, rtp + 13, rtp_len - 13);
+    } else if (AB_H264_NALU_FU_A == nal_type || 0x1d == nal_type) {
+        if (rtp_len <= 14) {
+            return;
+        }
+
+        if (0x80 == (rtp[13] & 0xe0)) {
+            unsigned char nal_header = (rtp[12] & 0xe0) | (rtp[13] & 0x1f);
+            output_nalu(depacketizer, &nal_header, 1);
+        }
+        depacketizer->callback(rtp + 14, rtp_len - 14, depacketizer->user_data);
+    } else {
+        output_nalu(depacketizer, rtp + 12, rtp_len - 12);
+    }
+}
+
+static void process_h265(T depacketizer,
+    const unsigned char *rtp, unsigned int rtp_len) {
+    ab_h265_nalu_header_t payload_header;
+    if (ab_h265_nalu_header_parse(rtp + 12, rtp_len - 12, &payload_header) < 0) {
+        return;
+    }
+
+    if (AB_H265_NALU_AP == payload_header.nal_unit_type) {
+        process_aggregation_packet(depacketizer, rtp + 14, rtp_len - 14);
+    } else if (AB_H265_NALU_FU == payload_header.nal_unit_type) {
+        if (rtp_len <= 15) {
+            return;
+        }
+
+        if (0x80 == (rtp[14] & 0xc0)) {
+            // F, LayerId and TID come from the PayloadHdr
+            ab_h265_nalu_header_t nalu_header = payload_header;
+            nalu_header.nal_unit_type = rtp[14] & 0x3f;
+            unsigned char nal_header[2];
+            ab_h265_nalu_header_write(&nalu_header, nal_header);
+            output_nalu(depacketizer, nal_header, sizeof(nal_header));
+        }
+        depacketizer->callback(rtp + 15, rtp_len - 15, depacketizer->user_data);
+    } else {
+        output_nalu(depacketizer, rtp + 12, rtp_len - 12);
+    }
+}
+
+void ab_rtp_depacketizer_push(T depacketizer,
+    const unsigned char *rtp, unsigned int rtp_len) {
+    assert(depacketizer);
+
+    if (NULL == rtp || rtp_len <= 12) {
+        return;
+    }
+
+    if (AB_NALU_CODEC_H264 == depacketizer->codec) {
+        process_h264(depacketizer, rtp, rtp_len);
+    } else {
+        process_h265(depacketizer, rtp, rtp_len);
+    }
+}
+
+/*
+ * 聚合包取各NALU的并集，temporal_id取最小值，max_temporal_id和switch_point取最大值
+ */
+static void inspect_nalu(int codec, const unsigned char *nalu, unsigned int nalu_len,
+    ab_rtp_packet_info_t *info) {
+    uint8_t temporal_id = ab_nalu_temporal_id(codec, nalu, nalu_len);
+    if (0 == info->nalu_count || temporal_id < info->temporal_id)
+        info->temporal_id = temporal_id;
+    if (temporal_id > info->max_temporal_id)
+        info->max_temporal_id = temporal_id;
+    uint8_t switch_point = ab_nalu_switch_point(codec, nalu, nalu_len);
+    if (switch_point > info->switch_point)
+        info->switch_point = switch_point;
+    if (ab_nalu_is_key(codec, nalu, nalu_len))
+        info->key = true;
+    if (ab_nalu_is_reference(codec, nalu, nalu_len))
+        info->reference = true;
+    ++info->nalu_count;
+}
+
+int ab_rtp_payload_inspect(int codec,
+    const unsigned char *payload, unsigned int payload_len,
+    ab_rtp_packet_info_t *info,
+    void (*cb)(const unsigned char *, unsigned int, void *), void *user_data) {
+    assert(AB_NALU_CODEC_H264 == codec || AB_NALU_CODEC_H265 == codec);
+    assert(info);
+
+    unsigned int header_size = ab_nalu_header_size(codec);
+    if (NULL == payload || payload_len <= header_size)
+        return -1;
+
+    info->key           = false;
+    info->nalu_start    = true;
+    info->reference     = false;
+    info->temporal_id   = 0;
+    info->max_temporal_id   = 0;
+    info->switch_point  = AB_NALU_SWITCH_NONE;
+    info->nalu_count    = 0;
+
+    unsigned int type = AB_NALU_CODEC_H264 == codec ?
+        payload[0] & 0x1f : (payload[0] >> 1) & 0x3f;
+    bool aggregation = AB_NALU_CODEC_H264 == codec ?
+        AB_H264_NALU_STAP_A == type : AB_H265_NALU_AP == type;
+    bool fragment = AB_NALU_CODEC_H264 == codec ?
+        AB_H264_NALU_FU_A == type : AB_H265_NALU_FU == type;
+
+    if (fragment) {
+        // the NAL unit header, rebuilt from the payload header and FU header
+        unsigned char fu = payload[header_size];
+        unsigned char nal_header[2] = { payload[0], payload[1] };
+        if (AB_NALU_CODEC_H264 == codec)
+            nal_header[0] = (payload[0] & 0xe0) | (fu & 0x1f);
+        else
+            nal_header[0] = (payload[0] & 0x81) | ((fu & 0x3f) << 1);
+
+        inspect_nalu(codec, nal_header, header_size, info);
+        info->nalu_start = (fu & 0x80) != 0;
+        info->nalu_count = 0;
+        return 0;
+    }
+
+    if (!aggregation) {
+        inspect_nalu(codec, payload, payload_len, info);
+        if (cb)
+            cb(payload, payload_len, user_data);
+        return 0;
+    }
+
+    unsigned int pos = header_size;
+    while (pos + 2 < payload_len) {
+        unsigned int nalu_len = (payload[pos] << 8) | payload[pos + 1];
+        pos += 2;
+        if (0 == nalu_len || pos + nalu_len > payload_len)
+            break;
+
+        inspect_nalu(codec, payload + pos, nalu_len, info);
+        if (cb)
+            cb(payload + pos, nalu_len, user_data);
+        pos += nalu_len;
+    }
+
+    return info->nalu_count > 0 ? 0 : -1;
+}
@@ -0,0 +1,55 @@
+/*
+ * ab_rtp_depacketizer.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_RTP_DEPACKETIZER_H_
+#define AB_RTP_DEPACKETIZER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ab_rtp_packetizer.h"
+
+/*
+ * H.264(RFC 6184)/H.265(RFC 7798)解包，输出Annex B字节流：
+ * 每个NALU前输出起始码00 00 00 01，分片的负载依次输出，不做重组
+ */
+#define T ab_rtp_depacketizer_t
+typedef struct T *T;
+
+/*
+ * codec: @ab_nalu_codec_t
+ * cb: 字节流按片段回调，片段指向输入的RTP包或内部数据，回调返回后失效
+ */
+extern T    ab_rtp_depacketizer_new(int codec,
+    void (*cb)(const unsigned char *, unsigned int, void *), void *user_data);
+extern void ab_rtp_depacketizer_free(T *depacketizer);
+
+/*
+ * rtp: 完整的RTP包，不检查序列号
+ */
+extern void ab_rtp_depacketizer_push(T depacketizer,
+    const unsigned char *rtp, unsigned int rtp_len);
+
+/*
+ * 不解包，只看负载头得到与打包器相同的包信息，用于原样转发
+ * payload: RTP负载(不含RTP头)
+ * cb: 单NALU包和聚合包中完整的NALU依次回调，可为NULL；分片不回调
+ * return: 负载不完整返回-1
+ */
+extern int  ab_rtp_payload_inspect(int codec,
+    const unsigned char *payload, unsigned int payload_len,
+    ab_rtp_packet_info_t *info,
+    void (*cb)(const unsigned char *, unsigned int, void *), void *user_data);
+
+#undef T
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_RTP_DEPACKETIZER_H_
@@ -0,0 +1,480 @@
+/*
+ * ab_rtp_fec.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_rtp_fec.h"
+
+#include "ab_base/ab_mem.h"
+#include "ab_base/ab_assert.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/*
+ * FEC packet layout (RFC 5109):
+ * +--------------+---------------------+----------------------+-------------+
+ * | RTP header   | FEC header (10)     | ULP level header (4) | XOR payload |
+ * +--------------+---------------------+----------------------+-------------+
+ * FEC header: E|L|P|X|CC | M|PT | SN base | TS recovery | length recovery
+ * ULP level header: protection length | mask
+ */
+
+#define RTP_HEADER_SIZE         12
+#define FEC_HEADER_SIZE         10
+#define FEC_LEVEL_HEADER_SIZE   4
+#define FEC_OVERHEAD            (RTP_HEADER_SIZE + FEC_HEADER_SIZE + FEC_LEVEL_HEADER_SIZE)
+#define FEC_MAX_PAYLOAD         (AB_RTP_FEC_MAX_PACKET_SIZE - FEC_OVERHEAD)
+
+#define DECODER_WINDOW          128     // media packets kept for recovery, power of 2
+#define DECODER_FEC_SLOTS       16
+#define DECODER_MAX_WAIT        64      // packets to wait for a missing one
+#define DECODER_MAX_WAIT_US     100000  // or this long since delivery stalled
+
+static inline uint16_t read_u16(const unsigned char *p) {
+    return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t read_u32(const unsigned char *p) {
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) |
+           ((uint32_t) p[2] << 8) | p[3];
+}
+
+static inline void write_u16(unsigned char *p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v & 0xff;
+}
+
+static inline void write_u32(unsigned char *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = (v >> 16) & 0xff;
+    p[2] = (v >> 8) & 0xff;
+    p[3] = v & 0xff;
+}
+
+static inline int16_t seq_diff(uint16_t a, uint16_t b) {
+    return (int16_t) (a - b);
+}
+
+static void xor_bytes(unsigned char *dst, const unsigned char *src, unsigned int len) {
+    for (unsigned int i = 0; i < len; ++i)
+        dst[i] ^= src[i];
+}
+
+#define T ab_rtp_fec_encoder_t
+
+struct T {
+    uint8_t         payload_type;
+    uint16_t        sequence;
+
+    int             count;              // media packets in the current group
+    uint16_t        sn_base;
+    uint16_t        mask;
+    uint8_t         bits_recovery;      // P|X|CC
+    uint8_t         m_pt_recovery;      // M|PT
+    uint32_t        ts_recovery;
+    uint16_t        length_recovery;
+    uint32_t        last_timestamp;
+    uint32_t        ssrc;               // of the FEC stream
+
+    unsigned int    protection_length;
+    unsigned char   payload[FEC_MAX_PAYLOAD];
+};
+
+T ab_rtp_fec_encoder_new(int payload_type, uint32_t ssrc) {
+    T enc;
+    NEW0(enc);
+    enc->payload_type = payload_type & 0x7f;
+    enc->ssrc         = ssrc;
+    return enc;
+}
+
+void ab_rtp_fec_encoder_free(T *enc) {
+    assert(enc && *enc);
+    FREE(*enc);
+}
+
+int ab_rtp_fec_encoder_add(T enc, const unsigned char *rtp, unsigned int rtp_len) {
+    assert(enc);
+    assert(rtp && rtp_len >= RTP_HEADER_SIZE);
+
+    uint16_t seq = read_u16(rtp + 2);
+    unsigned int payload_len = rtp_len - RTP_HEADER_SIZE;
+    if (payload_len > FEC_MAX_PAYLOAD)
+        payload_len = FEC_MAX_PAYLOAD;
+
+    if (0 == enc->count) {
+        enc->sn_base            = seq;
+        enc->mask               = 0;
+        enc->bits_recovery      = 0;
+        enc->m_pt_recovery      = 0;
+        enc->ts_recovery        = 0;
+        enc->length_recovery    = 0;
+        enc->protection_length  = 0;
+    } else {
+        int16_t offset = seq_diff(seq, enc->sn_base);
+        if (offset < 0 || offset >= AB_RTP_FEC_MAX_GROUP)
+            return -1;
+    }
+
+    if (payload_len > enc->protection_length) {
+        memset(enc->payload + enc->protection_length, 0,
+            payload_len - enc->protection_length);
+        enc->protection_length = payload_len;
+    }
+
+    enc->mask               |= 0x8000 >> seq_diff(seq, enc->sn_base);
+    enc->bits_recovery      ^= rtp[0] & 0x3f;
+    enc->m_pt_recovery      ^= rtp[1];
+    enc->ts_recovery        ^= read_u32(rtp + 4);
+    enc->length_recovery    ^= rtp_len - RTP_HEADER_SIZE;
+    enc->last_timestamp     = read_u32(rtp + 4);
+    xor_bytes(enc->payload, rtp + RTP_HEADER_SIZE, payload_len);
+
+    return ++enc->count;
+}
+
+int ab_rtp_fec_encoder_flush(T enc, unsigned char *buf, unsigned int buf_size) {
+    assert(enc);
+    assert(buf);
+
+    if (0 == enc->count)
+        return 0;
+
+    unsigned int len = FEC_OVERHEAD + enc->protection_length;
+    if (buf_size < len)
+        return 0;
+
+    buf[0] = 0x80;
+    buf[1] = enc->payload_type;
+    write_u16(buf + 2, enc->sequence++);
+    write_u32(buf + 4, enc->last_timestamp);
+    write_u32(buf + 8, enc->ssrc);
+
+    unsigned char *fec = buf + RTP_HEADER_SIZE;
+    fec[0] = enc->bits_recovery;        // E = 0, L = 0
+    fec[1] = enc->m_pt_recovery;
+    write_u16(fec + 2, enc->sn_base);
+    write_u32(fec + 4, enc->ts_recovery);
+    write_u16(fec + 8, enc->length_recovery);
+    write_u16(fec + 10, enc->protection_length);
+    write_u16(fec + 12, enc->mask);
+
+    memcpy(buf + FEC_OVERHEAD, enc->payload, enc->protection_length);
+
+    enc->count = 0;
+    return len;
+}
+
+#undef T
+
+#define T ab_rtp_fec_decoder_t
+
+typedef struct ab_rtp_fec_slot_t {
+    bool            used;
+    uint16_t        seq;
+    unsigned int    len;
+    unsigned char   data[AB_RTP_FEC_MAX_PACKET_SIZE];
+} ab_rtp_fec_slot_t;
+
+struct T {
+    uint8_t             payload_type;
+
+    void               *user_data;
+    void              (*callback)(const unsigned char *, unsigned int, void *);
+
+    bool                started;
+    uint32_t            ssrc;           // of the media stream
+    uint16_t            next_seq;       // next media packet to deliver
+    uint16_t            highest_seq;
+    uint32_t            highest_ts;     // of the packet at highest_seq
+
+    bool                waiting;        // delivery stalled on a missing packet
+    uint64_t            wait_us;        // since then
+
+    bool                fec_started;
+    uint16_t            fec_base;       // highest SN base received
+
+    ab_rtp_fec_slot_t   media[DECODER_WINDOW];
+    ab_rtp_fec_slot_t   fec[DECODER_FEC_SLOTS];
+    unsigned int        fec_pos;
+
+    unsigned long       recovered;
+    unsigned long       lost;
+};
+
+T ab_rtp_fec_decoder_new(int payload_type,
+    void (*cb)(const unsigned char *, unsigned int, void *), void *user_data) {
+    T dec;
+    NEW0(dec);
+    dec->payload_type   = payload_type & 0x7f;
+    dec->callback       = cb;
+    dec->user_data      = user_data;
+    return dec;
+}
+
+void ab_rtp_fec_decoder_free(T *dec) {
+    assert(dec && *dec);
+    FREE(*dec);
+}
+
+unsigned long ab_rtp_fec_decoder_recovered(T dec) {
+    assert(dec);
+    return dec->recovered;
+}
+
+unsigned long ab_rtp_fec_decoder_lost(T dec) {
+    assert(dec);
+    return dec->lost;
+}
+
+static ab_rtp_fec_slot_t *find_media(T dec, uint16_t seq) {
+    ab_rtp_fec_slot_t *slot = &dec->media[seq & (DECODER_WINDOW - 1)];
+    if (slot->used && slot->seq == seq)
+        return slot;
+    return NULL;
+}
+
+static void store_media(T dec, uint16_t seq,
+    const unsigned char *rtp, unsigned int rtp_len) {
+    ab_rtp_fec_slot_t *slot = &dec->media[seq & (DECODER_WINDOW - 1)];
+    slot->used  = true;
+    slot->seq   = seq;
+    slot->len   = rtp_len;
+    memcpy(slot->data, rtp, rtp_len);
+
+    if (seq_diff(seq, dec->highest_seq) >= 0) {
+        dec->highest_seq    = seq;
+        dec->highest_ts     = read_u32(rtp + 4);
+    }
+}
+
+/*
+ * return: number of protected media packets still missing
+ */
+static int count_missing(T dec, const ab_rtp_fec_slot_t *fec, uint16_t *missing_seq) {
+    const unsigned char *hdr = fec->data + RTP_HEADER_SIZE;
+    uint16_t sn_base = read_u16(hdr + 2);
+    uint16_t mask = read_u16(hdr + FEC_HEADER_SIZE + 2);
+
+    int missing = 0;
+    for (int i = 0; i < AB_RTP_FEC_MAX_GROUP; ++i) {
+        if (!(mask & (0x8000 >> i)))
+            continue;
+
+        uint16_t seq = sn_base + i;
+        if (NULL == find_media(dec, seq)) {
+            ++missing;
+            if (missing_seq)
+                *missing_seq = seq;
+        }
+    }
+
+    return missing;
+}
+
+static bool fec_protects(const ab_rtp_fec_slot_t *fec, uint16_t seq) {
+    const unsigned char *hdr = fec->data + RTP_HEADER_SIZE;
+    int16_t offset = seq_diff(seq, read_u16(hdr + 2));
+    if (offset < 0 || offset >= AB_RTP_FEC_MAX_GROUP)
+        return false;
+    return (read_u16(hdr + FEC_HEADER_SIZE + 2) & (0x8000 >> offset)) != 0;
+}
+
+static void try_recover(T dec, ab_rtp_fec_slot_t *fec) {
+    uint16_t missing_seq = 0;
+    int missing = count_missing(dec, fec, &missing_seq);
+    if (missing != 1 || seq_diff(missing_seq, dec->next_seq) < 0) {
+        if (0 == missing)
+            fec->used = false;
+        return;
+    }
+
+    const unsigned char *hdr = fec->data + RTP_HEADER_SIZE;
+    uint16_t sn_base = read_u16(hdr + 2);
+    uint16_t mask = read_u16(hdr + FEC_HEADER_SIZE + 2);
+    unsigned int protection_length = read_u16(hdr + FEC_HEADER_SIZE);
+    if (FEC_OVERHEAD + protection_length > fec->len)
+        return;
+
+    uint8_t bits_recovery = hdr[0];
+    uint8_t m_pt_recovery = hdr[1];
+    uint32_t ts_recovery = read_u32(hdr + 4);
+    uint16_t length_recovery = read_u16(hdr + 8);
+
+    unsigned char packet[AB_RTP_FEC_MAX_PACKET_SIZE];
+    unsigned char *payload = packet + RTP_HEADER_SIZE;
+    memcpy(payload, fec->data + FEC_OVERHEAD, protection_length);
+
+    for (int i = 0; i < AB_RTP_FEC_MAX_GROUP; ++i) {
+        if (!(mask & (0x8000 >> i)))
+            continue;
+
+        const ab_rtp_fec_slot_t *media = find_media(dec, sn_base + i);
+        if (NULL == media)
+            continue;
+
+        unsigned int payload_len = media->len - RTP_HEADER_SIZE;
+        if (payload_len > protection_length)
+            payload_len = protection_length;
+
+        bits_recovery   ^= media->data[0];
+        m_pt_recovery   ^= media->data[1];
+        ts_recovery     ^= read_u32(media->data + 4);
+        length_recovery ^= media->len - RTP_HEADER_SIZE;
+        xor_bytes(payload, media->data + RTP_HEADER_SIZE, payload_len);
+    }
+
+    fec->used = false;
+    if (length_recovery > protection_length)
+        return;
+
+    packet[0] = 0x80 | (bits_recovery & 0x3f);
+    packet[1] = m_pt_recovery;
+    write_u16(packet + 2, missing_seq);
+    write_u32(packet + 4, ts_recovery);
+    write_u32(packet + 8, dec->ssrc);
+
+    store_media(dec, missing_seq, packet, RTP_HEADER_SIZE + length_recovery);
+    ++dec->recovered;
+}
+
+/*
+ * 下一帧已经开始：发送端在帧结束时flush保护组，seq所在组的FEC包已经发出
+ */
+static bool frame_passed(T dec, uint16_t seq) {
+    for (uint16_t next = seq + 1; seq_diff(dec->highest_seq, next) >= 0; ++next) {
+        const ab_rtp_fec_slot_t *slot = find_media(dec, next);
+        if (slot)
+            return (int32_t) (dec->highest_ts - read_u32(slot->data + 4)) > 0;
+    }
+
+    return false;
+}
+
+/*
+ * 收到的FEC包恢复不了seq，之后也不会有能恢复它的FEC包时放弃，不再等
+ */
+static bool give_up(T dec, uint16_t seq, uint64_t now_us) {
+    if (seq_diff(dec->highest_seq, seq) >= DECODER_MAX_WAIT ||
+        (dec->waiting && now_us - dec->wait_us >= DECODER_MAX_WAIT_US))
+        return true;
+
+    bool covered = false;
+    for (int i = 0; i < DECODER_FEC_SLOTS; ++i) {
+        ab_rtp_fec_slot_t *fec = &dec->fec[i];
+        if (fec->used && fec_protects(fec, seq)) {
+            if (count_missing(dec, fec, NULL) > 1)
+                return true;
+            covered = true;
+        }
+    }
+    if (covered)
+        return false;
+
+    // groups are sent in order, a later one means ours was lost or never sent
+    if (dec->fec_started && seq_diff(dec->fec_base, seq) > 0)
+        return true;
+    return frame_passed(dec, seq);
+}
+
+static void deliver(T dec, uint64_t now_us) {
+    while (seq_diff(dec->highest_seq, dec->next_seq) >= 0) {
+        ab_rtp_fec_slot_t *slot = find_media(dec, dec->next_seq);
+        if (slot) {
+            // keep the slot, later packets of the same group may need it
+            if (dec->callback)
+                dec->callback(slot->data, slot->len, dec->user_data);
+            dec->waiting = false;
+        } else if (give_up(dec, dec->next_seq, now_us)) {
+            ++dec->lost;
+        } else {
+            if (!dec->waiting) {
+                dec->waiting    = true;
+                dec->wait_us    = now_us;
+            }
+            break;
+        }
+
+        ++dec->next_seq;
+    }
+}
+
+void ab_rtp_fec_decoder_push(T dec, const unsigned char *rtp, unsigned int rtp_len,
+    uint64_t now_us) {
+    assert(dec);
+
+    if (NULL == rtp || rtp_len < RTP_HEADER_SIZE ||
+        rtp_len > AB_RTP_FEC_MAX_PACKET_SIZE || (rtp[0] >> 6) != 2)
+        return;
+
+    if ((rtp[1] & 0x7f) == dec->payload_type) {
+        if (rtp_len < FEC_OVERHEAD)
+            return;
+
+        ab_rtp_fec_slot_t *fec = &dec->fec[dec->fec_pos++ % DECODER_FEC_SLOTS];
+        fec->used   = true;
+        fec->len    = rtp_len;
+        memcpy(fec->data, rtp, rtp_len);
+
+        uint16_t sn_base = read_u16(rtp + RTP_HEADER_SIZE + 2);
+        if (!dec->fec_started || seq_diff(sn_base, dec->fec_base) > 0) {
+            dec->fec_started    = true;
+            dec->fec_base       = sn_base;
+        }
+
+        if (dec->started)
+            try_recover(dec, fec);
+    } else {
+        uint16_t seq = read_u16(rtp + 2);
+        dec->ssrc = read_u32(rtp + 8);
+        // sender restarted with a new sequence space
+        if (dec->started && seq_diff(seq, dec->next_seq) < -DECODER_WINDOW) {
+            for (int i = 0; i < DECODER_WINDOW; ++i)
+                dec->media[i].used = false;
+            dec->started        = false;
+            dec->waiting        = false;
+            dec->fec_started    = false;
+        }
+
+        if (!dec->started) {
+            dec->started        = true;
+            dec->next_seq       = seq;
+            dec->highest_seq    = seq;
+        }
+
+        if (seq_diff(seq, dec->next_seq) < 0 || find_media(dec, seq))
+            return;
+
+        // far ahead of the window: give up on everything in between
+        while (seq_diff(seq, dec->next_seq) >= DECODER_WINDOW) {
+            ab_rtp_fec_slot_t *slot = find_media(dec, dec->next_seq);
+            if (slot) {
+                if (dec->callback)
+                    dec->callback(slot->data, slot->len, dec->user_data);
+            } else {
+                ++dec->lost;
+            }
+            ++dec->next_seq;
+        }
+
+        store_media(dec, seq, rtp, rtp_len);
+
+        for (int i = 0; i < DECODER_FEC_SLOTS; ++i) {
+            if (dec->fec[i].used)
+                try_recover(dec, &dec->fec[i]);
+        }
+    }
+
+    deliver(dec, now_us);
+}
+
+void ab_rtp_fec_decoder_poll(T dec, uint64_t now_us) {
+    assert(dec);
+
+    if (dec->started)
+        deliver(dec, now_us);
+}
@@ -0,0 +1,79 @@
+/*
+ * ab_rtp_fec.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_RTP_FEC_H_
+#define AB_RTP_FEC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * XOR parity FEC, packet format of RFC 5109 (ULPFEC, single level, 16-bit mask).
+ * FEC packets go out as their own RTP stream: own SSRC and sequence numbers,
+ * on the media port, demultiplexed by payload type.
+ */
+
+#define AB_RTP_FEC_MAX_GROUP        16
+#define AB_RTP_FEC_MAX_PACKET_SIZE  1500
+
+#define T ab_rtp_fec_encoder_t
+typedef struct T *T;
+
+/*
+ * ssrc: FEC流的SSRC，不能与媒体流相同，序列号才不会混在一起
+ */
+extern T    ab_rtp_fec_encoder_new(int payload_type, uint32_t ssrc);
+extern void ab_rtp_fec_encoder_free(T *enc);
+
+/*
+ * 把一个媒体RTP包加入当前保护组
+ * return: 组内包数，-1表示超出16包掩码范围，需要先flush
+ */
+extern int  ab_rtp_fec_encoder_add(T enc, const unsigned char *rtp, unsigned int rtp_len);
+/*
+ * 生成当前保护组的FEC包(完整RTP包)
+ * return: FEC包长度，0表示组为空
+ */
+extern int  ab_rtp_fec_encoder_flush(T enc, unsigned char *buf, unsigned int buf_size);
+
+#undef T
+
+#define T ab_rtp_fec_decoder_t
+typedef struct T *T;
+
+/*
+ * cb按序列号顺序输出媒体RTP包(包括恢复出来的包)，恢复的包用媒体流的SSRC
+ */
+extern T    ab_rtp_fec_decoder_new(int payload_type,
+    void (*cb)(const unsigned char *, unsigned int, void *), void *user_data);
+extern void ab_rtp_fec_decoder_free(T *dec);
+
+/*
+ * 缺包时等FEC恢复，收到的FEC包恢复不了、之后也不会有时立即跳过；
+ * 最多等64个包或100ms
+ * now_us: CLOCK_MONOTONIC
+ */
+extern void ab_rtp_fec_decoder_push(T dec, const unsigned char *rtp, unsigned int rtp_len,
+    uint64_t now_us);
+/*
+ * 没有新包时定期调用，跳过等待超时的缺包
+ */
+extern void ab_rtp_fec_decoder_poll(T dec, uint64_t now_us);
+
+extern unsigned long ab_rtp_fec_decoder_recovered(T dec);
+extern unsigned long ab_rtp_fec_decoder_lost(T dec);
+
+#undef T
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_RTP_FEC_H_
@@ -0,0 +1,387 @@
+/*
+ * ab_rtp_packetizer.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_rtp_packetizer.h"
+#include "ab_rtp_def.h"
+#include "ab_nalu.h"
+
+#include "ab_base/ab_mem.h"
+#include "ab_base/ab_assert.h"
+
+#include <string.h>
+
+#include <arpa/inet.h>
+
+#define T ab_rtp_packetizer_t
+
+typedef struct ab_rtp_aggregation_t {
+    unsigned char  *data;               // 16-bit size + NAL unit, ...
+    unsigned int    used;
+    unsigned int    count;
+    bool            key;
+    bool            reference;
+    uint8_t         temporal_id;
+    uint8_t         max_temporal_id;
+    uint8_t         switch_point;
+    uint32_t        timestamp;
+    // STAP-A/AP payload header: F any, NRI highest, LayerId/TID lowest
+    uint8_t         forbidden_zero_bit;
+    uint8_t         nal_ref_idc;
+    uint8_t         nuh_layer_id;
+    uint8_t         nuh_temporal_id_plus1;
+} ab_rtp_aggregation_t;
+
+struct T {
+    int             codec;              // @ab_nalu_codec_t
+    int             payload_type;
+    uint32_t        ssrc;
+    uint16_t        sequence;
+    unsigned int    max_payload;
+
+    void           *user_data;
+    void          (*callback)(unsigned char *, unsigned int,
+                        const ab_rtp_packet_info_t *, void *);
+
+    // headroom + RTP header + payload; the last packet built waits in
+    // packets[pending] until it is known whether it ends the access unit
+    unsigned char  *packets[2];
+    int             pending;
+    unsigned int    pending_len;        // 0: nothing waiting
+    uint32_t        pending_timestamp;
+    ab_rtp_packet_info_t pending_info;
+    ab_rtp_aggregation_t aggregation;
+};
+
+T ab_rtp_packetizer_new(int codec, int payload_type, uint32_t ssrc,
+    unsigned int max_payload,
+    void (*cb)(unsigned char *, unsigned int, const ab_rtp_packet_info_t *, void *),
+    void *user_data) {
+    assert(AB_NALU_CODEC_H264 == codec || AB_NALU_CODEC_H265 == codec);
+    // room for at least one byte behind a FU header
+    assert(max_payload > 3);
+
+    T packetizer;
+    NEW0(packetizer);
+
+    packetizer->codec           = codec;
+    packetizer->payload_type    = payload_type;
+    packetizer->ssrc            = ssrc;
+    packetizer->sequence        = 0;
+    packetizer->max_payload     = max_payload;
+    packetizer->callback        = cb;
+    packetizer->user_data       = user_data;
+
+    for (int i = 0; i < 2; ++i)
+        packetizer->packets[i] = ALLOC(AB_RTP_PACKETIZER_HEADROOM +
+            sizeof(ab_rtp_header_t) + max_payload);
+    packetizer->pending         = 0;
+    packetizer->pending_len     = 0;
+    packetizer->aggregation.data = ALLOC(max_payload);
+
+    return packetizer;
+}
+
+void ab_rtp_packetizer_free(T *packetizer) {
+    assert(packetizer && *packetizer);
+
+    FREE((*packetizer)->aggregation.data);
+    FREE((*packetizer)->packets[0]);
+    FREE((*packetizer)->packets[1]);
+    FREE(*packetizer);
+}
+
+uint16_t ab_rtp_packetizer_sequence(T packetizer) {
+    assert(packetizer);
+    return packetizer->sequence;
+}
+
+/*
+ * marker: 该包是AU的最后一个包(RFC 6184 5.1/RFC 7798 4.1)
+ */
+static void send_pending(T packetizer, bool marker) {
+    if (0 == packetizer->pending_len)
+        return;
+
+    unsigned char *rtp = packetizer->packets[packetizer->pending] +
+        AB_RTP_PACKETIZER_HEADROOM;
+    unsigned int len = packetizer->pending_len;
+    ((ab_rtp_header_t *) rtp)->marker = marker;
+    packetizer->pending_len = 0;
+
+    if (packetizer->callback)
+        packetizer->callback(rtp, len, &packetizer->pending_info,
+            packetizer->user_data);
+}
+
+/*
+ * 组好的包先挂起，下一个包组好时前一个包一定不是AU的最后一个
+ */
+static void send_packet(T packetizer, uint32_t timestamp,
+    const unsigned char *header, unsigned int header_len,
+    const unsigned char *data, unsigned int data_len,
+    const ab_rtp_packet_info_t *info) {
+    send_pending(packetizer, false);
+    packetizer->pending = !packetizer->pending;
+    unsigned char *rtp = packetizer->packets[packetizer->pending] +
+        AB_RTP_PACKETIZER_HEADROOM;
+
+    ab_rtp_header_t *rtp_header = (ab_rtp_header_t *) rtp;
+    rtp_header->csrc_len        = 0;
+    rtp_header->extension       = 0;
+    rtp_header->padding         = 0;
+    rtp_header->version         = RTP_VERSION;
+    rtp_header->payload_type    = packetizer->payload_type;
+    rtp_header->marker          = 0;
+    rtp_header->seq             = htons(packetizer->sequence);
+    rtp_header->timestamp       = htonl(timestamp);
+    rtp_header->ssrc            = htonl(packetizer->ssrc);
+
+    unsigned int len = sizeof(ab_rtp_header_t);
+    if (header_len > 0) {
+        memcpy(rtp + len, header, header_len);
+        len += header_len;
+    }
+    memcpy(rtp + len, data, data_len);
+    len += data_len;
+
+    packetizer->pending_len         = len;
+    packetizer->pending_timestamp   = timestamp;
+    packetizer->pending_info        = *info;
+    ++packetizer->sequence;
+}
+
+static void send_aggregation(T packetizer) {
+    ab_rtp_aggregation_t *aggr = &packetizer->aggregation;
+    if (0 == aggr->count)
+        return;
+
+    ab_rtp_packet_info_t info;
+    info.key            = aggr->key;
+    info.nalu_start     = true;
+    info.reference      = aggr->reference;
+    info.temporal_id    = aggr->temporal_id;
+    info.max_temporal_id    = aggr->max_temporal_id;
+    info.switch_point   = aggr->switch_point;
+    info.nalu_count     = aggr->count;
+
+    if (1 == aggr->count) {
+        send_packet(packetizer, aggr->timestamp, NULL, 0,
+            aggr->data + 2, aggr->used - 2, &info);
+    } else {
+        unsigned char header[2];
+        unsigned int header_len = 0;
+        if (AB_NALU_CODEC_H264 == packetizer->codec) {
+            ab_h264_nalu_header_t stap;
+            stap.forbidden_zero_bit     = aggr->forbidden_zero_bit;
+            stap.nal_ref_idc            = aggr->nal_ref_idc;
+            stap.nal_unit_type          = AB_H264_NALU_STAP_A;
+            ab_h264_nalu_header_write(&stap, header);
+            header_len = 1;
+        } else {
+            ab_h265_nalu_header_t ap;
+            ap.forbidden_zero_bit       = aggr->forbidden_zero_bit;
+            ap.nal_unit_type            = AB_H265_NALU_AP;
+            ap.nuh_layer_id             = aggr->nuh_layer_id;
+            ap.nuh_temporal_id_plus1    = aggr->nuh_temporal_id_plus1;
+            ab_h265_nalu_header_write(&ap, header);
+            header_len = 2;
+        }
+
+        send_packet(packetizer, aggr->timestamp, header, header_len,
+            aggr->data, aggr->used, &info);
+    }
+
+    aggr->used  = 0;
+    aggr->count = 0;
+    aggr->key   = false;
+}
+
+void ab_rtp_packetizer_flush(T packetizer, bool end_of_au) {
+    assert(packetizer);
+
+    send_aggregation(packetizer);
+    send_pending(packetizer, end_of_au);
+}
+
+/*
+ * return: false表示放不下，需要先flush
+ */
+static bool aggregate_nalu(T packetizer,
+    const unsigned char *nalu, unsigned int nalu_len,
+    uint32_t timestamp, bool key) {
+    ab_rtp_aggregation_t *aggr = &packetizer->aggregation;
+
+    // STAP-A/AP payload header + 16-bit size per NAL unit
+    unsigned int header_len = ab_nalu_header_size(packetizer->codec);
+    if (aggr->count > 0 &&
+        header_len + aggr->used + 2 + nalu_len > packetizer->max_payload)
+        return false;
+
+    unsigned char *pos = aggr->data + aggr->used;
+    pos[0] = nalu_len >> 8;
+    pos[1] = nalu_len & 0xff;
+    memcpy(pos + 2, nalu, nalu_len);
+    aggr->used += 2 + nalu_len;
+
+    if (AB_NALU_CODEC_H264 == packetizer->codec) {
+        ab_h264_nalu_header_t header;
+        ab_h264_nalu_header_parse(nalu, nalu_len, &header);
+        if (0 == aggr->count) {
+            aggr->forbidden_zero_bit    = header.forbidden_zero_bit;
+            aggr->nal_ref_idc           = header.nal_ref_idc;
+        } else {
+            aggr->forbidden_zero_bit |= header.forbidden_zero_bit;
+            if (header.nal_ref_idc > aggr->nal_ref_idc)
+                aggr->nal_ref_idc = header.nal_ref_idc;
+        }
+    } else {
+        ab_h265_nalu_header_t header;
+        ab_h265_nalu_header_parse(nalu, nalu_len, &header);
+        if (0 == aggr->count) {
+            aggr->forbidden_zero_bit    = header.forbidden_zero_bit;
+            aggr->nuh_layer_id          = header.nuh_layer_id;
+            aggr->nuh_temporal_id_plus1 = header.nuh_temporal_id_plus1;
+        } else {
+            aggr->forbidden_zero_bit |= header.forbidden_zero_bit;
+            if (header.nuh_layer_id < aggr->nuh_layer_id)
+                aggr->nuh_layer_id = header.nuh_layer_id;
+            if (header.nuh_temporal_id_plus1 < aggr->nuh_temporal_id_plus1)
+                aggr->nuh_temporal_id_plus1 = header.nuh_temporal_id_plus1;
+        }
+    }
+
+    bool reference = ab_nalu_is_reference(packetizer->codec, nalu, nalu_len);
+    int temporal_id = ab_nalu_temporal_id(packetizer->codec, nalu, nalu_len);
+    int switch_point = ab_nalu_switch_point(packetizer->codec, nalu, nalu_len);
+    if (0 == aggr->count) {
+        aggr->reference     = reference;
+        aggr->temporal_id   = temporal_id;
+        aggr->max_temporal_id   = temporal_id;
+        aggr->switch_point  = switch_point;
+    } else {
+        aggr->reference     = aggr->reference || reference;
+        if (temporal_id < aggr->temporal_id)
+            aggr->temporal_id = temporal_id;
+        if (temporal_id > aggr->max_temporal_id)
+            aggr->max_temporal_id = temporal_id;
+        if (switch_point > aggr->switch_point)
+            aggr->switch_point = switch_point;
+    }
+
+    aggr->timestamp = timestamp;
+    aggr->key       = aggr->key || key;
+    ++aggr->count;
+    return true;
+}
+
+/*
+ * FU-A(RFC 6184 5.8)/FU(RFC 7798 4.4.3)，NALU头不发送，由FU头携带
+ */
+static void fragment_nalu(T packetizer,
+    const unsigned char *nalu, unsigned int nalu_len,
+    uint32_t timestamp, bool key) {
+    unsigned char fu_header[3];
+    unsigned int fu_header_len = 0;
+    unsigned int nalu_header_len = ab_nalu_header_size(packetizer->codec);
+
+    if (AB_NALU_CODEC_H264 == packetizer->codec) {
+        ab_h264_nalu_header_t header;
+        ab_h264_nalu_header_parse(nalu, nalu_len, &header);
+
+        ab_h264_nalu_header_t indicator = header;
+        indicator.nal_unit_type = AB_H264_NALU_FU_A;
+        ab_h264_nalu_header_write(&indicator, fu_header);
+        fu_header[1]    = header.nal_unit_type;
+        fu_header_len   = 2;
+    } else {
+        ab_h265_nalu_header_t header;
+        ab_h265_nalu_header_parse(nalu, nalu_len, &header);
+
+        // PayloadHdr keeps F, LayerId and TID of the fragmented NAL unit
+        ab_h265_nalu_header_t payload_header = header;
+        payload_header.nal_unit_type = AB_H265_NALU_FU;
+        ab_h265_nalu_header_write(&payload_header, fu_header);
+        fu_header[2]    = header.nal_unit_type;
+        fu_header_len   = 3;
+    }
+
+    ab_rtp_packet_info_t info;
+    info.key            = key;
+    info.reference      = ab_nalu_is_reference(packetizer->codec, nalu, nalu_len);
+    info.temporal_id    = ab_nalu_temporal_id(packetizer->codec, nalu, nalu_len);
+    info.max_temporal_id    = info.temporal_id;
+    info.switch_point   = ab_nalu_switch_point(packetizer->codec, nalu, nalu_len);
+    info.nalu_count     = 0;
+
+    unsigned char *fu_flags = &fu_header[fu_header_len - 1];
+    unsigned char fu_type = *fu_flags;
+
+    const unsigned char *data = nalu + nalu_header_len;
+    unsigned int remain = nalu_len - nalu_header_len;
+    unsigned int max_fragment = packetizer->max_payload - fu_header_len;
+    bool start = true;
+
+    while (remain > 0) {
+        unsigned int len = remain > max_fragment ? max_fragment : remain;
+
+        // S and E are never set together: the NAL unit is bigger than
+        // one packet, so there are at least two fragments
+        *fu_flags = fu_type;
+        if (start)
+            *fu_flags |= 0x80;
+        else if (len == remain)
+            *fu_flags |= 0x40;
+
+        info.nalu_start = start;
+        send_packet(packetizer, timestamp, fu_header, fu_header_len,
+            data, len, &info);
+
+        data    += len;
+        remain  -= len;
+        start   = false;
+    }
+}
+
+void ab_rtp_packetizer_push(T packetizer,
+    const unsigned char *nalu, unsigned int nalu_len, uint32_t timestamp) {
+    assert(packetizer);
+    assert(nalu);
+
+    unsigned int nalu_header_len = ab_nalu_header_size(packetizer->codec);
+    if (nalu_len <= nalu_header_len)
+        return;
+
+    // a new timestamp is a new access unit, the previous one has ended
+    ab_rtp_aggregation_t *aggr = &packetizer->aggregation;
+    if ((aggr->count > 0 && aggr->timestamp != timestamp) ||
+        (packetizer->pending_len > 0 && packetizer->pending_timestamp != timestamp))
+        ab_rtp_packetizer_flush(packetizer, true);
+
+    bool key = ab_nalu_is_key(packetizer->codec, nalu, nalu_len);
+
+    if (nalu_header_len + 2 + nalu_len <= packetizer->max_payload) {
+        if (!aggregate_nalu(packetizer, nalu, nalu_len, timestamp, key)) {
+            send_aggregation(packetizer);
+            aggregate_nalu(packetizer, nalu, nalu_len, timestamp, key);
+        }
+    } else if (nalu_len <= packetizer->max_payload) {
+        send_aggregation(packetizer);
+
+        ab_rtp_packet_info_t info;
+        info.key            = key;
+        info.nalu_start     = true;
+        info.reference      = ab_nalu_is_reference(packetizer->codec, nalu, nalu_len);
+        info.temporal_id    = ab_nalu_temporal_id(packetizer->codec, nalu, nalu_len);
+        info.max_temporal_id    = info.temporal_id;
+        info.switch_point   = ab_nalu_switch_point(packetizer->codec, nalu, nalu_len);
+        info.nalu_count     = 1;
+        send_packet(packetizer, timestamp, NULL, 0, nalu, nalu_len, &info);
+    } else {
+        send_aggregation(packetizer);
+        fragment_nalu(packetizer, nalu, nalu_len, timestamp, key);
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ * ab_rtp_packetizer.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_RTP_PACKETIZER_H_
+#define AB_RTP_PACKETIZER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * 回调的RTP包前预留的字节数，可直接在前面填写interleaved frame
+ */
+#define AB_RTP_PACKETIZER_HEADROOM  4
+
+typedef struct ab_rtp_packet_info_t {
+    bool            key;                // 含IDR/IRAP或参数集
+    bool            nalu_start;         // 单NALU、聚合包或第一个分片
+    bool            reference;          // 含参考帧(H.264 nal_ref_idc != 0，
+                                        // H.265非sub-layer non-reference)
+    uint8_t         temporal_id;        // H.265 TID - 1，聚合包取最小值
+    uint8_t         max_temporal_id;    // 聚合包中的最大值
+    uint8_t         switch_point;       // @ab_nalu_switch_point_t，聚合包取最大值
+    unsigned int    nalu_count;         // 聚合包中的NALU数，分片为0
+} ab_rtp_packet_info_t;
+
+/*
+ * H.264(RFC 6184)/H.265(RFC 7798)打包：单NALU、STAP-A/AP聚合、FU-A/FU分片
+ */
+#define T ab_rtp_packetizer_t
+typedef struct T *T;
+
+/*
+ * codec: @ab_nalu_codec_t
+ * max_payload: 每个RTP包的最大负载长度
+ * cb: rtp前有AB_RTP_PACKETIZER_HEADROOM字节可写
+ */
+extern T    ab_rtp_packetizer_new(int codec, int payload_type, uint32_t ssrc,
+    unsigned int max_payload,
+    void (*cb)(unsigned char *, unsigned int, const ab_rtp_packet_info_t *, void *),
+    void *user_data);
+extern void ab_rtp_packetizer_free(T *packetizer);
+
+/*
+ * nalu: 不含起始码；同一时间戳的小NALU(含同一帧的多个slice)缓存起来聚合，
+ * 直到放不下、时间戳变化或者flush；最后组好的一个包也要等到下一个包组好、
+ * 时间戳变化或者flush时才回调，以便确定标记位
+ */
+extern void ab_rtp_packetizer_push(T packetizer,
+    const unsigned char *nalu, unsigned int nalu_len, uint32_t timestamp);
+/*
+ * 发送缓存的聚合包和挂起的包
+ * end_of_au: AU已结束，最后一个包带标记位；每个AU结束时调用一次
+ */
+extern void ab_rtp_packetizer_flush(T packetizer, bool end_of_au);
+
+extern uint16_t ab_rtp_packetizer_sequence(T packetizer);
+
+#undef T
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_RTP_PACKETIZER_H_
@@ -0,0 +1,241 @@
+/*
+ * ab_rtp_reorder.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_rtp_reorder.h"
+
+#include "ab_base/ab_mem.h"
+#include "ab_base/ab_assert.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#define RTP_HEADER_SIZE         12
+
+#define T ab_rtp_reorder_t
+
+typedef struct ab_rtp_reorder_slot_t {
+    bool            used;
+    uint16_t        seq;
+    unsigned int    len;
+    uint64_t        arrival_us;
+    unsigned char   data[AB_RTP_REORDER_MAX_PACKET_SIZE];
+} ab_rtp_reorder_slot_t;
+
+struct T {
+    unsigned int        window;
+    unsigned int        max_delay_us;
+
+    void               *user_data;
+    void              (*callback)(const unsigned char *, unsigned int, void *);
+
+    bool                started;
+    bool                primed;         // delivered since the (re)start
+    uint16_t            next_seq;       // next packet to deliver
+    uint16_t            highest_seq;    // while not primed
+    unsigned int        pending;        // packets held in slots
+    uint64_t            oldest_us;      // arrival of the oldest held packet
+
+    ab_rtp_reorder_slot_t *slots;
+    ab_rtp_reorder_stats_t stats;
+};
+
+static inline int16_t seq_diff(uint16_t a, uint16_t b) {
+    return (int16_t) (a - b);
+}
+
+static inline uint16_t read_u16(const unsigned char *p) {
+    return (p[0] << 8) | p[1];
+}
+
+T ab_rtp_reorder_new(unsigned int window, unsigned int max_delay_us,
+    void (*cb)(const unsigned char *, unsigned int, void *), void *user_data) {
+    assert(window > 0 && window <= AB_RTP_REORDER_MAX_WINDOW);
+    assert(0 == (window & (window - 1)));
+    assert(cb);
+
+    T reorder;
+    NEW0(reorder);
+    reorder->window         = window;
+    reorder->max_delay_us   = max_delay_us;
+    reorder->callback       = cb;
+    reorder->user_data      = user_data;
+    reorder->slots          = CALLOC(window, sizeof(ab_rtp_reorder_slot_t));
+    return reorder;
+}
+
+void ab_rtp_reorder_free(T *reorder) {
+    assert(reorder && *reorder);
+    FREE((*reorder)->slots);
+    FREE(*reorder);
+}
+
+void ab_rtp_reorder_stats(T reorder, ab_rtp_reorder_stats_t *stats) {
+    assert(reorder);
+    assert(stats);
+    *stats = reorder->stats;
+}
+
+static ab_rtp_reorder_slot_t *slot_of(T reorder, uint16_t seq) {
+    return &reorder->slots[seq & (reorder->window - 1)];
+}
+
+/*
+ * 从next_seq开始输出连续的包，遇到缺包停下
+ */
+static void deliver(T reorder) {
+    while (reorder->pending > 0) {
+        ab_rtp_reorder_slot_t *slot = slot_of(reorder, reorder->next_seq);
+        if (!slot->used || slot->seq != reorder->next_seq)
+            break;
+
+        slot->used = false;
+        --reorder->pending;
+        ++reorder->next_seq;
+        ++reorder->stats.delivered;
+        ++reorder->stats.reordered;
+        reorder->callback(slot->data, slot->len, reorder->user_data);
+    }
+}
+
+/*
+ * 跳过next_seq处的缺包，直到下一个缓存的包
+ */
+static void skip_gap(T reorder) {
+    while (reorder->pending > 0) {
+        ab_rtp_reorder_slot_t *slot = slot_of(reorder, reorder->next_seq);
+        if (slot->used && slot->seq == reorder->next_seq)
+            break;
+        ++reorder->next_seq;
+        ++reorder->stats.lost;
+    }
+}
+
+/*
+ * 剩下的缓存包中最早的到达时间
+ */
+static void update_oldest(T reorder) {
+    reorder->oldest_us = UINT64_MAX;
+    for (unsigned int i = 0; i < reorder->window && reorder->pending > 0; ++i) {
+        const ab_rtp_reorder_slot_t *slot = &reorder->slots[i];
+        if (slot->used && slot->arrival_us < reorder->oldest_us)
+            reorder->oldest_us = slot->arrival_us;
+    }
+}
+
+static void restart(T reorder, uint16_t seq) {
+    for (unsigned int i = 0; i < reorder->window; ++i)
+        reorder->slots[i].used = false;
+    reorder->pending        = 0;
+    reorder->next_seq       = seq;
+    reorder->highest_seq    = seq;
+    reorder->started        = true;
+    reorder->primed         = false;
+}
+
+static void deliver_direct(T reorder, const unsigned char *rtp, unsigned int rtp_len) {
+    ++reorder->next_seq;
+    ++reorder->stats.delivered;
+    reorder->callback(rtp, rtp_len, reorder->user_data);
+    deliver(reorder);
+}
+
+void ab_rtp_reorder_push(T reorder, const unsigned char *rtp,
+    unsigned int rtp_len, uint64_t now_us) {
+    assert(reorder);
+
+    if (NULL == rtp || rtp_len < RTP_HEADER_SIZE || (rtp[0] >> 6) != 2)
+        return;
+
+    uint16_t seq = read_u16(rtp + 2);
+    if (!reorder->started)
+        restart(reorder, seq);
+    int offset = seq_diff(seq, reorder->next_seq);
+    // the sender restarted with a new sequence space
+    if (offset < -(int) reorder->window || offset >= (int) reorder->window * 4) {
+        ++reorder->stats.restarts;
+        restart(reorder, seq);
+        offset = 0;
+    }
+
+    // the first packet may itself be out of order: until something is
+    // delivered an earlier one moves the start back
+    if (!reorder->primed) {
+        if (offset < 0 && seq_diff(reorder->highest_seq, seq) < (int) reorder->window) {
+            reorder->next_seq = seq;
+            offset = 0;
+        }
+        if (seq_diff(seq, reorder->highest_seq) > 0)
+            reorder->highest_seq = seq;
+        if (offset >= (int) reorder->window)
+            reorder->primed = true;
+    }
+
+    if (offset < 0) {
+        ++reorder->stats.late;
+        return;
+    }
+
+    if (reorder->primed) {
+        if (0 == offset) {
+            deliver_direct(reorder, rtp, rtp_len);
+            if (reorder->pending > 0)
+                update_oldest(reorder);
+            return;
+        }
+
+        // too far ahead: give up on what is missing at the front
+        while (seq_diff(seq, reorder->next_seq) >= (int) reorder->window) {
+            ab_rtp_reorder_slot_t *slot = slot_of(reorder, reorder->next_seq);
+            if (slot->used && slot->seq == reorder->next_seq) {
+                deliver(reorder);
+            } else {
+                ++reorder->next_seq;
+                ++reorder->stats.lost;
+            }
+        }
+
+        if (0 == seq_diff(seq, reorder->next_seq)) {
+            deliver_direct(reorder, rtp, rtp_len);
+            if (reorder->pending > 0)
+                update_oldest(reorder);
+            return;
+        }
+    }
+
+    ab_rtp_reorder_slot_t *slot = slot_of(reorder, seq);
+    if (slot->used && slot->seq == seq) {
+        ++reorder->stats.late;
+        return;
+    }
+    if (rtp_len > AB_RTP_REORDER_MAX_PACKET_SIZE) {
+        ++reorder->stats.oversized;
+        return;
+    }
+
+    slot->used          = true;
+    slot->seq           = seq;
+    slot->len           = rtp_len;
+    slot->arrival_us    = now_us;
+    memcpy(slot->data, rtp, rtp_len);
+    if (0 == reorder->pending || now_us < reorder->oldest_us)
+        reorder->oldest_us = now_us;
+    ++reorder->pending;
+
+    ab_rtp_reorder_poll(reorder, now_us);
+}
+
+void ab_rtp_reorder_poll(T reorder, uint64_t now_us) {
+    assert(reorder);
+
+    // each gap gets max_delay_us from when the first packet after it arrived
+    while (reorder->pending > 0 && now_us - reorder->oldest_us >= reorder->max_delay_us) {
+        reorder->primed = true;
+        skip_gap(reorder);
+        deliver(reorder);
+        update_oldest(reorder);
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ * ab_rtp_reorder.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_RTP_REORDER_H_
+#define AB_RTP_REORDER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * 按序列号重排RTP包：缺包时最多等window个包或max_delay_us，之后跳过
+ * 按序到达且没有积压时直接回调，不拷贝
+ */
+
+#define AB_RTP_REORDER_MAX_WINDOW       512
+#define AB_RTP_REORDER_MAX_PACKET_SIZE  1500
+
+#define T ab_rtp_reorder_t
+typedef struct T *T;
+
+typedef struct ab_rtp_reorder_stats_t {
+    uint64_t        delivered;
+    uint64_t        reordered;          // 先缓存再按序输出的包
+    uint64_t        lost;               // 等不到而跳过的序列号
+    uint64_t        late;               // 已跳过或重复的包，丢弃
+    uint64_t        oversized;          // 超过AB_RTP_REORDER_MAX_PACKET_SIZE需要缓存时丢弃
+    uint64_t        restarts;           // 序列号跳变，重新开始
+} ab_rtp_reorder_stats_t;
+
+/*
+ * window: 2的幂，不超过AB_RTP_REORDER_MAX_WINDOW
+ * cb: 按序列号顺序回调完整的RTP包
+ */
+extern T    ab_rtp_reorder_new(unsigned int window, unsigned int max_delay_us,
+    void (*cb)(const unsigned char *, unsigned int, void *), void *user_data);
+extern void ab_rtp_reorder_free(T *reorder);
+
+/*
+ * now_us: CLOCK_MONOTONIC，用于max_delay_us
+ */
+extern void ab_rtp_reorder_push(T reorder, const unsigned char *rtp,
+    unsigned int rtp_len, uint64_t now_us);
+/*
+ * 没有新包时定期调用，跳过等待超时的缺包
+ */
+extern void ab_rtp_reorder_poll(T reorder, uint64_t now_us);
+
+extern void ab_rtp_reorder_stats(T reorder, ab_rtp_reorder_stats_t *stats);
+
+#undef T
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_RTP_REORDER_H_
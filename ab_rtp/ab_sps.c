@@ -0,0 +1,430 @@
+/*
+ * ab_sps.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_sps.h"
+#include "ab_nalu.h"
+#include "ab_bitstream.h"
+
+#include "ab_base/ab_assert.h"
+
+#include <string.h>
+
+// parameter sets are small, anything beyond this is not worth parsing
+#define SPS_MAX_SIZE            1024
+#define H265_MAX_SHORT_TERM_RPS 64
+#define H265_MAX_SUB_LAYERS     7
+
+/*
+ * H.264 7.3.2.1.1.1，只跳过
+ */
+static void h264_skip_scaling_list(ab_bitstream_t *bs, int size) {
+    int last_scale = 8, next_scale = 8;
+    for (int j = 0; j < size && !bs->error; ++j) {
+        if (next_scale != 0) {
+            int delta_scale = ab_bitstream_read_se(bs);
+            next_scale = (last_scale + delta_scale + 256) % 256;
+        }
+        if (next_scale != 0)
+            last_scale = next_scale;
+    }
+}
+
+/*
+ * H.264 E.1.1, up to timing_info
+ */
+static void h264_parse_vui(ab_bitstream_t *bs, ab_sps_info_t *info) {
+    if (ab_bitstream_read_flag(bs)) {           // aspect_ratio_info_present_flag
+        if (255 == ab_bitstream_read_bits(bs, 8))   // Extended_SAR
+            ab_bitstream_skip_bits(bs, 32);
+    }
+    if (ab_bitstream_read_flag(bs))             // overscan_info_present_flag
+        ab_bitstream_skip_bits(bs, 1);
+    if (ab_bitstream_read_flag(bs)) {           // video_signal_type_present_flag
+        ab_bitstream_skip_bits(bs, 4);
+        if (ab_bitstream_read_flag(bs))         // colour_description_present_flag
+            ab_bitstream_skip_bits(bs, 24);
+    }
+    if (ab_bitstream_read_flag(bs)) {           // chroma_loc_info_present_flag
+        ab_bitstream_read_ue(bs);
+        ab_bitstream_read_ue(bs);
+    }
+    if (ab_bitstream_read_flag(bs)) {           // timing_info_present_flag
+        info->num_units_in_tick = ab_bitstream_read_bits(bs, 32);
+        info->time_scale        = ab_bitstream_read_bits(bs, 32);
+        info->fixed_frame_rate  = ab_bitstream_read_flag(bs);
+    }
+}
+
+/*
+ * H.264 7.3.2.1.1
+ */
+static int h264_parse_sps(ab_bitstream_t *bs, ab_sps_info_t *info) {
+    ab_bitstream_skip_bits(bs, 8);              // NAL unit header
+
+    info->profile_idc = ab_bitstream_read_bits(bs, 8);
+    ab_bitstream_skip_bits(bs, 8);              // constraint_set flags
+    info->level_idc = ab_bitstream_read_bits(bs, 8);
+    ab_bitstream_read_ue(bs);                   // seq_parameter_set_id
+
+    info->chroma_format_idc = 1;
+    info->bit_depth         = 8;
+    bool separate_colour_plane = false;
+
+    switch (info->profile_idc) {
+    case 100: case 110: case 122: case 244: case 44: case 83:
+    case 86: case 118: case 128: case 138: case 139: case 134: case 135:
+        info->chroma_format_idc = ab_bitstream_read_ue(bs);
+        if (info->chroma_format_idc > 3)
+            return -1;
+        if (3 == info->chroma_format_idc)
+            separate_colour_plane = ab_bitstream_read_flag(bs);
+        uint32_t bit_depth_luma_minus8   = ab_bitstream_read_ue(bs);
+        uint32_t bit_depth_chroma_minus8 = ab_bitstream_read_ue(bs);
+        if (bit_depth_luma_minus8 > 6 || bit_depth_chroma_minus8 > 6)
+            return -1;
+        info->bit_depth = bit_depth_luma_minus8 + 8;
+        ab_bitstream_skip_bits(bs, 1);          // qpprime_y_zero_transform_bypass_flag
+        if (ab_bitstream_read_flag(bs)) {       // seq_scaling_matrix_present_flag
+            int count = 3 != info->chroma_format_idc ? 8 : 12;
+            for (int i = 0; i < count; ++i) {
+                if (ab_bitstream_read_flag(bs))
+                    h264_skip_scaling_list(bs, i < 6 ? 16 : 64);
+            }
+        }
+        break;
+    default:
+        break;
+    }
+
+    ab_bitstream_read_ue(bs);                   // log2_max_frame_num_minus4
+    uint32_t pic_order_cnt_type = ab_bitstream_read_ue(bs);
+    if (0 == pic_order_cnt_type) {
+        ab_bitstream_read_ue(bs);               // log2_max_pic_order_cnt_lsb_minus4
+    } else if (1 == pic_order_cnt_type) {
+        ab_bitstream_skip_bits(bs, 1);          // delta_pic_order_always_zero_flag
+        ab_bitstream_read_se(bs);               // offset_for_non_ref_pic
+        ab_bitstream_read_se(bs);               // offset_for_top_to_bottom_field
+        uint32_t cycle = ab_bitstream_read_ue(bs);
+        if (cycle > 255)
+            return -1;
+        for (uint32_t i = 0; i < cycle; ++i)
+            ab_bitstream_read_se(bs);           // offset_for_ref_frame
+    } else if (pic_order_cnt_type > 2) {
+        return -1;
+    }
+
+    ab_bitstream_read_ue(bs);                   // max_num_ref_frames
+    ab_bitstream_skip_bits(bs, 1);              // gaps_in_frame_num_value_allowed_flag
+    uint32_t width_in_mbs   = ab_bitstream_read_ue(bs) + 1;
+    uint32_t height_in_maps = ab_bitstream_read_ue(bs) + 1;
+    bool frame_mbs_only     = ab_bitstream_read_flag(bs);
+    if (!frame_mbs_only)
+        ab_bitstream_skip_bits(bs, 1);          // mb_adaptive_frame_field_flag
+    ab_bitstream_skip_bits(bs, 1);              // direct_8x8_inference_flag
+
+    uint32_t crop_left = 0, crop_right = 0, crop_top = 0, crop_bottom = 0;
+    if (ab_bitstream_read_flag(bs)) {           // frame_cropping_flag
+        crop_left   = ab_bitstream_read_ue(bs);
+        crop_right  = ab_bitstream_read_ue(bs);
+        crop_top    = ab_bitstream_read_ue(bs);
+        crop_bottom = ab_bitstream_read_ue(bs);
+    }
+
+    if (ab_bitstream_read_flag(bs))             // vui_parameters_present_flag
+        h264_parse_vui(bs, info);
+
+    // 16384 luma samples each way covers every level in Table A-1
+    if (bs->error || width_in_mbs > 1024 ||
+        (2 - frame_mbs_only) * height_in_maps > 1024)
+        return -1;
+
+    // 7.4.2.1.1: CropUnitX/CropUnitY
+    unsigned int chroma_array_type = separate_colour_plane ? 0 : info->chroma_format_idc;
+    unsigned int crop_unit_x = 1, crop_unit_y = 2 - frame_mbs_only;
+    if (chroma_array_type != 0) {
+        unsigned int sub_width_c  = 3 == chroma_array_type ? 1 : 2;
+        unsigned int sub_height_c = 1 == chroma_array_type ? 2 : 1;
+        crop_unit_x = sub_width_c;
+        crop_unit_y = sub_height_c * (2 - frame_mbs_only);
+    }
+
+    uint64_t width  = width_in_mbs * 16;
+    uint64_t height = (2 - frame_mbs_only) * height_in_maps * 16;
+    uint64_t crop_x = (uint64_t) crop_unit_x * ((uint64_t) crop_left + crop_right);
+    uint64_t crop_y = (uint64_t) crop_unit_y * ((uint64_t) crop_top + crop_bottom);
+    if (crop_x >= width || crop_y >= height)
+        return -1;
+
+    info->width         = width - crop_x;
+    info->height        = height - crop_y;
+    info->interlaced    = !frame_mbs_only;
+
+    return 0;
+}
+
+/*
+ * H.265 7.3.3 profile_tier_level(1, sps_max_sub_layers_minus1)
+ */
+static void h265_parse_profile_tier_level(ab_bitstream_t *bs,
+    unsigned int max_sub_layers_minus1, ab_sps_info_t *info) {
+    ab_bitstream_skip_bits(bs, 3);              // general_profile_space, tier_flag
+    info->profile_idc = ab_bitstream_read_bits(bs, 5);
+    ab_bitstream_skip_bits(bs, 32);             // general_profile_compatibility_flag
+    ab_bitstream_skip_bits(bs, 48);             // source flags, constraint flags
+    info->level_idc = ab_bitstream_read_bits(bs, 8);
+
+    bool profile_present[H265_MAX_SUB_LAYERS];
+    bool level_present[H265_MAX_SUB_LAYERS];
+    for (unsigned int i = 0; i < max_sub_layers_minus1; ++i) {
+        profile_present[i]  = ab_bitstream_read_flag(bs);
+        level_present[i]    = ab_bitstream_read_flag(bs);
+    }
+    if (max_sub_layers_minus1 > 0) {
+        for (unsigned int i = max_sub_layers_minus1; i < 8; ++i)
+            ab_bitstream_skip_bits(bs, 2);      // reserved_zero_2bits
+    }
+    for (unsigned int i = 0; i < max_sub_layers_minus1; ++i) {
+        if (profile_present[i])
+            ab_bitstream_skip_bits(bs, 88);
+        if (level_present[i])
+            ab_bitstream_skip_bits(bs, 8);
+    }
+}
+
+/*
+ * H.265 7.3.4，只跳过
+ */
+static void h265_skip_scaling_list_data(ab_bitstream_t *bs) {
+    for (int size_id = 0; size_id < 4; ++size_id) {
+        for (int matrix_id = 0; matrix_id < 6; matrix_id += 3 == size_id ? 3 : 1) {
+            if (!ab_bitstream_read_flag(bs)) {  // scaling_list_pred_mode_flag
+                ab_bitstream_read_ue(bs);       // scaling_list_pred_matrix_id_delta
+            } else {
+                int coef_num = 64 < (1 << (4 + (size_id << 1))) ?
+                    64 : (1 << (4 + (size_id << 1)));
+                if (size_id > 1)
+                    ab_bitstream_read_se(bs);   // scaling_list_dc_coef_minus8
+                for (int i = 0; i < coef_num && !bs->error; ++i)
+                    ab_bitstream_read_se(bs);   // scaling_list_delta_coef
+            }
+        }
+    }
+}
+
+/*
+ * H.265 7.3.7 st_ref_pic_set(idx)，只需要记下每个集合的NumDeltaPocs
+ */
+static int h265_skip_short_term_ref_pic_set(ab_bitstream_t *bs,
+    unsigned int idx, unsigned int *num_delta_pocs) {
+    bool inter_ref_pic_set_prediction = idx != 0 && ab_bitstream_read_flag(bs);
+    if (inter_ref_pic_set_prediction) {
+        // delta_idx_minus1 only appears in slice headers, so RefRpsIdx = idx - 1
+        ab_bitstream_skip_bits(bs, 1);          // delta_rps_sign
+        ab_bitstream_read_ue(bs);               // abs_delta_rps_minus1
+
+        unsigned int count = 0;
+        for (unsigned int j = 0; j <= num_delta_pocs[idx - 1] && !bs->error; ++j) {
+            bool used_by_curr_pic = ab_bitstream_read_flag(bs);
+            bool use_delta = used_by_curr_pic || ab_bitstream_read_flag(bs);
+            if (use_delta)
+                ++count;
+        }
+        num_delta_pocs[idx] = count;
+    } else {
+        uint32_t num_negative = ab_bitstream_read_ue(bs);
+        uint32_t num_positive = ab_bitstream_read_ue(bs);
+        if (num_negative > 16 || num_positive > 16)
+            return -1;
+        for (uint32_t i = 0; i < num_negative + num_positive; ++i) {
+            ab_bitstream_read_ue(bs);           // delta_poc_sX_minus1
+            ab_bitstream_skip_bits(bs, 1);      // used_by_curr_pic_sX_flag
+        }
+        num_delta_pocs[idx] = num_negative + num_positive;
+    }
+
+    return bs->error ? -1 : 0;
+}
+
+/*
+ * H.265 E.2.1, up to vui_timing_info
+ */
+static void h265_parse_vui(ab_bitstream_t *bs, ab_sps_info_t *info) {
+    if (ab_bitstream_read_flag(bs)) {           // aspect_ratio_info_present_flag
+        if (255 == ab_bitstream_read_bits(bs, 8))   // EXTENDED_SAR
+            ab_bitstream_skip_bits(bs, 32);
+    }
+    if (ab_bitstream_read_flag(bs))             // overscan_info_present_flag
+        ab_bitstream_skip_bits(bs, 1);
+    if (ab_bitstream_read_flag(bs)) {           // video_signal_type_present_flag
+        ab_bitstream_skip_bits(bs, 4);
+        if (ab_bitstream_read_flag(bs))         // colour_description_present_flag
+            ab_bitstream_skip_bits(bs, 24);
+    }
+    if (ab_bitstream_read_flag(bs)) {           // chroma_loc_info_present_flag
+        ab_bitstream_read_ue(bs);
+        ab_bitstream_read_ue(bs);
+    }
+    // neutral_chroma_indication_flag, field_seq_flag, frame_field_info_present_flag
+    ab_bitstream_skip_bits(bs, 3);
+    if (ab_bitstream_read_flag(bs)) {           // default_display_window_flag
+        for (int i = 0; i < 4; ++i)
+            ab_bitstream_read_ue(bs);
+    }
+    if (ab_bitstream_read_flag(bs)) {           // vui_timing_info_present_flag
+        info->num_units_in_tick = ab_bitstream_read_bits(bs, 32);
+        info->time_scale        = ab_bitstream_read_bits(bs, 32);
+        info->fixed_frame_rate  = true;
+    }
+}
+
+/*
+ * H.265 7.3.2.2.1
+ */
+static int h265_parse_sps(ab_bitstream_t *bs, ab_sps_info_t *info) {
+    ab_bitstream_skip_bits(bs, 16);             // NAL unit header
+
+    ab_bitstream_skip_bits(bs, 4);              // sps_video_parameter_set_id
+    unsigned int max_sub_layers_minus1 = ab_bitstream_read_bits(bs, 3);
+    ab_bitstream_skip_bits(bs, 1);              // sps_temporal_id_nesting_flag
+    if (max_sub_layers_minus1 >= H265_MAX_SUB_LAYERS)
+        return -1;
+
+    h265_parse_profile_tier_level(bs, max_sub_layers_minus1, info);
+
+    ab_bitstream_read_ue(bs);                   // sps_seq_parameter_set_id
+    info->chroma_format_idc = ab_bitstream_read_ue(bs);
+    if (info->chroma_format_idc > 3)
+        return -1;
+    bool separate_colour_plane = false;
+    if (3 == info->chroma_format_idc)
+        separate_colour_plane = ab_bitstream_read_flag(bs);
+
+    uint32_t width  = ab_bitstream_read_ue(bs);  // pic_width_in_luma_samples
+    uint32_t height = ab_bitstream_read_ue(bs);
+    uint32_t conf_left = 0, conf_right = 0, conf_top = 0, conf_bottom = 0;
+    if (ab_bitstream_read_flag(bs)) {           // conformance_window_flag
+        conf_left   = ab_bitstream_read_ue(bs);
+        conf_right  = ab_bitstream_read_ue(bs);
+        conf_top    = ab_bitstream_read_ue(bs);
+        conf_bottom = ab_bitstream_read_ue(bs);
+    }
+
+    uint32_t bit_depth_luma_minus8   = ab_bitstream_read_ue(bs);
+    uint32_t bit_depth_chroma_minus8 = ab_bitstream_read_ue(bs);
+    if (bit_depth_luma_minus8 > 8 || bit_depth_chroma_minus8 > 8)
+        return -1;
+    info->bit_depth = bit_depth_luma_minus8 + 8;
+    uint32_t log2_max_poc_lsb = ab_bitstream_read_ue(bs) + 4;
+    if (log2_max_poc_lsb > 16)
+        return -1;
+
+    bool sub_layer_ordering_info_present = ab_bitstream_read_flag(bs);
+    for (unsigned int i = sub_layer_ordering_info_present ? 0 : max_sub_layers_minus1;
+        i <= max_sub_layers_minus1; ++i) {
+        ab_bitstream_read_ue(bs);               // sps_max_dec_pic_buffering_minus1
+        ab_bitstream_read_ue(bs);               // sps_max_num_reorder_pics
+        ab_bitstream_read_ue(bs);               // sps_max_latency_increase_plus1
+    }
+
+    // log2_min_luma_coding_block_size_minus3 ... max_transform_hierarchy_depth_intra
+    for (int i = 0; i < 6; ++i)
+        ab_bitstream_read_ue(bs);
+
+    if (ab_bitstream_read_flag(bs)) {           // scaling_list_enabled_flag
+        if (ab_bitstream_read_flag(bs))         // sps_scaling_list_data_present_flag
+            h265_skip_scaling_list_data(bs);
+    }
+
+    ab_bitstream_skip_bits(bs, 2);              // amp_enabled_flag, sample_adaptive_offset_enabled_flag
+    if (ab_bitstream_read_flag(bs)) {           // pcm_enabled_flag
+        ab_bitstream_skip_bits(bs, 8);          // pcm bit depths
+        ab_bitstream_read_ue(bs);
+        ab_bitstream_read_ue(bs);
+        ab_bitstream_skip_bits(bs, 1);          // pcm_loop_filter_disabled_flag
+    }
+
+    uint32_t num_short_term_ref_pic_sets = ab_bitstream_read_ue(bs);
+    if (num_short_term_ref_pic_sets > H265_MAX_SHORT_TERM_RPS)
+        return -1;
+    unsigned int num_delta_pocs[H265_MAX_SHORT_TERM_RPS];
+    for (uint32_t i = 0; i < num_short_term_ref_pic_sets; ++i) {
+        if (h265_skip_short_term_ref_pic_set(bs, i, num_delta_pocs) < 0)
+            return -1;
+    }
+
+    if (ab_bitstream_read_flag(bs)) {           // long_term_ref_pics_present_flag
+        uint32_t num_long_term_ref_pics = ab_bitstream_read_ue(bs);
+        if (num_long_term_ref_pics > 32)
+            return -1;
+        for (uint32_t i = 0; i < num_long_term_ref_pics; ++i)
+            ab_bitstream_skip_bits(bs, log2_max_poc_lsb + 1);
+    }
+
+    // sps_temporal_mvp_enabled_flag, strong_intra_smoothing_enabled_flag
+    ab_bitstream_skip_bits(bs, 2);
+    if (ab_bitstream_read_flag(bs))             // vui_parameters_present_flag
+        h265_parse_vui(bs, info);
+
+    if (bs->error || 0 == width || 0 == height || width > 16888 || height > 16888)
+        return -1;
+
+    // Table 6-1: SubWidthC/SubHeightC
+    unsigned int chroma_array_type = separate_colour_plane ? 0 : info->chroma_format_idc;
+    unsigned int sub_width_c  = 1 == chroma_array_type || 2 == chroma_array_type ? 2 : 1;
+    unsigned int sub_height_c = 1 == chroma_array_type ? 2 : 1;
+
+    uint64_t crop_x = (uint64_t) sub_width_c * ((uint64_t) conf_left + conf_right);
+    uint64_t crop_y = (uint64_t) sub_height_c * ((uint64_t) conf_top + conf_bottom);
+    if (crop_x >= width || crop_y >= height)
+        return -1;
+
+    info->width         = width - crop_x;
+    info->height        = height - crop_y;
+    info->interlaced    = false;
+
+    return 0;
+}
+
+int ab_sps_parse(int codec, const unsigned char *nalu,
+    unsigned int nalu_len, ab_sps_info_t *info) {
+    assert(nalu || 0 == nalu_len);
+    assert(info);
+
+    memset(info, 0, sizeof(*info));
+    if (ab_nalu_parameter_set(codec, nalu, nalu_len) != AB_NALU_PARAMETER_SET_SPS)
+        return -1;
+
+    unsigned char rbsp[SPS_MAX_SIZE];
+    unsigned int rbsp_len = ab_bitstream_unescape(nalu, nalu_len, rbsp, sizeof(rbsp));
+
+    ab_bitstream_t bs;
+    ab_bitstream_init(&bs, rbsp, rbsp_len);
+
+    int ret = -1;
+    if (AB_NALU_CODEC_H264 == codec)
+        ret = h264_parse_sps(&bs, info);
+    else if (AB_NALU_CODEC_H265 == codec)
+        ret = h265_parse_sps(&bs, info);
+
+    if (ret < 0)
+        memset(info, 0, sizeof(*info));
+    return ret;
+}
+
+bool ab_sps_frame_duration(int codec, const ab_sps_info_t *info,
+    uint64_t *frame_duration_num, uint64_t *frame_duration_den) {
+    assert(info);
+    assert(frame_duration_num && frame_duration_den);
+
+    if (0 == info->num_units_in_tick || 0 == info->time_scale)
+        return false;
+
+    unsigned int ticks_per_frame = AB_NALU_CODEC_H264 == codec ? 2 : 1;
+    *frame_duration_num = (uint64_t) info->num_units_in_tick * ticks_per_frame;
+    *frame_duration_den = info->time_scale;
+    return true;
+}
@@ -0,0 +1,56 @@
+/*
+ * ab_sps.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_SPS_H_
+#define AB_SPS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * 从SPS(含VUI)中取出的流信息
+ */
+typedef struct ab_sps_info_t {
+    unsigned int    profile_idc;        // H.265: general_profile_idc
+    unsigned int    level_idc;          // H.265: general_level_idc (30 * level)
+    unsigned int    chroma_format_idc;
+    unsigned int    bit_depth;          // luma
+
+    unsigned int    width;              // 已减去裁剪/conformance window
+    unsigned int    height;
+    bool            interlaced;         // H.264 frame_mbs_only_flag == 0
+
+    // VUI timing_info，没有时都为0
+    uint32_t        num_units_in_tick;
+    uint32_t        time_scale;
+    bool            fixed_frame_rate;   // H.264 fixed_frame_rate_flag
+} ab_sps_info_t;
+
+/*
+ * nalu: 完整的SPS NALU(含NALU头，不含起始码)
+ * return: 0成功，格式错误或不支持返回-1
+ */
+extern int  ab_sps_parse(int codec, const unsigned char *nalu,
+    unsigned int nalu_len, ab_sps_info_t *info);
+
+/*
+ * 每帧的时长 = frame_duration_num / frame_duration_den 秒
+ * H.264每帧两个tick(E.2.1)，H.265每帧一个tick
+ * return: 没有timing_info返回false
+ */
+extern bool ab_sps_frame_duration(int codec, const ab_sps_info_t *info,
+    uint64_t *frame_duration_num, uint64_t *frame_duration_den);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_SPS_H_
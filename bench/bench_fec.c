@@ -0,0 +1,233 @@
+/*
+ * bench_fec.c
+ *
+ * Lossy-link loopback harness for ab_rtp_fec: synthetic frames are
+ * packetized, protected, dropped at random and decoded again, reporting
+ * how many frames survive against the FEC bandwidth overhead.
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_rtp/ab_rtp_fec.h"
+
+#include "ab_base/ab_mem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define FRAME_RATE          25
+#define GOP_SIZE            50
+#define IDR_FRAME_SIZE      (120 * 1024)
+#define P_FRAME_SIZE        (8 * 1024)
+#define RTP_PAYLOAD_SIZE    1370
+#define FEC_PAYLOAD_TYPE    127
+#define FEC_SSRC            0x88923425
+#define DEFAULT_FRAMES      3000
+
+typedef struct bench_link_t {
+    double          loss;               // Gilbert-Elliott: loss in the bad state
+    double          p_good_to_bad;
+    double          p_bad_to_good;
+    bool            bad;
+    uint64_t        rng;
+} bench_link_t;
+
+typedef struct bench_frame_t {
+    uint16_t        first_seq;
+    int             packets;
+    int             received;
+    bool            idr;
+} bench_frame_t;
+
+typedef struct bench_result_t {
+    unsigned long   media_bytes;
+    unsigned long   fec_bytes;
+    unsigned long   sent;
+    unsigned long   dropped;
+    bench_frame_t  *frames;
+    int             frame_count;
+    uint16_t        first_seq;
+    uint64_t        now_us;             // frame time of the packet being pushed
+    uint64_t        max_hold_us;        // held back by the decoder waiting for FEC
+} bench_result_t;
+
+static double next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return (x >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static bool link_drop(bench_link_t *link) {
+    if (link->bad) {
+        if (next_random(&link->rng) < link->p_bad_to_good)
+            link->bad = false;
+    } else {
+        if (next_random(&link->rng) < link->p_good_to_bad)
+            link->bad = true;
+    }
+
+    return link->bad && next_random(&link->rng) < link->loss;
+}
+
+static void on_packet(const unsigned char *rtp, unsigned int rtp_len, void *user_data) {
+    (void) rtp_len;
+    bench_result_t *result = (bench_result_t *) user_data;
+    uint16_t seq = (rtp[2] << 8) | rtp[3];
+    uint16_t offset = seq - result->first_seq;
+
+    // frames are laid out back to back in sequence number space
+    int lo = 0, hi = result->frame_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if ((uint16_t) (result->frames[mid].first_seq - result->first_seq) <= offset)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    ++result->frames[lo].received;
+
+    uint64_t hold_us = result->now_us - (uint64_t) lo * 1000000 / FRAME_RATE;
+    if (hold_us > result->max_hold_us)
+        result->max_hold_us = hold_us;
+}
+
+static void build_packet(unsigned char *buf, uint16_t seq, uint32_t timestamp,
+    bool marker, unsigned int payload_len, uint64_t *rng) {
+    buf[0] = 0x80;
+    buf[1] = (marker ? 0x80 : 0) | 96;
+    buf[2] = seq >> 8;
+    buf[3] = seq & 0xff;
+    buf[4] = timestamp >> 24;
+    buf[5] = (timestamp >> 16) & 0xff;
+    buf[6] = (timestamp >> 8) & 0xff;
+    buf[7] = timestamp & 0xff;
+    buf[8] = 0x88;
+    buf[9] = 0x92;
+    buf[10] = 0x34;
+    buf[11] = 0x23;
+    for (unsigned int i = 0; i < payload_len; ++i)
+        buf[12 + i] = (unsigned char) (next_random(rng) * 256);
+}
+
+static void run(int frames, double loss, double burst, int idr_group, int group) {
+    bench_link_t link;
+    link.loss           = 1.0;
+    link.bad            = false;
+    link.rng            = 0x9e3779b97f4a7c15ULL;
+    // mean burst length 'burst' packets, stationary loss rate 'loss'
+    link.p_bad_to_good  = 1.0 / burst;
+    link.p_good_to_bad  = loss * link.p_bad_to_good / (1.0 - loss);
+
+    uint64_t payload_rng = 42;
+
+    bench_result_t result;
+    memset(&result, 0, sizeof(result));
+    result.frames       = CALLOC(frames, sizeof(bench_frame_t));
+    result.frame_count  = frames;
+    result.first_seq    = 1000;
+
+    ab_rtp_fec_encoder_t enc = (idr_group || group) ?
+        ab_rtp_fec_encoder_new(FEC_PAYLOAD_TYPE, FEC_SSRC) : NULL;
+    ab_rtp_fec_decoder_t dec = ab_rtp_fec_decoder_new(FEC_PAYLOAD_TYPE,
+        on_packet, &result);
+
+    unsigned char packet[AB_RTP_FEC_MAX_PACKET_SIZE];
+    unsigned char fec[AB_RTP_FEC_MAX_PACKET_SIZE];
+    uint16_t seq = result.first_seq;
+
+    for (int f = 0; f < frames; ++f) {
+        bench_frame_t *frame = &result.frames[f];
+        frame->idr          = 0 == f % GOP_SIZE;
+        frame->first_seq    = seq;
+        result.now_us       = (uint64_t) f * 1000000 / FRAME_RATE;
+
+        unsigned int frame_size = frame->idr ? IDR_FRAME_SIZE : P_FRAME_SIZE;
+        int k = frame->idr ? idr_group : group;
+        frame->packets = (frame_size + RTP_PAYLOAD_SIZE - 1) / RTP_PAYLOAD_SIZE;
+
+        for (int i = 0; i < frame->packets; ++i) {
+            unsigned int len = RTP_PAYLOAD_SIZE;
+            if (i == frame->packets - 1)
+                len = frame_size - i * RTP_PAYLOAD_SIZE;
+
+            build_packet(packet, seq++, f * (90000 / FRAME_RATE),
+                i == frame->packets - 1, len, &payload_rng);
+            result.media_bytes += 12 + len;
+            ++result.sent;
+            if (link_drop(&link))
+                ++result.dropped;
+            else
+                ab_rtp_fec_decoder_push(dec, packet, 12 + len, result.now_us);
+
+            if (NULL == enc || k <= 0)
+                continue;
+
+            int count = ab_rtp_fec_encoder_add(enc, packet, 12 + len);
+            if (count >= k || i == frame->packets - 1) {
+                int fec_len = ab_rtp_fec_encoder_flush(enc, fec, sizeof(fec));
+                result.fec_bytes += fec_len;
+                ++result.sent;
+                if (link_drop(&link))
+                    ++result.dropped;
+                else
+                    ab_rtp_fec_decoder_push(dec, fec, fec_len, result.now_us);
+            }
+        }
+    }
+
+    int complete = 0, decodable = 0;
+    bool broken = true;
+    for (int f = 0; f < frames; ++f) {
+        bench_frame_t *frame = &result.frames[f];
+        bool ok = frame->received >= frame->packets;
+        if (ok)
+            ++complete;
+        if (frame->idr)
+            broken = !ok;
+        else if (!ok)
+            broken = true;
+        if (!broken)
+            ++decodable;
+    }
+
+    printf("loss=%.3f burst=%.1f idr_group=%d group=%d overhead=%.2f%% "
+           "packet_loss=%.2f%% recovered=%lu residual=%lu "
+           "complete_fps=%.2f decodable_fps=%.2f max_hold_ms=%.0f\n",
+        loss, burst, idr_group, group,
+        100.0 * result.fec_bytes / result.media_bytes,
+        100.0 * result.dropped / result.sent,
+        ab_rtp_fec_decoder_recovered(dec), ab_rtp_fec_decoder_lost(dec),
+        (double) FRAME_RATE * complete / frames,
+        (double) FRAME_RATE * decodable / frames, result.max_hold_us / 1000.0);
+
+    ab_rtp_fec_decoder_free(&dec);
+    if (enc)
+        ab_rtp_fec_encoder_free(&enc);
+    FREE(result.frames);
+}
+
+int main(int argc, char *argv[]) {
+    int frames = argc > 1 ? atoi(argv[1]) : DEFAULT_FRAMES;
+    if (frames <= 0)
+        frames = DEFAULT_FRAMES;
+
+    const double losses[] = { 0.005, 0.01, 0.03, 0.05 };
+    const double bursts[] = { 1.0, 3.0 };
+    const int groups[][2] = { { 0, 0 }, { 8, 16 }, { 4, 10 }, { 2, 5 } };
+
+    for (unsigned int b = 0; b < sizeof(bursts) / sizeof(bursts[0]); ++b) {
+        for (unsigned int l = 0; l < sizeof(losses) / sizeof(losses[0]); ++l) {
+            for (unsigned int g = 0; g < sizeof(groups) / sizeof(groups[0]); ++g)
+                run(frames, losses[l], bursts[b], groups[g][0], groups[g][1]);
+        }
+    }
+
+    return 0;
+}
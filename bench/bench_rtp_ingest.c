@@ -0,0 +1,558 @@
+/*
+ * bench_rtp_ingest.c
+ *
+ * Replays an RTP capture over loopback into the RTP/UDP ingest:
+ *   source     ab_udp_source (recvmmsg + reorder) into ab_rtp_depacketizer
+ *   server     ab_rtsp_server_set_rtp_ingest, forwarded with no viewers
+ *
+ * The capture is a classic pcap (Ethernet, Linux cooked, raw IP or
+ * loopback link types, IPv4/IPv6 UDP); the first RTP SSRC in it is
+ * replayed. Without one a synthetic stream of the chosen codec is
+ * packetized instead.
+ * Packets go out with sendmmsg, every REORDER_DEPTH packets in reverse
+ * order, so each gap is filled from the reorder window. Each repeat
+ * continues the sequence numbers and timestamps of the one before. The
+ * depacketized bytes are checked against an in-order run.
+ *
+ * usage: bench_rtp_ingest [capture.pcap|-] [h264|h265] [repeat] [port]
+ *
+ * Every result is one line of key=value pairs:
+ *   bench=<source|server> codec= packets= batches= packets_per_batch=
+ *   reordered= lost= late= packets_per_sec= mbyte_per_sec= check=
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#define _GNU_SOURCE                     // sendmmsg
+
+#include "rtsp_server/ab_rtsp_server.h"
+#include "rtsp_server/ab_udp_source.h"
+
+#include "ab_rtp/ab_nalu.h"
+#include "ab_rtp/ab_rtp_packetizer.h"
+#include "ab_rtp/ab_rtp_depacketizer.h"
+#include "ab_base/ab_mem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define DEFAULT_REPEAT      20
+#define DEFAULT_PORT        5004        // ingest, the server's RTSP port is +1
+
+#define SEND_BATCH          32
+#define REORDER_DEPTH       4
+#define MAX_IN_FLIGHT       1024        // well inside the 4 MB receive buffer
+#define DRAIN_TIMEOUT_SEC   2.0
+
+#define REORDER_WINDOW      64
+#define REORDER_DELAY_US    20000
+
+#define SYNTHETIC_FRAMES    250
+#define SYNTHETIC_GOP       25
+#define IDR_SLICE_SIZE      (80 * 1024)
+#define P_SLICE_SIZE        (8 * 1024)
+#define RTP_MAX_PAYLOAD     1400
+
+typedef struct bench_capture_t {
+    unsigned char  *data;               // RTP packets back to back
+    unsigned int    len;
+    unsigned int    size;
+    unsigned int   *offsets;
+    unsigned int   *lens;
+    unsigned int    count;
+    unsigned int    max_count;
+    uint32_t        ssrc;
+    uint32_t        span;               // 90 kHz ticks one repeat covers
+} bench_capture_t;
+
+typedef struct bench_sink_t {
+    ab_rtp_depacketizer_t depacketizer;
+    unsigned long   bytes;              // depacketized
+    unsigned long   delivered;          // RTP packets, read by the sender
+    bool            started;
+    uint16_t        last_seq;
+    unsigned long   gaps;
+} bench_sink_t;
+
+static const unsigned char h264_sps[] = {
+    0x67, 0x64, 0x00, 0x28, 0xac, 0xd9, 0x40, 0x78, 0x02, 0x27, 0xe5, 0xc0,
+    0x44, 0x00, 0x00, 0x03, 0x00, 0x04, 0x00, 0x00, 0x03, 0x00, 0xf0, 0x3c,
+    0x60, 0xc6, 0x58,
+};
+static const unsigned char h264_pps[] = { 0x68, 0xeb, 0xe3, 0xcb, 0x22, 0xc0 };
+
+static const unsigned char h265_vps[] = {
+    0x40, 0x01, 0x0c, 0x01, 0xff, 0xff, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00,
+    0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x5d, 0x95, 0x98, 0x09,
+};
+static const unsigned char h265_sps[] = {
+    0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00,
+    0x03, 0x00, 0x00, 0x03, 0x00, 0x5d, 0xa0, 0x02, 0x80, 0x80, 0x2d, 0x16,
+    0x59, 0x59, 0xa4, 0x93, 0x2b, 0xc0, 0x5a, 0x70, 0x80, 0x00, 0x01, 0xf4,
+    0x80, 0x00, 0x3a, 0x98, 0x04,
+};
+static const unsigned char h265_pps[] = { 0x44, 0x01, 0xc1, 0x72, 0xb4, 0x62, 0x40 };
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline uint16_t read_u16(const unsigned char *p) {
+    return (p[0] << 8) | p[1];
+}
+
+static inline uint32_t read_u32(const unsigned char *p) {
+    return ((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static inline void write_u16(unsigned char *p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static inline void write_u32(unsigned char *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static void add_packet(bench_capture_t *capture,
+    const unsigned char *rtp, unsigned int rtp_len) {
+    if (capture->count == capture->max_count) {
+        unsigned int max_count = capture->max_count ? capture->max_count * 2 : 1024;
+        unsigned int *offsets = CALLOC(max_count, sizeof(unsigned int));
+        unsigned int *lens = CALLOC(max_count, sizeof(unsigned int));
+        if (capture->count > 0) {
+            memcpy(offsets, capture->offsets, capture->count * sizeof(unsigned int));
+            memcpy(lens, capture->lens, capture->count * sizeof(unsigned int));
+            FREE(capture->offsets);
+            FREE(capture->lens);
+        }
+        capture->offsets    = offsets;
+        capture->lens       = lens;
+        capture->max_count  = max_count;
+    }
+    if (capture->len + rtp_len > capture->size) {
+        unsigned int size = (capture->size + rtp_len) * 2;
+        unsigned char *data = ALLOC(size);
+        if (capture->len > 0) {
+            memcpy(data, capture->data, capture->len);
+            FREE(capture->data);
+        }
+        capture->data = data;
+        capture->size = size;
+    }
+
+    capture->offsets[capture->count]    = capture->len;
+    capture->lens[capture->count]       = rtp_len;
+    memcpy(capture->data + capture->len, rtp, rtp_len);
+    capture->len += rtp_len;
+    ++capture->count;
+}
+
+static void free_capture(bench_capture_t *capture) {
+    if (capture->data)
+        FREE(capture->data);
+    if (capture->offsets)
+        FREE(capture->offsets);
+    if (capture->lens)
+        FREE(capture->lens);
+}
+
+/*
+ * RTP version 2 that is not RTCP (RFC 5761 4)
+ */
+static bool is_rtp(const unsigned char *data, unsigned int len) {
+    return len > 12 && 2 == (data[0] >> 6) && (data[1] < 192 || data[1] > 223);
+}
+
+/*
+ * return: offset of the IP header in a frame of the link type, -1 if not IP
+ */
+static int link_header_size(unsigned int link_type,
+    const unsigned char *frame, unsigned int len) {
+    switch (link_type) {
+    case 0:                             // BSD loopback, host order family
+        return len >= 4 ? 4 : -1;
+    case 1: {                           // Ethernet, maybe one VLAN tag
+        if (len < 14)
+            return -1;
+        unsigned int offset = 14;
+        unsigned int type = read_u16(frame + 12);
+        if (0x8100 == type && len >= 18) {
+            type = read_u16(frame + 16);
+            offset = 18;
+        }
+        return 0x0800 == type || 0x86dd == type ? (int) offset : -1;
+    }
+    case 12: case 101: case 228: case 229:  // raw IP
+        return 0;
+    case 113:                           // Linux cooked
+        return len >= 16 ? 16 : -1;
+    case 276:                           // Linux cooked v2
+        return len >= 20 ? 20 : -1;
+    default:
+        return -1;
+    }
+}
+
+/*
+ * UDP payload of an IPv4/IPv6 packet
+ */
+static const unsigned char *udp_payload(const unsigned char *ip, unsigned int len,
+    unsigned int *payload_len) {
+    unsigned int offset;
+    if (len >= 20 && 4 == (ip[0] >> 4)) {
+        if (ip[9] != 17)
+            return NULL;
+        offset = (ip[0] & 0x0f) * 4;
+    } else if (len >= 40 && 6 == (ip[0] >> 4)) {
+        if (ip[6] != 17)
+            return NULL;
+        offset = 40;
+    } else {
+        return NULL;
+    }
+
+    if (offset + 8 > len)
+        return NULL;
+    unsigned int udp_len = read_u16(ip + offset + 4);
+    if (udp_len < 8)
+        return NULL;
+    *payload_len = udp_len - 8;
+    if (offset + 8 + *payload_len > len)
+        *payload_len = len - offset - 8;
+    return ip + offset + 8;
+}
+
+static bool load_pcap(const char *path, bench_capture_t *capture) {
+    FILE *file = fopen(path, "rb");
+    if (NULL == file) {
+        perror(path);
+        return false;
+    }
+
+    unsigned char header[24];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header)) {
+        fclose(file);
+        return false;
+    }
+
+    // microsecond or nanosecond magic, in either byte order
+    uint32_t magic = read_u32(header);
+    bool swapped = 0xd4c3b2a1 == magic || 0x4d3cb2a1 == magic;
+    if (!swapped && magic != 0xa1b2c3d4 && magic != 0xa1b23c4d) {
+        fprintf(stderr, "%s: not a pcap file\n", path);
+        fclose(file);
+        return false;
+    }
+    #define PCAP_U32(p) (swapped ? \
+        ((uint32_t) (p)[3] << 24 | (p)[2] << 16 | (p)[1] << 8 | (p)[0]) : read_u32(p))
+    unsigned int link_type = PCAP_U32(header + 20) & 0xffff;
+
+    unsigned char record[16];
+    unsigned char *frame = ALLOC(262144);
+    bool have_ssrc = false;
+    while (fread(record, 1, sizeof(record), file) == sizeof(record)) {
+        unsigned int caplen = PCAP_U32(record + 8);
+        if (caplen > 262144 || fread(frame, 1, caplen, file) != caplen)
+            break;
+
+        int offset = link_header_size(link_type, frame, caplen);
+        if (offset < 0)
+            continue;
+
+        unsigned int rtp_len = 0;
+        const unsigned char *rtp = udp_payload(frame + offset, caplen - offset, &rtp_len);
+        if (NULL == rtp || !is_rtp(rtp, rtp_len))
+            continue;
+
+        uint32_t ssrc = read_u32(rtp + 8);
+        if (!have_ssrc) {
+            capture->ssrc = ssrc;
+            have_ssrc = true;
+        }
+        if (ssrc == capture->ssrc)
+            add_packet(capture, rtp, rtp_len);
+    }
+    #undef PCAP_U32
+
+    FREE(frame);
+    fclose(file);
+    return capture->count > 0;
+}
+
+static void synthetic_packet_cb(unsigned char *rtp, unsigned int rtp_len,
+    const ab_rtp_packet_info_t *info, void *user_data) {
+    (void) info;
+    add_packet((bench_capture_t *) user_data, rtp, rtp_len);
+}
+
+/*
+ * GOPs of random slice data without zero bytes, so nothing needs escaping
+ */
+static void build_synthetic(bench_capture_t *capture, int codec) {
+    ab_rtp_packetizer_t packetizer = ab_rtp_packetizer_new(codec,
+        96, 0x12345678, RTP_MAX_PAYLOAD, synthetic_packet_cb, capture);
+    unsigned char *slice = ALLOC(IDR_SLICE_SIZE);
+    uint32_t rng = AB_NALU_CODEC_H264 == codec ? 0x264 : 0x265;
+
+    capture->ssrc = 0x12345678;
+    for (int frame = 0; frame < SYNTHETIC_FRAMES; ++frame) {
+        bool idr = 0 == frame % SYNTHETIC_GOP;
+        uint32_t timestamp = frame * 3600;
+        unsigned int header_len;
+        if (AB_NALU_CODEC_H264 == codec) {
+            if (idr) {
+                ab_rtp_packetizer_push(packetizer, h264_sps, sizeof(h264_sps), timestamp);
+                ab_rtp_packetizer_push(packetizer, h264_pps, sizeof(h264_pps), timestamp);
+            }
+            slice[0] = idr ? 0x65 : 0x41;
+            header_len = 1;
+        } else {
+            if (idr) {
+                ab_rtp_packetizer_push(packetizer, h265_vps, sizeof(h265_vps), timestamp);
+                ab_rtp_packetizer_push(packetizer, h265_sps, sizeof(h265_sps), timestamp);
+                ab_rtp_packetizer_push(packetizer, h265_pps, sizeof(h265_pps), timestamp);
+            }
+            // IDR_W_RADL or TRAIL_R, TID 0
+            slice[0] = idr ? 0x26 : 0x02;
+            slice[1] = 0x01;
+            header_len = 2;
+        }
+
+        unsigned int len = idr ? IDR_SLICE_SIZE : P_SLICE_SIZE;
+        for (unsigned int i = header_len; i < len; ++i) {
+            rng = rng * 1103515245 + 12345;
+            slice[i] = 1 + (rng >> 16) % 255;
+        }
+        ab_rtp_packetizer_push(packetizer, slice, len, timestamp);
+        ab_rtp_packetizer_flush(packetizer, true);
+    }
+
+    FREE(slice);
+    ab_rtp_packetizer_free(&packetizer);
+}
+
+static void sink_bytes_cb(const unsigned char *data, unsigned int len, void *user_data) {
+    (void) data;
+    ((bench_sink_t *) user_data)->bytes += len;
+}
+
+static void sink_rtp_cb(const unsigned char *rtp, unsigned int rtp_len, void *user_data) {
+    bench_sink_t *sink = (bench_sink_t *) user_data;
+    uint16_t seq = read_u16(rtp + 2);
+    if (sink->started && seq != (uint16_t) (sink->last_seq + 1))
+        ++sink->gaps;
+    sink->started   = true;
+    sink->last_seq  = seq;
+
+    ab_rtp_depacketizer_push(sink->depacketizer, rtp, rtp_len);
+    __atomic_store_n(&sink->delivered, sink->delivered + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * the depacketized size of one repeat, in order and straight from the capture
+ */
+static unsigned long reference_bytes(const bench_capture_t *capture, int codec) {
+    bench_sink_t sink;
+    memset(&sink, 0, sizeof(sink));
+    sink.depacketizer = ab_rtp_depacketizer_new(codec, sink_bytes_cb, &sink);
+    for (unsigned int i = 0; i < capture->count; ++i)
+        ab_rtp_depacketizer_push(sink.depacketizer,
+            capture->data + capture->offsets[i], capture->lens[i]);
+    ab_rtp_depacketizer_free(&sink.depacketizer);
+    return sink.bytes;
+}
+
+static void measure_span(bench_capture_t *capture) {
+    uint32_t first = read_u32(capture->data + capture->offsets[0] + 4);
+    uint32_t last = first;
+    for (unsigned int i = 0; i < capture->count; ++i) {
+        uint32_t timestamp = read_u32(capture->data + capture->offsets[i] + 4);
+        if ((int32_t) (timestamp - last) > 0)
+            last = timestamp;
+    }
+    // one frame at 25 fps past the last one
+    capture->span = last - first + 3600;
+}
+
+/*
+ * Sends repeat copies with sendmmsg, REORDER_DEPTH packets reversed at a
+ * time, and stops for the receiver whenever MAX_IN_FLIGHT are outstanding.
+ * return: seconds from the first send until received() catches up
+ */
+static double replay(const bench_capture_t *capture, int repeat, unsigned short port,
+    unsigned long (*received)(void *), void *arg) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family         = AF_INET;
+    addr.sin_port           = htons(port);
+    addr.sin_addr.s_addr    = htonl(INADDR_LOOPBACK);
+    connect(fd, (struct sockaddr *) &addr, sizeof(addr));
+
+    unsigned char *buf = ALLOC(SEND_BATCH * 65536);
+    struct mmsghdr msgs[SEND_BATCH];
+    struct iovec iovs[SEND_BATCH];
+    memset(msgs, 0, sizeof(msgs));
+
+    unsigned long total = (unsigned long) capture->count * repeat;
+    unsigned long sent = 0;
+    double start = now_sec();
+    while (sent < total) {
+        unsigned int batch = 0;
+        while (batch < SEND_BATCH && sent + batch < total) {
+            // reversed within each group of REORDER_DEPTH
+            unsigned long n = sent + batch;
+            unsigned long group = n / REORDER_DEPTH * REORDER_DEPTH;
+            unsigned long last = group + REORDER_DEPTH - 1 < total ?
+                group + REORDER_DEPTH - 1 : total - 1;
+            unsigned long index = last - (n - group);
+            unsigned int rep = index / capture->count;
+            unsigned int i = index % capture->count;
+
+            unsigned char *rtp = buf + batch * 65536;
+            memcpy(rtp, capture->data + capture->offsets[i], capture->lens[i]);
+            write_u16(rtp + 2, read_u16(rtp + 2) + rep * capture->count);
+            write_u32(rtp + 4, read_u32(rtp + 4) + rep * capture->span);
+
+            iovs[batch].iov_base        = rtp;
+            iovs[batch].iov_len         = capture->lens[i];
+            msgs[batch].msg_hdr.msg_iov     = &iovs[batch];
+            msgs[batch].msg_hdr.msg_iovlen  = 1;
+            ++batch;
+        }
+
+        int count = sendmmsg(fd, msgs, batch, 0);
+        if (count <= 0)
+            break;
+        sent += count;
+
+        while (sent - received(arg) > MAX_IN_FLIGHT)
+            usleep(50);
+    }
+
+    double deadline = now_sec() + DRAIN_TIMEOUT_SEC;
+    while (received(arg) < sent && now_sec() < deadline)
+        usleep(100);
+    double elapsed = now_sec() - start;
+
+    FREE(buf);
+    close(fd);
+    return elapsed;
+}
+
+static unsigned long sink_received(void *arg) {
+    return __atomic_load_n(&((bench_sink_t *) arg)->delivered, __ATOMIC_ACQUIRE);
+}
+
+static bool bench_source(const bench_capture_t *capture, int codec, const char *name,
+    int repeat, unsigned short port) {
+    bench_sink_t sink;
+    memset(&sink, 0, sizeof(sink));
+    sink.depacketizer = ab_rtp_depacketizer_new(codec, sink_bytes_cb, &sink);
+
+    ab_udp_source_t source = ab_udp_source_open(port, REORDER_WINDOW, REORDER_DELAY_US,
+        sink_rtp_cb, &sink);
+    if (NULL == source) {
+        ab_rtp_depacketizer_free(&sink.depacketizer);
+        return false;
+    }
+
+    double elapsed = replay(capture, repeat, port, sink_received, &sink);
+
+    ab_udp_source_stats_t stats;
+    ab_udp_source_stats(source, &stats);
+    ab_udp_source_close(&source);
+    ab_rtp_depacketizer_free(&sink.depacketizer);
+
+    unsigned long expect = reference_bytes(capture, codec) * repeat;
+    bool ok = sink.bytes == expect && 0 == sink.gaps;
+    printf("bench=source codec=%s packets=%lu batches=%lu packets_per_batch=%.1f "
+        "reordered=%lu lost=%lu late=%lu packets_per_sec=%.0f mbyte_per_sec=%.1f "
+        "check=%s\n",
+        name, sink.delivered, (unsigned long) stats.batches,
+        stats.batches ? (double) stats.datagrams / stats.batches : 0.0,
+        (unsigned long) stats.reorder.reordered, (unsigned long) stats.reorder.lost,
+        (unsigned long) stats.reorder.late, sink.delivered / elapsed,
+        stats.bytes / elapsed / 1e6, ok ? "ok" : "FAIL");
+    if (!ok)
+        fprintf(stderr, "depacketized %lu bytes, expected %lu, %lu sequence gaps\n",
+            sink.bytes, expect, sink.gaps);
+    return ok;
+}
+
+static unsigned long server_received(void *arg) {
+    ab_rtsp_stats_t stats;
+    ab_rtsp_server_stats((ab_rtsp_server_t) arg, &stats);
+    return stats.rtp_packets;
+}
+
+static bool bench_server(const bench_capture_t *capture, int codec, const char *name,
+    int repeat, unsigned short port) {
+    ab_rtsp_server_t rtsp = ab_rtsp_server_new(port + 1, codec);
+    if (ab_rtsp_server_set_rtp_ingest(rtsp, port) != 0) {
+        ab_rtsp_server_free(&rtsp);
+        return false;
+    }
+
+    double elapsed = replay(capture, repeat, port, server_received, rtsp);
+
+    ab_rtsp_stats_t stats;
+    ab_rtsp_server_stats(rtsp, &stats);
+    ab_rtsp_server_free(&rtsp);
+
+    unsigned long total = (unsigned long) capture->count * repeat;
+    bool ok = stats.rtp_packets == total;
+    printf("bench=server codec=%s packets=%lu frames=%lu key_frames=%lu "
+        "packets_per_sec=%.0f mbyte_per_sec=%.1f check=%s\n",
+        name, (unsigned long) stats.rtp_packets, (unsigned long) stats.frames,
+        (unsigned long) stats.key_frames, stats.rtp_packets / elapsed,
+        stats.ingest_bytes / elapsed / 1e6, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = argc > 1 && strcmp(argv[1], "-") != 0 ? argv[1] : NULL;
+    int codec = argc > 2 && strstr(argv[2], "265") ? AB_NALU_CODEC_H265 : AB_NALU_CODEC_H264;
+    int repeat = argc > 3 ? atoi(argv[3]) : DEFAULT_REPEAT;
+    if (repeat <= 0)
+        repeat = DEFAULT_REPEAT;
+    unsigned short port = argc > 4 ? atoi(argv[4]) : DEFAULT_PORT;
+
+    bench_capture_t capture;
+    memset(&capture, 0, sizeof(capture));
+    if (path) {
+        if (!load_pcap(path, &capture)) {
+            fprintf(stderr, "%s: no RTP found\n", path);
+            free_capture(&capture);
+            return 1;
+        }
+    } else {
+        build_synthetic(&capture, codec);
+    }
+    measure_span(&capture);
+
+    const char *name = AB_NALU_CODEC_H264 == codec ? "h264" : "h265";
+    printf("capture source=%s codec=%s ssrc=%08x packets=%u bytes=%u\n",
+        path ? path : "synthetic", name, capture.ssrc, capture.count, capture.len);
+
+    bool ok = bench_source(&capture, codec, name, repeat, port);
+    ok = bench_server(&capture, codec, name, repeat, port) && ok;
+
+    free_capture(&capture);
+    return ok ? 0 : 1;
+}
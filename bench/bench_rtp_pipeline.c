@@ -0,0 +1,641 @@
+/*
+ * bench_rtp_pipeline.c
+ *
+ * Microbenchmarks for each stage of the video path, server and client:
+ *   split          ab_nalu_find_start_code over an Annex B stream
+ *   server_send    ab_rtsp_server_send in recv()-sized chunks, no viewers
+ *   packetize      ab_rtp_packetizer with a null sink
+ *   depacketize    ab_rtp_depacketizer on whole RTP packets (RTP over UDP)
+ *   interleaved    '$' framing cut at TCP segment boundaries, then
+ *                  depacketized (RTP over TCP)
+ *
+ * The H.264/H.265 streams are synthetic but deterministic: parameter sets,
+ * an IDR followed by P slices, slice data with the zero runs and emulation
+ * prevention bytes an encoder produces. The depacketized output is checked
+ * against the input before anything is timed, and the packetizer output for
+ * a few fixed NAL units is checked byte for byte: single NAL unit, STAP-A/AP,
+ * FU-A/FU, the H.265 PayloadHdr and the marker bit.
+ *
+ * Every result is one line of key=value pairs, best of BENCH_RUNS runs:
+ *   bench=<stage> codec=<h264|h265> unit=<nalu|packet> bytes= units=
+ *   ns_per_byte= units_per_sec= mbyte_per_sec=
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "rtsp_server/ab_rtsp_server.h"
+#include "rtsp_client/ab_rtsp_interleaved.h"
+
+#include "ab_rtp/ab_nalu.h"
+#include "ab_rtp/ab_rtp_packetizer.h"
+#include "ab_rtp/ab_rtp_depacketizer.h"
+#include "ab_base/ab_mem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_RUNS          5
+#define DEFAULT_REPEAT      100
+#define DEFAULT_PORT        8556
+
+#define GOP_SIZE            25
+#define FRAME_COUNT         50
+#define IDR_SLICE_SIZE      (80 * 1024)
+#define P_SLICE_SIZE        (8 * 1024)
+
+#define SEND_CHUNK_SIZE     (16 * 1024)
+#define TCP_SEGMENT_SIZE    1448
+#define RTP_MAX_PAYLOAD     1400
+#define RTP_PAYLOAD_TYPE    96
+#define RTP_SSRC            0x12345678
+
+// small enough that a few bytes of input exercise every packet type
+#define GOLDEN_MAX_PAYLOAD  16
+
+typedef struct bench_stream_t {
+    int             codec;              // @ab_nalu_codec_t
+    const char     *name;
+
+    unsigned char  *data;               // Annex B, 4-byte start codes
+    unsigned int    len;
+
+    unsigned int   *nalu_offsets;       // behind the start code
+    unsigned int   *nalu_lens;
+    unsigned int    nalu_count;
+
+    unsigned char  *packets;            // RTP packets back to back
+    unsigned int   *packet_lens;
+    unsigned int    packet_count;
+    unsigned int    packets_len;
+
+    unsigned char  *interleaved;        // the same packets in '$' frames
+    unsigned int    interleaved_len;
+} bench_stream_t;
+
+typedef struct bench_sink_t {
+    unsigned long   units;
+    unsigned long   bytes;
+
+    // when set, output is compared against it
+    const unsigned char *expect;
+    unsigned int    expect_len;
+    unsigned int    checked;
+    bool            mismatch;
+} bench_sink_t;
+
+typedef struct bench_result_t {
+    double          best;
+    unsigned long   bytes;
+    unsigned long   units;
+} bench_result_t;
+
+static const unsigned char h264_sps[] = {
+    0x67, 0x64, 0x00, 0x28, 0xac, 0xd9, 0x40, 0x78, 0x02, 0x27, 0xe5, 0xc0,
+    0x44, 0x00, 0x00, 0x03, 0x00, 0x04, 0x00, 0x00, 0x03, 0x00, 0xf0, 0x3c,
+    0x60, 0xc6, 0x58,
+};
+static const unsigned char h264_pps[] = { 0x68, 0xeb, 0xe3, 0xcb, 0x22, 0xc0 };
+
+static const unsigned char h265_vps[] = {
+    0x40, 0x01, 0x0c, 0x01, 0xff, 0xff, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00,
+    0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x5d, 0x95, 0x98, 0x09,
+};
+static const unsigned char h265_sps[] = {
+    0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00,
+    0x03, 0x00, 0x00, 0x03, 0x00, 0x5d, 0xa0, 0x02, 0x80, 0x80, 0x2d, 0x16,
+    0x59, 0x59, 0xa4, 0x93, 0x2b, 0xc0, 0x5a, 0x70, 0x80, 0x00, 0x01, 0xf4,
+    0x80, 0x00, 0x3a, 0x98, 0x04,
+};
+static const unsigned char h265_pps[] = { 0x44, 0x01, 0xc1, 0x72, 0xb4, 0x62, 0x40 };
+
+/*
+ * in: frame, length, NAL unit, ...; frame N is stamped 3600 * (N + 1)
+ * out: length, RTP packet, ...; the last packet of each frame has the marker
+ */
+typedef struct golden_case_t {
+    const char             *name;
+    int                     codec;      // @ab_nalu_codec_t
+    const unsigned char    *in;
+    unsigned int            in_len;
+    const unsigned char    *out;
+    unsigned int            out_len;
+} golden_case_t;
+
+static const unsigned char golden_single_in[] = {
+    0, 15, 0x65, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+};
+static const unsigned char golden_single_out[] = {
+    27, 0x80, 0xe0, 0x00, 0x00, 0x00, 0x00, 0x0e, 0x10, 0x12, 0x34, 0x56, 0x78,
+        0x65, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+};
+
+static const unsigned char golden_stap_a_in[] = {
+    0, 4, 0x67, 0x42, 0x00, 0x1f,
+    0, 3, 0x68, 0xce, 0x3c,
+    0, 15, 0x65, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+};
+static const unsigned char golden_stap_a_out[] = {
+    // STAP-A: NRI 3 from the parameter sets
+    24, 0x80, 0x60, 0x00, 0x00, 0x00, 0x00, 0x0e, 0x10, 0x12, 0x34, 0x56, 0x78,
+        0x78, 0x00, 0x04, 0x67, 0x42, 0x00, 0x1f, 0x00, 0x03, 0x68, 0xce, 0x3c,
+    27, 0x80, 0xe0, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x12, 0x34, 0x56, 0x78,
+        0x65, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+};
+
+static const unsigned char golden_fu_a_in[] = {
+    0, 21, 0x41, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a,
+        0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14,
+    // a new timestamp ends the previous access unit without a flush
+    1, 3, 0x41, 0xaa, 0xbb,
+};
+static const unsigned char golden_fu_a_out[] = {
+    // FU indicator NRI 2, FU header S and E around type 1
+    28, 0x80, 0x60, 0x00, 0x00, 0x00, 0x00, 0x0e, 0x10, 0x12, 0x34, 0x56, 0x78,
+        0x5c, 0x81, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+    20, 0x80, 0xe0, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x12, 0x34, 0x56, 0x78,
+        0x5c, 0x41, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14,
+    15, 0x80, 0xe0, 0x00, 0x02, 0x00, 0x00, 0x1c, 0x20, 0x12, 0x34, 0x56, 0x78,
+        0x41, 0xaa, 0xbb,
+};
+
+static const unsigned char golden_ap_in[] = {
+    // prefix SEI at TID 1, TRAIL_R at TID 2
+    0, 4, 0x4e, 0x02, 0x05, 0x01,
+    0, 3, 0x02, 0x03, 0xaf,
+};
+static const unsigned char golden_ap_out[] = {
+    // AP PayloadHdr: type 48, the lowest LayerId and TID
+    25, 0x80, 0xe0, 0x00, 0x00, 0x00, 0x00, 0x0e, 0x10, 0x12, 0x34, 0x56, 0x78,
+        0x60, 0x02, 0x00, 0x04, 0x4e, 0x02, 0x05, 0x01, 0x00, 0x03, 0x02, 0x03, 0xaf,
+};
+
+static const unsigned char golden_fu_in[] = {
+    // TRAIL_R at TID 2
+    0, 22, 0x02, 0x03, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a,
+        0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14,
+};
+static const unsigned char golden_fu_out[] = {
+    // FU PayloadHdr: type 49 with the TID of the fragmented NAL unit
+    28, 0x80, 0x60, 0x00, 0x00, 0x00, 0x00, 0x0e, 0x10, 0x12, 0x34, 0x56, 0x78,
+        0x62, 0x03, 0x81, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d,
+    22, 0x80, 0xe0, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x12, 0x34, 0x56, 0x78,
+        0x62, 0x03, 0x41, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14,
+};
+
+#define GOLDEN_CASE(name, codec) \
+    { #name, codec, golden_##name##_in, sizeof(golden_##name##_in), \
+        golden_##name##_out, sizeof(golden_##name##_out) }
+
+static const golden_case_t golden_cases[] = {
+    GOLDEN_CASE(single, AB_NALU_CODEC_H264),
+    GOLDEN_CASE(stap_a, AB_NALU_CODEC_H264),
+    GOLDEN_CASE(fu_a, AB_NALU_CODEC_H264),
+    GOLDEN_CASE(ap, AB_NALU_CODEC_H265),
+    GOLDEN_CASE(fu, AB_NALU_CODEC_H265),
+};
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x >> 32;
+}
+
+static void append(bench_stream_t *stream,
+    const unsigned char *data, unsigned int len) {
+    memcpy(stream->data + stream->len, data, len);
+    stream->len += len;
+}
+
+static void append_nalu(bench_stream_t *stream,
+    const unsigned char *nalu, unsigned int nalu_len) {
+    static const unsigned char start_code[4] = { 0x00, 0x00, 0x00, 0x01 };
+    append(stream, start_code, sizeof(start_code));
+    append(stream, nalu, nalu_len);
+}
+
+/*
+ * header + slice data; every eighth byte is zero on average and two zeros
+ * in a row are escaped with 0x03 the way an encoder writes them
+ */
+static unsigned int make_slice(unsigned char *buf, const unsigned char *header,
+    unsigned int header_len, unsigned int size, uint64_t *rng) {
+    memcpy(buf, header, header_len);
+    unsigned int len = header_len;
+    buf[len++] = 0x80 | (next_random(rng) & 0x7f);   // first slice of the picture
+
+    unsigned int zeros = 0;
+    while (len < size - 1) {
+        uint32_t r = next_random(rng);
+        unsigned char byte = (r & 0x07) ? (r >> 8) & 0xff : 0x00;
+        if (2 == zeros && byte <= 0x03) {
+            buf[len++] = 0x03;
+            zeros = 0;
+        }
+        buf[len++] = byte;
+        zeros = 0 == byte ? zeros + 1 : 0;
+    }
+    // rbsp_trailing_bits, the NAL unit never ends in zero
+    buf[len++] = 0x80;
+
+    return len;
+}
+
+static void build_stream(bench_stream_t *stream, int codec) {
+    memset(stream, 0, sizeof(*stream));
+    stream->codec = codec;
+    stream->name = AB_NALU_CODEC_H264 == codec ? "h264" : "h265";
+
+    // parameter sets and slices with their start codes
+    stream->data = ALLOC(FRAME_COUNT * (IDR_SLICE_SIZE + 256));
+
+    uint64_t rng = AB_NALU_CODEC_H264 == codec ? 0x264264264ULL : 0x265265265ULL;
+    // an escape byte may push the slice one byte past its nominal size
+    unsigned char *slice = ALLOC(IDR_SLICE_SIZE + 2);
+
+    for (int frame = 0; frame < FRAME_COUNT; ++frame) {
+        bool idr = 0 == frame % GOP_SIZE;
+        unsigned int slice_len;
+        if (AB_NALU_CODEC_H264 == codec) {
+            if (idr) {
+                append_nalu(stream, h264_sps, sizeof(h264_sps));
+                append_nalu(stream, h264_pps, sizeof(h264_pps));
+            }
+            unsigned char header = idr ? 0x65 : 0x41;
+            slice_len = make_slice(slice, &header, 1,
+                idr ? IDR_SLICE_SIZE : P_SLICE_SIZE, &rng);
+        } else {
+            if (idr) {
+                append_nalu(stream, h265_vps, sizeof(h265_vps));
+                append_nalu(stream, h265_sps, sizeof(h265_sps));
+                append_nalu(stream, h265_pps, sizeof(h265_pps));
+            }
+            // IDR_W_RADL or TRAIL_R, TID 0
+            unsigned char header[2] = { idr ? 0x26 : 0x02, 0x01 };
+            slice_len = make_slice(slice, header, 2,
+                idr ? IDR_SLICE_SIZE : P_SLICE_SIZE, &rng);
+        }
+        append_nalu(stream, slice, slice_len);
+    }
+    FREE(slice);
+
+    // NAL unit index
+    unsigned int capacity = FRAME_COUNT * 4;
+    stream->nalu_offsets = ALLOC(capacity * sizeof(unsigned int));
+    stream->nalu_lens = ALLOC(capacity * sizeof(unsigned int));
+    unsigned int pos = 0, start_code = 0;
+    int first = ab_nalu_find_start_code(stream->data, stream->len, &start_code);
+    while (first >= 0) {
+        pos += first + start_code;
+        int next = ab_nalu_find_start_code(stream->data + pos, stream->len - pos,
+            &start_code);
+        unsigned int nalu_len = next < 0 ? stream->len - pos : (unsigned int) next;
+        stream->nalu_offsets[stream->nalu_count] = pos;
+        stream->nalu_lens[stream->nalu_count] = nalu_len;
+        ++stream->nalu_count;
+        first = next;
+    }
+}
+
+static void collect_packet_cb(unsigned char *rtp, unsigned int rtp_len,
+    const ab_rtp_packet_info_t *info, void *user_data) {
+    (void) info;
+    bench_stream_t *stream = (bench_stream_t *) user_data;
+
+    memcpy(stream->packets + stream->packets_len, rtp, rtp_len);
+    stream->packet_lens[stream->packet_count++] = rtp_len;
+    stream->packets_len += rtp_len;
+}
+
+static void packetize_stream(bench_stream_t *stream) {
+    // every packet but the last of a NAL unit carries a full payload
+    unsigned int capacity = stream->nalu_count + stream->len / (RTP_MAX_PAYLOAD - 3);
+    stream->packets = ALLOC(stream->len + capacity * (12 + 3));
+    stream->packet_lens = ALLOC(capacity * sizeof(unsigned int));
+
+    ab_rtp_packetizer_t packetizer = ab_rtp_packetizer_new(stream->codec,
+        RTP_PAYLOAD_TYPE, RTP_SSRC, RTP_MAX_PAYLOAD, collect_packet_cb, stream);
+    for (unsigned int i = 0; i < stream->nalu_count; ++i)
+        ab_rtp_packetizer_push(packetizer, stream->data + stream->nalu_offsets[i],
+            stream->nalu_lens[i], i * 3600);
+    ab_rtp_packetizer_flush(packetizer, true);
+    ab_rtp_packetizer_free(&packetizer);
+
+    stream->interleaved_len = stream->packets_len + 4 * stream->packet_count;
+    stream->interleaved = ALLOC(stream->interleaved_len);
+    unsigned int in = 0, out = 0;
+    for (unsigned int i = 0; i < stream->packet_count; ++i) {
+        unsigned int len = stream->packet_lens[i];
+        stream->interleaved[out]     = '$';
+        stream->interleaved[out + 1] = 0;
+        stream->interleaved[out + 2] = len >> 8;
+        stream->interleaved[out + 3] = len;
+        memcpy(stream->interleaved + out + 4, stream->packets + in, len);
+        in += len;
+        out += len + 4;
+    }
+}
+
+static void free_stream(bench_stream_t *stream) {
+    FREE(stream->data);
+    FREE(stream->nalu_offsets);
+    FREE(stream->nalu_lens);
+    FREE(stream->packets);
+    FREE(stream->packet_lens);
+    FREE(stream->interleaved);
+}
+
+static void report(const char *bench, const bench_stream_t *stream,
+    const char *unit, const bench_result_t *result) {
+    printf("bench=%s codec=%s unit=%s bytes=%lu units=%lu ns_per_byte=%.3f "
+           "units_per_sec=%.0f mbyte_per_sec=%.1f\n",
+        bench, stream->name, unit, result->bytes, result->units,
+        result->best * 1e9 / result->bytes, result->units / result->best,
+        result->bytes / result->best / 1e6);
+}
+
+static void keep_best(bench_result_t *result, double elapsed) {
+    if (0 == result->best || elapsed < result->best)
+        result->best = elapsed;
+}
+
+static void bench_split(const bench_stream_t *stream, int repeat) {
+    bench_result_t result = { 0 };
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+        unsigned long units = 0;
+        double start = now_sec();
+        for (int i = 0; i < repeat; ++i) {
+            unsigned int pos = 0, start_code = 0;
+            int found;
+            while ((found = ab_nalu_find_start_code(stream->data + pos,
+                stream->len - pos, &start_code)) >= 0) {
+                pos += found + start_code;
+                ++units;
+            }
+        }
+        keep_best(&result, now_sec() - start);
+        result.units = units;
+    }
+    result.bytes = (unsigned long) stream->len * repeat;
+    report("split", stream, "nalu", &result);
+}
+
+static void bench_server_send(const bench_stream_t *stream, int repeat,
+    unsigned short port) {
+    ab_rtsp_server_t rtsp = ab_rtsp_server_new(port, stream->codec);
+    if (NULL == rtsp) {
+        printf("bench=server_send codec=%s error=listen port=%u\n",
+            stream->name, port);
+        return;
+    }
+
+    bench_result_t result = { 0 };
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+        ab_rtsp_stats_t before, after;
+        ab_rtsp_server_stats(rtsp, &before);
+
+        double start = now_sec();
+        for (int i = 0; i < repeat; ++i) {
+            for (unsigned int pos = 0; pos < stream->len; pos += SEND_CHUNK_SIZE) {
+                unsigned int len = stream->len - pos;
+                if (len > SEND_CHUNK_SIZE)
+                    len = SEND_CHUNK_SIZE;
+                ab_rtsp_server_send(rtsp, (const char *) stream->data + pos, len);
+            }
+            ab_rtsp_server_send(rtsp, NULL, 0);
+        }
+        keep_best(&result, now_sec() - start);
+
+        ab_rtsp_server_stats(rtsp, &after);
+        result.units = after.rtp_packets - before.rtp_packets;
+    }
+    result.bytes = (unsigned long) stream->len * repeat;
+    report("server_send", stream, "packet", &result);
+
+    ab_rtsp_server_free(&rtsp);
+}
+
+static void count_packet_cb(unsigned char *rtp, unsigned int rtp_len,
+    const ab_rtp_packet_info_t *info, void *user_data) {
+    (void) rtp;
+    (void) info;
+    bench_sink_t *sink = (bench_sink_t *) user_data;
+    ++sink->units;
+    sink->bytes += rtp_len;
+}
+
+static void bench_packetize(const bench_stream_t *stream, int repeat) {
+    bench_result_t result = { 0 };
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+        bench_sink_t sink = { 0 };
+        ab_rtp_packetizer_t packetizer = ab_rtp_packetizer_new(stream->codec,
+            RTP_PAYLOAD_TYPE, RTP_SSRC, RTP_MAX_PAYLOAD, count_packet_cb, &sink);
+
+        uint32_t timestamp = 0;
+        double start = now_sec();
+        for (int i = 0; i < repeat; ++i) {
+            for (unsigned int n = 0; n < stream->nalu_count; ++n)
+                ab_rtp_packetizer_push(packetizer, stream->data + stream->nalu_offsets[n],
+                    stream->nalu_lens[n], timestamp += 3600);
+        }
+        ab_rtp_packetizer_flush(packetizer, true);
+        keep_best(&result, now_sec() - start);
+
+        ab_rtp_packetizer_free(&packetizer);
+        result.units = sink.units;
+    }
+    result.bytes = (unsigned long) stream->len * repeat;
+    report("packetize", stream, "packet", &result);
+}
+
+static void output_cb(const unsigned char *data, unsigned int data_len, void *user_data) {
+    bench_sink_t *sink = (bench_sink_t *) user_data;
+    sink->bytes += data_len;
+
+    if (sink->expect && !sink->mismatch) {
+        if (sink->checked + data_len > sink->expect_len ||
+            memcmp(sink->expect + sink->checked, data, data_len) != 0)
+            sink->mismatch = true;
+        sink->checked += data_len;
+    }
+}
+
+static void push_packets(ab_rtp_depacketizer_t depacketizer,
+    const bench_stream_t *stream) {
+    unsigned int pos = 0;
+    for (unsigned int i = 0; i < stream->packet_count; ++i) {
+        ab_rtp_depacketizer_push(depacketizer, stream->packets + pos,
+            stream->packet_lens[i]);
+        pos += stream->packet_lens[i];
+    }
+}
+
+static void interleaved_frame_cb(unsigned char channel, const unsigned char *data,
+    unsigned int data_len, void *user_data) {
+    (void) channel;
+    ab_rtp_depacketizer_push((ab_rtp_depacketizer_t) user_data, data, data_len);
+}
+
+/*
+ * the receiving loop of the client: segments are appended to what is left
+ * of the last one, complete frames are consumed, the rest moves to the front
+ */
+static void push_interleaved(ab_rtp_depacketizer_t depacketizer,
+    const bench_stream_t *stream, unsigned char *buf) {
+    unsigned int used = 0;
+    for (unsigned int pos = 0; pos < stream->interleaved_len; pos += TCP_SEGMENT_SIZE) {
+        unsigned int len = stream->interleaved_len - pos;
+        if (len > TCP_SEGMENT_SIZE)
+            len = TCP_SEGMENT_SIZE;
+        memcpy(buf + used, stream->interleaved + pos, len);
+        used += len;
+
+        unsigned int parsed = ab_rtsp_interleaved_parse(buf, used,
+            interleaved_frame_cb, depacketizer);
+        used -= parsed;
+        if (used > 0)
+            memmove(buf, buf + parsed, used);
+    }
+}
+
+static bool check_depacketizer(const bench_stream_t *stream, bool interleaved,
+    unsigned char *buf) {
+    bench_sink_t sink = { 0 };
+    sink.expect = stream->data;
+    sink.expect_len = stream->len;
+
+    ab_rtp_depacketizer_t depacketizer = ab_rtp_depacketizer_new(stream->codec,
+        output_cb, &sink);
+    if (interleaved)
+        push_interleaved(depacketizer, stream, buf);
+    else
+        push_packets(depacketizer, stream);
+    ab_rtp_depacketizer_free(&depacketizer);
+
+    bool ok = !sink.mismatch && sink.checked == stream->len;
+    printf("check=%s codec=%s result=%s output=%u expected=%u\n",
+        interleaved ? "interleaved" : "depacketize", stream->name,
+        ok ? "ok" : "mismatch", sink.checked, stream->len);
+    return ok;
+}
+
+static void golden_packet_cb(unsigned char *rtp, unsigned int rtp_len,
+    const ab_rtp_packet_info_t *info, void *user_data) {
+    (void) info;
+    bench_sink_t *sink = (bench_sink_t *) user_data;
+    ++sink->units;
+
+    if (!sink->mismatch) {
+        if (sink->checked + 1 + rtp_len > sink->expect_len ||
+            sink->expect[sink->checked] != rtp_len ||
+            memcmp(sink->expect + sink->checked + 1, rtp, rtp_len) != 0)
+            sink->mismatch = true;
+        sink->checked += 1 + rtp_len;
+    }
+}
+
+static bool check_golden(const golden_case_t *golden) {
+    bench_sink_t sink = { 0 };
+    sink.expect = golden->out;
+    sink.expect_len = golden->out_len;
+
+    ab_rtp_packetizer_t packetizer = ab_rtp_packetizer_new(golden->codec,
+        RTP_PAYLOAD_TYPE, RTP_SSRC, GOLDEN_MAX_PAYLOAD, golden_packet_cb, &sink);
+    unsigned int pos = 0;
+    while (pos + 2 <= golden->in_len) {
+        unsigned int frame = golden->in[pos];
+        unsigned int nalu_len = golden->in[pos + 1];
+        ab_rtp_packetizer_push(packetizer, golden->in + pos + 2, nalu_len,
+            3600 * (frame + 1));
+        pos += 2 + nalu_len;
+    }
+    ab_rtp_packetizer_flush(packetizer, true);
+    ab_rtp_packetizer_free(&packetizer);
+
+    bool ok = !sink.mismatch && sink.checked == golden->out_len;
+    printf("check=golden case=%s codec=%s result=%s packets=%lu\n", golden->name,
+        AB_NALU_CODEC_H264 == golden->codec ? "h264" : "h265",
+        ok ? "ok" : "mismatch", sink.units);
+    return ok;
+}
+
+static void bench_depacketize(const bench_stream_t *stream, int repeat,
+    bool interleaved, unsigned char *buf) {
+    bench_result_t result = { 0 };
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+        bench_sink_t sink = { 0 };
+        ab_rtp_depacketizer_t depacketizer = ab_rtp_depacketizer_new(stream->codec,
+            output_cb, &sink);
+
+        double start = now_sec();
+        for (int i = 0; i < repeat; ++i) {
+            if (interleaved)
+                push_interleaved(depacketizer, stream, buf);
+            else
+                push_packets(depacketizer, stream);
+        }
+        keep_best(&result, now_sec() - start);
+
+        ab_rtp_depacketizer_free(&depacketizer);
+    }
+    result.units = (unsigned long) stream->packet_count * repeat;
+    result.bytes = (unsigned long) (interleaved ?
+        stream->interleaved_len : stream->packets_len) * repeat;
+    report(interleaved ? "interleaved" : "depacketize", stream, "packet", &result);
+}
+
+int main(int argc, char *argv[]) {
+    int repeat = argc > 1 ? atoi(argv[1]) : DEFAULT_REPEAT;
+    if (repeat <= 0)
+        repeat = DEFAULT_REPEAT;
+    unsigned short port = argc > 2 ? atoi(argv[2]) : DEFAULT_PORT;
+
+    // room for a segment behind the longest incomplete frame
+    unsigned char *buf = ALLOC(65536 + 4 + TCP_SEGMENT_SIZE);
+
+    bool ok = true;
+    for (unsigned int i = 0; i < sizeof(golden_cases) / sizeof(golden_cases[0]); ++i)
+        ok = check_golden(&golden_cases[i]) && ok;
+
+    const int codecs[] = { AB_NALU_CODEC_H264, AB_NALU_CODEC_H265 };
+    for (unsigned int i = 0; i < sizeof(codecs) / sizeof(codecs[0]); ++i) {
+        bench_stream_t stream;
+        build_stream(&stream, codecs[i]);
+        packetize_stream(&stream);
+        printf("stream codec=%s bytes=%u nalus=%u packets=%u\n",
+            stream.name, stream.len, stream.nalu_count, stream.packet_count);
+
+        ok = check_depacketizer(&stream, false, buf) && ok;
+        ok = check_depacketizer(&stream, true, buf) && ok;
+
+        bench_split(&stream, repeat);
+        bench_server_send(&stream, repeat, port);
+        bench_packetize(&stream, repeat);
+        bench_depacketize(&stream, repeat, false, buf);
+        bench_depacketize(&stream, repeat, true, buf);
+
+        free_stream(&stream);
+    }
+
+    FREE(buf);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,337 @@
+/*
+ * bench_rtsp_handshake.c
+ *
+ * Control-plane throughput: how fast a reconnect storm is absorbed.
+ * First the response generation of one OPTIONS/DESCRIBE/SETUP/PLAY
+ * handshake is measured in process, pre-rendered templates against the
+ * snprintf-per-request code the server used before. Then concurrent
+ * viewers run full handshakes (connect, OPTIONS, DESCRIBE, SETUP, PLAY,
+ * TEARDOWN, close) against a live ab_rtsp_server over loopback, optionally
+ * spread over several SO_REUSEPORT listeners.
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "rtsp_server/ab_rtsp_server.h"
+#include "rtsp_server/ab_rtsp_response.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#define RENDER_ROUNDS       200000
+#define DEFAULT_SECONDS     5
+#define DEFAULT_VIEWERS     8
+#define DEFAULT_PORT        8554
+#define BENCH_URL           "rtsp://127.0.0.1:8554/live"
+
+typedef struct bench_viewer_t {
+    unsigned short  port;
+    volatile bool  *quit;
+    unsigned long   handshakes;
+    unsigned long   failures;
+    double          latency_sum;
+    double          latency_max;
+    pthread_t       thd;
+} bench_viewer_t;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * 旧实现：每个请求都用snprintf拼出完整响应，DESCRIBE每次重新生成SDP
+ */
+static int legacy_handshake(char *buf, unsigned int size, unsigned int cseq) {
+    int total = 0;
+
+    snprintf(buf, size,
+        "RTSP/1.0 200 OK\r\n"
+        "CSeq: %u\r\n"
+        "Public: OPTIONS, DESCRIBE, SETUP, "
+        "PLAY, TEARDOWN\r\n\r\n", cseq);
+    total += strlen(buf);
+
+    char sdp[512];
+    char local_ip[32];
+    sscanf(BENCH_URL, "rtsp://%[^:]:", local_ip);
+    snprintf(sdp, sizeof(sdp),
+        "v=0\r\n"
+        "o=- 9%ld 1 IN IP4 %s\r\n"
+        "t=0 0\r\n"
+        "a=control:*\r\n"
+        "m=video 0 RTP/AVP 96%s\r\n"
+        "a=rtpmap:96 H264/90000\r\n"
+        "%s"
+        "a=control:track0\r\n", time(NULL), local_ip, "", "");
+    snprintf(buf, size,
+        "RTSP/1.0 200 OK\r\n"
+        "CSeq: %u\r\n"
+        "Content-Base: %s\r\n"
+        "Content-type: application/sdp\r\n"
+        "Content-length: %lu\r\n\r\n"
+        "%s", cseq + 1, BENCH_URL, strlen(sdp), sdp);
+    total += strlen(buf);
+
+    snprintf(buf, size,
+        "RTSP/1.0 200 OK\r\n"
+        "CSeq: %u\r\n"
+        "Transport: RTP/AVP/TCP;unicast;"
+        "interleaved=%u-%u\r\n"
+        "Session: 66334873\r\n\r\n", cseq + 2, 0, 1);
+    total += strlen(buf);
+
+    snprintf(buf, size,
+        "RTSP/1.0 200 OK\r\n"
+        "CSeq: %u\r\n"
+        "Range: npt=0.000-\r\n"
+        "Session: 66334873; timeout=60\r\n\r\n", cseq + 3);
+    total += strlen(buf);
+
+    return total;
+}
+
+static void run_render(void) {
+    char buf[2048];
+    const char session[] = "Session: 0123456789abcdef;timeout=60\r\n";
+    const unsigned int session_len = sizeof(session) - 1;
+
+    ab_rtsp_response_t options, describe, play;
+    ab_rtsp_response_init(&options, "200 OK",
+        "Public: OPTIONS, DESCRIBE, SETUP, PLAY, TEARDOWN, GET_PARAMETER\r\n\r\n");
+    ab_rtsp_response_init(&describe, "200 OK",
+        "Content-Base: %s\r\n"
+        "Content-type: application/sdp\r\n"
+        "Content-length: 118\r\n\r\n"
+        "v=0\r\n"
+        "o=- 91792353934 1 IN IP4 127.0.0.1\r\n"
+        "t=0 0\r\n"
+        "a=control:*\r\n"
+        "m=video 0 RTP/AVP 96\r\n"
+        "a=rtpmap:96 H264/90000\r\n"
+        "a=control:track0\r\n", BENCH_URL);
+    ab_rtsp_response_init(&play, "200 OK", "Range: npt=0.000-\r\n\r\n");
+
+    volatile unsigned long sink = 0;
+    double start = now_sec();
+    for (unsigned int i = 0; i < RENDER_ROUNDS; ++i) {
+        unsigned int cseq = i * 4;
+        sink += ab_rtsp_response_render(&options, buf, sizeof(buf), cseq, NULL, 0);
+        sink += ab_rtsp_response_render(&describe, buf, sizeof(buf), cseq + 1, NULL, 0);
+        // SETUP still echoes the transport with snprintf
+        sink += snprintf(buf, sizeof(buf),
+            "RTSP/1.0 200 OK\r\n"
+            "CSeq: %u\r\n"
+            "Transport: RTP/AVP/TCP;unicast;interleaved=%u-%u\r\n"
+            "%s\r\n", cseq + 2, 0, 1, session);
+        sink += ab_rtsp_response_render(&play, buf, sizeof(buf), cseq + 3,
+            session, session_len);
+    }
+    double elapsed = now_sec() - start;
+    printf("render=template handshakes=%u handshakes_per_sec=%.0f ns_per_handshake=%.1f\n",
+        RENDER_ROUNDS, RENDER_ROUNDS / elapsed, elapsed * 1e9 / RENDER_ROUNDS);
+
+    start = now_sec();
+    for (unsigned int i = 0; i < RENDER_ROUNDS; ++i)
+        sink += legacy_handshake(buf, sizeof(buf), i * 4);
+    elapsed = now_sec() - start;
+    printf("render=legacy_snprintf handshakes=%u handshakes_per_sec=%.0f ns_per_handshake=%.1f\n",
+        RENDER_ROUNDS, RENDER_ROUNDS / elapsed, elapsed * 1e9 / RENDER_ROUNDS);
+
+    ab_rtsp_response_clear(&options);
+    ab_rtsp_response_clear(&describe);
+    ab_rtsp_response_clear(&play);
+}
+
+/*
+ * 读完一个响应(头部 + Content-length)，返回状态码
+ * session: 非NULL时取出Session ID，至少64字节
+ */
+static int read_response(int fd, char *buf, unsigned int size, char *session) {
+    unsigned int used = 0;
+    while (used < size - 1) {
+        int n = recv(fd, buf + used, size - 1 - used, 0);
+        if (n <= 0)
+            return -1;
+        used += n;
+        buf[used] = '\0';
+
+        char *end = strstr(buf, "\r\n\r\n");
+        if (NULL == end)
+            continue;
+
+        unsigned int body = 0;
+        const char *line = strstr(buf, "Content-length:");
+        if (line)
+            body = atoi(line + strlen("Content-length:"));
+        if (used < (end - buf) + 4 + body)
+            continue;
+
+        if (session) {
+            line = strstr(buf, "Session: ");
+            if (line)
+                sscanf(line, "Session: %63[^;\r\n]", session);
+        }
+
+        int status = 0;
+        sscanf(buf, "RTSP/1.0 %d", &status);
+        return status;
+    }
+
+    return -1;
+}
+
+static bool request(int fd, const char *req, char *buf, unsigned int size,
+    char *session) {
+    unsigned int len = strlen(req);
+    if (send(fd, req, len, MSG_NOSIGNAL) != (int) len)
+        return false;
+    return 200 == read_response(fd, buf, size, session);
+}
+
+static bool handshake(unsigned short port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    // a lost response counts as a failure instead of hanging the bench
+    struct timeval timeout = { 2, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family         = AF_INET;
+    addr.sin_port           = htons(port);
+    addr.sin_addr.s_addr    = htonl(INADDR_LOOPBACK);
+
+    bool ok = false;
+    char buf[2048], req[512], session[64] = "";
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0)
+        goto done;
+
+    snprintf(req, sizeof(req), "OPTIONS %s RTSP/1.0\r\nCSeq: 1\r\n\r\n", BENCH_URL);
+    if (!request(fd, req, buf, sizeof(buf), NULL))
+        goto done;
+
+    snprintf(req, sizeof(req), "DESCRIBE %s RTSP/1.0\r\nCSeq: 2\r\n"
+        "Accept: application/sdp\r\n\r\n", BENCH_URL);
+    if (!request(fd, req, buf, sizeof(buf), NULL))
+        goto done;
+
+    snprintf(req, sizeof(req), "SETUP %s/track0 RTSP/1.0\r\nCSeq: 3\r\n"
+        "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n\r\n", BENCH_URL);
+    if (!request(fd, req, buf, sizeof(buf), session))
+        goto done;
+
+    snprintf(req, sizeof(req), "PLAY %s RTSP/1.0\r\nCSeq: 4\r\n"
+        "Session: %s\r\nRange: npt=0.000-\r\n\r\n", BENCH_URL, session);
+    if (!request(fd, req, buf, sizeof(buf), NULL))
+        goto done;
+
+    // the server does not answer TEARDOWN
+    snprintf(req, sizeof(req), "TEARDOWN %s RTSP/1.0\r\nCSeq: 5\r\n"
+        "Session: %s\r\n\r\n", BENCH_URL, session);
+    ok = send(fd, req, strlen(req), MSG_NOSIGNAL) > 0;
+
+done:
+    close(fd);
+    return ok;
+}
+
+static void *viewer_thd(void *arg) {
+    bench_viewer_t *viewer = (bench_viewer_t *) arg;
+
+    while (!*viewer->quit) {
+        double start = now_sec();
+        if (handshake(viewer->port)) {
+            double latency = now_sec() - start;
+            ++viewer->handshakes;
+            viewer->latency_sum += latency;
+            if (latency > viewer->latency_max)
+                viewer->latency_max = latency;
+        } else {
+            ++viewer->failures;
+        }
+    }
+
+    return NULL;
+}
+
+static void run_loopback(int seconds, int viewers, unsigned short port,
+    unsigned int listeners) {
+    ab_rtsp_server_t rtsp = ab_rtsp_server_new(port, 1);
+    if (listeners > 1 && ab_rtsp_server_set_listen(rtsp, 0, listeners) < 0)
+        listeners = 1;
+
+    // SPS/PPS so DESCRIBE has parameter sets to cache
+    static const char parameter_sets[] = {
+        0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0xc0, 0x1f, 0xda, 0x01, 0x40, 0x16,
+        0x00, 0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80,
+        0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00,
+    };
+    ab_rtsp_server_send(rtsp, parameter_sets, sizeof(parameter_sets));
+    usleep(100 * 1000);
+
+    volatile bool quit = false;
+    bench_viewer_t *viewer = calloc(viewers, sizeof(bench_viewer_t));
+    for (int i = 0; i < viewers; ++i) {
+        viewer[i].port = port;
+        viewer[i].quit = &quit;
+        pthread_create(&viewer[i].thd, NULL, viewer_thd, &viewer[i]);
+    }
+
+    double start = now_sec();
+    sleep(seconds);
+    quit = true;
+
+    unsigned long handshakes = 0, failures = 0;
+    double latency_sum = 0, latency_max = 0;
+    for (int i = 0; i < viewers; ++i) {
+        pthread_join(viewer[i].thd, NULL);
+        handshakes  += viewer[i].handshakes;
+        failures    += viewer[i].failures;
+        latency_sum += viewer[i].latency_sum;
+        if (viewer[i].latency_max > latency_max)
+            latency_max = viewer[i].latency_max;
+    }
+    double elapsed = now_sec() - start;
+
+    printf("loopback viewers=%d listeners=%u handshakes=%lu failures=%lu handshakes_per_sec=%.0f "
+           "avg_ms=%.3f max_ms=%.3f\n", viewers, listeners, handshakes, failures,
+        handshakes / elapsed, handshakes ? latency_sum * 1e3 / handshakes : 0,
+        latency_max * 1e3);
+
+    free(viewer);
+    ab_rtsp_server_free(&rtsp);
+}
+
+int main(int argc, char *argv[]) {
+    int seconds = argc > 1 ? atoi(argv[1]) : DEFAULT_SECONDS;
+    int viewers = argc > 2 ? atoi(argv[2]) : DEFAULT_VIEWERS;
+    int port    = argc > 3 ? atoi(argv[3]) : DEFAULT_PORT;
+    int listeners = argc > 4 ? atoi(argv[4]) : 1;
+    if (seconds <= 0)
+        seconds = DEFAULT_SECONDS;
+    if (viewers <= 0)
+        viewers = DEFAULT_VIEWERS;
+
+    run_render();
+    run_loopback(seconds, viewers, port, listeners > 0 ? listeners : 1);
+
+    return 0;
+}
@@ -0,0 +1,743 @@
+/*
+ * bench_rtsp_load.c
+ *
+ * Data-plane load over loopback: an ab_rtsp_server is fed a synthetic
+ * H.264 stream at a fixed bitrate while N TCP (interleaved) and M UDP
+ * viewers, each after a full OPTIONS/DESCRIBE/SETUP/PLAY handshake,
+ * drain it from a few epoll threads. Reports what the viewers received
+ * (packets/s, Mbit/s), server CPU per viewer, congestion drops, UDP loss
+ * and latency, both as seen by the viewers (frame fed to each of its
+ * packets received) and from the server's own ingest-to-wire histogram.
+ *
+ * With workers > 0 the stream is packetized here into a shared packet ring
+ * and that many forked worker servers share the port, each fanning out to
+ * the viewers the kernel hands it; server CPU then includes the workers,
+ * while the sent_* and server_latency lines only cover this process, which
+ * has no viewers of its own.
+ *
+ * usage: bench_rtsp_load [seconds] [tcp_viewers] [udp_viewers] [mbps] [fps]
+ *                        [port] [pacing_percent] [workers]
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE                     // recvmmsg
+#endif
+
+#include "rtsp_server/ab_rtsp_server.h"
+#include "rtsp_server/ab_shm_source.h"
+
+#include "ab_base/ab_histogram.h"
+#include "ab_base/ab_shm_ring.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#define DEFAULT_SECONDS     10
+#define DEFAULT_TCP_VIEWERS 100
+#define DEFAULT_UDP_VIEWERS 100
+#define DEFAULT_MBPS        4.0
+#define DEFAULT_FPS         25
+#define DEFAULT_PORT        8554
+#define GOP_SIZE            50
+#define IDR_WEIGHT          8           // an IDR is this many P frames
+#define HANDSHAKE_THREADS   8
+#define WORKER_THREADS      4
+#define MAX_EVENTS          256
+#define UDP_BATCH           32
+#define FEED_RING_SIZE      1024        // frames, by RTP timestamp
+#define TIMESTAMP_STEP      3600        // 90 kHz, no VUI timing in the SPS: 25 fps
+#define BENCH_URL_FMT       "rtsp://127.0.0.1:%u/live"
+#define BENCH_RING_NAME     "/ab_bench_load_packets"
+#define BENCH_RING_SIZE     (16 * 1024 * 1024)
+
+typedef struct bench_viewer_t {
+    int             fd;                 // RTSP connection, media too over TCP
+    int             udp_fd;             // RTP over UDP, -1 for TCP viewers
+    bool            closed;
+
+    // interleaved frame being parsed: '$' channel length + RTP header
+    unsigned char   head[16];
+    unsigned int    head_used;
+    unsigned int    frame_len;
+    unsigned int    skip;
+
+    bool            seq_valid;
+    uint16_t        last_seq;
+    uint64_t        packets;
+    uint64_t        bytes;
+    uint64_t        lost;               // gaps in the RTP sequence
+} bench_viewer_t;
+
+typedef struct bench_worker_t {
+    int             epoll_fd;
+    pthread_t       thd;
+    struct timespec cpu;                // thread CPU time when it quit
+} bench_worker_t;
+
+typedef struct bench_handshaker_t {
+    unsigned int    first;
+    unsigned int    step;
+    pthread_t       thd;
+} bench_handshaker_t;
+
+static volatile bool g_quit = false;
+static volatile bool g_measuring = false;
+
+static unsigned short g_port = DEFAULT_PORT;
+static bench_viewer_t *g_viewers = NULL;
+static unsigned int g_tcp_viewers = 0;
+static unsigned int g_viewer_count = 0;
+static bench_worker_t g_workers[WORKER_THREADS];
+static unsigned long g_handshake_failures = 0;
+
+// feed time of each frame, indexed by RTP timestamp / TIMESTAMP_STEP
+static uint64_t g_feed_ns[FEED_RING_SIZE];
+static ab_histogram_t g_latency = NULL;     // us, frame fed to packet received
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static double cpu_sec(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * /proc/<pid>/stat的utime + stime
+ */
+static double process_cpu_sec(pid_t pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE *file = fopen(path, "r");
+    if (NULL == file)
+        return 0;
+
+    unsigned long utime = 0, stime = 0;
+    // comm may hold spaces, the fields resume after its ')'
+    char line[1024];
+    if (fgets(line, sizeof(line), file)) {
+        const char *rest = strrchr(line, ')');
+        if (rest)
+            sscanf(rest + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                &utime, &stime);
+    }
+    fclose(file);
+
+    return (double) (utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+static void raise_fd_limit(void) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+/*
+ * 一个RTP包：按序号统计丢包，按时间戳找到所属帧的送入时间计算延时
+ * (服务端不置M位，看不出帧的最后一个包)
+ */
+static void on_rtp(bench_viewer_t *viewer, const unsigned char *rtp,
+    unsigned int header_len, unsigned int len) {
+    ++viewer->packets;
+    viewer->bytes += len;
+    if (header_len < 12 || (rtp[1] & 0x7f) != 96)
+        return;
+
+    uint16_t seq = (rtp[2] << 8) | rtp[3];
+    if (viewer->seq_valid && seq != (uint16_t) (viewer->last_seq + 1))
+        viewer->lost += (uint16_t) (seq - viewer->last_seq - 1);
+    viewer->seq_valid = true;
+    viewer->last_seq  = seq;
+
+    if (g_measuring) {
+        uint32_t timestamp = ((uint32_t) rtp[4] << 24) | (rtp[5] << 16) |
+            (rtp[6] << 8) | rtp[7];
+        unsigned int frame = timestamp / TIMESTAMP_STEP % FEED_RING_SIZE;
+        uint64_t fed = __atomic_load_n(&g_feed_ns[frame], __ATOMIC_RELAXED);
+        uint64_t now = now_ns();
+        if (fed != 0 && now > fed)
+            ab_histogram_record(g_latency, (now - fed) / 1000);
+    }
+}
+
+/*
+ * 解析interleaved流，帧可以跨多次读取
+ * return: 不是interleaved帧时返回-1
+ */
+static int parse_interleaved(bench_viewer_t *viewer,
+    const unsigned char *data, unsigned int len) {
+    unsigned int pos = 0;
+    while (pos < len) {
+        if (viewer->skip > 0) {
+            unsigned int n = len - pos < viewer->skip ? len - pos : viewer->skip;
+            viewer->skip -= n;
+            pos += n;
+            continue;
+        }
+
+        unsigned int want = viewer->head_used < 4 ? 4 :
+            4 + (viewer->frame_len < 12 ? viewer->frame_len : 12);
+        while (viewer->head_used < want && pos < len)
+            viewer->head[viewer->head_used++] = data[pos++];
+        if (viewer->head_used < want)
+            break;
+
+        if (4 == viewer->head_used && 4 == want) {
+            if (viewer->head[0] != '$')
+                return -1;
+            viewer->frame_len = (viewer->head[2] << 8) | viewer->head[3];
+            if (viewer->frame_len > 0)
+                continue;
+        }
+
+        // even channels carry RTP, odd ones RTCP sender reports
+        if (0 == viewer->head[1] % 2 && viewer->frame_len > 0)
+            on_rtp(viewer, viewer->head + 4, viewer->head_used - 4, viewer->frame_len);
+        viewer->skip        = viewer->frame_len - (viewer->head_used - 4);
+        viewer->head_used   = 0;
+        viewer->frame_len   = 0;
+    }
+    return 0;
+}
+
+static void read_tcp(bench_viewer_t *viewer) {
+    unsigned char buf[64 * 1024];
+    int n = recv(viewer->fd, buf, sizeof(buf), 0);
+    if (n > 0) {
+        if (parse_interleaved(viewer, buf, n) < 0)
+            n = 0;
+    } else if (n < 0 && (EAGAIN == errno || EINTR == errno)) {
+        return;
+    }
+
+    if (n <= 0) {
+        viewer->closed = true;
+        close(viewer->fd);
+        viewer->fd = -1;
+    }
+}
+
+static void read_udp(bench_viewer_t *viewer) {
+    static __thread unsigned char bufs[UDP_BATCH][2048];
+    struct mmsghdr msgs[UDP_BATCH];
+    struct iovec iovs[UDP_BATCH];
+    for (int i = 0; i < UDP_BATCH; ++i) {
+        iovs[i].iov_base = bufs[i];
+        iovs[i].iov_len  = sizeof(bufs[i]);
+        memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+        msgs[i].msg_hdr.msg_iov     = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen  = 1;
+    }
+
+    int count = recvmmsg(viewer->udp_fd, msgs, UDP_BATCH, MSG_DONTWAIT, NULL);
+    for (int i = 0; i < count; ++i)
+        on_rtp(viewer, bufs[i], msgs[i].msg_len, msgs[i].msg_len);
+}
+
+static void *worker_thd(void *arg) {
+    bench_worker_t *worker = (bench_worker_t *) arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (!g_quit) {
+        int count = epoll_wait(worker->epoll_fd, events, MAX_EVENTS, 100);
+        for (int i = 0; i < count; ++i) {
+            bench_viewer_t *viewer = (bench_viewer_t *) events[i].data.ptr;
+            if (viewer->udp_fd >= 0)
+                read_udp(viewer);
+            else if (!viewer->closed)
+                read_tcp(viewer);
+        }
+    }
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &worker->cpu);
+    return NULL;
+}
+
+/*
+ * 读完一个响应(头部 + Content-length)
+ * session: 非NULL时取出Session ID，至少64字节
+ * rest/rest_len: 响应之后已读到的数据(PLAY之后的媒体)
+ * return: 状态码，出错返回-1
+ */
+static int read_response(int fd, char *buf, unsigned int size, char *session,
+    const char **rest, unsigned int *rest_len) {
+    unsigned int used = 0;
+    while (used < size - 1) {
+        int n = recv(fd, buf + used, size - 1 - used, 0);
+        if (n <= 0)
+            return -1;
+        used += n;
+        buf[used] = '\0';
+
+        char *end = strstr(buf, "\r\n\r\n");
+        if (NULL == end)
+            continue;
+
+        unsigned int body = 0;
+        const char *line = strstr(buf, "Content-length:");
+        if (line && line < end)
+            body = atoi(line + strlen("Content-length:"));
+        unsigned int response_len = (end - buf) + 4 + body;
+        if (used < response_len)
+            continue;
+
+        if (session) {
+            line = strstr(buf, "Session: ");
+            if (line)
+                sscanf(line, "Session: %63[^;\r\n]", session);
+        }
+        if (rest) {
+            *rest       = buf + response_len;
+            *rest_len   = used - response_len;
+        }
+
+        int status = 0;
+        sscanf(buf, "RTSP/1.0 %d", &status);
+        return status;
+    }
+
+    return -1;
+}
+
+static bool request(int fd, const char *req, char *buf, unsigned int size,
+    char *session) {
+    unsigned int len = strlen(req);
+    if (send(fd, req, len, MSG_NOSIGNAL) != (int) len)
+        return false;
+    return 200 == read_response(fd, buf, size, session, NULL, NULL);
+}
+
+/*
+ * return: UDP时为RTP端口的socket，TCP时为0，失败返回-1
+ */
+static int open_rtp_socket(bool tcp, unsigned short *port) {
+    if (tcp)
+        return 0;
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return -1;
+
+    int size = 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family         = AF_INET;
+    addr.sin_addr.s_addr    = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+        getsockname(fd, (struct sockaddr *) &addr, &addr_len) != 0) {
+        close(fd);
+        return -1;
+    }
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static bool handshake(bench_viewer_t *viewer, bool tcp, bench_worker_t *worker) {
+    char url[64];
+    snprintf(url, sizeof(url), BENCH_URL_FMT, g_port);
+
+    viewer->fd      = socket(AF_INET, SOCK_STREAM, 0);
+    viewer->udp_fd  = -1;
+    if (viewer->fd < 0)
+        return false;
+
+    int on = 1;
+    setsockopt(viewer->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    struct timeval timeout = { 5, 0 };
+    setsockopt(viewer->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family         = AF_INET;
+    addr.sin_port           = htons(g_port);
+    addr.sin_addr.s_addr    = htonl(INADDR_LOOPBACK);
+
+    char buf[4096], req[512], session[64] = "";
+    const char *rest = NULL;
+    unsigned int rest_len = 0;
+    unsigned short rtp_port = 0;
+    int rtp_fd = -1;
+    if (connect(viewer->fd, (struct sockaddr *) &addr, sizeof(addr)) != 0)
+        goto fail;
+
+    snprintf(req, sizeof(req), "OPTIONS %s RTSP/1.0\r\nCSeq: 1\r\n\r\n", url);
+    if (!request(viewer->fd, req, buf, sizeof(buf), NULL))
+        goto fail;
+
+    snprintf(req, sizeof(req), "DESCRIBE %s RTSP/1.0\r\nCSeq: 2\r\n"
+        "Accept: application/sdp\r\n\r\n", url);
+    if (!request(viewer->fd, req, buf, sizeof(buf), NULL))
+        goto fail;
+
+    rtp_fd = open_rtp_socket(tcp, &rtp_port);
+    if (rtp_fd < 0)
+        goto fail;
+    if (tcp) {
+        snprintf(req, sizeof(req), "SETUP %s/track0 RTSP/1.0\r\nCSeq: 3\r\n"
+            "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n\r\n", url);
+    } else {
+        viewer->udp_fd = rtp_fd;
+        snprintf(req, sizeof(req), "SETUP %s/track0 RTSP/1.0\r\nCSeq: 3\r\n"
+            "Transport: RTP/AVP;unicast;client_port=%hu-%hu\r\n\r\n",
+            url, rtp_port, (unsigned short) (rtp_port + 1));
+    }
+    if (!request(viewer->fd, req, buf, sizeof(buf), session))
+        goto fail;
+
+    snprintf(req, sizeof(req), "PLAY %s RTSP/1.0\r\nCSeq: 4\r\n"
+        "Session: %s\r\nRange: npt=0.000-\r\n\r\n", url, session);
+    if (send(viewer->fd, req, strlen(req), MSG_NOSIGNAL) != (int) strlen(req) ||
+        read_response(viewer->fd, buf, sizeof(buf), NULL, &rest, &rest_len) != 200)
+        goto fail;
+
+    // media may already follow the PLAY response
+    if (tcp && rest_len > 0 && parse_interleaved(viewer,
+        (const unsigned char *) rest, rest_len) < 0)
+        goto fail;
+
+    fcntl(viewer->fd, F_SETFL, fcntl(viewer->fd, F_GETFL) | O_NONBLOCK);
+    struct epoll_event event;
+    event.events    = EPOLLIN;
+    event.data.ptr  = viewer;
+    if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD,
+        tcp ? viewer->fd : viewer->udp_fd, &event) != 0)
+        goto fail;
+    return true;
+
+fail:
+    if (viewer->udp_fd >= 0)
+        close(viewer->udp_fd);
+    viewer->udp_fd = -1;
+    close(viewer->fd);
+    viewer->fd      = -1;
+    viewer->closed  = true;
+    return false;
+}
+
+static void *handshaker_thd(void *arg) {
+    bench_handshaker_t *handshaker = (bench_handshaker_t *) arg;
+
+    for (unsigned int i = handshaker->first; i < g_viewer_count; i += handshaker->step) {
+        if (!handshake(&g_viewers[i], i < g_tcp_viewers,
+            &g_workers[i % WORKER_THREADS]))
+            __atomic_fetch_add(&g_handshake_failures, 1, __ATOMIC_RELAXED);
+    }
+
+    return NULL;
+}
+
+typedef struct bench_feeder_t {
+    ab_rtsp_server_t rtsp;
+    double          mbps;
+    unsigned int    fps;
+    unsigned char  *idr;                // SPS + PPS + IDR slice
+    unsigned int    idr_len;
+    unsigned char  *p;                  // P slice
+    unsigned int    p_len;
+    unsigned long   frames;
+    pthread_t       thd;
+} bench_feeder_t;
+
+/*
+ * start code + 两字节头(first_mb_in_slice = 0)，其余填充不含0x000001
+ */
+static unsigned int fill_slice(unsigned char *buf, unsigned char nal_header,
+    unsigned char slice_header, unsigned int len) {
+    static const unsigned char start_code[] = { 0x00, 0x00, 0x00, 0x01 };
+    memcpy(buf, start_code, sizeof(start_code));
+    buf[4] = nal_header;
+    buf[5] = slice_header;
+    memset(buf + 6, 0x5a, len - 6);
+    return len;
+}
+
+static void init_feeder(bench_feeder_t *feeder) {
+    static const unsigned char parameter_sets[] = {
+        0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0xc0, 0x1f, 0xda, 0x01, 0x40, 0x16,
+        0x00, 0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80,
+    };
+
+    // GOP_SIZE frames carry (GOP_SIZE - 1 + IDR_WEIGHT) P-frame units
+    double bytes_per_gop = feeder->mbps * 1e6 / 8 * GOP_SIZE / feeder->fps;
+    unsigned int p_len = bytes_per_gop / (GOP_SIZE - 1 + IDR_WEIGHT);
+    if (p_len < 16)
+        p_len = 16;
+    unsigned int idr_len = p_len * IDR_WEIGHT;
+
+    feeder->p       = malloc(p_len);
+    feeder->p_len   = fill_slice(feeder->p, 0x41, 0x9a, p_len);
+    feeder->idr     = malloc(sizeof(parameter_sets) + idr_len);
+    memcpy(feeder->idr, parameter_sets, sizeof(parameter_sets));
+    feeder->idr_len = sizeof(parameter_sets) +
+        fill_slice(feeder->idr + sizeof(parameter_sets), 0x65, 0x88, idr_len);
+    feeder->frames  = 0;
+}
+
+/*
+ * 按帧率送帧，每帧之后flush，让服务端立即打包而不是等下一个起始码
+ */
+static void feed_frame(bench_feeder_t *feeder) {
+    bool key = 0 == feeder->frames % GOP_SIZE;
+    __atomic_store_n(&g_feed_ns[feeder->frames % FEED_RING_SIZE], now_ns(),
+        __ATOMIC_RELAXED);
+    if (key)
+        ab_rtsp_server_send(feeder->rtsp, (const char *) feeder->idr, feeder->idr_len);
+    else
+        ab_rtsp_server_send(feeder->rtsp, (const char *) feeder->p, feeder->p_len);
+    ab_rtsp_server_send(feeder->rtsp, NULL, 0);
+    ++feeder->frames;
+}
+
+static void *feeder_thd(void *arg) {
+    bench_feeder_t *feeder = (bench_feeder_t *) arg;
+
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    const long interval_ns = 1000000000L / feeder->fps;
+    while (!g_quit) {
+        feed_frame(feeder);
+
+        next.tv_nsec += interval_ns;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            ++next.tv_sec;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+
+    return NULL;
+}
+
+/*
+ * 只做扇出的worker：从包环转发，直到被kill
+ */
+static pid_t spawn_worker(unsigned short port, unsigned int worker, int pacing) {
+    pid_t pid = fork();
+    if (pid != 0)
+        return pid;
+
+    ab_rtsp_server_t rtsp = ab_rtsp_server_new_worker(port, 1, worker);
+    ab_rtsp_server_set_session_timeout(rtsp, 0);
+    if (pacing > 0)
+        ab_rtsp_server_set_pacing(rtsp, NULL, pacing);
+    ab_rtsp_server_set_packet_ring_ingest(rtsp, BENCH_RING_NAME);
+    for (;;)
+        pause();
+}
+
+static double workers_cpu_sec(const pid_t *workers, int count) {
+    double result = 0;
+    for (int i = 0; i < count; ++i)
+        result += process_cpu_sec(workers[i]);
+    return result;
+}
+
+static void sum_viewers(uint64_t *packets, uint64_t *bytes, uint64_t *lost,
+    unsigned int *closed) {
+    *packets = *bytes = *lost = 0;
+    *closed = 0;
+    for (unsigned int i = 0; i < g_viewer_count; ++i) {
+        *packets    += __atomic_load_n(&g_viewers[i].packets, __ATOMIC_RELAXED);
+        *bytes      += __atomic_load_n(&g_viewers[i].bytes, __ATOMIC_RELAXED);
+        *lost       += __atomic_load_n(&g_viewers[i].lost, __ATOMIC_RELAXED);
+        if (g_viewers[i].closed)
+            ++*closed;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int seconds         = argc > 1 ? atoi(argv[1]) : DEFAULT_SECONDS;
+    int tcp_viewers     = argc > 2 ? atoi(argv[2]) : DEFAULT_TCP_VIEWERS;
+    int udp_viewers     = argc > 3 ? atoi(argv[3]) : DEFAULT_UDP_VIEWERS;
+    double mbps         = argc > 4 ? atof(argv[4]) : DEFAULT_MBPS;
+    int fps             = argc > 5 ? atoi(argv[5]) : DEFAULT_FPS;
+    int port            = argc > 6 ? atoi(argv[6]) : DEFAULT_PORT;
+    int pacing          = argc > 7 ? atoi(argv[7]) : 0;
+    int workers         = argc > 8 ? atoi(argv[8]) : 0;
+    if (seconds <= 0)
+        seconds = DEFAULT_SECONDS;
+    if (tcp_viewers < 0)
+        tcp_viewers = 0;
+    if (udp_viewers < 0)
+        udp_viewers = 0;
+    if (mbps <= 0)
+        mbps = DEFAULT_MBPS;
+    if (fps <= 0)
+        fps = DEFAULT_FPS;
+    if (workers < 0)
+        workers = 0;
+    if (workers > AB_RTSP_MAX_WORKERS)
+        workers = AB_RTSP_MAX_WORKERS;
+
+    raise_fd_limit();
+    g_port          = port;
+    g_tcp_viewers   = tcp_viewers;
+    g_viewer_count  = tcp_viewers + udp_viewers;
+    g_viewers       = calloc(g_viewer_count ? g_viewer_count : 1, sizeof(bench_viewer_t));
+    g_latency       = ab_histogram_new();
+
+    // forked before any thread; a ring left by an earlier run would hand
+    // the workers stale frames
+    pid_t worker_pids[AB_RTSP_MAX_WORKERS];
+    ab_shm_ring_unlink(BENCH_RING_NAME);
+    for (int i = 0; i < workers; ++i)
+        worker_pids[i] = spawn_worker(port, i, pacing);
+
+    ab_rtsp_server_t rtsp = ab_rtsp_server_new(workers > 0 ? 0 : port, 1);
+    ab_rtsp_server_set_session_timeout(rtsp, 0);
+    if (pacing > 0)
+        ab_rtsp_server_set_pacing(rtsp, NULL, pacing);
+    if (workers > 0) {
+        ab_rtsp_server_set_packet_ring(rtsp, BENCH_RING_NAME, BENCH_RING_SIZE);
+        // attached before the first frame, the workers relay our timestamps
+        // unchanged and the feed times still match
+        usleep(3 * AB_SHM_SOURCE_RETRY_MS * 1000);
+    }
+
+    bench_feeder_t feeder;
+    feeder.rtsp = rtsp;
+    feeder.mbps = mbps;
+    feeder.fps  = fps;
+    init_feeder(&feeder);
+    // SPS/PPS before the first DESCRIBE
+    feed_frame(&feeder);
+    if (workers > 0)
+        usleep(100 * 1000);
+    pthread_create(&feeder.thd, NULL, feeder_thd, &feeder);
+
+    for (int i = 0; i < WORKER_THREADS; ++i) {
+        g_workers[i].epoll_fd = epoll_create1(0);
+        pthread_create(&g_workers[i].thd, NULL, worker_thd, &g_workers[i]);
+    }
+
+    double start = now_ns() / 1e9;
+    bench_handshaker_t handshakers[HANDSHAKE_THREADS];
+    for (int i = 0; i < HANDSHAKE_THREADS; ++i) {
+        handshakers[i].first    = i;
+        handshakers[i].step     = HANDSHAKE_THREADS;
+        pthread_create(&handshakers[i].thd, NULL, handshaker_thd, &handshakers[i]);
+    }
+    for (int i = 0; i < HANDSHAKE_THREADS; ++i)
+        pthread_join(handshakers[i].thd, NULL);
+    double handshake_sec = now_ns() / 1e9 - start;
+
+    // measure from here, the handshakes are bench_rtsp_handshake's business
+    ab_rtsp_stats_t stats_begin, stats_end;
+    uint64_t packets_begin, bytes_begin, lost_begin;
+    unsigned int closed_begin;
+    ab_rtsp_server_stats(rtsp, &stats_begin);
+    sum_viewers(&packets_begin, &bytes_begin, &lost_begin, &closed_begin);
+    double cpu_begin = cpu_sec(CLOCK_PROCESS_CPUTIME_ID);
+    double workers_cpu_begin = workers_cpu_sec(worker_pids, workers);
+    start = now_ns() / 1e9;
+    g_measuring = true;
+
+    sleep(seconds);
+
+    g_measuring = false;
+    double elapsed = now_ns() / 1e9 - start;
+    double cpu_end = cpu_sec(CLOCK_PROCESS_CPUTIME_ID);
+    double workers_cpu = workers_cpu_sec(worker_pids, workers) - workers_cpu_begin;
+    uint64_t packets, bytes, lost;
+    unsigned int closed;
+    ab_rtsp_server_stats(rtsp, &stats_end);
+    sum_viewers(&packets, &bytes, &lost, &closed);
+
+    g_quit = true;
+    pthread_join(feeder.thd, NULL);
+    double viewer_cpu = 0;
+    for (int i = 0; i < WORKER_THREADS; ++i) {
+        pthread_join(g_workers[i].thd, NULL);
+        viewer_cpu += g_workers[i].cpu.tv_sec + g_workers[i].cpu.tv_nsec / 1e9;
+        close(g_workers[i].epoll_fd);
+    }
+
+    // everything but the viewer threads is the server (feeder included:
+    // it packetizes and fans out when pacing is off); the workers idled
+    // through the handshakes, their whole CPU time is charged to the window
+    double server_cpu = (cpu_end - cpu_begin) - viewer_cpu + workers_cpu;
+    if (server_cpu < 0)
+        server_cpu = 0;
+    unsigned int viewers = g_viewer_count - (unsigned int) g_handshake_failures;
+
+    ab_histogram_summary_t latency;
+    ab_histogram_summary(g_latency, &latency);
+    const ab_histogram_summary_t *server_latency = &stats_end.latency[0].total;
+
+    printf("load tcp_viewers=%d udp_viewers=%d handshake_failures=%lu handshake_sec=%.2f "
+           "mbps=%.2f fps=%d pacing=%d workers=%d seconds=%.2f\n",
+        tcp_viewers, udp_viewers, g_handshake_failures, handshake_sec,
+        mbps, fps, pacing, workers, elapsed);
+    printf("load recv_pkts_per_sec=%.0f recv_mbit_per_sec=%.1f "
+           "sent_pkts_per_sec=%.0f sent_mbit_per_sec=%.1f\n",
+        (packets - packets_begin) / elapsed,
+        (bytes - bytes_begin) * 8 / elapsed / 1e6,
+        (stats_end.sent_packets - stats_begin.sent_packets) / elapsed,
+        (stats_end.sent_bytes - stats_begin.sent_bytes) * 8 / elapsed / 1e6);
+    printf("load server_cpu_pct=%.1f cpu_pct_per_viewer=%.4f viewer_cpu_pct=%.1f\n",
+        server_cpu * 100 / elapsed,
+        viewers ? server_cpu * 100 / elapsed / viewers : 0,
+        viewer_cpu * 100 / elapsed);
+    printf("load dropped=%" PRIu64 " send_errors=%" PRIu64 " udp_lost=%" PRIu64
+           " disconnected=%u\n",
+        stats_end.dropped_packets - stats_begin.dropped_packets,
+        stats_end.send_errors - stats_begin.send_errors,
+        lost - lost_begin, closed - closed_begin);
+    printf("load recv_latency_ms p50=%.3f p99=%.3f p999=%.3f max=%.3f packets=%" PRIu64 "\n",
+        latency.p50 / 1e3, latency.p99 / 1e3, latency.p999 / 1e3, latency.max / 1e3,
+        latency.count);
+    printf("load server_latency_ms p50=%.3f p99=%.3f p999=%.3f max=%.3f packets=%" PRIu64 "\n",
+        server_latency->p50 / 1e3, server_latency->p99 / 1e3,
+        server_latency->p999 / 1e3, server_latency->max / 1e3, server_latency->count);
+
+    for (unsigned int i = 0; i < g_viewer_count; ++i) {
+        if (g_viewers[i].fd >= 0)
+            close(g_viewers[i].fd);
+        if (g_viewers[i].udp_fd >= 0)
+            close(g_viewers[i].udp_fd);
+    }
+    ab_rtsp_server_free(&rtsp);
+    for (int i = 0; i < workers; ++i) {
+        kill(worker_pids[i], SIGKILL);
+        waitpid(worker_pids[i], NULL, 0);
+    }
+    if (workers > 0)
+        ab_shm_ring_unlink(BENCH_RING_NAME);
+    ab_histogram_free(&g_latency);
+    free(feeder.idr);
+    free(feeder.p);
+    free(g_viewers);
+
+    return 0;
+}
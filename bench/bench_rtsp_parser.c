@@ -0,0 +1,214 @@
+/*
+ * bench_rtsp_parser.c
+ *
+ * Parse throughput of ab_rtsp_parser: a realistic control-plane stream
+ * (handshake requests, keepalives with a body, interleaved RTCP) is fed
+ * in segments of different sizes, the way recv() hands it over. The
+ * sscanf/strstr scan the server used before is measured on whole
+ * requests for comparison.
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "rtsp_server/ab_rtsp_parser.h"
+
+#include "ab_base/ab_mem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define STREAM_COPIES       2000
+#define PARSER_BUFFER_SIZE  4096
+
+static const char *g_requests[] = {
+    "OPTIONS rtsp://192.168.1.10:554/live RTSP/1.0\r\n"
+    "CSeq: 1\r\n"
+    "User-Agent: LibVLC/3.0.18 (LIVE555 Streaming Media v2016.11.28)\r\n\r\n",
+
+    "DESCRIBE rtsp://192.168.1.10:554/live RTSP/1.0\r\n"
+    "CSeq: 2\r\n"
+    "User-Agent: LibVLC/3.0.18 (LIVE555 Streaming Media v2016.11.28)\r\n"
+    "Accept: application/sdp\r\n\r\n",
+
+    "SETUP rtsp://192.168.1.10:554/live/track0 RTSP/1.0\r\n"
+    "CSeq: 3\r\n"
+    "User-Agent: LibVLC/3.0.18 (LIVE555 Streaming Media v2016.11.28)\r\n"
+    "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n\r\n",
+
+    "PLAY rtsp://192.168.1.10:554/live RTSP/1.0\r\n"
+    "CSeq: 4\r\n"
+    "User-Agent: LibVLC/3.0.18 (LIVE555 Streaming Media v2016.11.28)\r\n"
+    "Session: 66334873\r\n"
+    "Range: npt=0.000-\r\n\r\n",
+
+    "GET_PARAMETER rtsp://192.168.1.10:554/live RTSP/1.0\r\n"
+    "CSeq: 5\r\n"
+    "User-Agent: LibVLC/3.0.18 (LIVE555 Streaming Media v2016.11.28)\r\n"
+    "Session: 66334873\r\n"
+    "Content-Type: text/parameters\r\n"
+    "Content-Length: 8\r\n\r\n"
+    "position",
+};
+
+// RTCP receiver report on the interleaved RTCP channel
+static const unsigned char g_rtcp[] = {
+    '$', 0x01, 0x00, 0x20,
+    0x81, 0xc9, 0x00, 0x07, 0x12, 0x34, 0x56, 0x78,
+    0x88, 0x92, 0x34, 0x23, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x10,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char *build_stream(unsigned int *stream_len, unsigned long *messages) {
+    unsigned int once = 0;
+    unsigned int count = sizeof(g_requests) / sizeof(g_requests[0]);
+    for (unsigned int i = 0; i < count; ++i)
+        once += strlen(g_requests[i]) + sizeof(g_rtcp);
+
+    char *stream = ALLOC(once * STREAM_COPIES);
+    unsigned int pos = 0;
+    for (int c = 0; c < STREAM_COPIES; ++c) {
+        for (unsigned int i = 0; i < count; ++i) {
+            unsigned int len = strlen(g_requests[i]);
+            memcpy(stream + pos, g_requests[i], len);
+            pos += len;
+            memcpy(stream + pos, g_rtcp, sizeof(g_rtcp));
+            pos += sizeof(g_rtcp);
+        }
+    }
+
+    *stream_len = pos;
+    *messages = (unsigned long) count * 2 * STREAM_COPIES;
+    return stream;
+}
+
+/*
+ * segment: 每次commit的字节数，0表示随机(1~1460)
+ */
+static void run_parser(const char *stream, unsigned int stream_len,
+    unsigned long expected, unsigned int segment, int rounds) {
+    unsigned long parsed = 0, bytes = 0, errors = 0;
+    unsigned int rng = 1;
+    volatile int sink = 0;
+
+    double start = now_sec();
+    for (int r = 0; r < rounds; ++r) {
+        ab_rtsp_parser_t parser = ab_rtsp_parser_new(PARSER_BUFFER_SIZE);
+        unsigned int pos = 0;
+        while (pos < stream_len) {
+            unsigned int space;
+            char *buf = ab_rtsp_parser_buffer(parser, &space);
+
+            unsigned int len = segment;
+            if (0 == len) {
+                rng = rng * 1103515245 + 12345;
+                len = 1 + (rng >> 16) % 1460;
+            }
+            if (len > space)
+                len = space;
+            if (len > stream_len - pos)
+                len = stream_len - pos;
+
+            memcpy(buf, stream + pos, len);
+            ab_rtsp_parser_commit(parser, len);
+            pos += len;
+
+            ab_rtsp_message_t msg;
+            int ret;
+            while ((ret = ab_rtsp_parser_next(parser, &msg)) !=
+                AB_RTSP_PARSE_NEED_MORE) {
+                if (AB_RTSP_PARSE_ERROR == ret) {
+                    ++errors;
+                    break;
+                }
+                if (AB_RTSP_PARSE_MESSAGE == ret)
+                    sink += msg.cseq;
+                ++parsed;
+            }
+        }
+        bytes += stream_len;
+        ab_rtsp_parser_free(&parser);
+    }
+    double elapsed = now_sec() - start;
+
+    printf("parser=ab_rtsp_parser segment=%s%u msgs=%lu expected=%lu errors=%lu "
+           "msgs_per_sec=%.0f mbytes_per_sec=%.1f ns_per_msg=%.1f\n",
+        segment ? "" : "random<=", segment ? segment : 1460,
+        parsed, expected * rounds, errors,
+        parsed / elapsed, bytes / elapsed / 1e6, elapsed * 1e9 / parsed);
+}
+
+/*
+ * 旧实现：假定一次recv恰好是一个完整请求，用sscanf/strstr逐项扫描
+ */
+static int legacy_parse(const char *request) {
+    char method[16], url[128], version[16];
+    sscanf(request, "%s %s %s\r\n", method, url, version);
+
+    unsigned int cseq = 0;
+    const char *line = strstr(request, "CSeq");
+    if (NULL == line)
+        return -1;
+    sscanf(line, "CSeq: %u\r\n", &cseq);
+
+    if (strcmp(method, "SETUP") == 0) {
+        unsigned short rtp = 0, rtcp = 0;
+        line = strstr(request, "Transport");
+        if (line && strstr(line, "RTP/AVP/TCP") != NULL)
+            sscanf(line, "Transport: RTP/AVP/TCP;unicast;interleaved=%hu-%hu\r\n",
+                &rtp, &rtcp);
+        cseq += rtp + rtcp;
+    }
+
+    return cseq;
+}
+
+static void run_legacy(int rounds) {
+    unsigned int count = sizeof(g_requests) / sizeof(g_requests[0]);
+    unsigned long parsed = 0, bytes = 0;
+    volatile int sink = 0;
+
+    double start = now_sec();
+    for (int r = 0; r < rounds; ++r) {
+        for (int c = 0; c < STREAM_COPIES; ++c) {
+            for (unsigned int i = 0; i < count; ++i) {
+                sink += legacy_parse(g_requests[i]);
+                bytes += strlen(g_requests[i]);
+                ++parsed;
+            }
+        }
+    }
+    double elapsed = now_sec() - start;
+
+    printf("parser=legacy_sscanf segment=whole msgs=%lu "
+           "msgs_per_sec=%.0f mbytes_per_sec=%.1f ns_per_msg=%.1f\n",
+        parsed, parsed / elapsed, bytes / elapsed / 1e6, elapsed * 1e9 / parsed);
+}
+
+int main(int argc, char *argv[]) {
+    int rounds = argc > 1 ? atoi(argv[1]) : 20;
+    if (rounds <= 0)
+        rounds = 20;
+
+    unsigned int stream_len;
+    unsigned long messages;
+    char *stream = build_stream(&stream_len, &messages);
+
+    const unsigned int segments[] = { 1, 7, 64, 536, 1460, 4096, 0 };
+    for (unsigned int i = 0; i < sizeof(segments) / sizeof(segments[0]); ++i)
+        run_parser(stream, stream_len, messages, segments[i], rounds);
+
+    run_legacy(rounds);
+
+    FREE(stream);
+    return 0;
+}
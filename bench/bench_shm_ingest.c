@@ -0,0 +1,425 @@
+/*
+ * bench_shm_ingest.c
+ *
+ * Encoder process to server hand-off, both ends in this process:
+ *   pipe       Annex B frames over a socketpair, a reader thread passes
+ *              them to ab_rtsp_server_send (the path the shm ingest replaces)
+ *   ring       ab_shm_ring alone, a writer and an in-place reader thread
+ *              checking every record
+ *   shm        ab_shm_ring_write into ab_rtsp_server_set_shm_ingest, the
+ *              writer restarts halfway through to check the server resumes
+ *
+ * The stream is synthetic H.264: SPS/PPS, an IDR then P slices of random
+ * bytes without zeros, one record per NAL unit. The writer never gets
+ * more than a quarter of the ring ahead of the reader, the ring does not
+ * hold writers back on its own. No viewers are connected, so the server
+ * numbers are ingest + packetize.
+ *
+ * usage: bench_shm_ingest [repeat] [port] [ring_mbyte]
+ *
+ * Every result is one line of key=value pairs:
+ *   bench=<pipe|ring|shm> nalus= frames= nalus_per_sec= frames_per_sec=
+ *   mbyte_per_sec= check=
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "rtsp_server/ab_rtsp_server.h"
+
+#include "ab_rtp/ab_nalu.h"
+#include "ab_base/ab_shm_ring.h"
+#include "ab_base/ab_mem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#define DEFAULT_REPEAT      40
+#define DEFAULT_PORT        8558
+#define DEFAULT_RING_MBYTE  8
+
+#define GOP_SIZE            25
+#define FRAME_COUNT         250
+#define IDR_SLICE_SIZE      (80 * 1024)
+#define P_SLICE_SIZE        (8 * 1024)
+#define FRAME_DURATION_US   40000
+
+#define RING_NAME           "/bench_shm_ingest"
+#define PIPE_CHUNK_SIZE     (64 * 1024)
+#define DRAIN_TIMEOUT_SEC   5.0
+
+typedef struct bench_nalu_t {
+    unsigned int    offset;
+    unsigned int    len;
+    unsigned int    frame;
+    unsigned int    flags;              // @ab_shm_ring_flag_t
+} bench_nalu_t;
+
+typedef struct bench_stream_t {
+    unsigned char  *data;               // NAL units back to back, no start codes
+    unsigned int    len;
+    bench_nalu_t   *nalus;
+    unsigned int    count;
+
+    unsigned char  *annexb;             // the same with 4-byte start codes
+    unsigned int    annexb_len;
+} bench_stream_t;
+
+static const unsigned char h264_sps[] = {
+    0x67, 0x64, 0x00, 0x28, 0xac, 0xd9, 0x40, 0x78, 0x02, 0x27, 0xe5, 0xc0,
+    0x44, 0x00, 0x00, 0x03, 0x00, 0x04, 0x00, 0x00, 0x03, 0x00, 0xf0, 0x3c,
+    0x60, 0xc6, 0x58,
+};
+static const unsigned char h264_pps[] = { 0x68, 0xeb, 0xe3, 0xcb, 0x22, 0xc0 };
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void add_nalu(bench_stream_t *stream, const unsigned char *nalu,
+    unsigned int len, unsigned int frame, unsigned int flags) {
+    bench_nalu_t *entry = &stream->nalus[stream->count++];
+    entry->offset   = stream->len;
+    entry->len      = len;
+    entry->frame    = frame;
+    entry->flags    = flags;
+    memcpy(stream->data + stream->len, nalu, len);
+    stream->len += len;
+
+    static const unsigned char start_code[] = { 0x00, 0x00, 0x00, 0x01 };
+    memcpy(stream->annexb + stream->annexb_len, start_code, sizeof(start_code));
+    memcpy(stream->annexb + stream->annexb_len + sizeof(start_code), nalu, len);
+    stream->annexb_len += sizeof(start_code) + len;
+}
+
+static void build_stream(bench_stream_t *stream) {
+    unsigned int max_len = (FRAME_COUNT / GOP_SIZE + 1) *
+        (IDR_SLICE_SIZE + sizeof(h264_sps) + sizeof(h264_pps)) +
+        FRAME_COUNT * P_SLICE_SIZE;
+    memset(stream, 0, sizeof(*stream));
+    stream->data    = ALLOC(max_len);
+    stream->annexb  = ALLOC(max_len + FRAME_COUNT * 3 * 4);
+    stream->nalus   = CALLOC(FRAME_COUNT * 3, sizeof(bench_nalu_t));
+
+    unsigned char *slice = ALLOC(IDR_SLICE_SIZE);
+    uint32_t rng = 0x264;
+    for (unsigned int frame = 0; frame < FRAME_COUNT; ++frame) {
+        bool idr = 0 == frame % GOP_SIZE;
+        if (idr) {
+            add_nalu(stream, h264_sps, sizeof(h264_sps), frame, AB_SHM_RING_KEY);
+            add_nalu(stream, h264_pps, sizeof(h264_pps), frame, 0);
+        }
+
+        unsigned int len = idr ? IDR_SLICE_SIZE : P_SLICE_SIZE;
+        slice[0] = idr ? 0x65 : 0x41;
+        slice[1] = 0x88;                // first_mb_in_slice = 0
+        for (unsigned int i = 2; i < len; ++i) {
+            rng = rng * 1103515245 + 12345;
+            slice[i] = 1 + (rng >> 16) % 255;
+        }
+        add_nalu(stream, slice, len, frame, AB_SHM_RING_FRAME_END);
+    }
+    FREE(slice);
+}
+
+static void free_stream(bench_stream_t *stream) {
+    FREE(stream->data);
+    FREE(stream->annexb);
+    FREE(stream->nalus);
+}
+
+static void report(const char *bench, unsigned long nalus, unsigned long frames,
+    unsigned long bytes, double elapsed, bool ok) {
+    printf("bench=%s nalus=%lu frames=%lu nalus_per_sec=%.0f frames_per_sec=%.0f "
+        "mbyte_per_sec=%.1f check=%s\n",
+        bench, nalus, frames, nalus / elapsed, frames / elapsed,
+        bytes / elapsed / 1e6, ok ? "ok" : "FAIL");
+}
+
+static uint64_t server_nal_units(ab_rtsp_server_t rtsp) {
+    ab_rtsp_stats_t stats;
+    ab_rtsp_server_stats(rtsp, &stats);
+    return stats.nal_units;
+}
+
+/*
+ * ---- pipe ----
+ */
+typedef struct pipe_reader_t {
+    int             fd;
+    ab_rtsp_server_t rtsp;
+} pipe_reader_t;
+
+static void *pipe_reader_cb(void *arg) {
+    pipe_reader_t *reader = (pipe_reader_t *) arg;
+    char *buf = ALLOC(PIPE_CHUNK_SIZE);
+    ssize_t len;
+    while ((len = read(reader->fd, buf, PIPE_CHUNK_SIZE)) > 0)
+        ab_rtsp_server_send(reader->rtsp, buf, len);
+    // the last NAL unit is complete at the end of the stream
+    ab_rtsp_server_send(reader->rtsp, NULL, 0);
+    FREE(buf);
+    return NULL;
+}
+
+static bool bench_pipe(const bench_stream_t *stream, int repeat, unsigned short port) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        return false;
+
+    pipe_reader_t reader;
+    reader.fd   = fds[1];
+    reader.rtsp = ab_rtsp_server_new(port, AB_NALU_CODEC_H264);
+    pthread_t thd;
+    pthread_create(&thd, NULL, pipe_reader_cb, &reader);
+
+    double start = now_sec();
+    for (int rep = 0; rep < repeat; ++rep) {
+        for (unsigned int i = 0; i < stream->count; ++i) {
+            // one write per frame, as an encoder would
+            const bench_nalu_t *nalu = &stream->nalus[i];
+            if (!(nalu->flags & AB_SHM_RING_FRAME_END))
+                continue;
+            unsigned int first = i;
+            while (first > 0 && stream->nalus[first - 1].frame == nalu->frame)
+                --first;
+            unsigned int begin = stream->nalus[first].offset + first * 4;
+            unsigned int end = nalu->offset + (i + 1) * 4 + nalu->len;
+            const unsigned char *pos = stream->annexb + begin;
+            while (begin < end) {
+                ssize_t sent = write(fds[0], pos, end - begin);
+                if (sent <= 0)
+                    break;
+                pos += sent;
+                begin += sent;
+            }
+        }
+    }
+    close(fds[0]);
+    pthread_join(thd, NULL);
+    double elapsed = now_sec() - start;
+    close(fds[1]);
+
+    unsigned long nalus = (unsigned long) stream->count * repeat;
+    uint64_t got = server_nal_units(reader.rtsp);
+    ab_rtsp_server_free(&reader.rtsp);
+    report("pipe", got, (unsigned long) FRAME_COUNT * repeat,
+        (unsigned long) stream->annexb_len * repeat, elapsed, got == nalus);
+    return got == nalus;
+}
+
+/*
+ * ---- ring ----
+ */
+typedef struct ring_reader_t {
+    const bench_stream_t *stream;
+    unsigned long   expect;             // records
+    unsigned long   records;            // read by the writer to throttle
+    unsigned long   bytes;
+    unsigned long   mismatches;
+    unsigned long   discontinuities;
+} ring_reader_t;
+
+static void *ring_reader_cb(void *arg) {
+    ring_reader_t *reader = (ring_reader_t *) arg;
+    ab_shm_ring_t ring = ab_shm_ring_open(RING_NAME);
+    if (NULL == ring)
+        return NULL;
+
+    unsigned long index = 0;
+    double deadline = now_sec() + DRAIN_TIMEOUT_SEC;
+    while (index < reader->expect && now_sec() < deadline) {
+        ab_shm_ring_record_t record;
+        if (ab_shm_ring_read(ring, &record, 100) <= 0)
+            continue;
+
+        // the reader opens after the writer is created and before it writes
+        const bench_nalu_t *nalu = &reader->stream->nalus[index % reader->stream->count];
+        if (record.len != nalu->len || record.timestamp != index ||
+            memcmp(record.data, reader->stream->data + nalu->offset, nalu->len) != 0)
+            ++reader->mismatches;
+        if (!ab_shm_ring_release(ring) || (record.discontinuity && index > 0))
+            ++reader->discontinuities;
+
+        reader->bytes += record.len;
+        ++index;
+        __atomic_store_n(&reader->records, index, __ATOMIC_RELEASE);
+        deadline = now_sec() + DRAIN_TIMEOUT_SEC;
+    }
+
+    ab_shm_ring_close(&ring);
+    return NULL;
+}
+
+typedef struct bench_throttle_t {
+    unsigned long   max_ahead;          // records
+    unsigned long   consumed;           // last seen, asked again only when needed
+    unsigned long (*get)(void *);
+    void           *arg;
+} bench_throttle_t;
+
+/*
+ * keeps the writer within about a quarter of the ring ahead of the reader
+ */
+static void throttle_init(bench_throttle_t *throttle, const bench_stream_t *stream,
+    unsigned long ring_size, unsigned long (*get)(void *), void *arg) {
+    throttle->max_ahead = ring_size / 4 / (stream->len / stream->count + 16);
+    if (throttle->max_ahead < 4)
+        throttle->max_ahead = 4;
+    throttle->consumed  = 0;
+    throttle->get       = get;
+    throttle->arg       = arg;
+}
+
+static void throttle_wait(bench_throttle_t *throttle, unsigned long written) {
+    if (written <= throttle->consumed + throttle->max_ahead)
+        return;
+
+    double deadline = now_sec() + DRAIN_TIMEOUT_SEC;
+    for (;;) {
+        throttle->consumed = throttle->get(throttle->arg);
+        // resume once half the allowance is free, not on every record
+        if (written <= throttle->consumed + throttle->max_ahead / 2 ||
+            now_sec() > deadline)
+            break;
+        usleep(20);
+    }
+}
+
+static unsigned long ring_consumed(void *arg) {
+    return __atomic_load_n(&((ring_reader_t *) arg)->records, __ATOMIC_ACQUIRE);
+}
+
+static bool bench_ring(const bench_stream_t *stream, int repeat, unsigned int ring_size) {
+    ab_shm_ring_unlink(RING_NAME);
+    ab_shm_ring_t ring = ab_shm_ring_create(RING_NAME, ring_size);
+    if (NULL == ring) {
+        fprintf(stderr, "shm_open %s failed\n", RING_NAME);
+        return false;
+    }
+
+    ring_reader_t reader;
+    memset(&reader, 0, sizeof(reader));
+    reader.stream = stream;
+    reader.expect = (unsigned long) stream->count * repeat;
+    pthread_t thd;
+    pthread_create(&thd, NULL, ring_reader_cb, &reader);
+    // let the reader attach and sleep on the futex
+    usleep(10000);
+
+    bench_throttle_t throttle;
+    throttle_init(&throttle, stream, ring_size, ring_consumed, &reader);
+    double start = now_sec();
+    unsigned long written = 0;
+    for (int rep = 0; rep < repeat; ++rep) {
+        for (unsigned int i = 0; i < stream->count; ++i, ++written) {
+            const bench_nalu_t *nalu = &stream->nalus[i];
+            throttle_wait(&throttle, written);
+            ab_shm_ring_write(ring, stream->data + nalu->offset, nalu->len,
+                written, nalu->flags);
+        }
+    }
+    pthread_join(thd, NULL);
+    double elapsed = now_sec() - start;
+
+    ab_shm_ring_close(&ring);
+    ab_shm_ring_unlink(RING_NAME);
+
+    bool ok = reader.records == reader.expect && 0 == reader.mismatches &&
+        0 == reader.discontinuities;
+    report("ring", reader.records, (unsigned long) FRAME_COUNT * repeat,
+        reader.bytes, elapsed, ok);
+    if (!ok)
+        fprintf(stderr, "%lu of %lu records, %lu mismatches, %lu discontinuities\n",
+            reader.records, reader.expect, reader.mismatches, reader.discontinuities);
+    return ok;
+}
+
+/*
+ * ---- shm ----
+ */
+static unsigned long shm_consumed(void *arg) {
+    return server_nal_units((ab_rtsp_server_t) arg);
+}
+
+static bool bench_shm(const bench_stream_t *stream, int repeat, unsigned short port,
+    unsigned int ring_size) {
+    ab_shm_ring_unlink(RING_NAME);
+    ab_shm_ring_t ring = ab_shm_ring_create(RING_NAME, ring_size);
+    if (NULL == ring) {
+        fprintf(stderr, "shm_open %s failed\n", RING_NAME);
+        return false;
+    }
+
+    ab_rtsp_server_t rtsp = ab_rtsp_server_new(port, AB_NALU_CODEC_H264);
+    ab_rtsp_server_set_shm_ingest(rtsp, RING_NAME);
+    // wait for the reader to attach, it starts from the next key frame
+    usleep(10000);
+
+    bench_throttle_t throttle;
+    throttle_init(&throttle, stream, ring_size, shm_consumed, rtsp);
+    double start = now_sec();
+    unsigned long written = 0;
+    for (int rep = 0; rep < repeat; ++rep) {
+        // an encoder restart: same name and size, the server resumes at the next
+        // key frame, which is the first record the new writer sends
+        if (rep == repeat / 2 && repeat > 1) {
+            ab_shm_ring_close(&ring);
+            ring = ab_shm_ring_create(RING_NAME, ring_size);
+        }
+        for (unsigned int i = 0; i < stream->count; ++i, ++written) {
+            const bench_nalu_t *nalu = &stream->nalus[i];
+            throttle_wait(&throttle, written);
+            uint64_t timestamp_us = (uint64_t) (rep * FRAME_COUNT + nalu->frame) *
+                FRAME_DURATION_US;
+            ab_shm_ring_write(ring, stream->data + nalu->offset, nalu->len,
+                timestamp_us, nalu->flags);
+        }
+    }
+
+    double deadline = now_sec() + DRAIN_TIMEOUT_SEC;
+    while (shm_consumed(rtsp) < written && now_sec() < deadline)
+        usleep(100);
+    double elapsed = now_sec() - start;
+
+    ab_rtsp_stats_t stats;
+    ab_rtsp_server_stats(rtsp, &stats);
+    ab_rtsp_server_free(&rtsp);
+    ab_shm_ring_close(&ring);
+    ab_shm_ring_unlink(RING_NAME);
+
+    report("shm", stats.nal_units, (unsigned long) FRAME_COUNT * repeat,
+        (unsigned long) stream->len * repeat, elapsed, stats.nal_units == written);
+    return stats.nal_units == written;
+}
+
+int main(int argc, char *argv[]) {
+    int repeat = argc > 1 ? atoi(argv[1]) : DEFAULT_REPEAT;
+    if (repeat <= 0)
+        repeat = DEFAULT_REPEAT;
+    unsigned short port = argc > 2 ? atoi(argv[2]) : DEFAULT_PORT;
+    unsigned int ring_mbyte = argc > 3 ? atoi(argv[3]) : DEFAULT_RING_MBYTE;
+    if (0 == ring_mbyte)
+        ring_mbyte = DEFAULT_RING_MBYTE;
+
+    bench_stream_t stream;
+    build_stream(&stream);
+    printf("stream codec=h264 frames=%u nalus=%u bytes=%u ring_mbyte=%u\n",
+        FRAME_COUNT, stream.count, stream.len, ring_mbyte);
+
+    bool ok = bench_pipe(&stream, repeat, port);
+    ok = bench_ring(&stream, repeat, ring_mbyte * 1024 * 1024) && ok;
+    ok = bench_shm(&stream, repeat, port, ring_mbyte * 1024 * 1024) && ok;
+
+    free_stream(&stream);
+    return ok ? 0 : 1;
+}
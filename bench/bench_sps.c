@@ -0,0 +1,302 @@
+/*
+ * bench_sps.c
+ *
+ * SPS/VUI parser: every parameter set below is first checked against the
+ * values it was encoded with, then parsed in a tight loop for throughput,
+ * and finally mutated at random (bit flips, truncation, inserted bytes,
+ * emulation prevention noise) to make sure malformed input is rejected or
+ * yields bounded values instead of reading past the buffer.
+ *
+ * The vectors are x264/x265 output plus hand-built sets covering scaling
+ * lists, POC type 1, cropping, interlace, 4:2:2/4:4:4, sub-layers,
+ * short/long term RPS and PCM.
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_rtp/ab_sps.h"
+#include "ab_rtp/ab_nalu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#define SPS_MAX_SIZE        600
+#define PARSE_ROUNDS        200000
+#define DEFAULT_MUTATIONS   1000000
+
+typedef struct bench_sps_t {
+    const char     *name;
+    int             codec;
+    unsigned int    len;
+    unsigned int    profile_idc;
+    unsigned int    level_idc;
+    unsigned int    width;
+    unsigned int    height;
+    uint32_t        num_units_in_tick;
+    uint32_t        time_scale;
+    unsigned char   data[SPS_MAX_SIZE];
+} bench_sps_t;
+
+static const bench_sps_t cases[] = {
+    { "x264_high_1920x1080", AB_NALU_CODEC_H264, 27, 100, 40, 1920, 1080, 1, 60, {
+        0x67, 0x64, 0x00, 0x28, 0xac, 0xd9, 0x40, 0x78, 0x02, 0x27, 0xe5, 0xc0,
+        0x44, 0x00, 0x00, 0x03, 0x00, 0x04, 0x00, 0x00, 0x03, 0x00, 0xf0, 0x3c,
+        0x60, 0xc6, 0x58,
+    } },
+    { "x265_main_1280x720", AB_NALU_CODEC_H265, 41, 1, 93, 1280, 720, 1001, 30000, {
+        0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00,
+        0x03, 0x00, 0x00, 0x03, 0x00, 0x5d, 0xa0, 0x02, 0x80, 0x80, 0x2d, 0x16,
+        0x59, 0x59, 0xa4, 0x93, 0x2b, 0xc0, 0x5a, 0x70, 0x80, 0x00, 0x01, 0xf4,
+        0x80, 0x00, 0x3a, 0x98, 0x04,
+    } },
+    { "h264_baseline_640x480", AB_NALU_CODEC_H264, 9, 66, 30, 640, 480, 0, 0, {
+        0x67, 0x42, 0x00, 0x1e, 0xec, 0xa0, 0x50, 0x1e, 0xc8,
+    } },
+    { "h264_main_1280x720_30fps", AB_NALU_CODEC_H264, 30, 77, 31, 1280, 720, 1, 60, {
+        0x67, 0x4d, 0x00, 0x1f, 0xec, 0xa0, 0x28, 0x02, 0xdd, 0xff, 0x80, 0x02,
+        0x00, 0x01, 0xb5, 0x01, 0x01, 0x01, 0xf0, 0x00, 0x00, 0x03, 0x00, 0x10,
+        0x00, 0x00, 0x03, 0x03, 0xc8, 0x40,
+    } },
+    { "h264_high_1920x1080_25fps", AB_NALU_CODEC_H264, 32, 100, 40, 1920, 1080, 1, 50, {
+        0x67, 0x64, 0x00, 0x28, 0xac, 0xd9, 0x40, 0x78, 0x02, 0x27, 0xe5, 0xff,
+        0xc0, 0x01, 0x00, 0x00, 0xda, 0x80, 0x80, 0x80, 0xf8, 0x00, 0x00, 0x03,
+        0x00, 0x08, 0x00, 0x00, 0x03, 0x01, 0x94, 0x20,
+    } },
+    { "h264_high_ntsc_scaling_poc1", AB_NALU_CODEC_H264, 138, 100, 41, 1920, 1080, 1001, 60000, {
+        0x67, 0x64, 0x00, 0x29, 0xad, 0x95, 0x22, 0xa4, 0x54, 0x8a, 0x91, 0x52,
+        0x2c, 0xa9, 0x15, 0x22, 0xa4, 0x54, 0x8a, 0x91, 0x65, 0x48, 0xa9, 0x15,
+        0x22, 0xa4, 0x54, 0x8b, 0x2a, 0x45, 0x48, 0xa9, 0x15, 0x22, 0xa4, 0x59,
+        0x52, 0x2a, 0x45, 0x48, 0xa9, 0x15, 0x22, 0xca, 0x91, 0x52, 0x2a, 0x45,
+        0x48, 0xa9, 0x16, 0x54, 0x8a, 0x91, 0x52, 0x2a, 0x45, 0x48, 0xa9, 0x15,
+        0x22, 0xa4, 0x54, 0x8a, 0x91, 0x52, 0x2a, 0x45, 0x48, 0xa9, 0x15, 0x22,
+        0xa4, 0x54, 0x8a, 0x91, 0x52, 0x2a, 0x45, 0x48, 0xb2, 0xa4, 0x54, 0x8a,
+        0x91, 0x52, 0x2a, 0x45, 0x48, 0xa9, 0x15, 0x22, 0xa4, 0x54, 0x8a, 0x91,
+        0x52, 0x2a, 0x45, 0x48, 0xa9, 0x15, 0x22, 0xa4, 0x54, 0x8a, 0x91, 0x52,
+        0x2a, 0x45, 0xa1, 0xc8, 0x44, 0xc4, 0x14, 0x07, 0x80, 0x22, 0x7e, 0x5f,
+        0xfc, 0x00, 0x10, 0x00, 0x0d, 0xa8, 0x08, 0x08, 0x0f, 0x80, 0x00, 0x01,
+        0xf4, 0x80, 0x00, 0x75, 0x30, 0x42,
+    } },
+    { "h264_high422_interlaced_1080i", AB_NALU_CODEC_H264, 32, 122, 40, 1920, 1080, 1, 50, {
+        0x67, 0x7a, 0x00, 0x28, 0xb6, 0xcd, 0x94, 0x07, 0x80, 0x44, 0xfc, 0xbf,
+        0xf8, 0x00, 0x20, 0x00, 0x1b, 0x50, 0x10, 0x10, 0x1f, 0x00, 0x00, 0x03,
+        0x00, 0x01, 0x00, 0x00, 0x03, 0x00, 0x32, 0x84,
+    } },
+    { "h264_high444_odd_size", AB_NALU_CODEC_H264, 22, 244, 51, 1366, 766, 0, 0, {
+        0x67, 0xf4, 0x00, 0x33, 0x91, 0x9b, 0x28, 0x0a, 0xc0, 0xc3, 0xc5, 0xdf,
+        0xfe, 0x00, 0x08, 0x00, 0x06, 0xd4, 0x04, 0x04, 0x07, 0x82,
+    } },
+    { "h265_main_1920x1080_25fps", AB_NALU_CODEC_H265, 45, 1, 120, 1920, 1080, 1, 25, {
+        0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0xb0, 0x00, 0x00,
+        0x03, 0x00, 0x00, 0x03, 0x00, 0x78, 0xa0, 0x03, 0xc0, 0x80, 0x10, 0xe5,
+        0x96, 0x57, 0x92, 0x44, 0x99, 0x3e, 0xaf, 0x01, 0x68, 0x19, 0x65, 0x80,
+        0x00, 0x00, 0x03, 0x00, 0x80, 0x00, 0x00, 0x0c, 0x84,
+    } },
+    { "h265_main10_3840x2160_sublayers", AB_NALU_CODEC_H265, 83, 2, 153, 3840, 2160, 1001, 60000, {
+        0x42, 0x01, 0x05, 0x02, 0x60, 0x00, 0x00, 0x03, 0x00, 0xb0, 0x00, 0x00,
+        0x03, 0x00, 0x00, 0x03, 0x00, 0x99, 0xf0, 0x00, 0x00, 0x03, 0x00, 0x00,
+        0x03, 0x00, 0x00, 0x03, 0x00, 0x01, 0x23, 0x45, 0x67, 0x89, 0x5a, 0x00,
+        0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x01, 0x23, 0x45, 0x67,
+        0x89, 0x5a, 0xa0, 0x01, 0xe0, 0x20, 0x02, 0x1c, 0x4d, 0x96, 0x57, 0x2b,
+        0x95, 0xe4, 0x91, 0x26, 0x2b, 0xeb, 0x6e, 0xdb, 0x6d, 0xbc, 0x05, 0xa0,
+        0x65, 0x96, 0x00, 0x00, 0x07, 0xd2, 0x00, 0x01, 0xd4, 0xc0, 0x10,
+    } },
+    { "h265_main_scaling_longterm_pcm", AB_NALU_CODEC_H265, 290, 1, 93, 1280, 720, 0, 0, {
+        0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0xb0, 0x00, 0x00,
+        0x03, 0x00, 0x00, 0x03, 0x00, 0x5d, 0xa0, 0x02, 0x80, 0x80, 0x2d, 0x16,
+        0x59, 0x5e, 0x49, 0x12, 0xe4, 0x64, 0x64, 0x64, 0x64, 0x64, 0x64, 0x64,
+        0x6c, 0x8c, 0x8c, 0x8c, 0x8c, 0x8c, 0x8c, 0x8c, 0x8d, 0x91, 0x91, 0x91,
+        0x91, 0x91, 0x91, 0x91, 0x91, 0xac, 0x8c, 0x8c, 0x8c, 0x8c, 0x8c, 0x8c,
+        0x8c, 0x8c, 0x8c, 0x8c, 0x8c, 0x8c, 0x8c, 0x8c, 0x8c, 0x8c, 0x8c, 0x8c,
+        0x8c, 0x8c, 0x8c, 0x8c, 0x8c, 0x8c, 0x8c, 0x8c, 0x8c, 0x8c, 0x8c, 0x8c,
+        0x8c, 0x8d, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91,
+        0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91,
+        0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0xb2, 0x32,
+        0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+        0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+        0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x39, 0x88, 0xc8, 0xc8, 0xc8, 0xc8,
+        0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8,
+        0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8,
+        0xc8, 0xc8, 0xc8, 0xd9, 0x88, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8,
+        0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8,
+        0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8,
+        0xd9, 0x88, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8,
+        0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8,
+        0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xd6, 0x62, 0x32,
+        0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+        0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+        0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x3e, 0xef, 0x44, 0xfa, 0xd8, 0x2c,
+        0x25, 0x90,
+    } },
+    { "h265_rext_444_odd_size", AB_NALU_CODEC_H265, 46, 4, 120, 1366, 766, 1, 30, {
+        0x42, 0x01, 0x01, 0x04, 0x60, 0x00, 0x00, 0x03, 0x00, 0xb0, 0x00, 0x00,
+        0x03, 0x00, 0x00, 0x03, 0x00, 0x78, 0x90, 0x00, 0x55, 0x90, 0x06, 0x03,
+        0xbb, 0xcb, 0x2b, 0xc9, 0x22, 0x4c, 0x9f, 0x57, 0x80, 0xb4, 0x0c, 0xb2,
+        0xc0, 0x00, 0x00, 0x03, 0x00, 0x40, 0x00, 0x00, 0x07, 0x82,
+    } },
+};
+
+#define CASE_COUNT  (sizeof(cases) / sizeof(cases[0]))
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static bool verify(const bench_sps_t *c) {
+    ab_sps_info_t info;
+    if (0 != ab_sps_parse(c->codec, c->data, c->len, &info)) {
+        printf("case=%s result=parse_error\n", c->name);
+        return false;
+    }
+
+    bool ok = info.profile_idc == c->profile_idc &&
+        info.level_idc == c->level_idc &&
+        info.width == c->width && info.height == c->height &&
+        info.num_units_in_tick == c->num_units_in_tick &&
+        info.time_scale == c->time_scale;
+
+    uint64_t num = 0, den = 0;
+    bool timing = ab_sps_frame_duration(c->codec, &info, &num, &den);
+
+    printf("case=%s result=%s profile=%u level=%u size=%ux%u fps=%.3f\n",
+        c->name, ok ? "ok" : "mismatch",
+        info.profile_idc, info.level_idc, info.width, info.height,
+        timing ? (double) den / num : 0.0);
+    if (!ok)
+        printf("case=%s expected profile=%u level=%u size=%ux%u timing=%u/%u "
+               "got timing=%u/%u\n",
+            c->name, c->profile_idc, c->level_idc, c->width, c->height,
+            c->num_units_in_tick, c->time_scale,
+            info.num_units_in_tick, info.time_scale);
+    return ok;
+}
+
+static void throughput(const bench_sps_t *c) {
+    ab_sps_info_t info;
+    unsigned long sink = 0;
+
+    double start = now_sec();
+    for (int i = 0; i < PARSE_ROUNDS; ++i) {
+        ab_sps_parse(c->codec, c->data, c->len, &info);
+        sink += info.width;
+    }
+    double elapsed = now_sec() - start;
+
+    printf("case=%s bytes=%u parses_per_sec=%.0f ns_per_parse=%.1f "
+           "mbyte_per_sec=%.1f sink=%lu\n",
+        c->name, c->len, PARSE_ROUNDS / elapsed, elapsed * 1e9 / PARSE_ROUNDS,
+        (double) PARSE_ROUNDS * c->len / elapsed / 1e6, sink % 10);
+}
+
+/*
+ * return: 变异后的长度
+ */
+static unsigned int mutate(const bench_sps_t *c, unsigned char *buf,
+    unsigned int size, uint64_t *rng) {
+    unsigned int len = c->len;
+    memcpy(buf, c->data, len);
+
+    int edits = 1 + next_random(rng) % 4;
+    for (int i = 0; i < edits; ++i) {
+        uint64_t r = next_random(rng);
+        unsigned int pos = 1 + (r >> 8) % (len > 1 ? len - 1 : 1);
+        switch (r % 5) {
+        case 0:     // bit flip, the NALU header is left alone
+        case 1:
+            if (pos < len)
+                buf[pos] ^= 1 << ((r >> 40) % 8);
+            break;
+        case 2:     // truncation
+            len = pos;
+            break;
+        case 3:     // inserted byte
+            if (len < size) {
+                memmove(buf + pos + 1, buf + pos, len - pos);
+                buf[pos] = r >> 48;
+                ++len;
+            }
+            break;
+        case 4:     // emulation prevention noise
+            if (len + 3 <= size) {
+                memmove(buf + pos + 3, buf + pos, len - pos);
+                buf[pos] = 0;
+                buf[pos + 1] = 0;
+                buf[pos + 2] = 3;
+                len += 3;
+            }
+            break;
+        }
+    }
+
+    return len;
+}
+
+static bool fuzz(unsigned long mutations) {
+    unsigned char buf[SPS_MAX_SIZE + 64];
+    uint64_t rng = 0x5eed5eed5eedULL;
+    unsigned long accepted = 0, rejected = 0, bad = 0;
+
+    double start = now_sec();
+    for (unsigned long i = 0; i < mutations; ++i) {
+        const bench_sps_t *c = &cases[i % CASE_COUNT];
+        unsigned int len = mutate(c, buf, sizeof(buf), &rng);
+
+        ab_sps_info_t info;
+        if (0 != ab_sps_parse(c->codec, buf, len, &info)) {
+            ++rejected;
+            continue;
+        }
+
+        ++accepted;
+        // 接受的SPS必须给出合理的值
+        uint64_t num, den;
+        if (info.width == 0 || info.height == 0 ||
+            info.width > 16888 || info.height > 16888 ||
+            info.chroma_format_idc > 3 || info.bit_depth < 8 || info.bit_depth > 16 ||
+            (ab_sps_frame_duration(c->codec, &info, &num, &den) &&
+                (num == 0 || den == 0))) {
+            if (++bad <= 10)
+                printf("fuzz_bad case=%s len=%u size=%ux%u chroma=%u depth=%u\n",
+                    c->name, len, info.width, info.height,
+                    info.chroma_format_idc, info.bit_depth);
+        }
+    }
+    double elapsed = now_sec() - start;
+
+    printf("fuzz mutations=%lu accepted=%lu rejected=%lu bad=%lu "
+           "mutations_per_sec=%.0f\n",
+        mutations, accepted, rejected, bad, mutations / elapsed);
+    return bad == 0;
+}
+
+int main(int argc, char *argv[]) {
+    long mutations = argc > 1 ? atol(argv[1]) : DEFAULT_MUTATIONS;
+    if (mutations <= 0)
+        mutations = DEFAULT_MUTATIONS;
+
+    bool ok = true;
+    for (unsigned int i = 0; i < CASE_COUNT; ++i)
+        ok = verify(&cases[i]) && ok;
+
+    for (unsigned int i = 0; i < CASE_COUNT; ++i)
+        throughput(&cases[i]);
+
+    ok = fuzz(mutations) && ok;
+
+    return ok ? 0 : 1;
+}
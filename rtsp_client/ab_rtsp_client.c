@@ -8,9 +8,13 @@
 #include "ab_rtsp_client.h"
 
 #include "ip_check.h"
+#include "ab_rtsp_interleaved.h"
 
 #include "ab_net/ab_tcp_client.h"
 #include "ab_net/ab_udp_client.h"
+#include "ab_rtp/ab_rtp_fec.h"
+#include "ab_rtp/ab_rtp_depacketizer.h"
+#include "ab_rtp/ab_nalu.h"
 #include "ab_base/ab_mem.h"
 #include "ab_base/ab_assert.h"
 
@@ -18,8 +22,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include <pthread.h>
+#include <time.h>
 
 #include <arpa/inet.h>
 
@@ -38,8 +44,34 @@
 #define RTP_CLIENT_PORT     30001
 #define RTCP_CLIENT_PORT    30002
 
+// keeps the server side session alive, well below its timeout
+#define RTCP_REPORT_INTERVAL    5
+
 #define T ab_rtsp_client_t
 
+/*
+ * Default socket options per role.
+ * control: requests go out at once, a dead server is noticed when data
+ *          stays unacked; the receive buffer keeps TCP autotuning
+ * RTP: a key frame arrives as a burst of datagrams, the default buffer
+ *      (~200KB) overflows while the receiving thread is busy
+ */
+static const ab_socket_options_t default_socket_options[AB_SOCKET_ROLE_COUNT] = {
+    [AB_SOCKET_ROLE_CONTROL] = {
+        .mask               = AB_SOCKET_OPT_NODELAY | AB_SOCKET_OPT_USER_TIMEOUT,
+        .nodelay            = true,
+        .user_timeout_ms    = 10000,
+    },
+    [AB_SOCKET_ROLE_RTP] = {
+        .mask               = AB_SOCKET_OPT_RECV_BUFFER,
+        .recv_buffer        = 4 * 1024 * 1024,
+    },
+    [AB_SOCKET_ROLE_RTCP] = {
+        .mask               = AB_SOCKET_OPT_TOS,
+        .tos                = AB_SOCKET_DSCP(AB_SOCKET_DSCP_AF41),
+    },
+};
+
 enum ab_rtsp_over_opt_t {
     AB_RTSP_OVER_NONE = 0,
     AB_RTSP_OVER_TCP,
@@ -56,15 +88,22 @@ struct T {
     int rtp_over_opt;                   // @ab_rtsp_over_opt_t
 
     char url[128];
+    char setup_url[256];                // url + / + the video track's a=control
     char srv_addr[64];
     unsigned short port;
 
     void *user_data;
     void (*callback)(const unsigned char *, unsigned int, void *);
 
+    // raw video RTP for relaying, set once while receiving
+    void *rtp_user_data;
+    void (*rtp_callback)(const unsigned char *, unsigned int, void *);
+
     ab_tcp_client_t tcp_client;
 
     int video_codec;                    // @ab_video_codec_t
+    int fec_payload_type;               // 0: SDP中没有ulpfec
+    ab_rtp_depacketizer_t depacketizer; // created by the receiving thread
 
     unsigned short udp_rtp_srv_port;
     unsigned short udp_rtcp_srv_port;
@@ -72,7 +111,10 @@ struct T {
     ab_udp_client_t udp_rtcp_client;
 
     unsigned int seq;
-    char session[16];
+    char session[64];
+
+    uint32_t ssrc;                      // of our RTCP receiver reports
+    time_t last_report;
 
     bool quit;
     pthread_t child_thd;
@@ -81,6 +123,7 @@ struct T {
 static bool parse_rtsp_addr(const char *rtsp_addr, 
     char *host_buf, unsigned int host_buf_size, unsigned short *port);
 static void *child_thd_callback(void *arg);
+static ab_socket_t role_socket(T t, int role);
 
 static bool send_cmd_options(T t);
 static bool send_cmd_describe(T t);
@@ -105,12 +148,10 @@ T ab_rtsp_client_new(int rtp_over_opt, const char *url,
     NEW(result);
 
     result->rtp_over_opt = rtp_over_opt;
-    int len = strlen(url);
-    if (len < sizeof(result->url)) {
-        memcpy(result->url, url, len);
-    }
+    snprintf(result->url, sizeof(result->url), "%s", url);
+    snprintf(result->setup_url, sizeof(result->setup_url), "%s", result->url);
 
-    len = strlen(host_buf);
+    int len = strlen(host_buf);
     memset(result->srv_addr, 0, sizeof(result->srv_addr));
     if (len < sizeof(result->srv_addr)) {
         memcpy(result->srv_addr, host_buf, len);
@@ -120,6 +161,9 @@ T ab_rtsp_client_new(int rtp_over_opt, const char *url,
 
     result->user_data = user_data;
     result->callback = cb;
+    result->rtp_user_data = NULL;
+    result->rtp_callback = NULL;
+    result->depacketizer = NULL;
 
     result->tcp_client = ab_tcp_client_new(host_buf, port);
 
@@ -128,8 +172,20 @@ T ab_rtsp_client_new(int rtp_over_opt, const char *url,
         result->udp_rtcp_client = ab_udp_client_new(RTCP_CLIENT_PORT);
     }
 
+    // before PLAY, the first key frame already needs the large buffer
+    for (int role = 0; role < AB_SOCKET_ROLE_COUNT; ++role) {
+        ab_socket_t sock = role_socket(result, role);
+        if (sock)
+            ab_socket_set_options(sock, &default_socket_options[role]);
+    }
+
     result->seq = 1;
     memset(result->session, 0, sizeof(result->session));
+    result->ssrc = (uint32_t) time(NULL) ^ ((uint32_t) getpid() << 16);
+    result->last_report = 0;
+
+    result->video_codec = AB_VIDEO_CODEC_NONE;
+    result->fec_payload_type = 0;
 
     if (result->tcp_client != NULL) {
         send_cmd_options(result);
@@ -163,6 +219,53 @@ void ab_rtsp_client_free(T *t) {
     FREE(*t);
 }
 
+int ab_rtsp_client_set_socket_options(T t, int role,
+    const ab_socket_options_t *options) {
+    assert(t);
+    assert(options);
+
+    if (role < 0 || role >= AB_SOCKET_ROLE_COUNT)
+        return -1;
+
+    ab_socket_t sock = role_socket(t, role);
+    if (NULL == sock)
+        return -1;
+    return ab_socket_set_options(sock, options);
+}
+
+int ab_rtsp_client_codec(T t) {
+    assert(t);
+
+    if (AB_VIDEO_CODEC_H264 == t->video_codec)
+        return AB_NALU_CODEC_H264;
+    if (AB_VIDEO_CODEC_H265 == t->video_codec)
+        return AB_NALU_CODEC_H265;
+    return AB_NALU_CODEC_NONE;
+}
+
+void ab_rtsp_client_set_rtp_callback(T t,
+    void (*cb)(const unsigned char *, unsigned int, void *), void *user_data) {
+    assert(t);
+
+    // the receiving thread loads the callback first, then user_data
+    t->rtp_user_data = user_data;
+    __atomic_store_n(&t->rtp_callback, cb, __ATOMIC_RELEASE);
+}
+
+/*
+ * RTP over TCP时媒体走RTSP连接，没有RTP/RTCP socket
+ */
+ab_socket_t role_socket(T t, int role) {
+    if (AB_SOCKET_ROLE_CONTROL == role)
+        return t->tcp_client ? ab_tcp_client_socket(t->tcp_client) : NULL;
+
+    if (AB_RTSP_OVER_UDP != t->rtp_over_opt)
+        return NULL;
+    if (AB_SOCKET_ROLE_RTP == role)
+        return t->udp_rtp_client ? ab_udp_client_socket(t->udp_rtp_client) : NULL;
+    return t->udp_rtcp_client ? ab_udp_client_socket(t->udp_rtcp_client) : NULL;
+}
+
 bool parse_rtsp_addr(const char *rtsp_addr, 
     char *host_buf, unsigned int host_buf_size, unsigned short *port) {
     char *pos_start = strstr(rtsp_addr, "rtsp://");
@@ -233,17 +336,38 @@ bool send_cmd_options(T t) {
     return true;
 }
 
+/*
+ * 视频m=段的a=control，相对路径接在url后面；没有或为*时SETUP聚合url
+ */
+static void parse_video_control(T t, const char *sdp) {
+    const char *media = strstr(sdp, "m=video");
+    if (NULL == media)
+        return;
+
+    const char *next = strstr(media, "\nm=");
+    const char *control = strstr(media, "a=control:");
+    char value[128];
+    if (NULL == control || (next && control > next) ||
+        sscanf(control + 10, "%127[^\r\n]", value) != 1 || strcmp(value, "*") == 0)
+        return;
+
+    if (strncmp(value, "rtsp://", 7) == 0) {
+        snprintf(t->setup_url, sizeof(t->setup_url), "%s", value);
+    } else {
+        unsigned int len = strlen(t->url);
+        snprintf(t->setup_url, sizeof(t->setup_url), "%s%s%s", t->url,
+            len > 0 && '/' == t->url[len - 1] ? "" : "/", value);
+    }
+}
+
 bool send_cmd_describe(T t) {
     assert(t);
 
-    char uri[64];
-    snprintf(uri, sizeof(uri), "rtsp://%s:%d/", t->srv_addr, t->port);
-
     char buf[1024];
     snprintf(buf, sizeof(buf), 
         "DESCRIBE %s RTSP/1.0\r\n"
         "CSeq: %u\r\n"
-        "Accept: application/sdp\r\n\r\n", uri, ++t->seq);
+        "Accept: application/sdp\r\n\r\n", t->url, ++t->seq);
     
     unsigned int buf_len =strlen(buf);
     if (ab_tcp_client_send(t->tcp_client, (unsigned char *) buf, buf_len) <= 0) {
@@ -266,15 +390,24 @@ bool send_cmd_describe(T t) {
         t->video_codec = AB_VIDEO_CODEC_NONE;
     }
 
+    parse_video_control(t, buf);
+
+    t->fec_payload_type = 0;
+    char *pos = strstr(buf, " ulpfec/");
+    if (pos != NULL) {
+        while (pos > buf && *(pos - 1) != ':') {
+            --pos;
+        }
+        t->fec_payload_type = atoi(pos);
+    }
+
     return true;
 }
 
 bool send_cmd_setup(T t) {
     assert(t);
 
-    char uri[64];
-    snprintf(uri, sizeof(uri), "rtsp://%s:%d/", t->srv_addr, t->port);
-
+    const char *uri = t->setup_url;
     char buf[1024];
     if (AB_RTSP_OVER_TCP == t->rtp_over_opt) {
         snprintf(buf, sizeof(buf), 
@@ -310,9 +443,10 @@ bool send_cmd_setup(T t) {
             &t->udp_rtp_srv_port, &t->udp_rtcp_srv_port);
     }
 
+    // "Session: id;timeout=60", only the id is echoed back
     pos = strstr(buf, "Session:");
     if (pos != NULL) {
-        sscanf(pos, "Session: %s\r\n", t->session);
+        sscanf(pos, "Session: %63[^;\r\n]", t->session);
     }
 
     return true;
@@ -321,9 +455,7 @@ bool send_cmd_setup(T t) {
 bool send_cmd_play(T t) {
     assert(t);
 
-    char uri[64];
-    snprintf(uri, sizeof(uri), "rtsp://%s:%d/", t->srv_addr, t->port);
-
+    const char *uri = t->url;
     char buf[1024];
     snprintf(buf, sizeof(buf), 
         "PLAY %s RTSP/1.0\r\n"
@@ -349,9 +481,7 @@ bool send_cmd_play(T t) {
 bool send_cmd_teardown(T t) {
     assert(t);
 
-    char uri[64];
-    snprintf(uri, sizeof(uri), "rtsp://%s:%d", t->srv_addr, t->port);
-
+    const char *uri = t->url;
     char buf[1024];
     snprintf(buf, sizeof(buf), 
         "TEARDOWN %s RTSP/1.0\r\n"
@@ -367,74 +497,87 @@ bool send_cmd_teardown(T t) {
     return true;
 }
 
+static void process_rtp_packet(const unsigned char *rtp, unsigned int rtp_len,
+    void *arg) {
+    T t = (T) arg;
+
+    // over TCP the FEC packets share the video channel
+    void (*rtp_callback)(const unsigned char *, unsigned int, void *) =
+        __atomic_load_n(&t->rtp_callback, __ATOMIC_ACQUIRE);
+    if (rtp_callback && rtp_len > 1 &&
+        (t->fec_payload_type <= 0 || (rtp[1] & 0x7f) != t->fec_payload_type))
+        rtp_callback(rtp, rtp_len, t->rtp_user_data);
+
+    if (t->depacketizer)
+        ab_rtp_depacketizer_push(t->depacketizer, rtp, rtp_len);
+}
+
+static time_t monotonic_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+static uint64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * 定期发送空的RTCP RR(RFC 3550 6.4.2)，服务端据此判断我们还在
+ */
+static void send_rtcp_report(T t) {
+    time_t now = monotonic_sec();
+    if (now - t->last_report < RTCP_REPORT_INTERVAL)
+        return;
+    t->last_report = now;
+
+    // '$' channel length, V=2 RC=0 PT=201 length=1, SSRC
+    unsigned char report[12] = { 0x24, 0x01, 0x00, 0x08, 0x80, 201, 0x00, 0x01 };
+    report[8]  = t->ssrc >> 24;
+    report[9]  = t->ssrc >> 16;
+    report[10] = t->ssrc >> 8;
+    report[11] = t->ssrc;
+
+    if (AB_RTSP_OVER_TCP == t->rtp_over_opt) {
+        ab_tcp_client_send(t->tcp_client, report, sizeof(report));
+    } else if (AB_RTSP_OVER_UDP == t->rtp_over_opt) {
+        ab_udp_client_send(t->udp_rtcp_client, t->srv_addr,
+            t->udp_rtcp_srv_port, report + 4, sizeof(report) - 4);
+    }
+}
+
+static void process_interleaved_frame(unsigned char channel,
+    const unsigned char *data, unsigned int data_len, void *arg) {
+    // odd channels carry RTCP, e.g. the server's sender reports
+    if (0 == (channel & 0x01))
+        process_rtp_packet(data, data_len, arg);
+}
+
 static void process_rtp_over_tcp(T t) {
     unsigned int recv_buf_size = 512 * 1024;
     unsigned char *recv_buf = (unsigned char *) ALLOC(recv_buf_size);
 
-    unsigned int start_pos = 0;
+    // a frame may straddle two reads, its head is kept in front of the buffer
+    unsigned int used = 0;
 
     while (!t->quit) {
-        int nrecv = ab_tcp_client_recv(t->tcp_client, recv_buf, recv_buf_size, -1);
+        // the server stops sending after TEARDOWN, wake up to see quit
+        int nrecv = ab_tcp_client_recv(t->tcp_client, recv_buf + used,
+            recv_buf_size - used, 500);
         if (nrecv <= 0) {
             continue;
         }
 
-        start_pos = 0;
-        while (start_pos < nrecv) {
-            if (recv_buf[start_pos] != 0x24) {
-                break;
-            }
-
-            unsigned short rtp_len = ntohs(*(unsigned short *)(recv_buf + start_pos + 2));
-
-            unsigned int slice = 0x1000000;
-            if (AB_VIDEO_CODEC_H264 == t->video_codec) {
-                unsigned char nal_type = recv_buf[start_pos + 16] & 0x1f;
-                if  (0x1c == nal_type || 0x1d == nal_type) {
-                    unsigned char flag = recv_buf[start_pos + 17] & 0xe0;
-                    if (0x80 == flag) {
-                        if (t->callback) {
-                            unsigned char nal_fua = (recv_buf[start_pos + 16] & 0xe0) | (recv_buf[start_pos + 17] & 0x1f);
-                            t->callback((unsigned char *) &slice, sizeof(slice), t->user_data);
-                            t->callback(&nal_fua, 1, t->user_data);
-                        }
-                    }
-
-                    if (t->callback) {
-                        t->callback(recv_buf + start_pos + 18, rtp_len - 14, t->user_data);
-                    }
-                } else {
-                    if (t->callback) {
-                        t->callback((unsigned char *) &slice, sizeof(slice), t->user_data);
-                        t->callback(recv_buf + start_pos + 16, rtp_len - 12, t->user_data);
-                    }
-                } 
-            } else if (AB_VIDEO_CODEC_H265 == t->video_codec) {
-                if (0x62 == recv_buf[start_pos + 16] && 0x1 == recv_buf[start_pos +  17]) {
-                    unsigned char flag = recv_buf[start_pos + 18] & 0xc0;
-                    if (0x80 == flag) {
-                        if (t->callback) {
-                            unsigned char nal_type = (recv_buf[start_pos + 18] << 1) & 0x7e;
-                            t->callback((unsigned char *) &slice, sizeof(slice), t->user_data);
-                            t->callback(&nal_type, 1, t->user_data);
-                            unsigned char tid = 0x1;
-                            t->callback(&tid, 1, t->user_data);
-                        }
-                    }
-
-                    if (t->callback) {
-                        t->callback(recv_buf + start_pos + 19, rtp_len - 15, t->user_data);
-                    }
-                } else {
-                    if (t->callback) {
-                        t->callback((unsigned char *) &slice, sizeof(slice), t->user_data);
-                        t->callback(recv_buf + start_pos + 16, rtp_len - 12, t->user_data);
-                    }
-                }
-            }
-
-            start_pos += rtp_len + 4;
-        }
+        send_rtcp_report(t);
+
+        used += nrecv;
+        unsigned int parsed = ab_rtsp_interleaved_parse(recv_buf, used,
+            process_interleaved_frame, t);
+        used -= parsed;
+        if (used > 0)
+            memmove(recv_buf, recv_buf + parsed, used);
     }
 
     FREE(recv_buf);
@@ -447,13 +590,22 @@ static void process_rtp_over_udp(T t) {
     char recv_addr[64];
     unsigned short recv_port = 0;
 
+    // 媒体包经过FEC解码器重排/恢复后再解包
+    ab_rtp_fec_decoder_t fec_decoder = NULL;
+    if (t->fec_payload_type > 0) {
+        fec_decoder = ab_rtp_fec_decoder_new(t->fec_payload_type,
+            process_rtp_packet, t);
+    }
+
     while (!t->quit) {
         memset(recv_addr, 0, sizeof(recv_addr));
         recv_port = 0;
 
         int nrecv = ab_udp_client_recv(t->udp_rtp_client, 
-            recv_addr, sizeof(recv_addr), &recv_port, recv_buf, recv_buf_size, -1);
+            recv_addr, sizeof(recv_addr), &recv_port, recv_buf, recv_buf_size, 500);
         if (nrecv <= 0) {
+            if (fec_decoder)
+                ab_rtp_fec_decoder_poll(fec_decoder, monotonic_us());
             continue;
         }
 
@@ -462,53 +614,22 @@ static void process_rtp_over_udp(T t) {
             continue;
         }
 
-        unsigned int slice = 0x1000000;
-        if (AB_VIDEO_CODEC_H264 == t->video_codec) {
-            unsigned char nal_type = recv_buf[12] & 0x1f;
-            if  (0x1c == nal_type || 0x1d == nal_type) {
-                unsigned char flag = recv_buf[13] & 0xe0;
-                if (0x80 == flag) {
-                    if (t->callback) {
-                        unsigned char nal_fua = (recv_buf[12] & 0xe0) | (recv_buf[13] & 0x1f);
-                        t->callback((unsigned char *) &slice, sizeof(slice), t->user_data);
-                        t->callback(&nal_fua, 1, t->user_data);
-                    }
-                }
-
-                if (t->callback) {
-                    t->callback(recv_buf + 14, nrecv - 14, t->user_data);
-                }
-            } else {
-                if (t->callback) {
-                    t->callback((unsigned char *) &slice, sizeof(slice), t->user_data);
-                    t->callback(recv_buf + 12, nrecv - 12, t->user_data);
-                }
-            }
-        } else if (AB_VIDEO_CODEC_H265 == t->video_codec) {
-            if (0x62 == recv_buf[12] && 0x1 == recv_buf[13]) {
-                unsigned char flag = recv_buf[14] & 0xc0;
-                if (0x80 == flag) {
-                    if (t->callback) {
-                        unsigned char nal_type = (recv_buf[14] << 1) & 0x7e;
-                        t->callback((unsigned char *) &slice, sizeof(slice), t->user_data);
-                        t->callback(&nal_type, 1, t->user_data);
-                        unsigned char tid = 0x1;
-                        t->callback(&tid, 1, t->user_data);
-                    }
-                }
-
-                if (t->callback) {
-                    t->callback(recv_buf + 15, nrecv - 15, t->user_data);
-                }
-            } else {
-                if (t->callback) {
-                    t->callback((unsigned char *) &slice, sizeof(slice), t->user_data);
-                    t->callback(recv_buf + 12, nrecv - 12, t->user_data);
-                }
-            }
+        send_rtcp_report(t);
+
+        if (fec_decoder) {
+            ab_rtp_fec_decoder_push(fec_decoder, recv_buf, nrecv, monotonic_us());
+        } else {
+            process_rtp_packet(recv_buf, nrecv, t);
         }
     }
 
+    if (fec_decoder) {
+        printf("FEC recovered %lu, lost %lu\n",
+            ab_rtp_fec_decoder_recovered(fec_decoder),
+            ab_rtp_fec_decoder_lost(fec_decoder));
+        ab_rtp_fec_decoder_free(&fec_decoder);
+    }
+
     FREE(recv_buf);
 }
 
@@ -517,11 +638,24 @@ void *child_thd_callback(void *arg) {
 
     T t = (T) arg;
 
+    if (t->callback) {
+        if (AB_VIDEO_CODEC_H264 == t->video_codec) {
+            t->depacketizer = ab_rtp_depacketizer_new(AB_NALU_CODEC_H264,
+                t->callback, t->user_data);
+        } else if (AB_VIDEO_CODEC_H265 == t->video_codec) {
+            t->depacketizer = ab_rtp_depacketizer_new(AB_NALU_CODEC_H265,
+                t->callback, t->user_data);
+        }
+    }
+
     if (AB_RTSP_OVER_TCP == t->rtp_over_opt) {
         process_rtp_over_tcp(t);
     } else if (AB_RTSP_OVER_UDP == t->rtp_over_opt) {
         process_rtp_over_udp(t);
     }
 
+    if (t->depacketizer)
+        ab_rtp_depacketizer_free(&t->depacketizer);
+
     return NULL;
 }
\ No newline at end of file
@@ -12,6 +12,8 @@
 extern "C" {
 #endif
 
+#include "ab_net/ab_socket.h"
+
 #define T ab_rtsp_client_t
 typedef struct T *T;
 
@@ -24,6 +26,28 @@ extern T    ab_rtsp_client_new(int rtp_over_opt, const char *url,
     void (*cb)(const unsigned char *, unsigned int, void *), void *user_data);
 extern void ab_rtsp_client_free(T *t);
 
+/*
+ * 按用途(AB_SOCKET_ROLE_*)设置套接字选项，默认值在连接时已设置：
+ * CONTROL: TCP_NODELAY、TCP_USER_TIMEOUT 10s
+ * RTP: 接收缓冲4MB(有CAP_NET_ADMIN时不受rmem_max限制)
+ * RTCP: DSCP AF41
+ * return: 该用途没有socket(RTP over TCP时的RTP/RTCP)或设置失败返回-1
+ */
+extern int  ab_rtsp_client_set_socket_options(T t, int role,
+    const ab_socket_options_t *options);
+
+/*
+ * DESCRIBE得到的视频编码，@ab_nalu_codec_t，SDP中没有H.264/H.265时为0
+ */
+extern int  ab_rtsp_client_codec(T t);
+
+/*
+ * 收到的视频RTP包(UDP时经过FEC恢复)原样交给cb，用于转发；与解包的cb互不影响
+ * 接收线程已经开始，设置之前的包不回调；只能设置一次
+ */
+extern void ab_rtsp_client_set_rtp_callback(T t,
+    void (*cb)(const unsigned char *, unsigned int, void *), void *user_data);
+
 #undef T
 
 #ifdef __cplusplus
@@ -0,0 +1,40 @@
+/*
+ * ab_rtsp_interleaved.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_rtsp_interleaved.h"
+
+#include <string.h>
+
+#define INTERLEAVED_HEADER_SIZE 4
+
+unsigned int ab_rtsp_interleaved_parse(const unsigned char *data,
+    unsigned int data_len,
+    void (*cb)(unsigned char, const unsigned char *, unsigned int, void *),
+    void *user_data) {
+    unsigned int pos = 0;
+    while (pos < data_len) {
+        if (data[pos] != '$') {
+            const unsigned char *next = memchr(data + pos, '$', data_len - pos);
+            if (NULL == next)
+                return data_len;
+            pos = next - data;
+        }
+
+        if (data_len - pos < INTERLEAVED_HEADER_SIZE)
+            break;
+
+        unsigned int frame_len = (data[pos + 2] << 8) | data[pos + 3];
+        if (data_len - pos - INTERLEAVED_HEADER_SIZE < frame_len)
+            break;
+
+        if (cb)
+            cb(data[pos + 1], data + pos + INTERLEAVED_HEADER_SIZE, frame_len, user_data);
+        pos += INTERLEAVED_HEADER_SIZE + frame_len;
+    }
+
+    return pos;
+}
@@ -0,0 +1,31 @@
+/*
+ * ab_rtsp_interleaved.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_RTSP_INTERLEAVED_H_
+#define AB_RTSP_INTERLEAVED_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * RTSP interleaved frame(RFC 2326 10.12): '$' + channel + 16-bit length + data
+ * 从TCP收到的字节流中切出完整的frame，不完整的frame留给下次
+ * 不以'$'开头的数据(RTSP响应等)跳到下一个'$'
+ * cb: channel, data, data_len, user_data
+ * return: 已处理的字节数，剩余的字节需要和后续收到的数据拼接后再解析
+ */
+extern unsigned int ab_rtsp_interleaved_parse(const unsigned char *data,
+    unsigned int data_len,
+    void (*cb)(unsigned char, const unsigned char *, unsigned int, void *),
+    void *user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_RTSP_INTERLEAVED_H_
@@ -0,0 +1,77 @@
+/*
+ * main.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_rtsp_client.h"
+#include "ab_rtsp_server.h"
+
+#include "ab_rtp/ab_nalu.h"
+
+#include "ab_log/ab_logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/signal.h>
+
+static bool g_quit = true;
+
+static void signal_catch(int signal_num) {
+    if (SIGINT == signal_num)
+        g_quit = true;
+}
+
+/*
+ * 拉流的接收线程回调，包直接进服务端的发送路径
+ */
+static void relay_rtp(const unsigned char *rtp, unsigned int rtp_len, void *user_data) {
+    ab_rtsp_server_send_rtp((ab_rtsp_server_t) user_data, rtp, rtp_len);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <1(RTP over TCP)|2(RTP over UDP)> <rtsp url> [port]\n",
+            argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int rtp_over_opt = atoi(argv[1]);
+    const char *rtsp_url = argv[2];
+    unsigned short port = argc > 3 ? atoi(argv[3]) : 8554;
+
+    signal(SIGINT, signal_catch);
+
+    ab_logger_init(AB_LOGGER_OUTPUT_TO_STDOUT, ".", "log", 100, 1024 * 1024);
+
+    // the camera is pulled once, only its raw RTP is used
+    ab_rtsp_client_t client = ab_rtsp_client_new(rtp_over_opt, rtsp_url, NULL, NULL);
+    if (NULL == client) {
+        AB_LOGGER_ERROR("bad url %s.\n", rtsp_url);
+        return EXIT_FAILURE;
+    }
+
+    int codec = ab_rtsp_client_codec(client);
+    if (AB_NALU_CODEC_NONE == codec) {
+        AB_LOGGER_ERROR("%s has no H.264/H.265 video.\n", rtsp_url);
+        ab_rtsp_client_free(&client);
+        return EXIT_FAILURE;
+    }
+
+    ab_rtsp_server_t rtsp = ab_rtsp_server_new(port, codec);
+    ab_rtsp_client_set_rtp_callback(client, relay_rtp, rtsp);
+    AB_LOGGER_INFO("relay %s on port %u.\n", rtsp_url, port);
+
+    g_quit = false;
+    while (!g_quit)
+        sleep(1);
+
+    // the receiving thread stops before the server goes away
+    ab_rtsp_client_free(&client);
+    ab_rtsp_server_free(&rtsp);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,305 @@
+/*
+ * ab_file_source.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_file_source.h"
+
+#include "ab_base/ab_mem.h"
+#include "ab_base/ab_assert.h"
+
+#include "ab_log/ab_logger.h"
+
+#include "ab_rtp/ab_nalu.h"
+#include "ab_rtp/ab_sps.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define T ab_file_source_t
+
+struct T {
+    int             codec;              // @ab_nalu_codec_t
+
+    const unsigned char *data;          // mmap
+    size_t          size;
+
+    ab_file_source_nalu_t *nalus;
+    unsigned int    nalu_count;
+    ab_file_source_frame_t *frames;
+    unsigned int    frame_count;
+    uint32_t       *key_frames;         // ascending frame indexes
+    unsigned int    key_frame_count;
+
+    // first of each kind, @ab_nalu_parameter_set_t; -1 when absent
+    int             parameter_sets[AB_NALU_PARAMETER_SET_COUNT];
+
+    uint64_t        frame_duration_num;
+    uint64_t        frame_duration_den;
+};
+
+static bool map_file(T source, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        AB_LOGGER_ERROR("open(%s) failed, %s.\n", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || 0 == st.st_size) {
+        AB_LOGGER_ERROR("%s is empty or unreadable.\n", path);
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == data) {
+        AB_LOGGER_ERROR("mmap(%s) failed, %s.\n", path, strerror(errno));
+        return false;
+    }
+
+    source->data = data;
+    source->size = st.st_size;
+    return true;
+}
+
+/*
+ * 两遍：先数出NALU个数，再一次分配好填写
+ */
+static unsigned int scan_nalus(T source, ab_file_source_nalu_t *nalus) {
+    unsigned int count = 0;
+    size_t pos = 0;
+    unsigned int start_code = 0;
+
+    // the scan takes unsigned int lengths, a huge file goes in 1GB windows
+    const size_t window = 1u << 30;
+    while (pos < source->size) {
+        size_t rest = source->size - pos;
+        int found = ab_nalu_find_start_code(source->data + pos,
+            rest > window ? window : rest, &start_code);
+        if (found < 0) {
+            if (rest <= window)
+                break;
+            // keep the last bytes, a start code may straddle the window
+            pos += window - 3;
+            continue;
+        }
+        pos += found + start_code;
+
+        if (nalus) {
+            if (count > 0) {
+                ab_file_source_nalu_t *prev = &nalus[count - 1];
+                prev->len = pos - start_code - prev->offset;
+            }
+            nalus[count].offset = pos;
+            nalus[count].len    = source->size - pos;
+        }
+        ++count;
+    }
+
+    return count;
+}
+
+static void parse_duration(T source, const unsigned char *sps, unsigned int sps_len) {
+    ab_sps_info_t info;
+    uint64_t num, den;
+    if (0 == ab_sps_parse(source->codec, sps, sps_len, &info) &&
+        ab_sps_frame_duration(source->codec, &info, &num, &den) &&
+        num * 1000 >= den && num <= den * 240) {
+        // between 1000 fps and 1 frame per 4 minutes, others are bogus VUI
+        source->frame_duration_num = num;
+        source->frame_duration_den = den;
+    }
+}
+
+/*
+ * 按ab_nalu_starts_access_unit分帧，与服务端打时间戳的规则一致
+ */
+static void build_index(T source) {
+    source->frames = ALLOC(source->nalu_count * sizeof(ab_file_source_frame_t));
+    source->key_frames = ALLOC(source->nalu_count * sizeof(uint32_t));
+
+    bool au_has_vcl = false;
+    ab_file_source_frame_t *frame = NULL;
+    for (unsigned int i = 0; i < source->nalu_count; ++i) {
+        ab_file_source_nalu_t *nalu = &source->nalus[i];
+        const unsigned char *data = source->data + nalu->offset;
+
+        if (AB_NALU_CODEC_H264 == source->codec)
+            nalu->type = nalu->len > 0 ? data[0] & 0x1f : 0;
+        else
+            nalu->type = nalu->len > 0 ? (data[0] >> 1) & 0x3f : 0;
+
+        int parameter_set = ab_nalu_parameter_set(source->codec, data, nalu->len);
+        if (parameter_set >= 0 && source->parameter_sets[parameter_set] < 0) {
+            source->parameter_sets[parameter_set] = i;
+            if (AB_NALU_PARAMETER_SET_SPS == parameter_set)
+                parse_duration(source, data, nalu->len);
+        }
+
+        // always called, the first NAL unit needs vcl as well
+        bool vcl = false;
+        bool starts = ab_nalu_starts_access_unit(source->codec, data, nalu->len, &vcl);
+        if (NULL == frame || (starts && au_has_vcl)) {
+            frame = &source->frames[source->frame_count++];
+            frame->first_nalu   = i;
+            frame->nalu_count   = 0;
+            frame->key          = false;
+            au_has_vcl          = false;
+        }
+        ++frame->nalu_count;
+
+        if (vcl) {
+            au_has_vcl = true;
+            if (!frame->key && ab_nalu_is_key(source->codec, data, nalu->len)) {
+                frame->key = true;
+                source->key_frames[source->key_frame_count++] = source->frame_count - 1;
+            }
+        }
+    }
+}
+
+T ab_file_source_open(const char *path, int codec) {
+    assert(path);
+    assert(AB_NALU_CODEC_H264 == codec || AB_NALU_CODEC_H265 == codec);
+
+    T source;
+    NEW0(source);
+    source->codec               = codec;
+    source->frame_duration_num  = 1;
+    source->frame_duration_den  = 25;
+    for (int i = 0; i < AB_NALU_PARAMETER_SET_COUNT; ++i)
+        source->parameter_sets[i] = -1;
+
+    if (!map_file(source, path)) {
+        FREE(source);
+        return NULL;
+    }
+    madvise((void *) source->data, source->size, MADV_SEQUENTIAL);
+
+    source->nalu_count = scan_nalus(source, NULL);
+    if (0 == source->nalu_count) {
+        AB_LOGGER_ERROR("no NAL unit in %s.\n", path);
+        munmap((void *) source->data, source->size);
+        FREE(source);
+        return NULL;
+    }
+    source->nalus = ALLOC(source->nalu_count * sizeof(ab_file_source_nalu_t));
+    scan_nalus(source, source->nalus);
+    build_index(source);
+
+    // viewers may start anywhere once seeking is possible
+    madvise((void *) source->data, source->size, MADV_NORMAL);
+
+    AB_LOGGER_INFO("%s: %u NAL units, %u frames, %u key frames, %.3f fps.\n",
+        path, source->nalu_count, source->frame_count, source->key_frame_count,
+        (double) source->frame_duration_den / source->frame_duration_num);
+
+    return source;
+}
+
+void ab_file_source_close(T *source) {
+    assert(source && *source);
+
+    munmap((void *) (*source)->data, (*source)->size);
+    FREE((*source)->nalus);
+    FREE((*source)->frames);
+    FREE((*source)->key_frames);
+    FREE(*source);
+}
+
+int ab_file_source_codec(T source) {
+    assert(source);
+    return source->codec;
+}
+
+unsigned int ab_file_source_frame_count(T source) {
+    assert(source);
+    return source->frame_count;
+}
+
+const ab_file_source_frame_t *ab_file_source_frame(T source, unsigned int index) {
+    assert(source);
+    assert(index < source->frame_count);
+    return &source->frames[index];
+}
+
+const unsigned char *ab_file_source_nalu(T source, unsigned int index,
+    unsigned int *nalu_len) {
+    assert(source);
+    assert(index < source->nalu_count);
+    assert(nalu_len);
+
+    *nalu_len = source->nalus[index].len;
+    return source->data + source->nalus[index].offset;
+}
+
+const unsigned char *ab_file_source_parameter_set(T source, int index,
+    unsigned int *len) {
+    assert(source);
+    assert(len);
+
+    if (index < 0 || index >= AB_NALU_PARAMETER_SET_COUNT ||
+        source->parameter_sets[index] < 0)
+        return NULL;
+
+    return ab_file_source_nalu(source, source->parameter_sets[index], len);
+}
+
+void ab_file_source_frame_duration(T source, uint64_t *num, uint64_t *den) {
+    assert(source);
+    assert(num && den);
+
+    *num = source->frame_duration_num;
+    *den = source->frame_duration_den;
+}
+
+uint64_t ab_file_source_frame_time_us(T source, unsigned int index) {
+    assert(source);
+    return index * source->frame_duration_num * 1000000 / source->frame_duration_den;
+}
+
+uint64_t ab_file_source_duration_us(T source) {
+    assert(source);
+    return ab_file_source_frame_time_us(source, source->frame_count);
+}
+
+unsigned int ab_file_source_key_frame(T source, unsigned int index) {
+    assert(source);
+
+    // the last key frame not after index
+    unsigned int low = 0, high = source->key_frame_count;
+    while (low < high) {
+        unsigned int mid = low + (high - low) / 2;
+        if (source->key_frames[mid] <= index)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low > 0 ? source->key_frames[low - 1] : 0;
+}
+
+unsigned int ab_file_source_next_key_frame(T source, unsigned int index) {
+    assert(source);
+
+    // the first key frame not before index
+    unsigned int low = 0, high = source->key_frame_count;
+    while (low < high) {
+        unsigned int mid = low + (high - low) / 2;
+        if (source->key_frames[mid] < index)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low < source->key_frame_count ? source->key_frames[low] :
+        source->frame_count;
+}
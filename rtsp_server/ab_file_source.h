@@ -0,0 +1,87 @@
+/*
+ * ab_file_source.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_FILE_SOURCE_H_
+#define AB_FILE_SOURCE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct ab_file_source_nalu_t {
+    uint64_t        offset;             // 不含起始码
+    uint32_t        len;
+    uint8_t         type;               // nal_unit_type
+} ab_file_source_nalu_t;
+
+typedef struct ab_file_source_frame_t {
+    uint32_t        first_nalu;
+    uint32_t        nalu_count;
+    bool            key;                // 含IDR/IRAP
+} ab_file_source_frame_t;
+
+/*
+ * H.264/H.265 Annex B文件，mmap后一次建好NALU/帧索引，之后只读
+ * 多个线程可以同时读同一个文件源
+ */
+#define T ab_file_source_t
+typedef struct T *T;
+
+/*
+ * codec: @ab_nalu_codec_t
+ * return: 打不开或没有NALU返回NULL
+ */
+extern T    ab_file_source_open(const char *path, int codec);
+extern void ab_file_source_close(T *source);
+
+extern int  ab_file_source_codec(T source);
+
+extern unsigned int ab_file_source_frame_count(T source);
+extern const ab_file_source_frame_t *ab_file_source_frame(T source, unsigned int index);
+
+/*
+ * return: 指向mmap的NALU(不含起始码)，文件源关闭前有效
+ */
+extern const unsigned char *ab_file_source_nalu(T source, unsigned int index,
+    unsigned int *nalu_len);
+
+/*
+ * index: @ab_nalu_parameter_set_t
+ * return: 文件中第一个该类参数集，没有时返回NULL
+ */
+extern const unsigned char *ab_file_source_parameter_set(T source, int index,
+    unsigned int *len);
+
+/*
+ * 第一个SPS的timing_info，没有时25fps
+ */
+extern void ab_file_source_frame_duration(T source, uint64_t *num, uint64_t *den);
+/*
+ * index帧相对第一帧的时间
+ */
+extern uint64_t ab_file_source_frame_time_us(T source, unsigned int index);
+extern uint64_t ab_file_source_duration_us(T source);
+
+/*
+ * return: index及之前最近的关键帧，没有关键帧时返回0
+ */
+extern unsigned int ab_file_source_key_frame(T source, unsigned int index);
+/*
+ * return: index及之后最近的关键帧，没有时返回帧数
+ */
+extern unsigned int ab_file_source_next_key_frame(T source, unsigned int index);
+
+#undef T
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_FILE_SOURCE_H_
@@ -0,0 +1,395 @@
+/*
+ * ab_rtp_pacer.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_rtp_pacer.h"
+
+#include "ab_base/ab_list.h"
+#include "ab_base/ab_mem.h"
+#include "ab_base/ab_assert.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#define PACKET_MAX_SIZE     1500
+#define DUE_UNSCHEDULED     UINT64_MAX
+
+#define T ab_rtp_pacer_t
+#define S ab_rtp_pacer_stream_t
+
+typedef struct ab_rtp_pacer_packet_t {
+    uint64_t        enqueue_ns;
+    uint64_t        due_ns;
+    unsigned int    len;
+    int             tag;
+    unsigned char   data[PACKET_MAX_SIZE];
+} ab_rtp_pacer_packet_t;
+
+struct S {
+    T               pacer;
+
+    void           *user_data;
+    void          (*callback)(const unsigned char *, unsigned int, int, void *);
+
+    pthread_mutex_t mutex;
+    pthread_cond_t  not_full;
+    ab_rtp_pacer_packet_t *queue;
+    unsigned int    queue_size;
+    unsigned int    head;
+    unsigned int    count;
+    unsigned int    unscheduled;        // tail packets of the frame being built
+    uint64_t        last_due_ns;
+
+    unsigned long   packets;
+    unsigned long   frames;
+    unsigned long   overflows;
+    unsigned long   late_frames;
+    unsigned long   max_burst;
+    uint64_t        total_delay_ns;
+    uint64_t        max_delay_ns;
+};
+
+struct T {
+    pthread_mutex_t mutex;
+    pthread_cond_t  idle;
+    list_t          streams;
+    bool            serving;            // a pass is calling back, unlocked
+    unsigned int    freeing;            // streams waiting for the pass to end
+
+    int             timer_fd;
+    int             event_fd;
+
+    bool            quit;
+    pthread_t       thd;
+};
+
+static void *pacer_thd_func(void *arg);
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void wakeup(T pacer) {
+    uint64_t one = 1;
+    if (write(pacer->event_fd, &one, sizeof(one)) < 0) {
+        // counter saturated, the thread is awake anyway
+    }
+}
+
+T ab_rtp_pacer_new(void) {
+    T pacer;
+    NEW(pacer);
+
+    pthread_mutex_init(&pacer->mutex, NULL);
+    pthread_cond_init(&pacer->idle, NULL);
+    pacer->streams  = NULL;
+    pacer->serving  = false;
+    pacer->freeing  = 0;
+    pacer->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    pacer->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    assert(pacer->timer_fd >= 0 && pacer->event_fd >= 0);
+
+    pacer->quit = false;
+    pthread_create(&pacer->thd, NULL, pacer_thd_func, pacer);
+
+    return pacer;
+}
+
+void ab_rtp_pacer_free(T *pacer) {
+    assert(pacer && *pacer);
+
+    (*pacer)->quit = true;
+    wakeup(*pacer);
+    pthread_join((*pacer)->thd, NULL);
+
+    // streams still attached are owned by their creators
+    list_free(&(*pacer)->streams);
+
+    close((*pacer)->timer_fd);
+    close((*pacer)->event_fd);
+    pthread_cond_destroy(&(*pacer)->idle);
+    pthread_mutex_destroy(&(*pacer)->mutex);
+
+    FREE(*pacer);
+}
+
+S ab_rtp_pacer_stream_new(T pacer, unsigned int queue_size,
+    void (*cb)(const unsigned char *, unsigned int, int, void *), void *user_data) {
+    assert(pacer);
+    assert(queue_size > 0);
+
+    S stream;
+    NEW0(stream);
+
+    stream->pacer       = pacer;
+    stream->callback    = cb;
+    stream->user_data   = user_data;
+    stream->queue_size  = queue_size;
+    stream->queue       = CALLOC(queue_size, sizeof(ab_rtp_pacer_packet_t));
+    pthread_mutex_init(&stream->mutex, NULL);
+    pthread_cond_init(&stream->not_full, NULL);
+
+    // a running pass keeps walking from the old head, nodes never move
+    pthread_mutex_lock(&pacer->mutex);
+    pacer->streams = list_push(pacer->streams, stream);
+    pthread_mutex_unlock(&pacer->mutex);
+
+    return stream;
+}
+
+void ab_rtp_pacer_stream_free(S *stream) {
+    assert(stream && *stream);
+
+    T pacer = (*stream)->pacer;
+
+    // the pass walks the list and calls back without the lock: wait it out
+    pthread_mutex_lock(&pacer->mutex);
+    ++pacer->freeing;
+    while (pacer->serving)
+        pthread_cond_wait(&pacer->idle, &pacer->mutex);
+    --pacer->freeing;
+
+    list_t *node = &pacer->streams;
+    while (*node) {
+        if ((*node)->first == *stream) {
+            *node = list_pop(*node, NULL);
+            break;
+        }
+        node = &(*node)->rest;
+    }
+    pthread_cond_broadcast(&pacer->idle);
+    pthread_mutex_unlock(&pacer->mutex);
+
+    pthread_cond_destroy(&(*stream)->not_full);
+    pthread_mutex_destroy(&(*stream)->mutex);
+    FREE((*stream)->queue);
+    FREE(*stream);
+}
+
+/*
+ * caller holds stream->mutex, the head packet has been sent
+ */
+static void pop_head(S stream, uint64_t now) {
+    ab_rtp_pacer_packet_t *packet = &stream->queue[stream->head];
+
+    uint64_t delay = now - packet->enqueue_ns;
+    stream->total_delay_ns += delay;
+    if (delay > stream->max_delay_ns)
+        stream->max_delay_ns = delay;
+    ++stream->packets;
+
+    stream->head = (stream->head + 1) % stream->queue_size;
+    --stream->count;
+    if (stream->unscheduled > stream->count)
+        stream->unscheduled = stream->count;
+    pthread_cond_signal(&stream->not_full);
+}
+
+int ab_rtp_pacer_stream_push(S stream,
+    const unsigned char *data, unsigned int data_len, int tag) {
+    assert(stream);
+    assert(data && data_len > 0);
+
+    if (data_len > PACKET_MAX_SIZE)
+        return -1;
+
+    uint64_t now = now_ns();
+
+    pthread_mutex_lock(&stream->mutex);
+    if (stream->count == stream->queue_size) {
+        // no room left: give up smoothing, the pacer thread sends the whole
+        // backlog now, still in order, and we wait for the first free slot
+        unsigned int pos = stream->head;
+        for (unsigned int i = 0; i < stream->count; ++i) {
+            stream->queue[pos].due_ns = now;
+            pos = (pos + 1) % stream->queue_size;
+        }
+        stream->unscheduled = 0;
+        stream->last_due_ns = now;
+        ++stream->overflows;
+
+        wakeup(stream->pacer);
+        while (stream->count == stream->queue_size)
+            pthread_cond_wait(&stream->not_full, &stream->mutex);
+    }
+
+    unsigned int tail = (stream->head + stream->count) % stream->queue_size;
+    ab_rtp_pacer_packet_t *packet = &stream->queue[tail];
+    packet->enqueue_ns  = now;
+    packet->due_ns      = DUE_UNSCHEDULED;
+    packet->len         = data_len;
+    packet->tag         = tag;
+    memcpy(packet->data, data, data_len);
+
+    ++stream->count;
+    ++stream->unscheduled;
+    pthread_mutex_unlock(&stream->mutex);
+
+    return data_len;
+}
+
+void ab_rtp_pacer_stream_end_frame(S stream, unsigned int duration_us) {
+    assert(stream);
+
+    uint64_t now = now_ns();
+
+    pthread_mutex_lock(&stream->mutex);
+    unsigned int n = stream->unscheduled;
+    if (n > 0) {
+        uint64_t duration_ns = (uint64_t) duration_us * 1000;
+        uint64_t start = now;
+        if (stream->last_due_ns > now + duration_ns) {
+            // more than a frame behind, the source outruns the frame interval:
+            // release the backlog at once instead of drifting further
+            unsigned int pos = stream->head;
+            for (unsigned int i = 0; i < stream->count - n; ++i) {
+                stream->queue[pos].due_ns = now;
+                pos = (pos + 1) % stream->queue_size;
+            }
+            ++stream->late_frames;
+        } else if (stream->last_due_ns > now) {
+            // a frame never starts before the previous one has been spread out
+            start = stream->last_due_ns;
+        }
+
+        uint64_t step = duration_ns / n;
+
+        unsigned int pos = (stream->head + stream->count - n) % stream->queue_size;
+        for (unsigned int i = 0; i < n; ++i) {
+            stream->queue[pos].due_ns = start + i * step;
+            pos = (pos + 1) % stream->queue_size;
+        }
+
+        stream->last_due_ns = start + n * step;
+        stream->unscheduled = 0;
+        ++stream->frames;
+    }
+    pthread_mutex_unlock(&stream->mutex);
+
+    if (n > 0)
+        wakeup(stream->pacer);
+}
+
+void ab_rtp_pacer_stream_stats(S stream, ab_rtp_pacer_stats_t *stats) {
+    assert(stream);
+    assert(stats);
+
+    pthread_mutex_lock(&stream->mutex);
+    stats->packets      = stream->packets;
+    stats->frames       = stream->frames;
+    stats->overflows    = stream->overflows;
+    stats->late_frames  = stream->late_frames;
+    stats->max_burst    = stream->max_burst;
+    stats->avg_delay_us = stream->packets ?
+        stream->total_delay_ns / stream->packets / 1000 : 0;
+    stats->max_delay_us = stream->max_delay_ns / 1000;
+    stats->queue_depth  = stream->count;
+    pthread_mutex_unlock(&stream->mutex);
+}
+
+/*
+ * return: due time of the next packet, DUE_UNSCHEDULED if none
+ */
+static uint64_t send_due_packets(S stream, uint64_t now) {
+    unsigned long burst = 0;
+
+    pthread_mutex_lock(&stream->mutex);
+    while (stream->count > 0 && stream->queue[stream->head].due_ns <= now) {
+        // called back unlocked; a full queue makes the producer wait, so
+        // the head slot is not overwritten meanwhile
+        ab_rtp_pacer_packet_t *packet = &stream->queue[stream->head];
+        pthread_mutex_unlock(&stream->mutex);
+        if (stream->callback)
+            stream->callback(packet->data, packet->len, packet->tag, stream->user_data);
+        pthread_mutex_lock(&stream->mutex);
+
+        pop_head(stream, now);
+        ++burst;
+    }
+
+    if (burst > stream->max_burst)
+        stream->max_burst = burst;
+
+    uint64_t next_due = stream->count > 0 ?
+        stream->queue[stream->head].due_ns : DUE_UNSCHEDULED;
+    pthread_mutex_unlock(&stream->mutex);
+
+    return next_due;
+}
+
+void *pacer_thd_func(void *arg) {
+    assert(arg);
+
+    T pacer = (T) arg;
+
+    struct pollfd fds[2];
+    fds[0].fd       = pacer->timer_fd;
+    fds[0].events   = POLLIN;
+    fds[1].fd       = pacer->event_fd;
+    fds[1].events   = POLLIN;
+
+    while (!pacer->quit) {
+        uint64_t next_due = DUE_UNSCHEDULED;
+
+        pthread_mutex_lock(&pacer->mutex);
+        while (pacer->freeing > 0)
+            pthread_cond_wait(&pacer->idle, &pacer->mutex);
+        pacer->serving = true;
+        list_t node = pacer->streams;
+        pthread_mutex_unlock(&pacer->mutex);
+
+        // no pacer lock is held across the callbacks, they take their own
+        uint64_t now = now_ns();
+        while (node) {
+            uint64_t due = send_due_packets(node->first, now);
+            if (due < next_due)
+                next_due = due;
+            node = node->rest;
+        }
+
+        pthread_mutex_lock(&pacer->mutex);
+        pacer->serving = false;
+        pthread_cond_broadcast(&pacer->idle);
+        pthread_mutex_unlock(&pacer->mutex);
+
+        struct itimerspec its;
+        memset(&its, 0, sizeof(its));
+        if (next_due != DUE_UNSCHEDULED) {
+            its.it_value.tv_sec     = next_due / 1000000000ULL;
+            its.it_value.tv_nsec    = next_due % 1000000000ULL;
+            // 0 would disarm the timer
+            if (0 == its.it_value.tv_sec && 0 == its.it_value.tv_nsec)
+                its.it_value.tv_nsec = 1;
+        }
+        timerfd_settime(pacer->timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+
+        if (poll(fds, 2, -1) < 0)
+            continue;
+
+        uint64_t value;
+        if (fds[0].revents & POLLIN) {
+            if (read(pacer->timer_fd, &value, sizeof(value)) < 0) {
+                // spurious wakeup
+            }
+        }
+        if (fds[1].revents & POLLIN) {
+            if (read(pacer->event_fd, &value, sizeof(value)) < 0) {
+                // spurious wakeup
+            }
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,69 @@
+/*
+ * ab_rtp_pacer.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_RTP_PACER_H_
+#define AB_RTP_PACER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ab_rtp_pacer_stats_t {
+    unsigned long   packets;            // 已发送的包数
+    unsigned long   frames;             // 已调度的帧数
+    unsigned long   overflows;          // 队列满时放弃平滑、立即发出积压的次数
+    unsigned long   late_frames;        // 积压超过一帧而放弃平滑的次数
+    unsigned long   max_burst;          // 一次唤醒内连续发送的最大包数
+    unsigned long   avg_delay_us;       // 入队到发送的平均延时
+    unsigned long   max_delay_us;
+    unsigned int    queue_depth;        // 当前排队的包数
+} ab_rtp_pacer_stats_t;
+
+/*
+ * 调度线程(timerfd驱动)，可被多个流共享
+ */
+#define T ab_rtp_pacer_t
+typedef struct T *T;
+
+extern T    ab_rtp_pacer_new(void);
+extern void ab_rtp_pacer_free(T *pacer);
+
+#define S ab_rtp_pacer_stream_t
+typedef struct S *S;
+
+/*
+ * queue_size: 最多排队的包数
+ * cb: 在调度线程中按入队顺序回调，tag为入队时的参数；回调时不持有pacer的锁
+ */
+extern S    ab_rtp_pacer_stream_new(T pacer, unsigned int queue_size,
+    void (*cb)(const unsigned char *, unsigned int, int, void *), void *user_data);
+/*
+ * 等正在进行的回调结束，之后不再回调；不能在回调中调用
+ */
+extern void ab_rtp_pacer_stream_free(S *stream);
+
+/*
+ * 拷贝入队，直到ab_rtp_pacer_stream_end_frame才开始发送
+ * 队列满时积压的包立即由调度线程发出，等到有空位才返回
+ */
+extern int  ab_rtp_pacer_stream_push(S stream,
+    const unsigned char *data, unsigned int data_len, int tag);
+/*
+ * 把本帧入队的包均匀分布在duration_us内发送
+ */
+extern void ab_rtp_pacer_stream_end_frame(S stream, unsigned int duration_us);
+
+extern void ab_rtp_pacer_stream_stats(S stream, ab_rtp_pacer_stats_t *stats);
+
+#undef S
+#undef T
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_RTP_PACER_H_
@@ -0,0 +1,312 @@
+/*
+ * ab_rtsp_dvr.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_rtsp_dvr.h"
+
+#include "ab_base/ab_mem.h"
+#include "ab_base/ab_assert.h"
+
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#define DVR_RECORD_HEADER   4           // NAL unit length in front of each
+
+#define T ab_rtsp_dvr_t
+
+typedef struct ab_rtsp_dvr_entry_t {
+    uint64_t        offset;             // of the first record, in bytes ever written
+    uint32_t        size;
+    uint32_t        nalu_count;
+    uint32_t        timestamp;
+    bool            key;
+    uint64_t        wall_us;
+} ab_rtsp_dvr_entry_t;
+
+struct T {
+    // the ingest thread appends, the event loop copies frames out
+    pthread_mutex_t mutex;
+
+    unsigned char  *data;
+    unsigned int    data_size;
+    uint64_t        head;               // bytes ever written
+
+    // frames [first, end) are in the window, entry n at frames[n % max_frames]
+    ab_rtsp_dvr_entry_t *frames;
+    unsigned int    max_frames;
+    uint64_t        first;
+    uint64_t        end;
+
+    // key frame numbers [key_first, key_end), ascending
+    uint64_t       *keys;
+    uint64_t        key_first;
+    uint64_t        key_end;
+
+    // the frame being appended
+    uint64_t        pending_offset;
+    uint32_t        pending_nalus;
+    bool            pending_dropped;    // larger than the whole buffer
+};
+
+T ab_rtsp_dvr_new(unsigned int data_size, unsigned int max_frames) {
+    assert(data_size > DVR_RECORD_HEADER);
+    assert(max_frames > 0);
+
+    T dvr;
+    NEW0(dvr);
+    pthread_mutex_init(&dvr->mutex, NULL);
+    dvr->data           = ALLOC(data_size);
+    dvr->data_size      = data_size;
+    dvr->head           = 0;
+    dvr->frames         = CALLOC(max_frames, sizeof(ab_rtsp_dvr_entry_t));
+    dvr->max_frames     = max_frames;
+    dvr->first          = 0;
+    dvr->end            = 0;
+    dvr->keys           = CALLOC(max_frames, sizeof(uint64_t));
+    dvr->key_first      = 0;
+    dvr->key_end        = 0;
+    dvr->pending_offset = 0;
+    dvr->pending_nalus  = 0;
+    dvr->pending_dropped = false;
+
+    return dvr;
+}
+
+void ab_rtsp_dvr_free(T *dvr) {
+    assert(dvr && *dvr);
+
+    pthread_mutex_destroy(&(*dvr)->mutex);
+    FREE((*dvr)->data);
+    FREE((*dvr)->frames);
+    FREE((*dvr)->keys);
+    FREE(*dvr);
+}
+
+static inline ab_rtsp_dvr_entry_t *entry(T dvr, uint64_t number) {
+    return &dvr->frames[number % dvr->max_frames];
+}
+
+static inline uint64_t key_at(T dvr, uint64_t index) {
+    return dvr->keys[index % dvr->max_frames];
+}
+
+static uint64_t realtime_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * 数据被覆盖的帧移出窗口，关键帧索引跟着移动
+ */
+static void evict(T dvr) {
+    uint64_t oldest = dvr->head > dvr->data_size ? dvr->head - dvr->data_size : 0;
+    while (dvr->first < dvr->end && entry(dvr, dvr->first)->offset < oldest)
+        ++dvr->first;
+    while (dvr->key_first < dvr->key_end && key_at(dvr, dvr->key_first) < dvr->first)
+        ++dvr->key_first;
+}
+
+static void ring_write(T dvr, const unsigned char *src, unsigned int len) {
+    unsigned int pos = dvr->head % dvr->data_size;
+    unsigned int part = dvr->data_size - pos;
+    if (part > len)
+        part = len;
+    memcpy(dvr->data + pos, src, part);
+    memcpy(dvr->data, src + part, len - part);
+    dvr->head += len;
+}
+
+static void ring_read(T dvr, uint64_t offset, unsigned char *dst, unsigned int len) {
+    unsigned int pos = offset % dvr->data_size;
+    unsigned int part = dvr->data_size - pos;
+    if (part > len)
+        part = len;
+    memcpy(dst, dvr->data + pos, part);
+    memcpy(dst + part, dvr->data, len - part);
+}
+
+void ab_rtsp_dvr_append(T dvr, const unsigned char *nalu, unsigned int nalu_len) {
+    assert(dvr);
+    assert(nalu);
+
+    pthread_mutex_lock(&dvr->mutex);
+    uint64_t size = dvr->head - dvr->pending_offset + DVR_RECORD_HEADER + nalu_len;
+    if (dvr->pending_dropped || size > dvr->data_size) {
+        dvr->pending_dropped = true;
+    } else {
+        uint32_t len = nalu_len;
+        ring_write(dvr, (const unsigned char *) &len, DVR_RECORD_HEADER);
+        ring_write(dvr, nalu, nalu_len);
+        ++dvr->pending_nalus;
+        evict(dvr);
+    }
+    pthread_mutex_unlock(&dvr->mutex);
+}
+
+void ab_rtsp_dvr_end_frame(T dvr, uint32_t timestamp, bool key) {
+    assert(dvr);
+
+    pthread_mutex_lock(&dvr->mutex);
+    if (dvr->pending_nalus > 0 && !dvr->pending_dropped) {
+        if (dvr->end - dvr->first == dvr->max_frames)
+            ++dvr->first;
+
+        ab_rtsp_dvr_entry_t *frame = entry(dvr, dvr->end);
+        frame->offset       = dvr->pending_offset;
+        frame->size         = dvr->head - dvr->pending_offset;
+        frame->nalu_count   = dvr->pending_nalus;
+        frame->timestamp    = timestamp;
+        frame->key          = key;
+        frame->wall_us      = realtime_us();
+
+        if (key) {
+            if (dvr->key_end - dvr->key_first == dvr->max_frames)
+                ++dvr->key_first;
+            dvr->keys[dvr->key_end++ % dvr->max_frames] = dvr->end;
+        }
+        ++dvr->end;
+        evict(dvr);
+    }
+
+    // a dropped frame leaves its bytes behind, they are overwritten in turn
+    dvr->pending_offset     = dvr->head;
+    dvr->pending_nalus      = 0;
+    dvr->pending_dropped    = false;
+    pthread_mutex_unlock(&dvr->mutex);
+}
+
+/*
+ * 调用者持有mutex
+ * return: number及之前最近的关键帧，number早于第一个关键帧时为第一个关键帧
+ */
+static int key_before(T dvr, uint64_t number, uint64_t *key) {
+    if (dvr->key_first == dvr->key_end)
+        return -1;
+
+    // the last key frame not after number
+    uint64_t low = dvr->key_first, high = dvr->key_end;
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        if (key_at(dvr, mid) <= number)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    *key = key_at(dvr, low > dvr->key_first ? low - 1 : dvr->key_first);
+    return 0;
+}
+
+int ab_rtsp_dvr_find_npt(T dvr, uint64_t npt_us, uint64_t *number) {
+    assert(dvr);
+    assert(number);
+
+    pthread_mutex_lock(&dvr->mutex);
+    int result = -1;
+    if (dvr->first < dvr->end) {
+        // timestamps only grow within the window
+        uint32_t live = entry(dvr, dvr->end - 1)->timestamp;
+        uint64_t ticks = npt_us * 90000 / 1000000;
+        uint64_t low = dvr->first, high = dvr->end;
+        while (low < high) {
+            uint64_t mid = low + (high - low) / 2;
+            if ((uint32_t) (live - entry(dvr, mid)->timestamp) >= ticks)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        result = key_before(dvr, low > dvr->first ? low - 1 : dvr->first, number);
+    }
+    pthread_mutex_unlock(&dvr->mutex);
+
+    return result;
+}
+
+int ab_rtsp_dvr_find_clock(T dvr, uint64_t wall_us, uint64_t *number) {
+    assert(dvr);
+    assert(number);
+
+    pthread_mutex_lock(&dvr->mutex);
+    int result = -1;
+    if (dvr->first < dvr->end) {
+        uint64_t low = dvr->first, high = dvr->end;
+        while (low < high) {
+            uint64_t mid = low + (high - low) / 2;
+            if (entry(dvr, mid)->wall_us <= wall_us)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        result = key_before(dvr, low > dvr->first ? low - 1 : dvr->first, number);
+    }
+    pthread_mutex_unlock(&dvr->mutex);
+
+    return result;
+}
+
+int ab_rtsp_dvr_position(T dvr, uint64_t number, uint64_t *npt_us, uint64_t *wall_us) {
+    assert(dvr);
+
+    pthread_mutex_lock(&dvr->mutex);
+    int result = -1;
+    if (dvr->first < dvr->end) {
+        if (number < dvr->first)
+            number = dvr->first;
+        else if (number >= dvr->end)
+            number = dvr->end - 1;
+
+        const ab_rtsp_dvr_entry_t *frame = entry(dvr, number);
+        uint32_t ticks = entry(dvr, dvr->end - 1)->timestamp - frame->timestamp;
+        if (npt_us)
+            *npt_us = (uint64_t) ticks * 1000000 / 90000;
+        if (wall_us)
+            *wall_us = frame->wall_us;
+        result = 0;
+    }
+    pthread_mutex_unlock(&dvr->mutex);
+
+    return result;
+}
+
+uint64_t ab_rtsp_dvr_live(T dvr) {
+    assert(dvr);
+
+    pthread_mutex_lock(&dvr->mutex);
+    uint64_t end = dvr->end;
+    pthread_mutex_unlock(&dvr->mutex);
+
+    return end;
+}
+
+int ab_rtsp_dvr_read(T dvr, uint64_t number, ab_rtsp_dvr_frame_t *frame,
+    unsigned char *buf, unsigned int buf_size) {
+    assert(dvr);
+    assert(frame);
+
+    pthread_mutex_lock(&dvr->mutex);
+    int result = AB_RTSP_DVR_OK;
+    if (number >= dvr->end) {
+        result = AB_RTSP_DVR_NOT_READY;
+    } else if (number < dvr->first) {
+        result = AB_RTSP_DVR_EVICTED;
+    } else {
+        const ab_rtsp_dvr_entry_t *stored = entry(dvr, number);
+        frame->timestamp    = stored->timestamp;
+        frame->wall_us      = stored->wall_us;
+        frame->key          = stored->key;
+        frame->nalu_count   = stored->nalu_count;
+        frame->size         = stored->size;
+        if (stored->size > buf_size)
+            result = AB_RTSP_DVR_NO_SPACE;
+        else
+            ring_read(dvr, stored->offset, buf, stored->size);
+    }
+    pthread_mutex_unlock(&dvr->mutex);
+
+    return result;
+}
@@ -0,0 +1,91 @@
+/*
+ * ab_rtsp_dvr.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_RTSP_DVR_H_
+#define AB_RTSP_DVR_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum ab_rtsp_dvr_result_t {
+    AB_RTSP_DVR_OK = 0,
+    AB_RTSP_DVR_NOT_READY = -1,         // 还没有写入
+    AB_RTSP_DVR_EVICTED = -2,           // 已被覆盖
+    AB_RTSP_DVR_NO_SPACE = -3           // buf不够，需要frame->size字节
+};
+
+/*
+ * 读出的一帧，buf中每个NALU前有4字节长度(本机字节序)
+ */
+typedef struct ab_rtsp_dvr_frame_t {
+    uint32_t        timestamp;          // 直播的RTP时间戳
+    uint64_t        wall_us;            // 写入时的CLOCK_REALTIME
+    bool            key;
+    unsigned int    nalu_count;
+    unsigned int    size;
+} ab_rtsp_dvr_frame_t;
+
+/*
+ * 直播的时移缓存：固定大小的NALU环和帧索引，写满后覆盖最老的帧
+ * 帧按写入顺序编号，关键帧另有索引；推流线程写入和事件循环读取可以并发
+ */
+#define T ab_rtsp_dvr_t
+typedef struct T *T;
+
+/*
+ * data_size: NALU缓存字节数，大于它的帧被丢弃
+ * max_frames: 最多保留的帧数
+ * 内存在创建时一次分配，之后不再增长
+ */
+extern T    ab_rtsp_dvr_new(unsigned int data_size, unsigned int max_frames);
+extern void ab_rtsp_dvr_free(T *dvr);
+
+/*
+ * 推流线程：一帧的NALU(不含起始码)依次append，end_frame结束该帧
+ * timestamp: 该帧的RTP时间戳；key: 含IDR/IRAP
+ */
+extern void ab_rtsp_dvr_append(T dvr, const unsigned char *nalu, unsigned int nalu_len);
+extern void ab_rtsp_dvr_end_frame(T dvr, uint32_t timestamp, bool key);
+
+/*
+ * 比最新的帧早npt_us处及之前最近的关键帧，早于窗口时为窗口内第一个关键帧
+ * return: 窗口内没有关键帧返回-1
+ */
+extern int  ab_rtsp_dvr_find_npt(T dvr, uint64_t npt_us, uint64_t *number);
+/*
+ * 同上，按写入时的CLOCK_REALTIME
+ */
+extern int  ab_rtsp_dvr_find_clock(T dvr, uint64_t wall_us, uint64_t *number);
+/*
+ * number帧比最新的帧早多少和写入时间，超出窗口时按最近的一端
+ * return: 缓存为空返回-1
+ */
+extern int  ab_rtsp_dvr_position(T dvr, uint64_t number,
+    uint64_t *npt_us, uint64_t *wall_us);
+/*
+ * 下一个写入的帧号，即直播的位置
+ */
+extern uint64_t ab_rtsp_dvr_live(T dvr);
+
+/*
+ * 拷贝出number帧
+ * return: @ab_rtsp_dvr_result_t
+ */
+extern int  ab_rtsp_dvr_read(T dvr, uint64_t number, ab_rtsp_dvr_frame_t *frame,
+    unsigned char *buf, unsigned int buf_size);
+
+#undef T
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_RTSP_DVR_H_
@@ -0,0 +1,836 @@
+/*
+ * ab_rtsp_ingest.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ *
+ * 媒体输入：AnnexB/NALU/AAC、RTP转发、共享内存和包环，以及打包后到观看端的包路径
+ */
+
+#include "ab_rtsp_server_def.h"
+
+#include "ab_base/ab_mem.h"
+#include "ab_base/ab_assert.h"
+#include "ab_base/ab_shm_ring.h"
+
+#include "ab_log/ab_logger.h"
+
+#include "ab_rtp/ab_rtp_depacketizer.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define T ab_rtsp_server_t
+
+#define RTSP_RELAY_MAX_JUMP             (10 * 90000)    // source clock, 90 kHz, relay and shm ingest
+#define RTSP_INGEST_REORDER_WINDOW      64      // packets, RTP/UDP ingest
+#define RTSP_INGEST_MAX_DELAY_US        20000
+
+static void rtp_send_nalu(T rtsp,
+    const unsigned char *nalu, unsigned int nalu_len);
+static void rtp_end_access_unit(T rtsp);
+static int audio_send(T rtsp, const char *data, unsigned int data_len);
+static void rtp_send_adts_frame(T rtsp, const unsigned char *frame,
+    const ab_aac_adts_header_t *header);
+
+static int send_annexb(T rtsp, const char *data, unsigned int data_len) {
+    int result = 0;
+    rtsp->ingest_us = monotonic_us();
+    if (NULL == data || 0 == data_len) {
+        unsigned int start_code = 0;
+        if (rtsp->cache.used > 0 &&
+            0 == ab_nalu_find_start_code(rtsp->cache.data, rtsp->cache.used,
+                &start_code)) {
+            if (rtsp->cache.used > (int) start_code)
+                rtp_send_nalu(rtsp, rtsp->cache.data + start_code,
+                    rtsp->cache.used - start_code);
+            rtsp->cache.used = 0;
+        }
+
+        rtp_end_access_unit(rtsp);
+
+        return result;
+    }
+
+    if ((unsigned int) (rtsp->cache.size - rtsp->cache.used) >= data_len) {
+        memcpy(rtsp->cache.data + rtsp->cache.used, data, data_len);
+        rtsp->cache.used += data_len;
+        add_counter(rtsp, AB_RTSP_COUNTER_INGEST_BYTES, data_len);
+    } else {
+        AB_LOGGER_WARN("Not enough spaces(%u < %u).\n", 
+            rtsp->cache.size, rtsp->cache.used + data_len);
+        return result;
+    }
+
+    result = data_len;
+
+    // a NAL unit is complete once the next start code has arrived
+    unsigned int start_pos = 0;
+    while (start_pos < (unsigned int) rtsp->cache.used) {
+        const unsigned char *pos = rtsp->cache.data + start_pos;
+        unsigned int rest = rtsp->cache.used - start_pos;
+
+        unsigned int start_code = 0;
+        int first = ab_nalu_find_start_code(pos, rest, &start_code);
+        if (first < 0)
+            break;
+        if (first > 0) {
+            // garbage in front of the first start code
+            start_pos += first;
+            continue;
+        }
+
+        int next = ab_nalu_find_start_code(pos + start_code, rest - start_code, NULL);
+        if (next < 0)
+            break;
+        if (next > 0)
+            rtp_send_nalu(rtsp, pos + start_code, next);
+        start_pos += start_code + next;
+    }
+
+    if (start_pos > 0) {
+        rtsp->cache.used -= start_pos;
+        memmove(rtsp->cache.data, rtsp->cache.data + start_pos, rtsp->cache.used);
+    }
+
+    return result;
+}
+
+int ab_rtsp_server_send(T rtsp, const char *data, unsigned int data_len) {
+    assert(rtsp);
+
+    pthread_mutex_lock(&rtsp->ingest_mutex);
+    int result = send_annexb(rtsp, data, data_len);
+    pthread_mutex_unlock(&rtsp->ingest_mutex);
+
+    return result;
+}
+
+int ab_rtsp_server_send_nalu(T rtsp, const unsigned char *nalu, unsigned int nalu_len) {
+    assert(rtsp);
+
+    if (NULL == nalu || 0 == nalu_len)
+        return 0;
+
+    pthread_mutex_lock(&rtsp->ingest_mutex);
+    rtsp->ingest_us = monotonic_us();
+    add_counter(rtsp, AB_RTSP_COUNTER_INGEST_BYTES, nalu_len);
+    rtp_send_nalu(rtsp, nalu, nalu_len);
+    pthread_mutex_unlock(&rtsp->ingest_mutex);
+
+    return nalu_len;
+}
+
+int ab_rtsp_server_send_audio(T rtsp, const char *data, unsigned int data_len) {
+    assert(rtsp);
+
+    pthread_mutex_lock(&rtsp->audio_mutex);
+    int result = audio_send(rtsp, data, data_len);
+    pthread_mutex_unlock(&rtsp->audio_mutex);
+
+    return result;
+}
+
+static int audio_send(T rtsp, const char *data, unsigned int data_len) {
+    if (NULL == rtsp->aac_packetizer)
+        return -1;
+
+    rtsp->audio_ingest_us = monotonic_us();
+    if (NULL == data || 0 == data_len) {
+        ab_rtp_aac_packetizer_flush(rtsp->aac_packetizer);
+        return 0;
+    }
+
+    ab_buffer_t *cache = &rtsp->audio_cache;
+    if (cache->size - cache->used < (int) data_len) {
+        AB_LOGGER_WARN("Not enough spaces(%u < %u).\n",
+            cache->size, cache->used + data_len);
+        return 0;
+    }
+    memcpy(cache->data + cache->used, data, data_len);
+    cache->used += data_len;
+    add_counter(rtsp, AB_RTSP_COUNTER_AUDIO_BYTES, data_len);
+
+    unsigned int pos = 0;
+    while (pos < (unsigned int) cache->used) {
+        int sync = ab_aac_adts_find_sync(cache->data + pos, cache->used - pos);
+        if (sync < 0) {
+            // a trailing 0xff may be the first half of the next syncword
+            pos = 0xff == cache->data[cache->used - 1] ?
+                cache->used - 1 : cache->used;
+            break;
+        }
+        pos += sync;
+
+        ab_aac_adts_header_t header;
+        if (cache->used - pos < AB_AAC_ADTS_HEADER_SIZE)
+            break;
+        if (ab_aac_adts_parse(cache->data + pos, cache->used - pos, &header) < 0) {
+            ++pos;
+            continue;
+        }
+        if (cache->used - pos < header.frame_len)
+            break;
+
+        rtp_send_adts_frame(rtsp, cache->data + pos, &header);
+        pos += header.frame_len;
+    }
+
+    if (pos > 0) {
+        cache->used -= pos;
+        memmove(cache->data, cache->data + pos, cache->used);
+    }
+
+    return data_len;
+}
+
+/*
+ * 计数先于入队，pacer线程可能马上就把包发出去
+ */
+static void pacer_push(T rtsp, ab_rtp_pacer_stream_t stream, int track,
+    const unsigned char *data, unsigned int data_len, int tag) {
+    __atomic_fetch_add(&rtsp->pacer_queued[track], 1, __ATOMIC_RELAXED);
+    if (ab_rtp_pacer_stream_push(stream, data, data_len, tag) < 0)
+        __atomic_fetch_sub(&rtsp->pacer_queued[track], 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * 发送或者交给pacer平滑发送
+ */
+static void rtp_emit_packet(T rtsp,
+    const unsigned char *data, unsigned int data_len, int tag) {
+    if (rtsp->pacer_stream) {
+        pacer_push(rtsp, rtsp->pacer_stream, AB_RTSP_TRACK_VIDEO, data, data_len, tag);
+    } else {
+        ab_rtsp_send_packet(rtsp, data, data_len, tag);
+    }
+}
+
+/*
+ * 发给观看端的视频包原样写入包环，不含interleaved头；FEC包worker自己生成
+ * 带标记位的包即一帧的最后一条记录
+ */
+static void packet_ring_write(T rtsp, const unsigned char *rtp, unsigned int rtp_len,
+    bool key) {
+    bool marker = ((const ab_rtp_header_t *) rtp)->marker;
+    unsigned int flags = 0;
+    if (key && rtsp->packet_ring_frame_start)
+        flags |= AB_SHM_RING_KEY;
+    if (marker)
+        flags |= AB_SHM_RING_FRAME_END;
+
+    if (ab_shm_ring_write(rtsp->packet_ring, rtp, rtp_len, rtsp->ingest_us, flags) < 0)
+        return;
+    rtsp->packet_ring_frame_start   = false;
+    rtsp->packet_ring_in_frame      = !marker;
+}
+
+static void rtp_end_frame(T rtsp) {
+    // an empty record when the frame did not end on a marker, e.g. a
+    // relayed source that never sets it
+    if (rtsp->packet_ring && rtsp->packet_ring_in_frame) {
+        ab_shm_ring_write(rtsp->packet_ring, NULL, 0, rtsp->ingest_us,
+            AB_SHM_RING_FRAME_END);
+        rtsp->packet_ring_in_frame = false;
+    }
+    rtsp->packet_ring_frame_start = true;
+
+    if (rtsp->pacer_stream) {
+        ab_rtp_pacer_stream_end_frame(rtsp->pacer_stream,
+            rtsp->frame_interval_us / 100 * rtsp->pacing_percent);
+    }
+}
+
+static void rtp_send_fec(T rtsp) {
+    int len = ab_rtp_fec_encoder_flush(rtsp->fec_encoder, rtsp->fec_buffer.data,
+        rtsp->fec_buffer.size);
+    if (len > 0) {
+        add_counter(rtsp, AB_RTSP_COUNTER_FEC_PACKETS, 1);
+        rtp_emit_packet(rtsp, rtsp->fec_buffer.data, len, AB_RTP_PACKET_FEC);
+    }
+}
+
+/*
+ * 把刚发送的包加入FEC保护组，组满时发送FEC包
+ */
+static void rtp_protect_packet(T rtsp,
+    const unsigned char *rtp, unsigned int rtp_len, bool key) {
+    if (NULL == rtsp->fec_encoder)
+        return;
+
+    int group = key ? rtsp->fec_idr_group : rtsp->fec_group;
+    if (group <= 0)
+        return;
+
+    int count = ab_rtp_fec_encoder_add(rtsp->fec_encoder, rtp, rtp_len);
+    if (count < 0) {
+        rtp_send_fec(rtsp);
+        count = ab_rtp_fec_encoder_add(rtsp->fec_encoder, rtp, rtp_len);
+    }
+
+    if (count >= group)
+        rtp_send_fec(rtsp);
+}
+
+static int packet_tag(const ab_rtp_packet_info_t *info) {
+    int tag = AB_RTP_PACKET_MEDIA;
+    if (info->key)
+        tag |= AB_RTP_PACKET_KEY;
+    if (info->nalu_start)
+        tag |= AB_RTP_PACKET_NALU_START;
+    if (!info->reference || info->temporal_id > 0)
+        tag |= AB_RTP_PACKET_DISCARDABLE;
+    if (AB_NALU_SWITCH_TSA == info->switch_point)
+        tag |= AB_RTP_PACKET_TSA;
+    else if (AB_NALU_SWITCH_STSA == info->switch_point)
+        tag |= AB_RTP_PACKET_STSA;
+
+    // a reference picture is needed by its own sub-layer, a sub-layer
+    // non-reference one only by those above; H.264 has one layer, nothing
+    // above a non-reference frame needs it
+    int breaks = info->reference ? info->temporal_id : info->temporal_id + 1;
+    tag |= info->max_temporal_id << AB_RTP_PACKET_TID_SHIFT;
+    tag |= (breaks < AB_RTSP_TID_NONE ? breaks : AB_RTSP_TID_NONE) <<
+        AB_RTP_PACKET_BREAKS_SHIFT;
+    return tag;
+}
+
+void ab_rtsp_video_packet_cb(unsigned char *rtp, unsigned int rtp_len,
+    const ab_rtp_packet_info_t *info, void *user_data) {
+    T rtsp = (T) user_data;
+
+    // the packetizer leaves headroom for the interleaved frame
+    unsigned char *data = rtp - sizeof(ab_rtsp_interleaved_frame_t);
+    ab_rtsp_fill_interleaved_frame((ab_rtsp_interleaved_frame_t *) data, 0x00, rtp_len);
+
+    int tag = packet_tag(info);
+
+    add_counter(rtsp, AB_RTSP_COUNTER_RTP_PACKETS, 1);
+    add_counter(rtsp, AB_RTSP_COUNTER_RTP_BYTES, rtp_len);
+    ab_rtsp_stamp_packet(rtsp, AB_RTSP_TRACK_VIDEO, rtp, rtsp->ingest_us);
+    rtp_emit_packet(rtsp, data, rtp_len + sizeof(ab_rtsp_interleaved_frame_t),
+        tag);
+    if (rtsp->packet_ring)
+        packet_ring_write(rtsp, rtp, rtp_len, info->key);
+
+    rtp_protect_packet(rtsp, rtp, rtp_len, info->key);
+}
+
+void ab_rtsp_audio_packet_cb(unsigned char *rtp, unsigned int rtp_len, void *user_data) {
+    T rtsp = (T) user_data;
+
+    unsigned char *data = rtp - sizeof(ab_rtsp_interleaved_frame_t);
+    ab_rtsp_fill_interleaved_frame((ab_rtsp_interleaved_frame_t *) data, 0x02, rtp_len);
+
+    add_counter(rtsp, AB_RTSP_COUNTER_AUDIO_PACKETS, 1);
+    ab_rtsp_stamp_packet(rtsp, AB_RTSP_TRACK_AUDIO, rtp, rtsp->audio_ingest_us);
+    unsigned int len = rtp_len + sizeof(ab_rtsp_interleaved_frame_t);
+    if (rtsp->audio_pacer_stream) {
+        // nothing to spread, the shared scheduler keeps A/V in order
+        pacer_push(rtsp, rtsp->audio_pacer_stream, AB_RTSP_TRACK_AUDIO, data, len,
+            AB_RTP_PACKET_AUDIO);
+        ab_rtp_pacer_stream_end_frame(rtsp->audio_pacer_stream, 0);
+    } else {
+        ab_rtsp_send_packet(rtsp, data, len, AB_RTP_PACKET_AUDIO);
+    }
+}
+
+/*
+ * 每个ADTS帧一个AU，时间戳以采样率为时钟，每帧1024个采样
+ */
+void rtp_send_adts_frame(T rtsp, const unsigned char *frame,
+    const ab_aac_adts_header_t *header) {
+    if (header->raw_data_blocks != 1) {
+        // without a CRC the block boundaries are not signalled
+        AB_LOGGER_WARN("ADTS frame with %u raw data blocks skipped.\n",
+            header->raw_data_blocks);
+        return;
+    }
+
+    // the writers hold audio_mutex as well, compare without mutex
+    if (!ab_aac_config_equal(&header->config, &rtsp->audio_config)) {
+        AB_LOGGER_INFO("audio AAC object type %u, %u Hz, %u channels.\n",
+            header->config.object_type, header->config.sample_rate,
+            header->config.channels);
+        ab_rtp_aac_packetizer_flush(rtsp->aac_packetizer);
+
+        pthread_mutex_lock(&rtsp->mutex);
+        rtsp->audio_config = header->config;
+        ab_rtsp_invalidate_describe(rtsp);
+        pthread_mutex_unlock(&rtsp->mutex);
+    }
+
+    ab_rtp_aac_packetizer_push(rtsp->aac_packetizer, frame + header->header_len,
+        header->frame_len - header->header_len, rtsp->audio_timestamp);
+    rtsp->audio_timestamp += AB_AAC_FRAME_SAMPLES;
+    add_counter(rtsp, AB_RTSP_COUNTER_AUDIO_FRAMES, 1);
+}
+
+/*
+ * 用SPS的timing_info打时间戳，没有时保持原来的帧率(默认25fps)
+ */
+static void update_video_info(T rtsp,
+    const unsigned char *sps, unsigned int sps_len) {
+    ab_sps_info_t info;
+    if (ab_sps_parse(rtsp->video_codec, sps, sps_len, &info) < 0) {
+        AB_LOGGER_WARN("bad SPS(%u bytes), keep the previous video info.\n", sps_len);
+        return;
+    }
+
+    uint64_t num, den;
+    if (ab_sps_frame_duration(rtsp->video_codec, &info, &num, &den) &&
+        num * 1000 >= den && num <= den * 240) {
+        // between 1000 fps and 1 frame per 4 minutes, others are bogus VUI
+        if (num != rtsp->frame_duration_num || den != rtsp->frame_duration_den) {
+            rtsp->frame_duration_num    = num;
+            rtsp->frame_duration_den    = den;
+            rtsp->timestamp_remainder   = 0;
+            rtsp->frame_interval_us     = num * 1000000 / den;
+        }
+    }
+
+    if (!rtsp->sps_valid || info.width != rtsp->sps_info.width ||
+        info.height != rtsp->sps_info.height) {
+        AB_LOGGER_INFO("video %ux%u, profile %u, level %u, %.3f fps.\n",
+            info.width, info.height, info.profile_idc, info.level_idc,
+            (double) rtsp->frame_duration_den / rtsp->frame_duration_num);
+    }
+
+    rtsp->sps_info  = info;
+    rtsp->sps_valid = true;
+}
+
+/*
+ * 以90kHz推进一帧，余数累积，非整数帧率(29.97)不会漂移
+ */
+static void advance_timestamp(T rtsp) {
+    uint64_t ticks = 90000 * rtsp->frame_duration_num + rtsp->timestamp_remainder;
+    rtsp->timestamp += ticks / rtsp->frame_duration_den;
+    rtsp->timestamp_remainder = ticks % rtsp->frame_duration_den;
+}
+
+/*
+ * 下一个AU开始或调用方结束一帧时调用一次；没有slice时只发出缓存的包
+ */
+static void rtp_end_access_unit(T rtsp) {
+    // the last packet of the access unit goes out with the marker bit
+    ab_rtp_packetizer_flush(rtsp->packetizer, rtsp->au_has_vcl);
+    if (!rtsp->au_has_vcl)
+        return;
+
+    // FEC groups never span frames
+    if (rtsp->fec_encoder)
+        rtp_send_fec(rtsp);
+    rtp_end_frame(rtsp);
+    if (rtsp->dvr)
+        ab_rtsp_dvr_end_frame(rtsp->dvr, rtsp->timestamp, rtsp->au_key);
+
+    add_counter(rtsp, AB_RTSP_COUNTER_FRAMES, 1);
+    if (rtsp->au_key)
+        add_counter(rtsp, AB_RTSP_COUNTER_KEY_FRAMES, 1);
+    rtsp->au_has_vcl = false;
+    rtsp->au_key     = false;
+
+    // the shm ingest stamps the next access unit from its own clock
+    if (!rtsp->shm_clock)
+        advance_timestamp(rtsp);
+}
+
+/*
+ * 参数集变化(换分辨率、编码器重启)时SDP要重新生成
+ */
+static void update_parameter_set(T rtsp,
+    const unsigned char *nalu, unsigned int nalu_len) {
+    int index = ab_nalu_parameter_set(rtsp->video_codec, nalu, nalu_len);
+    if (index < 0)
+        return;
+
+    // only this thread writes parameter_sets, compare without the lock
+    ab_buffer_t *parameter_set = &rtsp->parameter_sets[index];
+    if (parameter_set->used == (int) nalu_len &&
+        memcmp(parameter_set->data, nalu, nalu_len) == 0)
+        return;
+
+    pthread_mutex_lock(&rtsp->mutex);
+    if (parameter_set->size < (int) nalu_len) {
+        if (parameter_set->data)
+            FREE(parameter_set->data);
+        parameter_set->size = nalu_len;
+        parameter_set->data = ALLOC(nalu_len);
+    }
+    memcpy(parameter_set->data, nalu, nalu_len);
+    parameter_set->used = nalu_len;
+    ab_rtsp_invalidate_describe(rtsp);
+
+    if (AB_NALU_PARAMETER_SET_SPS == index)
+        update_video_info(rtsp, nalu, nalu_len);
+    pthread_mutex_unlock(&rtsp->mutex);
+}
+
+void rtp_send_nalu(T rtsp, 
+    const unsigned char *nalu, unsigned int nalu_len) {
+    assert(rtsp);
+    assert(nalu && nalu_len > 0);
+
+    update_parameter_set(rtsp, nalu, nalu_len);
+
+    add_counter(rtsp, AB_RTSP_COUNTER_NAL_UNITS, 1);
+
+    // the access unit ends when the next one starts or the caller says so,
+    // never after each slice
+    bool vcl = false;
+    if (ab_nalu_starts_access_unit(rtsp->video_codec, nalu, nalu_len, &vcl) &&
+        rtsp->au_has_vcl)
+        rtp_end_access_unit(rtsp);
+    if (!rtsp->au_has_vcl && rtsp->shm_clock)
+        rtsp->timestamp = rtsp->shm_timestamp;
+
+    ab_rtp_packetizer_push(rtsp->packetizer, nalu, nalu_len, rtsp->timestamp);
+    if (rtsp->dvr)
+        ab_rtsp_dvr_append(rtsp->dvr, nalu, nalu_len);
+
+    if (vcl) {
+        rtsp->au_has_vcl = true;
+        if (ab_nalu_is_key(rtsp->video_codec, nalu, nalu_len))
+            rtsp->au_key = true;
+    }
+}
+
+/*
+ * RTP头之后的负载，跳过CSRC、扩展头和填充
+ * return: 不是RTP版本2或长度不对返回-1
+ */
+static int rtp_payload(const unsigned char *rtp, unsigned int rtp_len,
+    unsigned int *offset, unsigned int *payload_len) {
+    const ab_rtp_header_t *header = (const ab_rtp_header_t *) rtp;
+    if (rtp_len <= sizeof(ab_rtp_header_t) || header->version != RTP_VERSION)
+        return -1;
+
+    unsigned int pos = sizeof(ab_rtp_header_t) + header->csrc_len * 4;
+    if (header->extension) {
+        if (pos + 4 > rtp_len)
+            return -1;
+        pos += 4 + ((rtp[pos + 2] << 8) | rtp[pos + 3]) * 4;
+    }
+
+    unsigned int padding = header->padding ? rtp[rtp_len - 1] : 0;
+    if (pos + padding >= rtp_len)
+        return -1;
+
+    *offset         = pos;
+    *payload_len    = rtp_len - padding - pos;
+    return 0;
+}
+
+/*
+ * 标记位结束一帧；源不设标记位或者标记位的包丢了时，由时间戳前进结束
+ * FEC组和pacer的帧与打包时一致
+ */
+static void relay_end_frame(T rtsp) {
+    rtsp->relay_in_frame = false;
+    if (rtsp->fec_encoder)
+        rtp_send_fec(rtsp);
+    rtp_end_frame(rtsp);
+
+    add_counter(rtsp, AB_RTSP_COUNTER_FRAMES, 1);
+    if (rtsp->au_key)
+        add_counter(rtsp, AB_RTSP_COUNTER_KEY_FRAMES, 1);
+    rtsp->au_key = false;
+}
+
+/*
+ * 新的源从我们的下一个序列号继续，时间戳从上一帧之后继续
+ */
+static void relay_rebase(T rtsp, const ab_rtp_header_t *header, bool restart) {
+    uint32_t ssrc       = ntohl(header->ssrc);
+    uint32_t timestamp  = ntohl(header->timestamp);
+    bool new_source     = !rtsp->relay_started || ssrc != rtsp->relay_ssrc || restart;
+    int32_t jump        = (int32_t) (timestamp - rtsp->relay_last_timestamp);
+
+    if (new_source) {
+        rtsp->relay_ssrc        = ssrc;
+        rtsp->relay_seq_offset  = rtsp->relay_next_seq - ntohs(header->seq);
+    }
+    if (new_source || jump > RTSP_RELAY_MAX_JUMP || jump < -RTSP_RELAY_MAX_JUMP) {
+        if (rtsp->relay_started) {
+            AB_LOGGER_INFO("relay source %08x, clock jumped %d ticks, rebased.\n",
+                ssrc, jump);
+            // the new clock lands right after the frame in progress
+            if (rtsp->relay_in_frame)
+                relay_end_frame(rtsp);
+            advance_timestamp(rtsp);
+        }
+        rtsp->relay_timestamp_offset = rtsp->timestamp - timestamp;
+    }
+
+    rtsp->relay_started         = true;
+    rtsp->relay_last_timestamp  = timestamp;
+}
+
+static void relay_parameter_set_cb(const unsigned char *nalu,
+    unsigned int nalu_len, void *user_data) {
+    update_parameter_set((T) user_data, nalu, nalu_len);
+}
+
+/*
+ * restart: 源的序列号不再连续(包环的写者重启或读者被覆盖)，按新的源重新对齐
+ */
+static int relay_send(T rtsp, const unsigned char *rtp, unsigned int rtp_len,
+    uint64_t ingest_us, bool restart) {
+    unsigned int offset, payload_len;
+    ab_rtp_packet_info_t info;
+    if (NULL == rtp || rtp_payload(rtp, rtp_len, &offset, &payload_len) < 0 ||
+        ab_rtp_payload_inspect(rtsp->video_codec, rtp + offset, payload_len,
+            &info, relay_parameter_set_cb, rtsp) < 0)
+        return -1;
+
+    rtsp->ingest_us = ingest_us;
+    add_counter(rtsp, AB_RTSP_COUNTER_INGEST_BYTES, rtp_len);
+
+    // the only copy, into room for the interleaved frame
+    ab_buffer_t *buffer = &rtsp->relay_buffer;
+    unsigned int len = rtp_len + sizeof(ab_rtsp_interleaved_frame_t);
+    if (buffer->size < (int) len) {
+        if (buffer->data)
+            FREE(buffer->data);
+        buffer->size = len;
+        buffer->data = ALLOC(len);
+    }
+    unsigned char *data = buffer->data;
+    unsigned char *out  = data + sizeof(ab_rtsp_interleaved_frame_t);
+    memcpy(out, rtp, rtp_len);
+
+    relay_rebase(rtsp, (const ab_rtp_header_t *) rtp, restart);
+    ab_rtp_header_t *header = (ab_rtp_header_t *) out;
+    uint16_t seq        = ntohs(header->seq) + rtsp->relay_seq_offset;
+    uint32_t timestamp  = ntohl(header->timestamp) + rtsp->relay_timestamp_offset;
+    // serial number arithmetic; a late packet of an earlier frame neither
+    // ends the current one nor moves the clock back
+    int32_t advance     = (int32_t) (timestamp - rtsp->timestamp);
+    if (advance > 0) {
+        if (rtsp->relay_in_frame)
+            relay_end_frame(rtsp);
+        rtsp->timestamp = timestamp;
+    }
+    if ((int16_t) (seq + 1 - rtsp->relay_next_seq) > 0)
+        rtsp->relay_next_seq = seq + 1;
+    header->payload_type    = RTP_PAYLOAD_TYPE_H264;
+    header->seq         = htons(seq);
+    header->timestamp   = htonl(timestamp);
+    header->ssrc        = htonl(RTSP_VIDEO_SSRC);
+    ab_rtsp_fill_interleaved_frame((ab_rtsp_interleaved_frame_t *) data, 0x00, rtp_len);
+
+    if (info.key)
+        rtsp->au_key = true;
+
+    add_counter(rtsp, AB_RTSP_COUNTER_RTP_PACKETS, 1);
+    add_counter(rtsp, AB_RTSP_COUNTER_RTP_BYTES, rtp_len);
+    ab_rtsp_stamp_packet(rtsp, AB_RTSP_TRACK_VIDEO, out, rtsp->ingest_us);
+    rtp_emit_packet(rtsp, data, len, packet_tag(&info));
+    if (rtsp->packet_ring)
+        packet_ring_write(rtsp, out, rtp_len, info.key);
+    rtp_protect_packet(rtsp, out, rtp_len, info.key);
+
+    // a late packet is passed on, its own frame has ended already
+    if (advance >= 0) {
+        rtsp->relay_in_frame = true;
+        if (header->marker)
+            relay_end_frame(rtsp);
+    }
+
+    return rtp_len;
+}
+
+int ab_rtsp_server_send_rtp(T rtsp, const unsigned char *rtp, unsigned int rtp_len) {
+    assert(rtsp);
+
+    pthread_mutex_lock(&rtsp->ingest_mutex);
+    int result = relay_send(rtsp, rtp, rtp_len, monotonic_us(), false);
+    pthread_mutex_unlock(&rtsp->ingest_mutex);
+
+    return result;
+}
+
+static void udp_source_cb(const unsigned char *rtp, unsigned int rtp_len,
+    void *user_data) {
+    ab_rtsp_server_send_rtp((T) user_data, rtp, rtp_len);
+}
+
+int ab_rtsp_server_set_rtp_ingest(T rtsp, unsigned short port) {
+    assert(rtsp);
+
+    // swapped under ingest_mutex, joined outside it: the receiving thread
+    // takes it to send
+    pthread_mutex_lock(&rtsp->ingest_mutex);
+    ab_udp_source_t source = rtsp->udp_source;
+    rtsp->udp_source = NULL;
+    pthread_mutex_unlock(&rtsp->ingest_mutex);
+    if (source)
+        ab_udp_source_close(&source);
+    if (0 == port)
+        return 0;
+
+    source = ab_udp_source_open(port, RTSP_INGEST_REORDER_WINDOW,
+        RTSP_INGEST_MAX_DELAY_US, udp_source_cb, rtsp);
+    if (NULL == source)
+        return -1;
+
+    pthread_mutex_lock(&rtsp->ingest_mutex);
+    rtsp->udp_source = source;
+    pthread_mutex_unlock(&rtsp->ingest_mutex);
+    return 0;
+}
+
+/*
+ * 写者的时钟(微秒)换算到90kHz，接到我们的时间戳上；第一次、不连续或跳变
+ * 超过RTSP_RELAY_MAX_JUMP时从上一帧之后继续
+ */
+static void shm_update_clock(T rtsp, uint64_t timestamp_us, bool rebase) {
+    uint32_t timestamp = timestamp_us * 9 / 100;
+    int32_t jump = (int32_t) (timestamp + rtsp->shm_timestamp_offset - rtsp->timestamp);
+
+    if (!rtsp->shm_started || rebase ||
+        jump > RTSP_RELAY_MAX_JUMP || jump < -RTSP_RELAY_MAX_JUMP) {
+        uint32_t next = rtsp->timestamp;
+        if (rtsp->shm_started) {
+            AB_LOGGER_INFO("shm ingest clock jumped %d ticks, rebased.\n", jump);
+            next += 90000 * rtsp->frame_duration_num / rtsp->frame_duration_den;
+        }
+        rtsp->shm_timestamp_offset  = next - timestamp;
+        rtsp->shm_started           = true;
+    }
+
+    rtsp->shm_timestamp = timestamp + rtsp->shm_timestamp_offset;
+}
+
+static void shm_send_record(T rtsp, const ab_shm_ring_record_t *record) {
+    // the writer restarted or we were overrun: resume at a key frame
+    if (record->discontinuity)
+        rtsp->shm_wait_key = true;
+    if (0 == record->len)
+        return;
+    if (rtsp->shm_wait_key) {
+        if (!ab_nalu_is_key(rtsp->video_codec, record->data, record->len))
+            return;
+        rtsp->shm_wait_key = false;
+        shm_update_clock(rtsp, record->timestamp, true);
+    } else {
+        shm_update_clock(rtsp, record->timestamp, false);
+    }
+
+    // in place: the packetizer reads the shared memory directly
+    rtsp->ingest_us = monotonic_us();
+    add_counter(rtsp, AB_RTSP_COUNTER_INGEST_BYTES, record->len);
+    rtp_send_nalu(rtsp, record->data, record->len);
+    if (record->flags & AB_SHM_RING_FRAME_END)
+        rtp_end_access_unit(rtsp);
+}
+
+static void shm_source_cb(const ab_shm_ring_record_t *record, void *user_data) {
+    T rtsp = (T) user_data;
+
+    pthread_mutex_lock(&rtsp->ingest_mutex);
+    shm_send_record(rtsp, record);
+    pthread_mutex_unlock(&rtsp->ingest_mutex);
+}
+
+int ab_rtsp_server_set_shm_ingest(T rtsp, const char *name) {
+    assert(rtsp);
+
+    // swapped under ingest_mutex, joined outside it: the receiving thread
+    // takes it to send
+    pthread_mutex_lock(&rtsp->ingest_mutex);
+    ab_shm_source_t source = rtsp->shm_source;
+    rtsp->shm_source = NULL;
+    pthread_mutex_unlock(&rtsp->ingest_mutex);
+    if (source)
+        ab_shm_source_close(&source);
+
+    // the packetizer reads the clock state under ingest_mutex
+    pthread_mutex_lock(&rtsp->ingest_mutex);
+    rtsp->shm_clock     = NULL != name;
+    rtsp->shm_started   = false;
+    rtsp->shm_wait_key  = true;
+    pthread_mutex_unlock(&rtsp->ingest_mutex);
+    if (NULL == name)
+        return 0;
+
+    source = ab_shm_source_open(name, shm_source_cb, rtsp);
+    pthread_mutex_lock(&rtsp->ingest_mutex);
+    rtsp->shm_source = source;
+    pthread_mutex_unlock(&rtsp->ingest_mutex);
+    return 0;
+}
+
+int ab_rtsp_server_set_packet_ring(T rtsp, const char *name, unsigned int size) {
+    assert(rtsp);
+
+    // the packetizer and the relay write through it under ingest_mutex
+    pthread_mutex_lock(&rtsp->ingest_mutex);
+    if (rtsp->packet_ring)
+        ab_shm_ring_close(&rtsp->packet_ring);
+    if (name) {
+        rtsp->packet_ring = ab_shm_ring_create(name, size);
+        rtsp->packet_ring_frame_start   = true;
+        rtsp->packet_ring_in_frame      = false;
+    }
+    int result = NULL == name || rtsp->packet_ring ? 0 : -1;
+    pthread_mutex_unlock(&rtsp->ingest_mutex);
+
+    return result;
+}
+
+static void ring_send_record(T rtsp, const ab_shm_ring_record_t *record) {
+    // the ingest process restarted or we were overrun: resume at a key frame,
+    // numbering on from what our viewers have already seen
+    bool restart = record->discontinuity;
+    if (restart)
+        rtsp->ring_wait_key = true;
+    if (rtsp->ring_wait_key) {
+        if (!(record->flags & AB_SHM_RING_KEY))
+            return;
+        rtsp->ring_wait_key = false;
+        restart = true;
+    }
+
+    if (record->len > 0)
+        relay_send(rtsp, record->data, record->len, record->timestamp, restart);
+    if ((record->flags & AB_SHM_RING_FRAME_END) && rtsp->relay_in_frame)
+        relay_end_frame(rtsp);
+}
+
+static void ring_source_cb(const ab_shm_ring_record_t *record, void *user_data) {
+    T rtsp = (T) user_data;
+
+    pthread_mutex_lock(&rtsp->ingest_mutex);
+    ring_send_record(rtsp, record);
+    pthread_mutex_unlock(&rtsp->ingest_mutex);
+}
+
+int ab_rtsp_server_set_packet_ring_ingest(T rtsp, const char *name) {
+    assert(rtsp);
+
+    // swapped under ingest_mutex, joined outside it: the receiving thread
+    // takes it to send
+    pthread_mutex_lock(&rtsp->ingest_mutex);
+    ab_shm_source_t source = rtsp->ring_source;
+    rtsp->ring_source = NULL;
+    pthread_mutex_unlock(&rtsp->ingest_mutex);
+    if (source)
+        ab_shm_source_close(&source);
+    if (NULL == name)
+        return 0;
+
+    pthread_mutex_lock(&rtsp->ingest_mutex);
+    rtsp->ring_wait_key = true;
+    pthread_mutex_unlock(&rtsp->ingest_mutex);
+
+    source = ab_shm_source_open(name, ring_source_cb, rtsp);
+    pthread_mutex_lock(&rtsp->ingest_mutex);
+    rtsp->ring_source = source;
+    pthread_mutex_unlock(&rtsp->ingest_mutex);
+    return 0;
+}
@@ -0,0 +1,259 @@
+/*
+ * ab_rtsp_metrics.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE                     // memmem
+#endif
+
+#include "ab_rtsp_metrics.h"
+
+#include "ab_base/ab_assert.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define METRICS_PATH    "/metrics"
+
+typedef struct ab_metrics_writer_t {
+    char           *buf;
+    unsigned int    size;
+    unsigned int    len;
+    bool            overflow;
+} ab_metrics_writer_t;
+
+typedef struct ab_metric_t {
+    const char     *name;
+    const char     *type;
+    const char     *help;
+    size_t          offset;
+} ab_metric_t;
+
+// uint64_t fields of ab_rtsp_stats_t
+static const ab_metric_t counters[] = {
+    { "ab_rtsp_ingest_bytes_total", "counter", "Video bytes pushed into the server.",
+        offsetof(ab_rtsp_stats_t, ingest_bytes) },
+    { "ab_rtsp_nal_units_total", "counter", "Video NAL units ingested.",
+        offsetof(ab_rtsp_stats_t, nal_units) },
+    { "ab_rtsp_frames_total", "counter", "Video access units ingested.",
+        offsetof(ab_rtsp_stats_t, frames) },
+    { "ab_rtsp_key_frames_total", "counter", "Video access units with an IDR/IRAP slice.",
+        offsetof(ab_rtsp_stats_t, key_frames) },
+    { "ab_rtsp_audio_bytes_total", "counter", "ADTS bytes pushed into the server.",
+        offsetof(ab_rtsp_stats_t, audio_bytes) },
+    { "ab_rtsp_audio_frames_total", "counter", "AAC access units ingested.",
+        offsetof(ab_rtsp_stats_t, audio_frames) },
+    { "ab_rtsp_rtp_packets_total", "counter", "Video RTP packets produced.",
+        offsetof(ab_rtsp_stats_t, rtp_packets) },
+    { "ab_rtsp_rtp_bytes_total", "counter", "Video RTP bytes produced.",
+        offsetof(ab_rtsp_stats_t, rtp_bytes) },
+    { "ab_rtsp_audio_packets_total", "counter", "Audio RTP packets produced.",
+        offsetof(ab_rtsp_stats_t, audio_packets) },
+    { "ab_rtsp_fec_packets_total", "counter", "FEC packets produced.",
+        offsetof(ab_rtsp_stats_t, fec_packets) },
+    { "ab_rtsp_sent_packets_total", "counter", "Packets sent to viewers.",
+        offsetof(ab_rtsp_stats_t, sent_packets) },
+    { "ab_rtsp_sent_bytes_total", "counter", "Bytes sent to viewers.",
+        offsetof(ab_rtsp_stats_t, sent_bytes) },
+    { "ab_rtsp_send_errors_total", "counter", "Failed sends to viewers.",
+        offsetof(ab_rtsp_stats_t, send_errors) },
+    { "ab_rtsp_dropped_packets_total", "counter", "Packets dropped for congested viewers.",
+        offsetof(ab_rtsp_stats_t, dropped_packets) },
+    { "ab_rtsp_accepted_total", "counter", "RTSP connections accepted.",
+        offsetof(ab_rtsp_stats_t, accepted) },
+    { "ab_rtsp_rtcp_reports_total", "counter", "RTCP reports received.",
+        offsetof(ab_rtsp_stats_t, rtcp_reports) },
+};
+
+// unsigned int fields of ab_rtsp_stats_t
+static const ab_metric_t gauges[] = {
+    { "ab_rtsp_connections", "gauge", "Open RTSP connections.",
+        offsetof(ab_rtsp_stats_t, connections) },
+    { "ab_rtsp_viewers", "gauge", "Connections past PLAY.",
+        offsetof(ab_rtsp_stats_t, viewers) },
+    { "ab_rtsp_pacer_queue", "gauge", "Packets waiting in the pacer.",
+        offsetof(ab_rtsp_stats_t, pacer_queue) },
+};
+
+enum ab_track_metric_id_t {
+    TRACK_PACKETS = 0,
+    TRACK_BYTES,
+    TRACK_FRACTION_LOST,
+    TRACK_PACKETS_LOST,
+    TRACK_JITTER,
+    TRACK_RTT,
+    TRACK_METRIC_COUNT
+};
+
+static const ab_metric_t track_metrics[TRACK_METRIC_COUNT] = {
+    { "ab_rtsp_viewer_packets_total", "counter", "Packets sent to the viewer.", 0 },
+    { "ab_rtsp_viewer_bytes_total", "counter", "Bytes sent to the viewer.", 0 },
+    { "ab_rtsp_viewer_fraction_lost", "gauge",
+        "Loss in the last RTCP report interval, 0 to 1.", 0 },
+    { "ab_rtsp_viewer_packets_lost", "gauge", "Cumulative loss from RTCP reports.", 0 },
+    { "ab_rtsp_viewer_jitter", "gauge", "Interarrival jitter, RTP timestamp units.", 0 },
+    { "ab_rtsp_viewer_rtt_seconds", "gauge", "Round trip time from RTCP SR/RR.", 0 },
+};
+
+static const char *track_names[] = { "video", "audio" };
+
+static const ab_metric_t latency_metric = { "ab_rtsp_latency_seconds", "summary",
+    "Ingest call to packetizer output (packetize), to the last viewer's send (send), "
+    "and end to end (total).", 0 };
+
+static void append(ab_metrics_writer_t *writer, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+void append(ab_metrics_writer_t *writer, const char *fmt, ...) {
+    if (writer->overflow)
+        return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(writer->buf + writer->len, writer->size - writer->len, fmt, ap);
+    va_end(ap);
+
+    if (len < 0 || (unsigned int) len >= writer->size - writer->len)
+        writer->overflow = true;
+    else
+        writer->len += len;
+}
+
+static void append_header(ab_metrics_writer_t *writer, const ab_metric_t *metric) {
+    append(writer, "# HELP %s %s\n# TYPE %s %s\n",
+        metric->name, metric->help, metric->name, metric->type);
+}
+
+static void append_latency(ab_metrics_writer_t *writer, const char *track,
+    const char *stage, const ab_histogram_summary_t *summary) {
+    const char *name = latency_metric.name;
+    append(writer, "%s{track=\"%s\",stage=\"%s\",quantile=\"0.5\"} %g\n",
+        name, track, stage, summary->p50 / 1e6);
+    append(writer, "%s{track=\"%s\",stage=\"%s\",quantile=\"0.99\"} %g\n",
+        name, track, stage, summary->p99 / 1e6);
+    append(writer, "%s{track=\"%s\",stage=\"%s\",quantile=\"0.999\"} %g\n",
+        name, track, stage, summary->p999 / 1e6);
+    append(writer, "%s_sum{track=\"%s\",stage=\"%s\"} %g\n",
+        name, track, stage, summary->sum / 1e6);
+    append(writer, "%s_count{track=\"%s\",stage=\"%s\"} %" PRIu64 "\n",
+        name, track, stage, summary->count);
+}
+
+static void append_track_value(ab_metrics_writer_t *writer, int id,
+    const ab_rtsp_track_stats_t *track) {
+    switch (id) {
+    case TRACK_PACKETS:
+        append(writer, "%" PRIu64 "\n", track->packets);
+        break;
+    case TRACK_BYTES:
+        append(writer, "%" PRIu64 "\n", track->bytes);
+        break;
+    case TRACK_FRACTION_LOST:
+        append(writer, "%g\n", track->fraction_lost / 256.0);
+        break;
+    case TRACK_PACKETS_LOST:
+        append(writer, "%" PRId32 "\n", track->cumulative_lost);
+        break;
+    case TRACK_JITTER:
+        append(writer, "%" PRIu32 "\n", track->jitter);
+        break;
+    default:
+        append(writer, "%g\n", track->rtt_us / 1e6);
+        break;
+    }
+}
+
+int ab_rtsp_metrics_render(const ab_rtsp_stats_t *stats,
+    const ab_rtsp_viewer_stats_t *viewers, unsigned int viewer_count,
+    char *buf, unsigned int buf_size) {
+    assert(stats);
+    assert(viewers || 0 == viewer_count);
+    assert(buf && buf_size > 0);
+
+    ab_metrics_writer_t writer = { buf, buf_size, 0, false };
+
+    for (unsigned int i = 0; i < sizeof(counters) / sizeof(counters[0]); ++i) {
+        append_header(&writer, &counters[i]);
+        append(&writer, "%s %" PRIu64 "\n", counters[i].name,
+            *(const uint64_t *) ((const char *) stats + counters[i].offset));
+    }
+    for (unsigned int i = 0; i < sizeof(gauges) / sizeof(gauges[0]); ++i) {
+        append_header(&writer, &gauges[i]);
+        append(&writer, "%s %u\n", gauges[i].name,
+            *(const unsigned int *) ((const char *) stats + gauges[i].offset));
+    }
+
+    append_header(&writer, &latency_metric);
+    for (int t = 0; t < 2; ++t) {
+        const ab_rtsp_latency_stats_t *latency = &stats->latency[t];
+        append_latency(&writer, track_names[t], "packetize", &latency->packetize);
+        append_latency(&writer, track_names[t], "send", &latency->send);
+        append_latency(&writer, track_names[t], "total", &latency->total);
+    }
+
+    for (int id = 0; id < TRACK_METRIC_COUNT; ++id) {
+        append_header(&writer, &track_metrics[id]);
+        for (unsigned int i = 0; i < viewer_count; ++i) {
+            for (int t = 0; t < 2; ++t) {
+                const ab_rtsp_track_stats_t *track = &viewers[i].tracks[t];
+                if (!track->setup)
+                    continue;
+                append(&writer, "%s{viewer=\"%s:%hu\",transport=\"%s\",track=\"%s\"} ",
+                    track_metrics[id].name, viewers[i].addr, viewers[i].port,
+                    viewers[i].tcp ? "tcp" : "udp", track_names[t]);
+                append_track_value(&writer, id, track);
+            }
+        }
+    }
+
+    return writer.overflow ? -1 : (int) writer.len;
+}
+
+int ab_rtsp_metrics_parse_request(const char *data, unsigned int len) {
+    assert(data || 0 == len);
+
+    // the request line is all we need, but read the headers off the socket
+    const char *end = memmem(data, len, "\r\n\r\n", 4);
+    if (NULL == end)
+        end = memmem(data, len, "\n\n", 2);
+    if (NULL == end)
+        return AB_RTSP_METRICS_NEED_MORE;
+
+    if (len < 4 || memcmp(data, "GET ", 4) != 0)
+        return AB_RTSP_METRICS_BAD_REQUEST;
+
+    const char *path = data + 4;
+    unsigned int path_len = strlen(METRICS_PATH);
+    if ((unsigned int) (end - path) > path_len &&
+        memcmp(path, METRICS_PATH, path_len) == 0 &&
+        (' ' == path[path_len] || '?' == path[path_len]))
+        return AB_RTSP_METRICS_GET;
+    return AB_RTSP_METRICS_NOT_FOUND;
+}
+
+int ab_rtsp_metrics_http_header(int status, unsigned int body_len,
+    char *buf, unsigned int buf_size) {
+    assert(buf);
+
+    const char *status_line = "200 OK";
+    if (AB_RTSP_METRICS_NOT_FOUND == status)
+        status_line = "404 Not Found";
+    else if (status != AB_RTSP_METRICS_GET)
+        status_line = "400 Bad Request";
+
+    int len = snprintf(buf, buf_size,
+        "HTTP/1.0 %s\r\n"
+        "Content-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: %u\r\n"
+        "Connection: close\r\n"
+        "\r\n", status_line, body_len);
+    if (len < 0 || (unsigned int) len >= buf_size)
+        return -1;
+    return len;
+}
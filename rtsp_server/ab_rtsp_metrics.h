@@ -0,0 +1,49 @@
+/*
+ * ab_rtsp_metrics.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_RTSP_METRICS_H_
+#define AB_RTSP_METRICS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ab_rtsp_server.h"
+
+enum ab_rtsp_metrics_request_t {
+    AB_RTSP_METRICS_NEED_MORE = 0,
+    AB_RTSP_METRICS_GET,                // GET /metrics
+    AB_RTSP_METRICS_NOT_FOUND,          // other path
+    AB_RTSP_METRICS_BAD_REQUEST
+};
+
+/*
+ * data: 目前收到的HTTP请求，只看请求行，等到头部结束
+ * return: @ab_rtsp_metrics_request_t
+ */
+extern int  ab_rtsp_metrics_parse_request(const char *data, unsigned int len);
+
+/*
+ * Prometheus文本格式(0.0.4)，观看端的指标带viewer/transport/track标签
+ * return: 写入的长度，buf不够时返回-1
+ */
+extern int  ab_rtsp_metrics_render(const ab_rtsp_stats_t *stats,
+    const ab_rtsp_viewer_stats_t *viewers, unsigned int viewer_count,
+    char *buf, unsigned int buf_size);
+
+/*
+ * HTTP/1.0响应头，之后关闭连接
+ * status: @ab_rtsp_metrics_request_t
+ */
+extern int  ab_rtsp_metrics_http_header(int status, unsigned int body_len,
+    char *buf, unsigned int buf_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_RTSP_METRICS_H_
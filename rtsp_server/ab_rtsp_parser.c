@@ -0,0 +1,296 @@
+/*
+ * ab_rtsp_parser.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_rtsp_parser.h"
+
+#include "ab_base/ab_mem.h"
+#include "ab_base/ab_assert.h"
+
+#include <string.h>
+#include <strings.h>
+
+#define T ab_rtsp_parser_t
+
+struct T {
+    char           *data;
+    unsigned int    size;
+    unsigned int    head;               // first unconsumed byte
+    unsigned int    tail;               // end of received data
+    unsigned int    scan;               // header end searched up to, from head
+    unsigned int    skip;               // rest of an oversized interleaved frame
+};
+
+T ab_rtsp_parser_new(unsigned int buffer_size) {
+    assert(buffer_size > 0);
+
+    T parser;
+    NEW0(parser);
+
+    parser->size = buffer_size;
+    parser->data = ALLOC(buffer_size);
+
+    return parser;
+}
+
+void ab_rtsp_parser_free(T *parser) {
+    assert(parser && *parser);
+
+    FREE((*parser)->data);
+    FREE(*parser);
+}
+
+char *ab_rtsp_parser_buffer(T parser, unsigned int *space) {
+    assert(parser);
+    assert(space);
+
+    if (parser->head > 0) {
+        parser->tail -= parser->head;
+        memmove(parser->data, parser->data + parser->head, parser->tail);
+        parser->head = 0;
+    }
+
+    *space = parser->size - parser->tail;
+    return parser->data + parser->tail;
+}
+
+void ab_rtsp_parser_commit(T parser, unsigned int len) {
+    assert(parser);
+    assert(parser->tail + len <= parser->size);
+
+    parser->tail += len;
+}
+
+static void trim(ab_rtsp_slice_t *slice) {
+    while (slice->len > 0 &&
+        (' ' == slice->data[0] || '\t' == slice->data[0])) {
+        ++slice->data;
+        --slice->len;
+    }
+    while (slice->len > 0 &&
+        (' ' == slice->data[slice->len - 1] || '\t' == slice->data[slice->len - 1]))
+        --slice->len;
+}
+
+/*
+ * return: 十进制数值，格式错误返回-1
+ */
+static long slice_to_long(const ab_rtsp_slice_t *slice) {
+    if (0 == slice->len || slice->len > 9)
+        return -1;
+
+    long value = 0;
+    for (unsigned int i = 0; i < slice->len; ++i) {
+        if (slice->data[i] < '0' || slice->data[i] > '9')
+            return -1;
+        value = value * 10 + (slice->data[i] - '0');
+    }
+    return value;
+}
+
+/*
+ * return: "\r\n\r\n"的位置，没有时返回-1
+ */
+static int find_header_end(const char *data, unsigned int len, unsigned int from) {
+    unsigned int i = from;
+    while (i + 3 < len) {
+        const char *lf = memchr(data + i + 1, '\n', len - i - 1);
+        if (NULL == lf)
+            break;
+
+        unsigned int pos = lf - data;
+        if (pos + 2 < len && '\r' == data[pos - 1] &&
+            '\r' == data[pos + 1] && '\n' == data[pos + 2])
+            return pos - 1;
+        i = pos;
+    }
+
+    return -1;
+}
+
+static int parse_start_line(const char *line, unsigned int len,
+    ab_rtsp_message_t *msg) {
+    unsigned int pos = 0;
+    for (int i = 0; i < 3; ++i) {
+        while (pos < len && ' ' == line[pos])
+            ++pos;
+
+        unsigned int begin = pos;
+        // the reason phrase of a response may contain spaces
+        while (pos < len && (' ' != line[pos] || 2 == i))
+            ++pos;
+
+        if (pos == begin)
+            return -1;
+
+        msg->start[i].data  = line + begin;
+        msg->start[i].len   = pos - begin;
+    }
+
+    return 0;
+}
+
+/*
+ * header: 起始行到最后一个头域的"\r\n"
+ */
+static int parse_header(const char *header, unsigned int len,
+    ab_rtsp_message_t *msg) {
+    const char *eol = memchr(header, '\r', len);
+    if (NULL == eol || parse_start_line(header, eol - header, msg) < 0)
+        return -1;
+
+    msg->header_count   = 0;
+    msg->cseq           = -1;
+
+    unsigned int pos = eol - header + 2;
+    while (pos < len) {
+        const char *line = header + pos;
+        eol = memchr(line, '\r', len - pos);
+        unsigned int line_len = eol ? (unsigned int) (eol - line) : len - pos;
+        pos += line_len + 2;
+
+        const char *colon = memchr(line, ':', line_len);
+        // folded or malformed lines carry nothing we use
+        if (NULL == colon || ' ' == line[0] || '\t' == line[0])
+            continue;
+
+        ab_rtsp_header_field_t field;
+        field.name.data     = line;
+        field.name.len      = colon - line;
+        field.value.data    = colon + 1;
+        field.value.len     = line_len - field.name.len - 1;
+        trim(&field.name);
+        trim(&field.value);
+
+        if (ab_rtsp_slice_equal(&field.name, "CSeq"))
+            msg->cseq = slice_to_long(&field.value);
+
+        if (msg->header_count < AB_RTSP_PARSER_MAX_HEADERS)
+            msg->headers[msg->header_count++] = field;
+    }
+
+    return 0;
+}
+
+int ab_rtsp_parser_next(T parser, ab_rtsp_message_t *msg) {
+    assert(parser);
+    assert(msg);
+
+    for (;;) {
+        if (parser->skip > 0) {
+            unsigned int n = parser->tail - parser->head;
+            if (n > parser->skip)
+                n = parser->skip;
+            parser->head += n;
+            parser->skip -= n;
+            if (parser->skip > 0)
+                return AB_RTSP_PARSE_NEED_MORE;
+        }
+
+        const char *data = parser->data + parser->head;
+        unsigned int avail = parser->tail - parser->head;
+        if (0 == avail)
+            return AB_RTSP_PARSE_NEED_MORE;
+
+        if ('$' == data[0]) {
+            if (avail < 4)
+                return AB_RTSP_PARSE_NEED_MORE;
+
+            unsigned int frame_len = 4 +
+                (((unsigned char) data[2] << 8) | (unsigned char) data[3]);
+            if (frame_len > parser->size) {
+                // bigger than we can ever hold, nobody here wants it
+                parser->skip = frame_len;
+                continue;
+            }
+            if (avail < frame_len)
+                return AB_RTSP_PARSE_NEED_MORE;
+
+            msg->channel        = data[1];
+            msg->payload.data   = data + 4;
+            msg->payload.len    = frame_len - 4;
+            parser->head       += frame_len;
+            parser->scan        = 0;
+            return AB_RTSP_PARSE_INTERLEAVED;
+        }
+
+        // empty lines between messages are allowed
+        if ('\r' == data[0] || '\n' == data[0]) {
+            ++parser->head;
+            continue;
+        }
+
+        int end = find_header_end(data, avail, parser->scan);
+        if (end < 0) {
+            if (parser->head == 0 && parser->tail == parser->size)
+                return AB_RTSP_PARSE_ERROR;
+            // restart just before the tail, the terminator may be split
+            parser->scan = avail > 3 ? avail - 3 : 0;
+            return AB_RTSP_PARSE_NEED_MORE;
+        }
+        parser->scan = end;
+
+        if (parse_header(data, end + 2, msg) < 0)
+            return AB_RTSP_PARSE_ERROR;
+
+        long content_length = 0;
+        const ab_rtsp_slice_t *value = ab_rtsp_message_header(msg, "Content-Length");
+        if (value) {
+            content_length = slice_to_long(value);
+            if (content_length < 0)
+                return AB_RTSP_PARSE_ERROR;
+        }
+
+        unsigned int message_len = end + 4 + content_length;
+        if (message_len > parser->size)
+            return AB_RTSP_PARSE_ERROR;
+        if (avail < message_len)
+            return AB_RTSP_PARSE_NEED_MORE;
+
+        msg->body.data  = data + end + 4;
+        msg->body.len   = content_length;
+        msg->channel    = 0;
+        msg->payload.data = NULL;
+        msg->payload.len = 0;
+
+        parser->head   += message_len;
+        parser->scan    = 0;
+        return AB_RTSP_PARSE_MESSAGE;
+    }
+}
+
+const ab_rtsp_slice_t *ab_rtsp_message_header(
+    const ab_rtsp_message_t *msg, const char *name) {
+    assert(msg);
+    assert(name);
+
+    for (unsigned int i = 0; i < msg->header_count; ++i) {
+        if (ab_rtsp_slice_equal(&msg->headers[i].name, name))
+            return &msg->headers[i].value;
+    }
+
+    return NULL;
+}
+
+bool ab_rtsp_slice_equal(const ab_rtsp_slice_t *slice, const char *str) {
+    assert(slice);
+    assert(str);
+
+    unsigned int len = strlen(str);
+    return slice->len == len && 0 == strncasecmp(slice->data, str, len);
+}
+
+char *ab_rtsp_slice_copy(const ab_rtsp_slice_t *slice,
+    char *buf, unsigned int buf_size) {
+    assert(slice);
+    assert(buf && buf_size > 0);
+
+    unsigned int len = slice->len < buf_size - 1 ? slice->len : buf_size - 1;
+    memcpy(buf, slice->data, len);
+    buf[len] = '\0';
+
+    return buf;
+}
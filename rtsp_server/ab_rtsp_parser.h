@@ -0,0 +1,103 @@
+/*
+ * ab_rtsp_parser.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_RTSP_PARSER_H_
+#define AB_RTSP_PARSER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+#define AB_RTSP_PARSER_MAX_HEADERS  32
+
+enum ab_rtsp_parse_result_t {
+    AB_RTSP_PARSE_ERROR = -1,           // 格式错误或消息超过缓冲区，应关闭连接
+    AB_RTSP_PARSE_NEED_MORE = 0,        // 数据不完整，继续接收
+    AB_RTSP_PARSE_MESSAGE,              // 一个完整的请求(或响应)
+    AB_RTSP_PARSE_INTERLEAVED           // '$'开头的interleaved帧
+};
+
+/*
+ * 指向接收缓冲区的片段，不以'\0'结尾
+ */
+typedef struct ab_rtsp_slice_t {
+    const char     *data;
+    unsigned int    len;
+} ab_rtsp_slice_t;
+
+typedef struct ab_rtsp_header_field_t {
+    ab_rtsp_slice_t name;
+    ab_rtsp_slice_t value;              // 已去掉首尾空白
+} ab_rtsp_header_field_t;
+
+typedef struct ab_rtsp_message_t {
+    // 请求: method url version；响应: version status reason
+    ab_rtsp_slice_t start[3];
+    ab_rtsp_header_field_t headers[AB_RTSP_PARSER_MAX_HEADERS];
+    unsigned int    header_count;       // 超出的头域被忽略
+    int             cseq;               // 没有CSeq时为-1
+    ab_rtsp_slice_t body;               // Content-Length指定的消息体
+
+    unsigned char   channel;            // interleaved帧的通道号
+    ab_rtsp_slice_t payload;            // interleaved帧的数据
+} ab_rtsp_message_t;
+
+#define ab_rtsp_message_method(msg)     (&(msg)->start[0])
+#define ab_rtsp_message_url(msg)        (&(msg)->start[1])
+#define ab_rtsp_message_version(msg)    (&(msg)->start[2])
+
+/*
+ * 每个连接一个的增量解析器，处理分段、流水线(pipelining)请求及interleaved帧
+ */
+#define T ab_rtsp_parser_t
+typedef struct T *T;
+
+/*
+ * buffer_size: 单个消息的最大长度，超过的interleaved帧被丢弃
+ */
+extern T    ab_rtsp_parser_new(unsigned int buffer_size);
+extern void ab_rtsp_parser_free(T *parser);
+
+/*
+ * 返回可写入接收数据的位置，space为剩余空间；
+ * 会整理缓冲区，之前解析得到的片段随之失效
+ */
+extern char *ab_rtsp_parser_buffer(T parser, unsigned int *space);
+extern void ab_rtsp_parser_commit(T parser, unsigned int len);
+
+/*
+ * 取出下一个完整的消息或interleaved帧，片段在下次调用
+ * ab_rtsp_parser_buffer前有效
+ * return: @ab_rtsp_parse_result_t
+ */
+extern int  ab_rtsp_parser_next(T parser, ab_rtsp_message_t *msg);
+
+/*
+ * 头域名不区分大小写，不存在时返回NULL
+ */
+extern const ab_rtsp_slice_t *ab_rtsp_message_header(
+    const ab_rtsp_message_t *msg, const char *name);
+
+/*
+ * 不区分大小写
+ */
+extern bool ab_rtsp_slice_equal(const ab_rtsp_slice_t *slice, const char *str);
+/*
+ * 拷贝为'\0'结尾的字符串，超长时截断
+ */
+extern char *ab_rtsp_slice_copy(const ab_rtsp_slice_t *slice,
+    char *buf, unsigned int buf_size);
+
+#undef T
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_RTSP_PARSER_H_
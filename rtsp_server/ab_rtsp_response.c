@@ -0,0 +1,91 @@
+/*
+ * ab_rtsp_response.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_rtsp_response.h"
+
+#include "ab_base/ab_mem.h"
+#include "ab_base/ab_assert.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+void ab_rtsp_response_init(ab_rtsp_response_t *response,
+    const char *status, const char *tail_fmt, ...) {
+    assert(response);
+    assert(status && tail_fmt);
+
+    char head[64];
+    int head_len = snprintf(head, sizeof(head), "RTSP/1.0 %s\r\nCSeq: ", status);
+    assert(head_len > 0 && head_len < (int) sizeof(head));
+
+    va_list ap;
+    va_start(ap, tail_fmt);
+    int tail_len = vsnprintf(NULL, 0, tail_fmt, ap);
+    va_end(ap);
+    assert(tail_len >= 0);
+
+    response->data      = ALLOC(head_len + tail_len + 1);
+    response->head_len  = head_len;
+    response->len       = head_len + tail_len;
+
+    memcpy(response->data, head, head_len);
+    va_start(ap, tail_fmt);
+    vsnprintf(response->data + head_len, tail_len + 1, tail_fmt, ap);
+    va_end(ap);
+}
+
+void ab_rtsp_response_clear(ab_rtsp_response_t *response) {
+    assert(response);
+
+    if (response->data)
+        FREE(response->data);
+    response->head_len  = 0;
+    response->len       = 0;
+}
+
+static unsigned int format_uint(char *buf, unsigned int value) {
+    char digits[10];
+    unsigned int n = 0;
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    for (unsigned int i = 0; i < n; ++i)
+        buf[i] = digits[n - 1 - i];
+    return n;
+}
+
+unsigned int ab_rtsp_response_render(const ab_rtsp_response_t *response,
+    char *buf, unsigned int buf_size, unsigned int cseq,
+    const char *session, unsigned int session_len) {
+    assert(response && response->data);
+    assert(buf);
+
+    if (NULL == session)
+        session_len = 0;
+    // 10 digits + "\r\n"
+    if (response->len + 12 + session_len > buf_size)
+        return 0;
+
+    unsigned int pos = response->head_len;
+    memcpy(buf, response->data, pos);
+    pos += format_uint(buf + pos, cseq);
+    buf[pos++] = '\r';
+    buf[pos++] = '\n';
+    if (session_len > 0) {
+        memcpy(buf + pos, session, session_len);
+        pos += session_len;
+    }
+
+    unsigned int tail_len = response->len - response->head_len;
+    memcpy(buf + pos, response->data + response->head_len, tail_len);
+    pos += tail_len;
+
+    return pos;
+}
@@ -0,0 +1,52 @@
+/*
+ * ab_rtsp_response.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_RTSP_RESPONSE_H_
+#define AB_RTSP_RESPONSE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/*
+ * 预渲染的响应：状态行 + "CSeq: " | CSeq | "\r\n" | Session | 其余头域和消息体
+ * 发送时只写入CSeq和Session
+ */
+typedef struct ab_rtsp_response_t {
+    char           *data;               // 状态行 + "CSeq: " + 其余部分
+    unsigned int    head_len;           // CSeq值之前的长度
+    unsigned int    len;
+} ab_rtsp_response_t;
+
+/*
+ * status: 如"200 OK"
+ * tail_fmt: Session之后的头域和消息体，包括结束的空行
+ */
+extern void ab_rtsp_response_init(ab_rtsp_response_t *response,
+    const char *status, const char *tail_fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+extern void ab_rtsp_response_clear(ab_rtsp_response_t *response);
+
+static inline int ab_rtsp_response_valid(const ab_rtsp_response_t *response) {
+    return response->data != NULL;
+}
+
+/*
+ * session: 完整的Session头域行(含"\r\n")，可为NULL
+ * return: 响应长度，缓冲区不足返回0
+ */
+extern unsigned int ab_rtsp_response_render(const ab_rtsp_response_t *response,
+    char *buf, unsigned int buf_size, unsigned int cseq,
+    const char *session, unsigned int session_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_RTSP_RESPONSE_H_
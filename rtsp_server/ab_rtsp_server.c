@@ -6,11 +6,24 @@
  */
 
 #include "ab_rtsp_server.h"
-#include "ab_rtp_def.h"
+#include "ab_rtsp_server_def.h"
+#include "ab_rtp_pacer.h"
+#include "ab_rtsp_parser.h"
+#include "ab_rtsp_response.h"
+#include "ab_rtsp_session.h"
+#include "ab_rtsp_vod.h"
+#include "ab_rtsp_dvr.h"
+#include "ab_rtsp_timeshift.h"
+#include "ab_udp_source.h"
+#include "ab_shm_source.h"
 
 #include "ab_base/ab_list.h"
 #include "ab_base/ab_mem.h"
 #include "ab_base/ab_assert.h"
+#include "ab_base/ab_base64.h"
+#include "ab_base/ab_timer_wheel.h"
+#include "ab_base/ab_counter.h"
+#include "ab_base/ab_histogram.h"
 
 #include "ab_log/ab_logger.h"
 
@@ -18,6 +31,15 @@
 #include "ab_net/ab_tcp_server.h"
 #include "ab_net/ab_udp_client.h"
 
+#include "ab_rtp/ab_rtp_def.h"
+#include "ab_rtp/ab_rtp_fec.h"
+#include "ab_rtp/ab_rtp_packetizer.h"
+#include "ab_rtp/ab_rtp_aac_packetizer.h"
+#include "ab_rtp/ab_aac.h"
+#include "ab_rtp/ab_nalu.h"
+#include "ab_rtp/ab_sps.h"
+#include "ab_rtp/ab_rtcp.h"
+
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -25,225 +47,631 @@
 #include <pthread.h>
 #include <errno.h>
 #include <unistd.h>
-#include <sys/select.h>
-#include <errno.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
 
 #include <arpa/inet.h>
 
 #define T ab_rtsp_server_t
 
-enum ab_rtsp_over_method_t {
-    AB_RTSP_OVER_NONE = 0,
-    AB_RTSP_OVER_TCP,
-    AB_RTSP_OVER_UDP
-};
+#define RTSP_REQUEST_MAX_SIZE           4096
+#define RTSP_RESPONSE_MAX_SIZE          4096
+#define RTSP_BACKLOG_MAX_SIZE           (256 * 1024)    // unread responses, per viewer
+#define RTSP_SESSION_TIMEOUT            60      // seconds
+#define RTSP_TIMER_TICK_MS              100
+#define RTSP_AUDIO_CACHE_SIZE           (64 * 1024)
+#define RTSP_AUDIO_MAX_AUS              8
+#define RTSP_MAX_EVENTS                 64
+#define RTSP_SR_INTERVAL_MS             5000
+#define RTSP_AUDIO_SSRC                 0x88923424
+#define RTSP_FEC_SSRC                   0x88923425
+#define RTSP_SESSION_TICK_MS            10
+#define RTSP_SESSION_MAX_BURST          8       // frames per session per tick
 
-enum ab_video_codec_t {
-    AB_VIDEO_CODEC_NONE = 0,
-    AB_VIDEO_CODEC_H264,
-    AB_VIDEO_CODEC_H265
+/*
+ * Default socket options per role.
+ * control: RTSP responses may wait for at most the send timeout, media is
+ *          written without waiting; dead peers are dropped once data
+ *          stays unacked
+ * RTP: one socket fans out to every UDP viewer, a key frame burst must
+ *      not block on the send buffer; AF41, and SO_PRIORITY set again since
+ *      IP_TOS alone maps AF41 to the bulk band
+ * RTCP: receiver reports from all viewers
+ */
+static const ab_socket_options_t default_socket_options[AB_SOCKET_ROLE_COUNT] = {
+    [AB_SOCKET_ROLE_CONTROL] = {
+        .mask               = AB_SOCKET_OPT_NODELAY | AB_SOCKET_OPT_SEND_TIMEOUT |
+                              AB_SOCKET_OPT_USER_TIMEOUT,
+        .nodelay            = true,
+        .send_timeout_ms    = 2000,
+        .user_timeout_ms    = 10000,
+    },
+    [AB_SOCKET_ROLE_RTP] = {
+        .mask               = AB_SOCKET_OPT_SEND_BUFFER | AB_SOCKET_OPT_TOS |
+                              AB_SOCKET_OPT_PRIORITY,
+        .send_buffer        = 4 * 1024 * 1024,
+        .tos                = AB_SOCKET_DSCP(AB_SOCKET_DSCP_AF41),
+        .priority           = 6,
+    },
+    [AB_SOCKET_ROLE_RTCP] = {
+        .mask               = AB_SOCKET_OPT_RECV_BUFFER,
+        .recv_buffer        = 1024 * 1024,
+    },
 };
 
-typedef struct ab_rtsp_interleaved_frame_t {
-    uint8_t         dollar_sign;        // '$' or 0x24
-    uint8_t         channel_identifier; // 0x00(Video RTP)、0x01(Video RTCP)、
-                                        // 0x02(Audio RTP)、0x03(Audio RTCP)
-    uint16_t        data_length;        // RTP length
-} ab_rtsp_interleaved_frame_t;
-
-typedef struct ab_buffer_t {
-    unsigned char  *data;
-    int             size;
-    int             used;
-} ab_buffer_t;
-
-typedef struct ab_rtsp_client_t {
-    ab_socket_t     sock;
-    int             video_codec;        // @ab_video_codec_t
-
-    bool            ready;              // 准备就绪为true（收到play)，否则为false
-    int             method;
 
-    unsigned short  rtp_chn_port;
-    unsigned short  rtcp_chn_port;
-
-} ab_rtsp_client_t;
-
-struct T {
-    ab_tcp_server_t rtsp_tcp_srv;
-    list_t          clients;
-
-    ab_udp_client_t rtp_udp_srv;
-    ab_udp_client_t rtcp_udp_srv;
-
-    int             video_codec;        // @ab_video_codec_t
-
-    pthread_mutex_t mutex;
-
-    bool            quit;
-    pthread_t       event_looper_thd;
-
-    uint16_t        sequence;
-    uint32_t        timestamp;
+static void *event_looper_cb(void *arg);
 
-    ab_buffer_t     cache;
-    ab_buffer_t     rtp_buffer;
-};
+static void free_client(ab_rtsp_client_t *client);
+static void close_client(T rtsp, ab_rtsp_client_t *client, const char *reason);
 
-static bool start_code3(const unsigned char *data, unsigned int data_size);
-static bool start_code4(const unsigned char *data, unsigned int data_size);
-static int find_start_code(const unsigned char *data, unsigned int data_size);
+static void accept_func(void *sock, void *user_data);
 
-static void *event_looper_cb(void *arg);
+static void init_responses(ab_rtsp_response_t *responses);
+static void session_packet_cb(unsigned char *rtp, unsigned int rtp_len,
+    const ab_rtp_packet_info_t *info, void *user_data);
 
-static void accept_func(void *sock, void *user_data);
+/*
+ * 水平触发，客户端、监听socket和RTCP共用一个epoll
+ */
+void ab_rtsp_watch_fd(T rtsp, int fd, ab_rtsp_io_t *io) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events    = EPOLLIN;
+    event.data.ptr  = io;
+    if (epoll_ctl(rtsp->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+        AB_LOGGER_ERROR("epoll_ctl(%d) failed, %s.\n", fd, strerror(errno));
+}
 
-static void fill_rtsp_interleave_frame(
-    ab_rtsp_interleaved_frame_t *interleaved_frame, 
-    unsigned short data_len);
+/*
+ * 关闭的fd自动从epoll中移除；槽位不释放，事件循环里过期的事件只会看到NULL
+ */
+static void close_listeners(T rtsp) {
+    for (unsigned int i = 0; i < rtsp->listener_count; ++i)
+        ab_tcp_server_free(&rtsp->listeners[i].tcp_srv);
+    rtsp->listener_count = 0;
+}
 
-static void fill_rtp_header(ab_rtp_header_t *rtp_header, 
-    unsigned int seq, unsigned int timestamp);
+/*
+ * count > 1时每个socket都设置SO_REUSEPORT，内核把新连接分散到各自的accept队列；
+ * worker进程只有一个也要设置，与其他worker共用端口
+ */
+static int open_listeners(T rtsp, unsigned int count, int backlog) {
+    close_listeners(rtsp);
+
+    for (unsigned int i = 0; i < count; ++i) {
+        ab_rtsp_listener_t *listener = &rtsp->listeners[i];
+        listener->tcp_srv = ab_tcp_server_listen(rtsp->port, backlog,
+            count > 1 || rtsp->reuse_port, accept_func, rtsp);
+        if (NULL == listener->tcp_srv)
+            return -1;
+
+        listener->io.kind   = AB_RTSP_IO_LISTENER;
+        listener->io.object = listener;
+        ++rtsp->listener_count;
+        ab_rtsp_watch_fd(rtsp, ab_tcp_server_fd(listener->tcp_srv), &listener->io);
+    }
 
-static void rtp_send_nalu(T rtsp, 
-    const unsigned char *nalu, unsigned int nalu_len);
+    return 0;
+}
 
-T ab_rtsp_server_new(unsigned short port, int video_codec) {
+/*
+ * worker < 0: 单进程
+ */
+static T server_new(unsigned short port, int video_codec, int worker) {
     const unsigned int data_cache_size          = 1024 * 1024;
-    const unsigned int rtp_buffer_size          = 1400;
 
 
     T result;
     NEW(result);
     assert(result);
 
-    result->rtsp_tcp_srv    = ab_tcp_server_new(port, accept_func, result);
+    result->epoll_fd        = epoll_create1(EPOLL_CLOEXEC);
+    assert(result->epoll_fd >= 0);
+
+    result->port            = port;
+    result->reuse_port      = worker >= 0;
+    memset(result->listeners, 0, sizeof(result->listeners));
+    result->listener_count  = 0;
+    if (port != 0) {
+        int ret = open_listeners(result, 1, 0);
+        assert(0 == ret);
+    }
 
-    result->rtp_udp_srv     = ab_udp_client_new(RTP_SERVER_PORT);
-    result->rtcp_udp_srv    = ab_udp_client_new(RTCP_SERVER_PORT);
+    // RTCP from a viewer must reach the worker serving it, so every worker
+    // has its own pair; without a listener nobody SETUPs, any port will do
+    if (0 == port) {
+        result->rtp_server_port     = 0;
+        result->rtcp_server_port    = 0;
+    } else {
+        result->rtp_server_port     = RTP_SERVER_PORT + 2 * (worker > 0 ? worker : 0);
+        result->rtcp_server_port    = RTCP_SERVER_PORT + 2 * (worker > 0 ? worker : 0);
+    }
+    result->rtp_udp_srv     = ab_udp_client_new(result->rtp_server_port);
+    result->rtcp_udp_srv    = ab_udp_client_new(result->rtcp_server_port);
+    memcpy(result->socket_options, default_socket_options,
+        sizeof(result->socket_options));
+    // best effort, e.g. SO_SNDBUF stays clamped to wmem_max without CAP_NET_ADMIN
+    ab_socket_set_options(ab_udp_client_socket(result->rtp_udp_srv),
+        &result->socket_options[AB_SOCKET_ROLE_RTP]);
+    ab_socket_set_options(ab_udp_client_socket(result->rtcp_udp_srv),
+        &result->socket_options[AB_SOCKET_ROLE_RTCP]);
+    result->rtcp_io.kind    = AB_RTSP_IO_RTCP;
+    result->rtcp_io.object  = result->rtcp_udp_srv;
+    ab_rtsp_watch_fd(result, ab_udp_client_fd(result->rtcp_udp_srv), &result->rtcp_io);
 
     result->video_codec     = video_codec;
 
     result->clients         = NULL;
 
+    result->sessions        = ab_rtsp_session_table_new(1024);
+    result->timers          = ab_timer_wheel_new(RTSP_TIMER_TICK_MS);
+    result->session_timeout = RTSP_SESSION_TIMEOUT;
+
+    init_responses(result->responses);
+    memset(&result->describe, 0, sizeof(result->describe));
+    result->describe_url[0] = '\0';
+    result->sdp_session_id  = time(NULL);
+    result->sdp_version     = 1;
+    memset(result->parameter_sets, 0, sizeof(result->parameter_sets));
+    memset(&result->sps_info, 0, sizeof(result->sps_info));
+    result->sps_valid       = false;
+
+    memset(&result->metrics_listener, 0, sizeof(result->metrics_listener));
+    result->metrics_conns   = NULL;
+
+    memset(result->vod_files, 0, sizeof(result->vod_files));
+    result->vod_file_count  = 0;
+    result->dvr             = NULL;
+    result->session_timer_fd    = -1;
+    result->session_io.kind     = AB_RTSP_IO_SESSIONS;
+    result->session_io.object   = result;
+    result->session_timer_armed = false;
+
+    result->counters        = ab_counter_new(AB_RTSP_COUNTER_COUNT);
+    memset(result->clocks, 0, sizeof(result->clocks));
+    result->last_report_ms  = monotonic_ms();
+    for (int i = 0; i < AB_RTSP_TRACK_COUNT; ++i) {
+        for (int j = 0; j < AB_RTSP_LATENCY_COUNT; ++j)
+            result->latency[i][j] = ab_histogram_new();
+    }
+    memset(result->stamps, 0, sizeof(result->stamps));
+    result->ingest_us       = 0;
+    result->audio_ingest_us = 0;
+
     pthread_mutex_init(&result->mutex, NULL);
+    pthread_mutex_init(&result->ingest_mutex, NULL);
+    pthread_mutex_init(&result->audio_mutex, NULL);
 
     result->quit            = false;
     pthread_create(&result->event_looper_thd, NULL, event_looper_cb, result);
 
-    result->sequence        = 0;
+    result->packetizer      = ab_rtp_packetizer_new(video_codec,
+        RTP_PAYLOAD_TYPE_H264, RTSP_VIDEO_SSRC, RTP_MAX_SIZE, ab_rtsp_video_packet_cb, result);
     result->timestamp       = 0;
+    result->frame_duration_num  = 1;
+    result->frame_duration_den  = 25;
+    result->timestamp_remainder = 0;
+    result->au_has_vcl      = false;
+    result->au_key          = false;
+
+    memset(&result->relay_buffer, 0, sizeof(result->relay_buffer));
+    result->relay_started   = false;
+    result->relay_ssrc      = 0;
+    result->relay_seq_offset    = 0;
+    result->relay_next_seq  = 0;
+    result->relay_timestamp_offset  = 0;
+    result->relay_last_timestamp    = 0;
+    result->relay_in_frame  = false;
+    result->udp_source      = NULL;
+
+    result->shm_source      = NULL;
+    result->shm_clock       = false;
+    result->shm_started     = false;
+    result->shm_wait_key    = false;
+    result->shm_timestamp_offset    = 0;
+    result->shm_timestamp   = 0;
+
+    result->packet_ring     = NULL;
+    result->packet_ring_frame_start = true;
+    result->packet_ring_in_frame    = false;
+    result->ring_source     = NULL;
+    result->ring_wait_key   = false;
 
     result->cache.size      = data_cache_size;
     result->cache.used      = 0;
     result->cache.data      = ALLOC(result->cache.size);
 
-    result->rtp_buffer.size = rtp_buffer_size;
-    result->rtp_buffer.used = 0;
-    result->rtp_buffer.data = ALLOC(result->rtp_buffer.size);
+    result->fec_encoder     = NULL;
+    result->fec_idr_group   = 0;
+    result->fec_group       = 0;
+    result->fec_payload_type = 0;
+    memset(&result->fec_buffer, 0, sizeof(result->fec_buffer));
+
+    result->aac_packetizer  = NULL;
+    memset(&result->audio_config, 0, sizeof(result->audio_config));
+    result->audio_timestamp = 0;
+    memset(&result->audio_cache, 0, sizeof(result->audio_cache));
+
+    result->pacer           = NULL;
+    result->own_pacer       = false;
+    result->pacer_stream    = NULL;
+    result->audio_pacer_stream = NULL;
+    memset(result->pacer_queued, 0, sizeof(result->pacer_queued));
+    result->frame_interval_us = 1000000 / 25;
+    result->pacing_percent  = 0;
+
+    result->discard_percent = 25;
+    result->skip_percent    = 50;
 
     return result;
 }
 
+T ab_rtsp_server_new(unsigned short port, int video_codec) {
+    return server_new(port, video_codec, -1);
+}
+
+T ab_rtsp_server_new_worker(unsigned short port, int video_codec, unsigned int worker) {
+    assert(port != 0);
+    assert(worker < AB_RTSP_MAX_WORKERS);
+
+    return server_new(port, video_codec, worker);
+}
+
 void ab_rtsp_server_free(T *rtsp) {
     assert(rtsp && *rtsp);
 
-    FREE((*rtsp)->rtp_buffer.data);
+    // their threads feed the stream like any other ingest
+    if ((*rtsp)->udp_source)
+        ab_udp_source_close(&(*rtsp)->udp_source);
+    if ((*rtsp)->shm_source)
+        ab_shm_source_close(&(*rtsp)->shm_source);
+    if ((*rtsp)->ring_source)
+        ab_shm_source_close(&(*rtsp)->ring_source);
+    if ((*rtsp)->packet_ring)
+        ab_shm_ring_close(&(*rtsp)->packet_ring);
+    ab_rtsp_server_set_pacing(*rtsp, NULL, 0);
+
+    ab_rtp_packetizer_free(&(*rtsp)->packetizer);
     FREE((*rtsp)->cache.data);
+    if ((*rtsp)->relay_buffer.data)
+        FREE((*rtsp)->relay_buffer.data);
+
+    if ((*rtsp)->aac_packetizer) {
+        ab_rtp_aac_packetizer_free(&(*rtsp)->aac_packetizer);
+        FREE((*rtsp)->audio_cache.data);
+    }
+
+    if ((*rtsp)->fec_encoder) {
+        ab_rtp_fec_encoder_free(&(*rtsp)->fec_encoder);
+        FREE((*rtsp)->fec_buffer.data);
+    }
 
     (*rtsp)->quit = true;
     pthread_join((*rtsp)->event_looper_thd, NULL);
 
     pthread_mutex_destroy(&(*rtsp)->mutex);
+    pthread_mutex_destroy(&(*rtsp)->ingest_mutex);
+    pthread_mutex_destroy(&(*rtsp)->audio_mutex);
 
     while ((*rtsp)->clients) {
         ab_rtsp_client_t *client;
         (*rtsp)->clients = list_pop((*rtsp)->clients, (void **) &client);
-        ab_socket_free(&(client->sock));
-        FREE(client);
+        free_client(client);
+    }
+
+    while ((*rtsp)->metrics_conns) {
+        ab_rtsp_metrics_conn_t *conn;
+        (*rtsp)->metrics_conns = list_pop((*rtsp)->metrics_conns, (void **) &conn);
+        ab_rtsp_free_metrics_conn(conn);
+    }
+    if ((*rtsp)->metrics_listener.tcp_srv)
+        ab_tcp_server_free(&(*rtsp)->metrics_listener.tcp_srv);
+
+    // sessions and their timers go with the tables
+    ab_timer_wheel_free(&(*rtsp)->timers);
+    ab_rtsp_session_table_free(&(*rtsp)->sessions);
+
+    for (int i = 0; i < AB_RTSP_RESPONSE_COUNT; ++i)
+        ab_rtsp_response_clear(&(*rtsp)->responses[i]);
+    ab_rtsp_response_clear(&(*rtsp)->describe);
+    for (int i = 0; i < AB_NALU_PARAMETER_SET_COUNT; ++i) {
+        if ((*rtsp)->parameter_sets[i].data)
+            FREE((*rtsp)->parameter_sets[i].data);
     }
 
+    // the sources belong to the caller
+    for (unsigned int i = 0; i < (*rtsp)->vod_file_count; ++i) {
+        ab_rtsp_vod_file_t *file = &(*rtsp)->vod_files[i];
+        ab_rtsp_response_clear(&file->describe);
+        for (int j = 0; j < AB_NALU_PARAMETER_SET_COUNT; ++j) {
+            if (file->parameter_sets[j].data)
+                FREE(file->parameter_sets[j].data);
+        }
+    }
+    if ((*rtsp)->session_timer_fd >= 0)
+        close((*rtsp)->session_timer_fd);
+    if ((*rtsp)->dvr)
+        ab_rtsp_dvr_free(&(*rtsp)->dvr);
+
     ab_udp_client_free(&(*rtsp)->rtcp_udp_srv);
     ab_udp_client_free(&(*rtsp)->rtp_udp_srv);
-    ab_tcp_server_free(&(*rtsp)->rtsp_tcp_srv);
+    close_listeners(*rtsp);
+    close((*rtsp)->epoll_fd);
+
+    ab_counter_free(&(*rtsp)->counters);
+    for (int i = 0; i < AB_RTSP_TRACK_COUNT; ++i) {
+        for (int j = 0; j < AB_RTSP_LATENCY_COUNT; ++j)
+            ab_histogram_free(&(*rtsp)->latency[i][j]);
+    }
 
     FREE(*rtsp);
 }
 
-int ab_rtsp_server_send(T rtsp, const char *data, unsigned int data_len) {
-    int result = 0;
-    if (NULL == data || 0 == data_len) {
-        if (rtsp->cache.used > 0) {
-            int first_start_code_pos = find_start_code(
-                rtsp->cache.data, rtsp->cache.used);
-            if (0 == first_start_code_pos) {
-                unsigned int start_code = 0;
-                if (start_code3(rtsp->cache.data, rtsp->cache.used))
-                    start_code = 3;
-                else if (start_code4(rtsp->cache.data, rtsp->cache.used))
-                    start_code = 4;
-
-                rtp_send_nalu(rtsp, rtsp->cache.data + start_code, 
-                    rtsp->cache.used - start_code);
-                rtsp->cache.used = 0;
-            }
+int ab_rtsp_server_set_fec(T rtsp, int idr_group, int group) {
+    assert(rtsp);
+
+    if (idr_group < 0 || idr_group > AB_RTP_FEC_MAX_GROUP ||
+        group < 0 || group > AB_RTP_FEC_MAX_GROUP)
+        return -1;
+
+    // the encoder is freed under the ingest thread's feet otherwise
+    pthread_mutex_lock(&rtsp->ingest_mutex);
+    if (0 == idr_group && 0 == group) {
+        if (rtsp->fec_encoder) {
+            ab_rtp_fec_encoder_free(&rtsp->fec_encoder);
+            FREE(rtsp->fec_buffer.data);
         }
+    } else if (NULL == rtsp->fec_encoder) {
+        rtsp->fec_encoder       = ab_rtp_fec_encoder_new(RTP_PAYLOAD_TYPE_ULPFEC,
+            RTSP_FEC_SSRC);
+        rtsp->fec_buffer.size   = AB_RTP_FEC_MAX_PACKET_SIZE;
+        rtsp->fec_buffer.used   = 0;
+        rtsp->fec_buffer.data   = ALLOC(rtsp->fec_buffer.size);
+    }
 
-        return result;
+    rtsp->fec_idr_group = idr_group;
+    rtsp->fec_group     = group;
+
+    // the SDP announces the ulpfec payload type, DESCRIBE only holds mutex
+    int payload_type = rtsp->fec_encoder ? RTP_PAYLOAD_TYPE_ULPFEC : 0;
+    pthread_mutex_lock(&rtsp->mutex);
+    if (rtsp->fec_payload_type != payload_type) {
+        rtsp->fec_payload_type = payload_type;
+        ab_rtsp_invalidate_describe(rtsp);
+    }
+    pthread_mutex_unlock(&rtsp->mutex);
+    pthread_mutex_unlock(&rtsp->ingest_mutex);
+
+    return 0;
+}
+
+static void pacer_send_cb(const unsigned char *data, unsigned int data_len,
+    int tag, void *user_data);
+static void free_pacer_stream(T rtsp, ab_rtp_pacer_stream_t *stream, int track);
+
+int ab_rtsp_server_set_pacing(T rtsp, ab_rtp_pacer_t pacer,
+    unsigned int spread_percent) {
+    assert(rtsp);
+
+    if (spread_percent > 100)
+        return -1;
+
+    // the ingest pushes into the streams; freeing one waits for its callbacks
+    pthread_mutex_lock(&rtsp->ingest_mutex);
+    pthread_mutex_lock(&rtsp->audio_mutex);
+    if (rtsp->pacer_stream)
+        free_pacer_stream(rtsp, &rtsp->pacer_stream, AB_RTSP_TRACK_VIDEO);
+    if (rtsp->audio_pacer_stream)
+        free_pacer_stream(rtsp, &rtsp->audio_pacer_stream, AB_RTSP_TRACK_AUDIO);
+    if (rtsp->own_pacer)
+        ab_rtp_pacer_free(&rtsp->pacer);
+    rtsp->pacer     = NULL;
+    rtsp->own_pacer = false;
+
+    rtsp->pacing_percent = spread_percent;
+    if (0 == spread_percent) {
+        pthread_mutex_unlock(&rtsp->audio_mutex);
+        pthread_mutex_unlock(&rtsp->ingest_mutex);
+        return 0;
+    }
+
+    if (NULL == pacer) {
+        pacer           = ab_rtp_pacer_new();
+        rtsp->own_pacer = true;
     }
 
-    if (rtsp->cache.size - rtsp->cache.used >= data_len) {
-        memcpy(rtsp->cache.data + rtsp->cache.used, data, data_len);
-        rtsp->cache.used += data_len;
+    // 1024 packets hold a 1.3 MB frame
+    rtsp->pacer         = pacer;
+    rtsp->pacer_stream  = ab_rtp_pacer_stream_new(pacer, 1024, pacer_send_cb, rtsp);
+    // audio shares the scheduler so both tracks leave in ingest order
+    if (rtsp->aac_packetizer)
+        rtsp->audio_pacer_stream = ab_rtp_pacer_stream_new(pacer, 256,
+            pacer_send_cb, rtsp);
+    pthread_mutex_unlock(&rtsp->audio_mutex);
+    pthread_mutex_unlock(&rtsp->ingest_mutex);
+
+    return 0;
+}
+
+int ab_rtsp_server_set_audio(T rtsp, unsigned int sample_rate,
+    unsigned int channels, unsigned int max_aus) {
+    assert(rtsp);
+
+    if (sample_rate != 0 && (ab_aac_sample_rate_index(sample_rate) < 0 ||
+        channels < 1 || channels > 7 ||
+        max_aus < 1 || max_aus > RTSP_AUDIO_MAX_AUS))
+        return -1;
+
+    // rtsp->pacer belongs to the video ingest, the rest to the audio one
+    pthread_mutex_lock(&rtsp->ingest_mutex);
+    pthread_mutex_lock(&rtsp->audio_mutex);
+    if (0 == sample_rate) {
+        if (rtsp->aac_packetizer) {
+            ab_rtp_aac_packetizer_free(&rtsp->aac_packetizer);
+            FREE(rtsp->audio_cache.data);
+        }
+        if (rtsp->audio_pacer_stream)
+            free_pacer_stream(rtsp, &rtsp->audio_pacer_stream, AB_RTSP_TRACK_AUDIO);
     } else {
-        AB_LOGGER_WARN("Not enough spaces(%u < %u).\n", 
-            rtsp->cache.size, rtsp->cache.used + data_len);
-        return result;
+        if (rtsp->aac_packetizer) {
+            ab_rtp_aac_packetizer_free(&rtsp->aac_packetizer);
+            FREE(rtsp->audio_cache.data);
+        }
+        rtsp->aac_packetizer = ab_rtp_aac_packetizer_new(RTP_PAYLOAD_TYPE_AAC,
+            RTSP_AUDIO_SSRC, RTP_MAX_SIZE, max_aus, ab_rtsp_audio_packet_cb, rtsp);
+        rtsp->audio_cache.size  = RTSP_AUDIO_CACHE_SIZE;
+        rtsp->audio_cache.used  = 0;
+        rtsp->audio_cache.data  = ALLOC(rtsp->audio_cache.size);
+
+        if (rtsp->pacer && NULL == rtsp->audio_pacer_stream)
+            rtsp->audio_pacer_stream = ab_rtp_pacer_stream_new(rtsp->pacer, 256,
+                pacer_send_cb, rtsp);
     }
 
-    result = data_len;
-
-    unsigned int start_pos = 0;
-    while (start_pos < rtsp->cache.used) {
-        int first_start_code_pos = find_start_code(
-            rtsp->cache.data + start_pos, rtsp->cache.used - start_pos);
-        if (0 == first_start_code_pos) {
-            unsigned int start_code = 0;
-            if (start_code3(rtsp->cache.data + start_pos, 
-                rtsp->cache.used - start_pos)) {
-                start_code = 3;
-            } else if (start_code4(rtsp->cache.data + start_pos, 
-                rtsp->cache.used - start_pos)) {
-                start_code = 4;
-            } else {
-                continue;
-            }
+    pthread_mutex_lock(&rtsp->mutex);
+    rtsp->audio_config.object_type  = AB_AAC_OBJECT_TYPE_LC;
+    rtsp->audio_config.sample_rate  = sample_rate;
+    rtsp->audio_config.channels     = channels;
+    ab_rtsp_invalidate_describe(rtsp);
+    pthread_mutex_unlock(&rtsp->mutex);
+    pthread_mutex_unlock(&rtsp->audio_mutex);
+    pthread_mutex_unlock(&rtsp->ingest_mutex);
 
-            int next_start_code_pos =
-                find_start_code(rtsp->cache.data + start_pos + start_code, 
-                    rtsp->cache.used - start_pos - start_code);
-            if (-1 == next_start_code_pos) {
-                if (start_pos != 0) {
-                    rtsp->cache.used -= start_pos;
-                    memcpy(rtsp->cache.data, 
-                        rtsp->cache.data + start_pos, 
-                        rtsp->cache.used);
-                }
-                break;
-            } else {
-                rtp_send_nalu(rtsp, 
-                    rtsp->cache.data + start_pos + start_code, 
-                    next_start_code_pos);
-                start_pos += start_code + next_start_code_pos;
-            }
-        } else {
-            break;
+    return 0;
+}
+
+int ab_rtsp_server_video_info(T rtsp, ab_rtsp_video_info_t *info) {
+    assert(rtsp);
+    assert(info);
+
+    memset(info, 0, sizeof(*info));
+
+    pthread_mutex_lock(&rtsp->mutex);
+    bool valid = rtsp->sps_valid;
+    if (valid) {
+        info->width         = rtsp->sps_info.width;
+        info->height        = rtsp->sps_info.height;
+        info->profile_idc   = rtsp->sps_info.profile_idc;
+        info->level_idc     = rtsp->sps_info.level_idc;
+        info->timing_info   = rtsp->sps_info.time_scale != 0;
+    }
+    info->frame_rate = (double) rtsp->frame_duration_den / rtsp->frame_duration_num;
+    pthread_mutex_unlock(&rtsp->mutex);
+
+    return valid ? 0 : -1;
+}
+
+int ab_rtsp_server_pacing_stats(T rtsp, ab_rtp_pacer_stats_t *stats) {
+    assert(rtsp);
+    assert(stats);
+
+    int result = 0;
+    pthread_mutex_lock(&rtsp->ingest_mutex);
+    if (rtsp->pacer_stream) {
+        ab_rtp_pacer_stream_stats(rtsp->pacer_stream, stats);
+    } else {
+        memset(stats, 0, sizeof(*stats));
+        result = -1;
+    }
+    pthread_mutex_unlock(&rtsp->ingest_mutex);
+
+    return result;
+}
+
+int ab_rtsp_server_set_session_timeout(T rtsp, unsigned int seconds) {
+    assert(rtsp);
+
+    pthread_mutex_lock(&rtsp->mutex);
+    rtsp->session_timeout = seconds;
+    pthread_mutex_unlock(&rtsp->mutex);
+
+    return 0;
+}
+
+int ab_rtsp_server_set_socket_options(T rtsp, int role,
+    const ab_socket_options_t *options) {
+    assert(rtsp);
+    assert(options);
+
+    if (role < 0 || role >= AB_SOCKET_ROLE_COUNT)
+        return -1;
+
+    int result = 0;
+    pthread_mutex_lock(&rtsp->mutex);
+    rtsp->socket_options[role] = *options;
+    if (AB_SOCKET_ROLE_RTP == role) {
+        result = ab_socket_set_options(ab_udp_client_socket(rtsp->rtp_udp_srv),
+            options);
+    } else if (AB_SOCKET_ROLE_RTCP == role) {
+        result = ab_socket_set_options(ab_udp_client_socket(rtsp->rtcp_udp_srv),
+            options);
+    } else {
+        for (list_t node = rtsp->clients; node; node = node->rest) {
+            ab_rtsp_client_t *client = node->first;
+            if (client->sock && ab_socket_set_options(client->sock, options) != 0)
+                result = -1;
+        }
+    }
+    pthread_mutex_unlock(&rtsp->mutex);
+
+    return result;
+}
+
+int ab_rtsp_server_socket_options(T rtsp, int role, ab_socket_options_t *options) {
+    assert(rtsp);
+    assert(options);
+
+    if (role < 0 || role >= AB_SOCKET_ROLE_COUNT)
+        return -1;
+
+    pthread_mutex_lock(&rtsp->mutex);
+    *options = rtsp->socket_options[role];
+    pthread_mutex_unlock(&rtsp->mutex);
+
+    return 0;
+}
+
+int ab_rtsp_server_set_listen(T rtsp, int backlog, unsigned int listeners) {
+    assert(rtsp);
+
+    if (listeners < 1 || listeners > RTSP_MAX_LISTENERS || 0 == rtsp->port)
+        return -1;
+
+    int result = 0;
+    pthread_mutex_lock(&rtsp->mutex);
+    if (listeners == rtsp->listener_count) {
+        for (unsigned int i = 0; i < rtsp->listener_count; ++i) {
+            if (ab_tcp_server_set_backlog(rtsp->listeners[i].tcp_srv, backlog) != 0)
+                result = -1;
         }
+    } else if (open_listeners(rtsp, listeners, backlog) != 0) {
+        AB_LOGGER_ERROR("%u listeners on port %u failed, %s.\n",
+            listeners, rtsp->port, strerror(errno));
+        open_listeners(rtsp, 1, backlog);
+        result = -1;
     }
+    pthread_mutex_unlock(&rtsp->mutex);
 
     return result;
 }
 
+int ab_rtsp_server_set_drop_policy(T rtsp, unsigned int discard_percent,
+    unsigned int skip_percent) {
+    assert(rtsp);
+
+    if (discard_percent > 100 || skip_percent > 100)
+        return -1;
+
+    pthread_mutex_lock(&rtsp->mutex);
+    rtsp->discard_percent   = discard_percent;
+    rtsp->skip_percent      = skip_percent;
+    pthread_mutex_unlock(&rtsp->mutex);
+
+    return 0;
+}
+
 static void get_sock_info(ab_socket_t sock,
     char *buf, unsigned int buf_size) {
     char addr_buf[64];
@@ -263,29 +691,88 @@ static void print_sock_info(ab_socket_t sock, const char *msg) {
     AB_LOGGER_DEBUG("[%s], %s\n", sock_info, msg);
 }
 
-void fill_rtsp_interleave_frame(
+void ab_rtsp_fill_interleaved_frame(
     ab_rtsp_interleaved_frame_t *interleaved_frame, 
-    unsigned short data_len) {
+    uint8_t channel, unsigned short data_len) {
     assert(interleaved_frame);
 
     interleaved_frame->dollar_sign          = 0x24;
-    interleaved_frame->channel_identifier   = 0x0;
+    interleaved_frame->channel_identifier   = channel;
     interleaved_frame->data_length          = htons(data_len);
 }
 
-void fill_rtp_header(ab_rtp_header_t *rtp_header, 
-    unsigned int sequence, unsigned int timestamp) {
-    if (rtp_header) {
-        rtp_header->csrc_len      = 0;
-        rtp_header->extension     = 0;
-        rtp_header->padding       = 0;
-        rtp_header->version       = RTP_VERSION;
-        rtp_header->payload_type  = RTP_PAYLOAD_TYPE_H264;
-        rtp_header->marker        = 0;
-        rtp_header->seq           = htons(sequence);
-        rtp_header->timestamp     = htonl(timestamp);
-        rtp_header->ssrc          = htonl(0x88923423);
-    }
+/*
+ * session已由close_client释放，或随session表一起释放
+ */
+void free_client(ab_rtsp_client_t *client) {
+    if (client->sock)
+        ab_socket_free(&client->sock);
+    if (client->vod)
+        ab_rtsp_vod_free(&client->vod);
+    if (client->timeshift)
+        ab_rtsp_timeshift_free(&client->timeshift);
+    ab_rtsp_parser_free(&client->parser);
+    if (client->backlog.data)
+        FREE(client->backlog.data);
+    FREE(client);
+}
+
+static void release_session(T rtsp, ab_rtsp_client_t *client) {
+    if (NULL == client->session)
+        return;
+
+    if (client->session->timer)
+        ab_timer_wheel_cancel(rtsp->timers, &client->session->timer);
+    ab_rtsp_session_table_remove(rtsp->sessions, &client->session);
+    client->session_line_len = 0;
+}
+
+/*
+ * RTP over TCP: 媒体走RTSP连接，按RTP的TOS/优先级标记
+ */
+static void mark_interleaved_media(T rtsp, ab_rtsp_client_t *client) {
+    const ab_socket_options_t *rtp = &rtsp->socket_options[AB_SOCKET_ROLE_RTP];
+
+    ab_socket_options_t options = *rtp;
+    options.mask &= AB_SOCKET_OPT_TOS | AB_SOCKET_OPT_PRIORITY;
+    if (options.mask)
+        ab_socket_set_options(client->sock, &options);
+}
+
+/*
+ * 关闭连接，事件循环随后把它从clients中删除
+ */
+void close_client(T rtsp, ab_rtsp_client_t *client, const char *reason) {
+    print_sock_info(client->sock, reason);
+    if (client->dropped > 0)
+        AB_LOGGER_DEBUG("%lu packets dropped by congestion.\n", client->dropped);
+
+    client->ready = false;
+    release_session(rtsp, client);
+    ab_socket_free(&client->sock);
+}
+
+static void session_expired_cb(void *arg) {
+    ab_rtsp_client_t *client = (ab_rtsp_client_t *) arg;
+    T rtsp = client->server;
+
+    // the wheel frees the timer after this callback
+    client->session->timer = NULL;
+    close_client(rtsp, client, "session timeout.");
+}
+
+/*
+ * 请求、RTCP都算作活跃
+ */
+static void refresh_session(T rtsp, ab_rtsp_client_t *client) {
+    if (NULL == client->session || NULL == client->session->timer)
+        return;
+
+    if (rtsp->session_timeout > 0)
+        ab_timer_wheel_restart(rtsp->timers, client->session->timer,
+            rtsp->session_timeout * 1000);
+    else
+        ab_timer_wheel_cancel(rtsp->timers, &client->session->timer);
 }
 
 void accept_func(void *sock, void *user_data) {
@@ -299,193 +786,452 @@ void accept_func(void *sock, void *user_data) {
     ab_rtsp_client_t *new_client;
     NEW(new_client);
 
+    new_client->server  = rtsp;
+    new_client->io.kind     = AB_RTSP_IO_CLIENT;
+    new_client->io.object   = new_client;
     new_client->sock    = sock;
+    ab_socket_set_options(sock, &rtsp->socket_options[AB_SOCKET_ROLE_CONTROL]);
+    new_client->parser  = ab_rtsp_parser_new(RTSP_REQUEST_MAX_SIZE);
+    new_client->session = NULL;
+    new_client->session_line_len = 0;
     new_client->video_codec = rtsp->video_codec;
     new_client->ready   = false;
     new_client->method  = AB_RTSP_OVER_NONE;
-
-    pthread_mutex_lock(&rtsp->mutex);
+    memset(new_client->tracks, 0, sizeof(new_client->tracks));
+    new_client->wait_key    = false;
+    new_client->dropping    = false;
+    new_client->drop_tid    = AB_RTSP_TID_NONE;
+    new_client->seq_offset  = 0;
+    memset(&new_client->backlog, 0, sizeof(new_client->backlog));
+    new_client->writable    = false;
+    new_client->dropped     = 0;
+    new_client->send_errors = 0;
+    new_client->vod_file    = NULL;
+    new_client->vod         = NULL;
+    new_client->timeshift   = NULL;
+    memset(&new_client->session_clock, 0, sizeof(new_client->session_clock));
+    add_counter(rtsp, AB_RTSP_COUNTER_ACCEPTED, 1);
+
+    // called from the event loop, which holds rtsp->mutex
     rtsp->clients = list_push(rtsp->clients, new_client);
-    pthread_mutex_unlock(&rtsp->mutex);
+    ab_rtsp_watch_fd(rtsp, ab_socket_fd(sock), &new_client->io);
 }
 
-bool start_code3(const unsigned char *data, unsigned int data_size) {
-    if (data_size >= 3 &&
-        0x00 == data[0] && 0x00 == data[1] && 0x01 == data[2])
-        return true;
-    return false;
+static int congestion_level(T rtsp, ab_rtsp_client_t *client) {
+    if (0 == rtsp->discard_percent && 0 == rtsp->skip_percent)
+        return AB_RTSP_DROP_NONE;
+
+    int queued = ab_socket_send_queue(client->sock);
+    int buffer = ab_socket_send_buffer(client->sock);
+    if (queued <= 0 || buffer <= 0)
+        return AB_RTSP_DROP_NONE;
+
+    // the kernel doubles SO_SNDBUF to leave room for bookkeeping overhead
+    unsigned int percent = (unsigned long) queued * 100 / (buffer / 2);
+    if (rtsp->skip_percent > 0 && percent >= rtsp->skip_percent)
+        return AB_RTSP_DROP_UNTIL_KEY;
+    if (rtsp->discard_percent > 0 && percent >= rtsp->discard_percent)
+        return AB_RTSP_DROP_DISCARDABLE;
+    return AB_RTSP_DROP_NONE;
 }
 
-bool start_code4(const unsigned char *data, unsigned int data_size) {
-    if (data_size >= 4 &&
-        0x00 == data[0] && 0x00 == data[1] &&
-        0x00 == data[2] && 0x01 == data[3]) {
-        return true;
+/*
+ * 丢了某个sub-layer的参考图像后，该层及以上的图像都解不出来，
+ * 一直丢到IRAP，或者能切换上去的TSA/STSA
+ */
+static bool sub_layer_blocked(ab_rtsp_client_t *client, int tag) {
+    int tid = AB_RTP_PACKET_TID(tag);
+    if (tag & AB_RTP_PACKET_KEY) {
+        client->drop_tid = AB_RTSP_TID_NONE;
+    } else if ((tag & AB_RTP_PACKET_TSA) && tid <= client->drop_tid) {
+        client->drop_tid = AB_RTSP_TID_NONE;
+    } else if ((tag & AB_RTP_PACKET_STSA) && tid == client->drop_tid) {
+        client->drop_tid = tid + 1;
     }
-    return false;
+
+    return tid >= client->drop_tid;
 }
 
-int find_start_code(const unsigned char *data, unsigned int data_size) {
-    int result = -1;
-    if (data_size >= 4) {
-        unsigned int i;
-        for (i = 0; i < data_size - 4; ++i) {
-            if (start_code3(data + i, 3) || start_code4(data + i, 4)) {
-                break;
-            }
+/*
+ * 按发送队列积压程度决定是否丢弃，同一NALU的分片一起丢弃
+ */
+static bool drop_packet(T rtsp, ab_rtsp_client_t *client, int tag) {
+    if (!(tag & AB_RTP_PACKET_NALU_START))
+        return client->dropping;
+
+    int level = congestion_level(rtsp, client);
+    if (client->wait_key) {
+        if ((tag & AB_RTP_PACKET_KEY) && level != AB_RTSP_DROP_UNTIL_KEY) {
+            client->wait_key = false;
+            print_sock_info(client->sock, "resume at key frame.");
         }
+    } else if (AB_RTSP_DROP_UNTIL_KEY == level) {
+        client->wait_key = true;
+        print_sock_info(client->sock, "congested, skip to next key frame.");
+    }
 
-        if ((i < data_size - 4) || start_code3(data + i, 3)) {
-            result = i;
-        }
+    if (client->wait_key) {
+        client->dropping = true;
+    } else if (sub_layer_blocked(client, tag)) {
+        // even once the congestion is gone
+        client->dropping = true;
+    } else if (AB_RTSP_DROP_DISCARDABLE == level && (tag & AB_RTP_PACKET_DISCARDABLE)) {
+        client->dropping = true;
+        if (AB_RTP_PACKET_BREAKS(tag) < client->drop_tid)
+            client->drop_tid = AB_RTP_PACKET_BREAKS(tag);
+    } else {
+        client->dropping = false;
     }
 
-    return result;
+    return client->dropping;
 }
 
-static void send_rtp_to_client(list_t clients, ab_udp_client_t rtp_udp_srv,
-    const unsigned char *data, unsigned int data_len) {
-    list_t node = clients;
-    while(node) {
-        ab_rtsp_client_t *rtsp_client = node->first;
-        if (rtsp_client->ready && rtsp_client->sock) {
-            if (AB_RTSP_OVER_UDP == rtsp_client->method) {
-                char addr_buf[32];
-                ab_socket_addr(rtsp_client->sock, 
-                    addr_buf, sizeof(addr_buf));
-                ab_udp_client_send(rtp_udp_srv, 
-                    addr_buf, rtsp_client->rtp_chn_port,
-                    data + sizeof(ab_rtsp_interleaved_frame_t), 
-                    data_len - sizeof(ab_rtsp_interleaved_frame_t));
-            } else if (AB_RTSP_OVER_TCP == rtsp_client->method) {
-                int nsend = ab_socket_send(rtsp_client->sock, data, data_len);
-                if (nsend != data_len)
-                    AB_LOGGER_DEBUG("ab_socket_send error.\n");
-            }
-        }
-        node = node->rest;
+/*
+ * rtp_len: 不含interleaved头
+ */
+static void count_sent(T rtsp, ab_rtsp_client_t *client,
+    ab_rtsp_transport_t *track, unsigned int rtp_len, bool ok) {
+    if (ok) {
+        ++track->stats.packets;
+        track->stats.bytes += rtp_len;
+        add_counter(rtsp, AB_RTSP_COUNTER_SENT_PACKETS, 1);
+        add_counter(rtsp, AB_RTSP_COUNTER_SENT_BYTES, rtp_len);
+    } else {
+        ++client->send_errors;
+        add_counter(rtsp, AB_RTSP_COUNTER_SEND_ERRORS, 1);
     }
 }
 
-static void set_h264_slice_header(unsigned char *slice_header, int nalu_type,
-    int slice_total, int slice_index) {
-    slice_header[0] = (nalu_type & 0x60) | 0x1c;
-    slice_header[1] = nalu_type & 0x1f;
+static void send_udp_to_client(T rtsp, ab_rtsp_client_t *client,
+    ab_rtsp_transport_t *track, const unsigned char *data, unsigned int data_len) {
+    char addr_buf[32];
+    ab_socket_addr(client->sock, addr_buf, sizeof(addr_buf));
+    int nsend = ab_udp_client_send(rtsp->rtp_udp_srv, addr_buf, track->rtp_chn_port,
+        data, data_len);
+    count_sent(rtsp, client, track, data_len, nsend == (int) data_len);
+}
 
-    if (0 == slice_index) {
-        slice_header[1] |= 0x80;
-    } else if (slice_total - 1 == slice_index) {
-        slice_header[1] |= 0x40;
+/*
+ * backlog非空时再关注EPOLLOUT，发完后只关注EPOLLIN
+ */
+static void watch_writable(T rtsp, ab_rtsp_client_t *client, bool writable) {
+    if (client->writable == writable)
+        return;
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events    = writable ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    event.data.ptr  = &client->io;
+    int fd = ab_socket_fd(client->sock);
+    if (epoll_ctl(rtsp->epoll_fd, EPOLL_CTL_MOD, fd, &event) != 0) {
+        AB_LOGGER_ERROR("epoll_ctl(%d) failed, %s.\n", fd, strerror(errno));
+        return;
     }
+    client->writable = writable;
 }
 
-static void set_h265_slice_header(unsigned char *slice_header, int nalu_type,
-    int slice_total, int slice_index) {
-    slice_header[0] = 0x62;
-    slice_header[1] = 1;
-
-    slice_header[2] = (nalu_type >> 1) & 0x3f;
-    if (0 == slice_index) {
-        slice_header[2] |= 0x80;
-    } else if (slice_total - 1 == slice_index) {
-        slice_header[2] |= 0x40;
+/*
+ * return: 超过RTSP_BACKLOG_MAX_SIZE返回-1
+ */
+static int append_backlog(ab_buffer_t *backlog,
+    const unsigned char *data, unsigned int data_len) {
+    unsigned int need = backlog->used + data_len;
+    if (need > RTSP_BACKLOG_MAX_SIZE)
+        return -1;
+
+    if ((unsigned int) backlog->size < need) {
+        unsigned int size = backlog->size > 0 ? backlog->size : 1024;
+        while (size < need)
+            size *= 2;
+        unsigned char *data_buf = ALLOC(size);
+        if (backlog->used > 0)
+            memcpy(data_buf, backlog->data, backlog->used);
+        if (backlog->data)
+            FREE(backlog->data);
+        backlog->data = data_buf;
+        backlog->size = size;
     }
+    memcpy(backlog->data + backlog->used, data, data_len);
+    backlog->used = need;
+    return 0;
 }
 
-void rtp_send_nalu(T rtsp, 
-    const unsigned char *nalu, unsigned int nalu_len) {
-    assert(rtsp);
-    assert(nalu && nalu_len > 0);
-
-    int nalu_type = nalu[0];
-    if (nalu_len < RTP_MAX_SIZE) {
-        fill_rtsp_interleave_frame(
-            (ab_rtsp_interleaved_frame_t *) rtsp->rtp_buffer.data,
-            sizeof(ab_rtp_header_t) + nalu_len);
-        rtsp->rtp_buffer.used = sizeof(ab_rtsp_interleaved_frame_t);
-
-        fill_rtp_header(
-            (ab_rtp_header_t *) (rtsp->rtp_buffer.data + rtsp->rtp_buffer.used), 
-            rtsp->sequence, rtsp->timestamp);
-        rtsp->rtp_buffer.used += sizeof(ab_rtp_header_t);
-
-        memcpy(rtsp->rtp_buffer.data + rtsp->rtp_buffer.used, nalu, nalu_len);
-        rtsp->rtp_buffer.used += nalu_len;
-
-        pthread_mutex_lock(&rtsp->mutex);
-        send_rtp_to_client(rtsp->clients, rtsp->rtp_udp_srv, 
-            rtsp->rtp_buffer.data, rtsp->rtp_buffer.used);
-        pthread_mutex_unlock(&rtsp->mutex);
-
-        ++rtsp->sequence;
-    } else {
-        unsigned int header_len = 0, data_offset = 0;
-        if (AB_VIDEO_CODEC_H264 == rtsp->video_codec) {
-            header_len = 2;
-            data_offset = 1;
-        } else if (AB_VIDEO_CODEC_H265 == rtsp->video_codec) {
-            header_len = 3;
-            data_offset = 2;
+/*
+ * 不等待发送缓冲区，写不完的留在backlog里等EPOLLOUT
+ * return: 1发完，0还有剩余，-1出错并关闭了连接
+ */
+static int drain_backlog(T rtsp, ab_rtsp_client_t *client) {
+    ab_buffer_t *backlog = &client->backlog;
+    if (backlog->used > 0) {
+        int nsend = ab_socket_try_send(client->sock, backlog->data, backlog->used);
+        if (nsend < 0 && EAGAIN != errno && EWOULDBLOCK != errno) {
+            close_client(rtsp, client, "send failed, close connection.");
+            return -1;
         }
-
-        int slice_num = (nalu_len - data_offset) / RTP_MAX_SIZE;
-        int remain = (nalu_len - data_offset) % RTP_MAX_SIZE;
-        if (remain) {
-            ++slice_num;
+        if (nsend > 0) {
+            backlog->used -= nsend;
+            memmove(backlog->data, backlog->data + nsend, backlog->used);
         }
+    }
 
-        for (int i = 0; i < slice_num; ++i) {
-            unsigned int pkg_data_len = 0;
-            if (i < slice_num - 1 || 0 == remain) {
-                pkg_data_len = RTP_MAX_SIZE;
-            } else {
-                pkg_data_len = remain;
-            }
+    watch_writable(rtsp, client, backlog->used > 0);
+    return backlog->used > 0 ? 0 : 1;
+}
 
-            fill_rtsp_interleave_frame(
-                (ab_rtsp_interleaved_frame_t *) rtsp->rtp_buffer.data,
-                pkg_data_len + sizeof(ab_rtp_header_t) + header_len);
-            rtsp->rtp_buffer.used = sizeof(ab_rtsp_interleaved_frame_t);
-
-            fill_rtp_header(
-                (ab_rtp_header_t *) (rtsp->rtp_buffer.data + rtsp->rtp_buffer.used), 
-                rtsp->sequence, rtsp->timestamp);
-            rtsp->rtp_buffer.used += sizeof(ab_rtp_header_t);
-
-            if (AB_VIDEO_CODEC_H264 == rtsp->video_codec) {
-                set_h264_slice_header(rtsp->rtp_buffer.data + rtsp->rtp_buffer.used,
-                    nalu_type, slice_num, i);
-            } else if (AB_VIDEO_CODEC_H265 == rtsp->video_codec) {
-                set_h265_slice_header(rtsp->rtp_buffer.data + rtsp->rtp_buffer.used,
-                    nalu_type, slice_num, i);
-            }
+/*
+ * 事件循环持有mutex时调用，不等待发送缓冲区，慢的观看端不能拖住其他人；
+ * 只写出一部分时余下的存入backlog，之后的包等它发完
+ * return: 1写出，0发送缓冲区满、什么也没写，-1出错并关闭了连接
+ */
+static int write_interleaved(T rtsp, ab_rtsp_client_t *client,
+    const unsigned char *data, unsigned int data_len) {
+    int result = drain_backlog(rtsp, client);
+    if (result <= 0)
+        return result;
 
-            rtsp->rtp_buffer.used += header_len;
+    int nsend = ab_socket_try_send(client->sock, data, data_len);
+    if (nsend < 0 && (EAGAIN == errno || EWOULDBLOCK == errno))
+        return 0;
+    if (nsend < 0) {
+        close_client(rtsp, client, "send failed, close connection.");
+        return -1;
+    }
 
-            memcpy(rtsp->rtp_buffer.data + rtsp->rtp_buffer.used, 
-                nalu + i * RTP_MAX_SIZE + data_offset, pkg_data_len);
-            rtsp->rtp_buffer.used += pkg_data_len;
+    // the peer is in the middle of this frame now, the rest has to follow
+    if ((unsigned int) nsend < data_len) {
+        append_backlog(&client->backlog, data + nsend, data_len - nsend);
+        watch_writable(rtsp, client, true);
+    }
+    return 1;
+}
 
-            pthread_mutex_lock(&rtsp->mutex);
-            send_rtp_to_client(rtsp->clients, rtsp->rtp_udp_srv, 
-                rtsp->rtp_buffer.data, rtsp->rtp_buffer.used);
-            pthread_mutex_unlock(&rtsp->mutex);
+/*
+ * RTSP响应不丢弃，排在backlog里未发完的帧之后；
+ * 观看端长时间不读，响应积压超过上限时关闭连接，不留半个响应
+ * return: 关闭连接后返回-1
+ */
+static int send_response(T rtsp, ab_rtsp_client_t *client,
+    const char *response, unsigned int len) {
+    if (append_backlog(&client->backlog, (const unsigned char *) response, len) != 0) {
+        close_client(rtsp, client, "response backlog full, close connection.");
+        return -1;
+    }
+    return drain_backlog(rtsp, client) < 0 ? -1 : 0;
+}
 
-            ++rtsp->sequence;
+/*
+ * 包是所有观看端共享的，通道号或序号不同时拷贝后改写
+ * return: @write_interleaved
+ */
+static int send_interleaved_to_client(T rtsp, ab_rtsp_client_t *client,
+    ab_rtsp_transport_t *track, const unsigned char *data, unsigned int data_len,
+    uint16_t seq_offset) {
+    uint8_t channel = track->rtp_chn_port;
+    const unsigned char *packet = data;
+    unsigned char rewritten[AB_RTP_PACKETIZER_HEADROOM +
+        sizeof(ab_rtp_header_t) + RTP_MAX_SIZE];
+    if ((seq_offset != 0 || channel != data[1]) &&
+        data_len <= sizeof(rewritten)) {
+        memcpy(rewritten, data, data_len);
+        ((ab_rtsp_interleaved_frame_t *) rewritten)->channel_identifier = channel;
+        if (seq_offset != 0) {
+            // keep the viewer's sequence numbers contiguous
+            ab_rtp_header_t *rtp_header = (ab_rtp_header_t *)
+                (rewritten + sizeof(ab_rtsp_interleaved_frame_t));
+            rtp_header->seq = htons(ntohs(rtp_header->seq) - seq_offset);
         }
+        packet = rewritten;
     }
 
-    if ((nalu_type & 0x1f) != 7 && (nalu_type & 0x1f) != 8)
-        rtsp->timestamp += 90000 / 25;
+    int result = write_interleaved(rtsp, client, packet, data_len);
+    if (result != 0) {
+        count_sent(rtsp, client, track, data_len - sizeof(ab_rtsp_interleaved_frame_t),
+            result > 0);
+    } else {
+        ++client->dropped;
+        add_counter(rtsp, AB_RTSP_COUNTER_DROPPED_PACKETS, 1);
+    }
+    return result;
 }
 
-static list_t update_clients_list(list_t head) {
-    while (head) {
+/*
+ * 点播、时移的观看端有自己的打包器
+ */
+static inline bool live_viewer(const ab_rtsp_client_t *client) {
+    return NULL == client->vod && NULL == client->timeshift;
+}
+
+/*
+ * return: 写了几个观看端
+ */
+static unsigned int send_rtp_to_client(T rtsp,
+    const unsigned char *data, unsigned int data_len, int tag) {
+    unsigned int sent = 0;
+    list_t node = rtsp->clients;
+    while(node) {
+        ab_rtsp_client_t *rtsp_client = node->first;
+        ab_rtsp_transport_t *track = &rtsp_client->tracks[AB_RTSP_TRACK_VIDEO];
+        if (rtsp_client->ready && rtsp_client->sock && track->setup &&
+            live_viewer(rtsp_client)) {
+            if (AB_RTSP_OVER_UDP == rtsp_client->method) {
+                send_udp_to_client(rtsp, rtsp_client, track,
+                    data + sizeof(ab_rtsp_interleaved_frame_t), 
+                    data_len - sizeof(ab_rtsp_interleaved_frame_t));
+            } else if (AB_RTSP_OVER_TCP == rtsp_client->method) {
+                if (drop_packet(rtsp, rtsp_client, tag)) {
+                    ++rtsp_client->seq_offset;
+                    ++rtsp_client->dropped;
+                    add_counter(rtsp, AB_RTSP_COUNTER_DROPPED_PACKETS, 1);
+                    node = node->rest;
+                    continue;
+                }
+
+                if (0 == send_interleaved_to_client(rtsp, rtsp_client, track,
+                    data, data_len, rtsp_client->seq_offset)) {
+                    // the frame is broken for this viewer
+                    ++rtsp_client->seq_offset;
+                    rtsp_client->dropping = true;
+                    if (!rtsp_client->wait_key) {
+                        rtsp_client->wait_key = true;
+                        print_sock_info(rtsp_client->sock,
+                            "send buffer full, skip to next key frame.");
+                    }
+                    node = node->rest;
+                    continue;
+                }
+            }
+            ++sent;
+        }
+        node = node->rest;
+    }
+    return sent;
+}
+
+/*
+ * 音频码率很低，拥塞时也不丢
+ */
+static unsigned int send_audio_to_client(T rtsp,
+    const unsigned char *data, unsigned int data_len) {
+    unsigned int sent = 0;
+    list_t node = rtsp->clients;
+    while (node) {
+        ab_rtsp_client_t *rtsp_client = node->first;
+        ab_rtsp_transport_t *track = &rtsp_client->tracks[AB_RTSP_TRACK_AUDIO];
+        if (rtsp_client->ready && rtsp_client->sock && track->setup &&
+            live_viewer(rtsp_client)) {
+            if (AB_RTSP_OVER_UDP == rtsp_client->method) {
+                send_udp_to_client(rtsp, rtsp_client, track,
+                    data + sizeof(ab_rtsp_interleaved_frame_t),
+                    data_len - sizeof(ab_rtsp_interleaved_frame_t));
+            } else if (AB_RTSP_OVER_TCP == rtsp_client->method) {
+                send_interleaved_to_client(rtsp, rtsp_client, track, data, data_len, 0);
+            }
+            ++sent;
+        }
+        node = node->rest;
+    }
+    return sent;
+}
+
+static void send_fec_to_client(T rtsp,
+    const unsigned char *data, unsigned int data_len) {
+    list_t node = rtsp->clients;
+    while (node) {
+        ab_rtsp_client_t *rtsp_client = node->first;
+        ab_rtsp_transport_t *track = &rtsp_client->tracks[AB_RTSP_TRACK_VIDEO];
+        if (rtsp_client->ready && rtsp_client->sock && track->setup &&
+            live_viewer(rtsp_client) && AB_RTSP_OVER_UDP == rtsp_client->method) {
+            send_udp_to_client(rtsp, rtsp_client, track, data, data_len);
+        }
+        node = node->rest;
+    }
+}
+
+/*
+ * 记下每帧第一个包的发送时间，发送者报告据此换算RTP时间戳
+ */
+static void update_clock(ab_rtsp_clock_t *clock, const unsigned char *data) {
+    const ab_rtp_header_t *rtp_header = (const ab_rtp_header_t *)
+        (data + sizeof(ab_rtsp_interleaved_frame_t));
+    uint32_t timestamp = ntohl(rtp_header->timestamp);
+    if (!clock->valid || clock->timestamp != timestamp) {
+        clock->valid        = true;
+        clock->timestamp    = timestamp;
+        clock->at_us        = monotonic_us();
+    }
+}
+
+void ab_rtsp_send_packet(T rtsp,
+    const unsigned char *data, unsigned int data_len, int tag) {
+    pthread_mutex_lock(&rtsp->mutex);
+    switch (tag & AB_RTP_PACKET_KIND_MASK) {
+    case AB_RTP_PACKET_FEC:
+        send_fec_to_client(rtsp, data, data_len);
+        break;
+    case AB_RTP_PACKET_AUDIO:
+        update_clock(&rtsp->clocks[AB_RTSP_TRACK_AUDIO], data);
+        if (send_audio_to_client(rtsp, data, data_len) > 0)
+            ab_rtsp_record_sent(rtsp, AB_RTSP_TRACK_AUDIO, data);
+        break;
+    default:
+        update_clock(&rtsp->clocks[AB_RTSP_TRACK_VIDEO], data);
+        if (send_rtp_to_client(rtsp, data, data_len, tag) > 0)
+            ab_rtsp_record_sent(rtsp, AB_RTSP_TRACK_VIDEO, data);
+        break;
+    }
+    pthread_mutex_unlock(&rtsp->mutex);
+}
+
+/*
+ * 点播、时移会话的打包器在事件循环中回调，只发给这一个观看端
+ */
+void session_packet_cb(unsigned char *rtp, unsigned int rtp_len,
+    const ab_rtp_packet_info_t *info, void *user_data) {
+    (void) info;
+    ab_rtsp_client_t *client = (ab_rtsp_client_t *) user_data;
+    T rtsp = client->server;
+
+    // an earlier fragment of the frame failed and closed the connection
+    if (NULL == client->sock)
+        return;
+
+    ab_rtsp_transport_t *track = &client->tracks[AB_RTSP_TRACK_VIDEO];
+    unsigned char *data = rtp - sizeof(ab_rtsp_interleaved_frame_t);
+    ab_rtsp_fill_interleaved_frame((ab_rtsp_interleaved_frame_t *) data,
+        track->rtp_chn_port, rtp_len);
+    update_clock(&client->session_clock, data);
+
+    if (AB_RTSP_OVER_UDP == client->method)
+        send_udp_to_client(rtsp, client, track, rtp, rtp_len);
+    else
+        send_interleaved_to_client(rtsp, client, track, data,
+            rtp_len + sizeof(ab_rtsp_interleaved_frame_t), 0);
+}
+
+void pacer_send_cb(const unsigned char *data, unsigned int data_len,
+    int tag, void *user_data) {
+    T rtsp = (T) user_data;
+    int track = AB_RTP_PACKET_AUDIO == (tag & AB_RTP_PACKET_KIND_MASK) ?
+        AB_RTSP_TRACK_AUDIO : AB_RTSP_TRACK_VIDEO;
+    __atomic_fetch_sub(&rtsp->pacer_queued[track], 1, __ATOMIC_RELAXED);
+    ab_rtsp_send_packet(rtsp, data, data_len, tag);
+}
+
+/*
+ * 排队的包随流一起丢弃；之后不再有回调，也没有并发的入队
+ */
+void free_pacer_stream(T rtsp, ab_rtp_pacer_stream_t *stream, int track) {
+    ab_rtp_pacer_stream_free(stream);
+    __atomic_store_n(&rtsp->pacer_queued[track], 0, __ATOMIC_RELAXED);
+}
+
+static list_t update_clients_list(list_t head) {
+    while (head) {
         ab_rtsp_client_t *client = head->first;
         if (NULL == client->sock) {
             list_t del_node = head;
             head = head->rest;
-            FREE(del_node->first);
+            free_client(del_node->first);
             FREE(del_node);
         } else {
             break;
@@ -498,7 +1244,7 @@ static list_t update_clients_list(list_t head) {
         if (NULL == client->sock) {
             list_t del_node = head->rest;
             head->rest = head->rest->rest;
-            FREE(del_node->first);
+            free_client(del_node->first);
             FREE(del_node);
         } else {
             head = head->rest;
@@ -508,72 +1254,268 @@ static list_t update_clients_list(list_t head) {
     return result;
 }
 
-static int handle_cmd_options(char *buf, unsigned int buf_size,
-        unsigned int cseq) {
-    snprintf(buf, buf_size, 
-        "RTSP/1.0 200 OK\r\n"
-        "CSeq: %u\r\n"
+static void init_responses(ab_rtsp_response_t *responses) {
+    ab_rtsp_response_init(&responses[AB_RTSP_RESPONSE_OPTIONS], "200 OK",
         "Public: OPTIONS, DESCRIBE, SETUP, "
-        "PLAY, TEARDOWN\r\n\r\n", cseq);
-    return strlen(buf);
+        "PLAY, PAUSE, TEARDOWN, GET_PARAMETER\r\n\r\n");
+    ab_rtsp_response_init(&responses[AB_RTSP_RESPONSE_PLAY], "200 OK",
+        "Range: npt=0.000-\r\n\r\n");
+    ab_rtsp_response_init(&responses[AB_RTSP_RESPONSE_OK], "200 OK", "\r\n");
+    ab_rtsp_response_init(&responses[AB_RTSP_RESPONSE_NOT_SUPPORTED],
+        "551 Option not supported", "\r\n");
+    ab_rtsp_response_init(&responses[AB_RTSP_RESPONSE_SESSION_NOT_FOUND],
+        "454 Session Not Found", "\r\n");
+    ab_rtsp_response_init(&responses[AB_RTSP_RESPONSE_NOT_FOUND],
+        "404 Not Found", "\r\n");
+    ab_rtsp_response_init(&responses[AB_RTSP_RESPONSE_INVALID_RANGE],
+        "457 Invalid Range", "\r\n");
 }
 
-static int handle_cmd_describe(char *buf, unsigned int buf_size,
-    const char *url, unsigned int cseq, int video_codec) {
-    char sdp[256];
-    char local_ip[32];
-    sscanf(url, "rtsp://%[^:]:", local_ip);
-
-    if (AB_VIDEO_CODEC_H264 == video_codec) {
-        snprintf(sdp, sizeof(sdp), 
-            "v=0\r\n"
-            "o=- 9%ld 1 IN IP4 %s\r\n"
-            "t=0 0\r\n"
-            "a=control:*\r\n"
-            "m=video 0 RTP/AVP 96\r\n"
-            "a=rtpmap:96 H264/90000\r\n"
-            "a=control:track0\r\n", time(NULL), local_ip);
-    } else if (AB_VIDEO_CODEC_H265 == video_codec) {
-        snprintf(sdp, sizeof(sdp), 
-            "v=0\r\n"
-            "o=- 9%ld 1 IN IP4 %s\r\n"
-            "t=0 0\r\n"
-            "a=control:*\r\n"
-            "m=video 0 RTP/AVP 96\r\n"
-            "a=rtpmap:96 H265/90000\r\n"
-            "a=control:track0\r\n", time(NULL), local_ip);
-    }
-
-    snprintf(buf, buf_size, 
-        "RTSP/1.0 200 OK\r\n"
-        "CSeq: %u\r\n"
+/*
+ * 调用者持有rtsp->mutex
+ */
+void ab_rtsp_invalidate_describe(T rtsp) {
+    if (ab_rtsp_response_valid(&rtsp->describe)) {
+        ab_rtsp_response_clear(&rtsp->describe);
+        ++rtsp->sdp_version;
+    }
+}
+
+/*
+ * 追加base64编码的参数集
+ * return: 写入的长度，参数集不存在或缓冲区不足返回0
+ */
+static int format_parameter_set(const ab_buffer_t *parameter_sets, int index,
+    const char *prefix, char *buf, unsigned int buf_size) {
+    const ab_buffer_t *parameter_set = &parameter_sets[index];
+    if (0 == parameter_set->used)
+        return 0;
+
+    int len = snprintf(buf, buf_size, "%s", prefix);
+    if (len < 0 || len >= (int) buf_size)
+        return 0;
+
+    int encoded = ab_base64_encode(parameter_set->data, parameter_set->used,
+        buf + len, buf_size - len);
+    return encoded < 0 ? 0 : len + encoded;
+}
+
+/*
+ * H.264: RFC 6184 8.1, H.265: RFC 7798 7.1
+ * 还没收到参数集时只有packetization-mode，播放器从带内参数集开始
+ */
+static void format_fmtp(T rtsp, const ab_buffer_t *parameter_sets,
+    char *buf, unsigned int buf_size) {
+    int len = 0;
+    if (AB_VIDEO_CODEC_H264 == rtsp->video_codec) {
+        len = snprintf(buf, buf_size, "a=fmtp:%d packetization-mode=1",
+            RTP_PAYLOAD_TYPE_H264);
+
+        const ab_buffer_t *sps = &parameter_sets[AB_NALU_PARAMETER_SET_SPS];
+        if (sps->used >= 4) {
+            // profile_idc, constraint flags, level_idc follow the NAL header
+            len += snprintf(buf + len, buf_size - len, ";profile-level-id=%02x%02x%02x",
+                sps->data[1], sps->data[2], sps->data[3]);
+        }
+
+        int sps_len = format_parameter_set(parameter_sets, AB_NALU_PARAMETER_SET_SPS,
+            ";sprop-parameter-sets=", buf + len, buf_size - len);
+        if (sps_len > 0) {
+            len += sps_len;
+            len += format_parameter_set(parameter_sets, AB_NALU_PARAMETER_SET_PPS,
+                ",", buf + len, buf_size - len);
+        }
+    } else if (AB_VIDEO_CODEC_H265 == rtsp->video_codec) {
+        len = snprintf(buf, buf_size, "a=fmtp:%d", RTP_PAYLOAD_TYPE_H264);
+
+        static const char *names[AB_NALU_PARAMETER_SET_COUNT] = {
+            "sprop-vps=", "sprop-sps=", "sprop-pps="
+        };
+
+        int count = 0;
+        for (int i = 0; i < AB_NALU_PARAMETER_SET_COUNT; ++i) {
+            char prefix[16];
+            snprintf(prefix, sizeof(prefix), "%s%s", count ? "; " : " ", names[i]);
+            int n = format_parameter_set(parameter_sets, i, prefix,
+                buf + len, buf_size - len);
+            if (n > 0) {
+                len += n;
+                ++count;
+            }
+        }
+
+        if (0 == count) {
+            buf[0] = '\0';
+            return;
+        }
+    }
+
+    if (len > 0 && len + 3 <= (int) buf_size)
+        snprintf(buf + len, buf_size - len, "\r\n");
+    else
+        buf[0] = '\0';
+}
+
+/*
+ * RFC 3640 mpeg4-generic, AAC-hbr; config为AudioSpecificConfig的16进制
+ */
+static void format_audio_media(T rtsp, char *buf, unsigned int buf_size) {
+    unsigned char config[2];
+    // aac_packetizer is not ours to look at, audio_config is
+    if (0 == rtsp->audio_config.sample_rate ||
+        ab_aac_audio_specific_config(&rtsp->audio_config,
+            config, sizeof(config)) < 0) {
+        buf[0] = '\0';
+        return;
+    }
+
+    snprintf(buf, buf_size,
+        "m=audio 0 RTP/AVP %d\r\n"
+        "a=rtpmap:%d mpeg4-generic/%u/%u\r\n"
+        "a=fmtp:%d streamtype=5;profile-level-id=1;mode=AAC-hbr;"
+        "sizelength=13;indexlength=3;indexdeltalength=3;config=%02X%02X\r\n"
+        "a=control:track1\r\n",
+        RTP_PAYLOAD_TYPE_AAC, RTP_PAYLOAD_TYPE_AAC,
+        rtsp->audio_config.sample_rate, rtsp->audio_config.channels,
+        RTP_PAYLOAD_TYPE_AAC, config[0], config[1]);
+}
+
+/*
+ * SDP只在url、FEC、音频配置或参数集变化后重新生成
+ * file: 点播文件，只有视频轨，带a=range；NULL时为直播
+ */
+static const ab_rtsp_response_t *describe_response(T rtsp,
+    ab_rtsp_vod_file_t *file, const char *url) {
+    ab_rtsp_response_t *describe = file ? &file->describe : &rtsp->describe;
+    char *describe_url = file ? file->describe_url : rtsp->describe_url;
+    if (ab_rtsp_response_valid(describe) && strcmp(describe_url, url) == 0)
+        return describe;
+
+    ab_rtsp_response_clear(describe);
+    snprintf(describe_url, sizeof(rtsp->describe_url), "%s", url);
+
+    char local_ip[32] = "0.0.0.0";
+    sscanf(url, "rtsp://%31[^:/]", local_ip);
+
+    char fec_pt[8] = "";
+    char fec_rtpmap[64] = "";
+    if (rtsp->fec_payload_type != 0 && NULL == file) {
+        snprintf(fec_pt, sizeof(fec_pt), " %d", rtsp->fec_payload_type);
+        snprintf(fec_rtpmap, sizeof(fec_rtpmap),
+            "a=rtpmap:%d ulpfec/90000\r\n", rtsp->fec_payload_type);
+    }
+
+    const char *encoding = AB_VIDEO_CODEC_H265 == rtsp->video_codec ?
+        "H265" : "H264";
+
+    char fmtp[1536];
+    format_fmtp(rtsp, file ? file->parameter_sets : rtsp->parameter_sets,
+        fmtp, sizeof(fmtp));
+
+    // RFC 4566 framerate, 3GPP framesize: lets players size the decoder
+    bool sps_valid = file ? file->sps_valid : rtsp->sps_valid;
+    const ab_sps_info_t *sps_info = file ? &file->sps_info : &rtsp->sps_info;
+    uint64_t num = file ? file->frame_duration_num : rtsp->frame_duration_num;
+    uint64_t den = file ? file->frame_duration_den : rtsp->frame_duration_den;
+    char video_attrs[96] = "";
+    if (sps_valid) {
+        snprintf(video_attrs, sizeof(video_attrs),
+            "a=framerate:%.2f\r\n"
+            "a=framesize:%d %u-%u\r\n",
+            (double) den / num,
+            RTP_PAYLOAD_TYPE_H264, sps_info->width, sps_info->height);
+    }
+
+    // RFC 2326 C.1.5, lets players show a seek bar
+    char range[48] = "";
+    if (file) {
+        snprintf(range, sizeof(range), "a=range:npt=0-%.3f\r\n",
+            ab_file_source_duration_us(file->source) / 1000000.0);
+    }
+
+    char audio[320] = "";
+    if (NULL == file)
+        format_audio_media(rtsp, audio, sizeof(audio));
+
+    char sdp[2560];
+    snprintf(sdp, sizeof(sdp), 
+        "v=0\r\n"
+        "o=- 9%ld %u IN IP4 %s\r\n"
+        "t=0 0\r\n"
+        "a=control:*\r\n"
+        "%s"
+        "m=video 0 RTP/AVP 96%s\r\n"
+        "a=rtpmap:96 %s/90000\r\n"
+        "%s"
+        "%s"
+        "%s"
+        "a=control:track0\r\n"
+        "%s", rtsp->sdp_session_id, rtsp->sdp_version,
+        local_ip, range, fec_pt, encoding, fmtp, video_attrs, fec_rtpmap, audio);
+
+    ab_rtsp_response_init(describe, "200 OK",
         "Content-Base: %s\r\n"
         "Content-type: application/sdp\r\n"
-        "Content-length: %lu\r\n\r\n"
-        "%s", cseq, url, strlen(sdp), sdp);
-    return strlen(buf);
+        "Content-length: %zu\r\n\r\n"
+        "%s", url, strlen(sdp), sdp);
+    return describe;
 }
 
+/*
+ * url路径的最后一段(不含/trackN)为点播文件名
+ * return: 直播返回NULL
+ */
+static ab_rtsp_vod_file_t *find_vod_file(T rtsp, const char *url) {
+    if (0 == rtsp->vod_file_count)
+        return NULL;
+
+    const char *path = strstr(url, "://");
+    path = path ? strchr(path + 3, '/') : NULL;
+    if (NULL == path)
+        return NULL;
+
+    char name[128];
+    snprintf(name, sizeof(name), "%s", path + 1);
+    char *last = strrchr(name, '/');
+    if (last && strncmp(last + 1, "track", 5) == 0)
+        *last = '\0';
+    unsigned int len = strlen(name);
+    if (len > 0 && '/' == name[len - 1])
+        name[len - 1] = '\0';
+    last = strrchr(name, '/');
+    const char *base = last ? last + 1 : name;
+
+    for (unsigned int i = 0; i < rtsp->vod_file_count; ++i) {
+        if (strcmp(rtsp->vod_files[i].name, base) == 0)
+            return &rtsp->vod_files[i];
+    }
+    return NULL;
+}
+
+/*
+ * Transport要回显客户端的端口，每个连接只有一次
+ */
 static int handle_cmd_setup(char *buf, unsigned int buf_size,
-    unsigned int cseq, int rtsp_over,
-    unsigned short rtp_client_port, unsigned short rtcp_client_port) {
+    unsigned int cseq, const char *session, int rtsp_over,
+    unsigned short rtp_client_port, unsigned short rtcp_client_port,
+    unsigned short rtp_server_port, unsigned short rtcp_server_port) {
    if (AB_RTSP_OVER_UDP == rtsp_over) {
         snprintf(buf, buf_size, 
             "RTSP/1.0 200 OK\r\n"
             "CSeq: %u\r\n"
             "Transport: RTP/AVP;unicast;"
             "client_port=%u-%u;server_port=%u-%u\r\n"
-            "Session: 66334873\r\n\r\n",
+            "%s\r\n",
             cseq, rtp_client_port, rtcp_client_port, 
-            RTP_SERVER_PORT, RTCP_SERVER_PORT);
+            rtp_server_port, rtcp_server_port, session);
    } else if (AB_RTSP_OVER_TCP == rtsp_over) {
         snprintf(buf, buf_size, 
             "RTSP/1.0 200 OK\r\n"
             "CSeq: %u\r\n"
             "Transport: RTP/AVP/TCP;unicast;"
             "interleaved=%u-%u\r\n"
-            "Session: 66334873\r\n\r\n", 
-            cseq, rtp_client_port, rtcp_client_port);
+            "%s\r\n", 
+            cseq, rtp_client_port, rtcp_client_port, session);
     } else {
         buf[0] = '\0';
     }
@@ -581,174 +1523,827 @@ static int handle_cmd_setup(char *buf, unsigned int buf_size,
     return strlen(buf);
 }
 
-static int handle_cmd_play(char *buf, unsigned int buf_size,
-    unsigned int cseq) {
-    snprintf(buf, buf_size, 
+/*
+ * a=control:track1是音频，其他(track0、不带track的旧客户端)都是视频
+ * return: 音频轨没有开启或点播时返回-1
+ */
+static int setup_track(T rtsp, const ab_rtsp_vod_file_t *file, const char *url) {
+    const char *name = strrchr(url, '/');
+    if (NULL == name || strcmp(name + 1, "track1") != 0)
+        return AB_RTSP_TRACK_VIDEO;
+
+    return rtsp->audio_config.sample_rate != 0 && NULL == file ?
+        AB_RTSP_TRACK_AUDIO : -1;
+}
+
+/*
+ * 没有在播的点播会话时停止定时器，事件循环不做空转
+ */
+static void arm_session_timer(T rtsp, bool on) {
+    if (on == rtsp->session_timer_armed || rtsp->session_timer_fd < 0)
+        return;
+
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    if (on) {
+        spec.it_interval.tv_nsec    = RTSP_SESSION_TICK_MS * 1000000;
+        spec.it_value               = spec.it_interval;
+    }
+    if (timerfd_settime(rtsp->session_timer_fd, 0, &spec, NULL) != 0) {
+        AB_LOGGER_ERROR("timerfd_settime failed, %s.\n", strerror(errno));
+        return;
+    }
+    rtsp->session_timer_armed = on;
+}
+
+/*
+ * npt-time: 秒数(10.5)或hh:mm:ss(.frac)
+ * return: 格式不对或为now时返回-1
+ */
+static int parse_npt_time(const char *value, double *seconds) {
+    unsigned int hours, minutes;
+    double secs;
+    if (sscanf(value, "%u:%u:%lf", &hours, &minutes, &secs) == 3) {
+        *seconds = hours * 3600.0 + minutes * 60.0 + secs;
+        return 0;
+    }
+    if (sscanf(value, "%lf", seconds) == 1 && *seconds >= 0)
+        return 0;
+    return -1;
+}
+
+/*
+ * Range: npt=start-[end]，RFC 2326 3.6
+ * return: 不是npt或开始为now时返回-1；没有end时end为0
+ */
+static int parse_npt_range(const char *range, double *start, double *end) {
+    *end = 0;
+    if (strncmp(range, "npt=", 4) != 0 || parse_npt_time(range + 4, start) < 0)
+        return -1;
+
+    const char *dash = strchr(range + 4, '-');
+    if (dash && parse_npt_time(dash + 1, end) < 0)
+        *end = 0;
+    return 0;
+}
+
+/*
+ * Scale/Speed头域的值
+ * return: 没有该头域或格式不对时返回-1
+ */
+static int header_double(const ab_rtsp_message_t *request, const char *name,
+    double *value) {
+    const ab_rtsp_slice_t *slice = ab_rtsp_message_header(request, name);
+    if (NULL == slice)
+        return -1;
+
+    char text[32];
+    ab_rtsp_slice_copy(slice, text, sizeof(text));
+    return sscanf(text, "%lf", value) == 1 ? 0 : -1;
+}
+
+/*
+ * 点播、时移只有视频轨，url为聚合控制时补上/track0
+ */
+static void format_rtp_info(const ab_rtsp_message_t *request, uint16_t seq,
+    uint32_t rtptime, char *buf, unsigned int buf_size) {
+    char url[128];
+    ab_rtsp_slice_copy(ab_rtsp_message_url(request), url, sizeof(url));
+    const char *name = strrchr(url, '/');
+    const char *track = name && strcmp(name + 1, "track0") == 0 ? "" : "/track0";
+
+    snprintf(buf, buf_size, "RTP-Info: url=%s%s;seq=%u;rtptime=%u\r\n",
+        url, track, seq, rtptime);
+}
+
+/*
+ * 有Range时定位到之前最近的关键帧，没有Range(或npt=now-)时从暂停处继续
+ * Scale、Speed先于Range生效，倒放的Range结束位置在开始之前
+ * 回复实际的开始位置、速率和下一个包的seq/rtptime
+ */
+static int handle_cmd_vod_play(T rtsp, ab_rtsp_client_t *client,
+    const ab_rtsp_message_t *request, char *buf, unsigned int buf_size) {
+    // a PLAY without them is back to normal rate
+    char rates[64] = "";
+    int len = 0;
+    double scale = 1.0, speed = 1.0;
+    bool has_scale = header_double(request, "Scale", &scale) == 0;
+    bool has_speed = header_double(request, "Speed", &speed) == 0;
+    scale = ab_rtsp_vod_set_scale(client->vod, scale);
+    speed = ab_rtsp_vod_set_speed(client->vod, speed);
+    if (has_scale)
+        len += snprintf(rates + len, sizeof(rates) - len, "Scale: %.3f\r\n", scale);
+    if (has_speed)
+        snprintf(rates + len, sizeof(rates) - len, "Speed: %.3f\r\n", speed);
+
+    const ab_rtsp_slice_t *value = ab_rtsp_message_header(request, "Range");
+    if (value) {
+        char range[64];
+        ab_rtsp_slice_copy(value, range, sizeof(range));
+
+        double start, end;
+        if (parse_npt_range(range, &start, &end) == 0) {
+            ab_rtsp_vod_seek(client->vod, (uint64_t) (start * 1000000),
+                (uint64_t) (end * 1000000));
+        }
+    }
+
+    ab_rtsp_vod_play(client->vod, monotonic_us());
+    client->ready = true;
+    if (ab_rtsp_vod_playing(client->vod))
+        arm_session_timer(rtsp, true);
+
+    char rtp_info[192];
+    format_rtp_info(request, ab_rtsp_vod_sequence(client->vod),
+        ab_rtsp_vod_timestamp(client->vod), rtp_info, sizeof(rtp_info));
+
+    return snprintf(buf, buf_size,
         "RTSP/1.0 200 OK\r\n"
         "CSeq: %u\r\n"
-        "Range: npt=0.000-\r\n"
-        "Session: 66334873; timeout=60\r\n\r\n", cseq);
-    return strlen(buf);
+        "%s"
+        "Range: npt=%.3f-%.3f\r\n"
+        "%s"
+        "%s\r\n",
+        request->cseq, client->session_line,
+        ab_rtsp_vod_position_us(client->vod) / 1000000.0,
+        ab_rtsp_vod_end_us(client->vod) / 1000000.0, rates, rtp_info);
 }
 
-static int handle_cmd_teardown(char *buf, unsigned int buf_size, 
-    unsigned int cseq) {
-    snprintf(buf, buf_size,
-            "RTSP/1.0 200 OK\r\n"
-            "CSeq: %u\r\n"
-            "Session: 66334873\r\n\r\n", cseq);
-    return strlen(buf);
+/*
+ * utc-time: YYYYMMDDThhmmss[.fraction]Z，RFC 2326 3.7
+ * return: 格式不对返回-1
+ */
+static int parse_utc_time(const char *value, uint64_t *wall_us) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    if (sscanf(value, "%4d%2d%2dT%2d%2d%2d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+        &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+        return -1;
+    tm.tm_year -= 1900;
+    tm.tm_mon  -= 1;
+
+    time_t seconds = timegm(&tm);
+    if ((time_t) -1 == seconds)
+        return -1;
+
+    double fraction = 0;
+    if ('.' == value[15])
+        sscanf(value + 15, "%lf", &fraction);
+    *wall_us = (uint64_t) seconds * 1000000 + (uint64_t) (fraction * 1000000);
+    return 0;
 }
 
-static int handle_cmd_not_supported(char *buf, unsigned int buf_size,
-    unsigned int cseq) {
-    snprintf(buf, buf_size,
-            "RTSP/1.0 551 Option not supported\r\n"
-            "CSeq: %u\r\n"
-            "Session: 66334873\r\n\r\n", cseq);
-    return strlen(buf);
+static void format_utc_time(uint64_t wall_us, char *buf, unsigned int buf_size) {
+    time_t seconds = wall_us / 1000000;
+    struct tm tm;
+    gmtime_r(&seconds, &tm);
+
+    unsigned int len = strftime(buf, buf_size, "%Y%m%dT%H%M%S", &tm);
+    snprintf(buf + len, buf_size - len, ".%03uZ",
+        (unsigned int) (wall_us % 1000000 / 1000));
 }
 
-static int process_client_request(ab_rtsp_client_t *client, 
-    const char *request, unsigned int request_len, 
-    char *response, unsigned int response_size) {
-    char method[16];
-    char url[128];
-    char version[16];
-    memset(method, 0, sizeof(method));
-    memset(url, 0, sizeof(url));
-    memset(version, 0, sizeof(version));
+/*
+ * 直播开启时移后：npt=N-从N秒前开始，clock=从该UTC时刻开始，都定位到之前最近的关键帧；
+ * npt=0-(播放器默认带的)、npt=now-回到直播，没有Range时从暂停处继续
+ * return: 回到直播时返回0，由调用者回复
+ */
+static int handle_cmd_timeshift_play(T rtsp, ab_rtsp_client_t *client,
+    const ab_rtsp_message_t *request, char *buf, unsigned int buf_size) {
+    char range[64] = "";
+    const ab_rtsp_slice_t *value = ab_rtsp_message_header(request, "Range");
+    if (value)
+        ab_rtsp_slice_copy(value, range, sizeof(range));
+
+    double start = 0, end;
+    uint64_t wall_us = 0;
+    bool by_clock = strncmp(range, "clock=", 6) == 0 &&
+        parse_utc_time(range + 6, &wall_us) == 0;
+    bool by_npt = !by_clock && parse_npt_range(range, &start, &end) == 0 && start > 0;
+    if (!by_clock && !by_npt && (value || NULL == client->timeshift)) {
+        if (client->timeshift)
+            ab_rtsp_timeshift_free(&client->timeshift);
+        client->ready = true;
+        return 0;
+    }
+
+    bool created = false;
+    if (NULL == client->timeshift) {
+        client->timeshift = ab_rtsp_timeshift_new(rtsp->dvr, rtsp->video_codec,
+            RTSP_VIDEO_SSRC, RTP_MAX_SIZE, session_packet_cb, client);
+        created = true;
+    }
+
+    int result = 0;
+    if (by_clock)
+        result = ab_rtsp_timeshift_seek_clock(client->timeshift, wall_us);
+    else if (by_npt)
+        result = ab_rtsp_timeshift_seek_npt(client->timeshift,
+            (uint64_t) (start * 1000000));
+    if (result < 0) {
+        // nothing buffered there, a new viewer stays on the live stream
+        if (created)
+            ab_rtsp_timeshift_free(&client->timeshift);
+        return ab_rtsp_response_render(
+            &rtsp->responses[AB_RTSP_RESPONSE_INVALID_RANGE], buf, buf_size,
+            request->cseq, client->session_line, client->session_line_len);
+    }
+
+    ab_rtsp_timeshift_play(client->timeshift);
+    client->ready = true;
+    arm_session_timer(rtsp, true);
 
-    sscanf(request, "%s %s %s\r\n", method, url, version);
+    uint64_t npt_us = 0;
+    ab_rtsp_timeshift_position(client->timeshift, &npt_us, &wall_us);
+    char position[48] = "clock=";
+    if (by_clock)
+        format_utc_time(wall_us, position + 6, sizeof(position) - 7);
+    else
+        snprintf(position, sizeof(position), "npt=%.3f", npt_us / 1000000.0);
 
-    unsigned int cseq = 0;
-    const char *line = strstr(request, "CSeq");
-    if (NULL == line) {
+    char rtp_info[192];
+    format_rtp_info(request, ab_rtsp_timeshift_sequence(client->timeshift),
+        ab_rtsp_timeshift_timestamp(client->timeshift), rtp_info, sizeof(rtp_info));
+
+    return snprintf(buf, buf_size,
+        "RTSP/1.0 200 OK\r\n"
+        "CSeq: %u\r\n"
+        "%s"
+        "Range: %s-\r\n"
+        "%s\r\n",
+        request->cseq, client->session_line, position, rtp_info);
+}
+
+/*
+ * 请求带的Session必须是本连接的session
+ * return: 没有Session头域或匹配时返回true
+ */
+static bool check_session(T rtsp, ab_rtsp_client_t *client,
+    const ab_rtsp_message_t *request) {
+    const ab_rtsp_slice_t *value = ab_rtsp_message_header(request, "Session");
+    if (NULL == value)
+        return true;
+
+    ab_rtsp_session_t *session = ab_rtsp_session_table_find(rtsp->sessions,
+        value->data, value->len);
+    return session != NULL && session == client->session;
+}
+
+static int process_client_request(T rtsp, ab_rtsp_client_t *client, 
+    const ab_rtsp_message_t *request,
+    char *response, unsigned int response_size) {
+    if (request->cseq < 0) {
         return 0;
-    } else {
-        sscanf(line, "CSeq: %u\r\n", &cseq);
     }
 
-    int len = 0;
-    if (strcmp(method, "OPTIONS") == 0) {
-        len = handle_cmd_options(response, response_size, cseq);
-    } else if (strcmp(method, "DESCRIBE") == 0) {
-        len = handle_cmd_describe(response, response_size, url, cseq, client->video_codec);
-    } else if (strcmp(method, "SETUP") == 0) {
-        line = strstr(request, "Transport");
-
-        if (strstr(line, "RTP/AVP/TCP") != NULL) {
+    unsigned int cseq = request->cseq;
+    const ab_rtsp_slice_t *method = ab_rtsp_message_method(request);
+    const ab_rtsp_response_t *reply = NULL;
+
+    if (!check_session(rtsp, client, request)) {
+        return ab_rtsp_response_render(
+            &rtsp->responses[AB_RTSP_RESPONSE_SESSION_NOT_FOUND],
+            response, response_size, cseq, NULL, 0);
+    }
+
+    // any request on the connection keeps its session alive
+    refresh_session(rtsp, client);
+
+    if (ab_rtsp_slice_equal(method, "OPTIONS")) {
+        reply = &rtsp->responses[AB_RTSP_RESPONSE_OPTIONS];
+    } else if (ab_rtsp_slice_equal(method, "DESCRIBE")) {
+        char url[128];
+        ab_rtsp_slice_copy(ab_rtsp_message_url(request), url, sizeof(url));
+        reply = describe_response(rtsp, find_vod_file(rtsp, url), url);
+    } else if (ab_rtsp_slice_equal(method, "SETUP")) {
+        const ab_rtsp_slice_t *value = ab_rtsp_message_header(request, "Transport");
+        if (NULL == value) {
+            return 0;
+        }
+
+        char transport[256];
+        ab_rtsp_slice_copy(value, transport, sizeof(transport));
+
+        char url[128];
+        ab_rtsp_slice_copy(ab_rtsp_message_url(request), url, sizeof(url));
+        ab_rtsp_vod_file_t *file = find_vod_file(rtsp, url);
+        int index = setup_track(rtsp, file, url);
+        // one session plays either the live stream or one file
+        if (index < 0 || (client->session && file != client->vod_file)) {
+            return ab_rtsp_response_render(
+                &rtsp->responses[AB_RTSP_RESPONSE_NOT_FOUND],
+                response, response_size, cseq,
+                client->session_line, client->session_line_len);
+        }
+        ab_rtsp_transport_t *track = &client->tracks[index];
+
+        const char *param = NULL;
+        if (strstr(transport, "RTP/AVP/TCP") != NULL) {
             client->method = AB_RTSP_OVER_TCP;
-            sscanf(line, "Transport: RTP/AVP/TCP;unicast;interleaved=%hu-%hu\r\n", 
-                &client->rtp_chn_port, &client->rtcp_chn_port);
-        } else if (strstr(line, "RTP/AVP/UDP") != NULL) {
-            client->method = AB_RTSP_OVER_UDP;
-            sscanf(line, "Transport: RTP/AVP/UDP;unicast;client_port=%hu-%hu\r\n", 
-                &client->rtp_chn_port, &client->rtcp_chn_port);
-        } else if (strstr(line, "RTP/AVP") != NULL) {
+            mark_interleaved_media(rtsp, client);
+            param = strstr(transport, "interleaved=");
+            if (param) {
+                sscanf(param, "interleaved=%hu-%hu",
+                    &track->rtp_chn_port, &track->rtcp_chn_port);
+            }
+        } else if (strstr(transport, "RTP/AVP") != NULL) {
             client->method = AB_RTSP_OVER_UDP;
-            sscanf(line, "Transport: RTP/AVP;unicast;client_port=%hu-%hu\r\n", 
-                &client->rtp_chn_port, &client->rtcp_chn_port);
-        } else {
+            param = strstr(transport, "client_port=");
+            if (param) {
+                sscanf(param, "client_port=%hu-%hu",
+                    &track->rtp_chn_port, &track->rtcp_chn_port);
+            }
+        }
+
+        if (NULL == param) {
             return 0;
         }
+        track->setup = true;
 
-        len = handle_cmd_setup(response, response_size, cseq, client->method, 
-            client->rtp_chn_port, client->rtcp_chn_port);
-    } else if (strcmp(method, "PLAY") == 0) {
-        len = handle_cmd_play(response, response_size, cseq);
-        client->ready = true;
-    } else if (strcmp(method, "TEARDOWN") == 0) {
+        if (file && NULL == client->vod) {
+            client->vod_file    = file;
+            client->vod         = ab_rtsp_vod_new(file->source, RTSP_VIDEO_SSRC,
+                RTP_MAX_SIZE, session_packet_cb, client);
+        }
+
+        if (NULL == client->session) {
+            client->session = ab_rtsp_session_table_add(rtsp->sessions, client);
+            if (rtsp->session_timeout > 0) {
+                client->session->timer = ab_timer_wheel_add(rtsp->timers,
+                    rtsp->session_timeout * 1000, session_expired_cb, client);
+            }
+
+            client->session_line_len = snprintf(client->session_line,
+                sizeof(client->session_line), "Session: %s;timeout=%u\r\n",
+                client->session->id, rtsp->session_timeout);
+        }
+
+        return handle_cmd_setup(response, response_size, cseq,
+            client->session_line, client->method,
+            track->rtp_chn_port, track->rtcp_chn_port,
+            rtsp->rtp_server_port, rtsp->rtcp_server_port);
+    } else if (ab_rtsp_slice_equal(method, "PLAY")) {
+        if (NULL == client->session) {
+            reply = &rtsp->responses[AB_RTSP_RESPONSE_SESSION_NOT_FOUND];
+        } else if (client->vod) {
+            return handle_cmd_vod_play(rtsp, client, request,
+                response, response_size);
+        } else {
+            int len = rtsp->dvr ? handle_cmd_timeshift_play(rtsp, client,
+                request, response, response_size) : 0;
+            if (len > 0)
+                return len;
+            reply = &rtsp->responses[AB_RTSP_RESPONSE_PLAY];
+            client->ready = true;
+        }
+    } else if (ab_rtsp_slice_equal(method, "PAUSE")) {
+        // live viewers resume where they paused when timeshift is enabled,
+        // otherwise at the live edge
+        if (NULL == client->session) {
+            reply = &rtsp->responses[AB_RTSP_RESPONSE_SESSION_NOT_FOUND];
+        } else {
+            reply = &rtsp->responses[AB_RTSP_RESPONSE_OK];
+            client->ready = false;
+            if (client->vod) {
+                ab_rtsp_vod_pause(client->vod);
+            } else if (client->timeshift) {
+                ab_rtsp_timeshift_pause(client->timeshift);
+            } else if (rtsp->dvr) {
+                client->timeshift = ab_rtsp_timeshift_new(rtsp->dvr,
+                    rtsp->video_codec, RTSP_VIDEO_SSRC, RTP_MAX_SIZE,
+                    session_packet_cb, client);
+                if (ab_rtsp_timeshift_seek_npt(client->timeshift, 0) < 0)
+                    ab_rtsp_timeshift_free(&client->timeshift);
+            }
+        }
+    } else if (ab_rtsp_slice_equal(method, "TEARDOWN")) {
         // IINA测试响应TEARDOWN会收到SIGPIPE信号，导致程序异常退出
-        // len = handle_cmd_teardown(response, response_size, cseq);
-        len = 0;
         client->ready = false;
+        release_session(rtsp, client);
+        return 0;
+    } else if (ab_rtsp_slice_equal(method, "GET_PARAMETER")) {
+        // keepalive, the body (if any) asks for nothing we report
+        reply = &rtsp->responses[AB_RTSP_RESPONSE_OK];
     } else {
-        len = handle_cmd_not_supported(response, response_size, cseq);
+        reply = &rtsp->responses[AB_RTSP_RESPONSE_NOT_SUPPORTED];
+    }
+
+    return ab_rtsp_response_render(reply, response, response_size, cseq,
+        client->session_line, client->session_line_len);
+}
+
+/*
+ * RTCP(RFC 3550 6.4)：版本2，第一个包为SR或RR
+ */
+static bool is_rtcp_report(const unsigned char *data, unsigned int len) {
+    return len >= 8 && 2 == (data[0] >> 6) && (200 == data[1] || 201 == data[1]);
+}
+
+/*
+ * channel: interleaved通道号或UDP端口
+ */
+static bool is_rtcp_channel(const ab_rtsp_client_t *client, unsigned int channel) {
+    for (int i = 0; i < AB_RTSP_TRACK_COUNT; ++i) {
+        if (client->tracks[i].setup && client->tracks[i].rtcp_chn_port == channel)
+            return true;
+    }
+    return false;
+}
+
+/*
+ * 按报告块的SSRC找到轨道，记下丢包、抖动和RTT
+ */
+static void update_receiver_stats(T rtsp, ab_rtsp_client_t *client,
+    const unsigned char *data, unsigned int len) {
+    add_counter(rtsp, AB_RTSP_COUNTER_RTCP_REPORTS, 1);
+
+    ab_rtcp_report_block_t blocks[4];
+    int nblocks = ab_rtcp_report_blocks(data, len, blocks,
+        sizeof(blocks) / sizeof(blocks[0]));
+    uint64_t now = ab_rtcp_ntp_now();
+    for (int i = 0; i < nblocks; ++i) {
+        int index = -1;
+        if (RTSP_VIDEO_SSRC == blocks[i].ssrc)
+            index = AB_RTSP_TRACK_VIDEO;
+        else if (RTSP_AUDIO_SSRC == blocks[i].ssrc)
+            index = AB_RTSP_TRACK_AUDIO;
+        if (index < 0 || !client->tracks[index].setup)
+            continue;
+
+        ab_rtsp_track_stats_t *stats = &client->tracks[index].stats;
+        stats->fraction_lost    = blocks[i].fraction_lost;
+        stats->cumulative_lost  = blocks[i].cumulative_lost;
+        stats->jitter           = blocks[i].jitter;
+        unsigned int rtt = ab_rtcp_rtt_us(now, &blocks[i]);
+        if (rtt > 0)
+            stats->rtt_us = rtt;
+    }
+}
+
+/*
+ * return: 轨道没有SETUP或还没有发过包返回-1
+ */
+static int format_sender_report(T rtsp, ab_rtsp_client_t *client, int index,
+    uint64_t now_us, uint64_t ntp, unsigned char *buf) {
+    ab_rtsp_transport_t *track = &client->tracks[index];
+    const ab_rtsp_clock_t *clock = !live_viewer(client) && AB_RTSP_TRACK_VIDEO == index ?
+        &client->session_clock : &rtsp->clocks[index];
+    unsigned int rate = AB_RTSP_TRACK_VIDEO == index ? 90000 :
+        rtsp->audio_config.sample_rate;
+    if (!track->setup || !clock->valid || 0 == rate)
+        return -1;
+
+    uint32_t timestamp = clock->timestamp +
+        (uint32_t) ((now_us - clock->at_us) * rate / 1000000);
+    // payload octets, without the 12-byte RTP header
+    uint32_t octets = (uint32_t) (track->stats.bytes -
+        track->stats.packets * sizeof(ab_rtp_header_t));
+
+    return ab_rtcp_sender_report(
+        AB_RTSP_TRACK_VIDEO == index ? RTSP_VIDEO_SSRC : RTSP_AUDIO_SSRC,
+        ntp, timestamp, (uint32_t) track->stats.packets, octets, buf, AB_RTCP_SR_SIZE);
+}
+
+/*
+ * packet前留有interleaved头的位置
+ * return: 发送失败关闭连接后返回-1
+ */
+static int send_rtcp_to_client(T rtsp, ab_rtsp_client_t *client,
+    ab_rtsp_transport_t *track, unsigned char *packet, unsigned int rtcp_len) {
+    unsigned char *rtcp = packet + sizeof(ab_rtsp_interleaved_frame_t);
+    if (AB_RTSP_OVER_UDP == client->method) {
+        char addr_buf[32];
+        ab_socket_addr(client->sock, addr_buf, sizeof(addr_buf));
+        ab_udp_client_send(rtsp->rtcp_udp_srv, addr_buf, track->rtcp_chn_port,
+            rtcp, rtcp_len);
+        return 0;
+    }
+
+    unsigned int len = sizeof(ab_rtsp_interleaved_frame_t) + rtcp_len;
+    ab_rtsp_fill_interleaved_frame((ab_rtsp_interleaved_frame_t *) packet,
+        track->rtcp_chn_port, rtcp_len);
+    // a report the buffer has no room for is skipped
+    return write_interleaved(rtsp, client, packet, len) < 0 ? -1 : 0;
+}
+
+/*
+ * 每个轨道一个SR，观看端的RR据此带回LSR/DLSR
+ */
+static void send_sender_reports(T rtsp, ab_rtsp_client_t *client) {
+    uint64_t now_us = monotonic_us();
+    uint64_t ntp = ab_rtcp_ntp_now();
+
+    for (int i = 0; i < AB_RTSP_TRACK_COUNT; ++i) {
+        unsigned char report[sizeof(ab_rtsp_interleaved_frame_t) + AB_RTCP_SR_SIZE];
+        if (format_sender_report(rtsp, client, i, now_us, ntp,
+            report + sizeof(ab_rtsp_interleaved_frame_t)) < 0)
+            continue;
+        if (send_rtcp_to_client(rtsp, client, &client->tracks[i],
+            report, AB_RTCP_SR_SIZE) < 0)
+            return;
+    }
+}
+
+/*
+ * 点播结束：SR+BYE复合包(RFC 3550 6.6)，之后停在结尾，PLAY带Range可以重新开始
+ */
+static void send_vod_bye(T rtsp, ab_rtsp_client_t *client) {
+    unsigned char packet[sizeof(ab_rtsp_interleaved_frame_t) +
+        AB_RTCP_SR_SIZE + AB_RTCP_BYE_SIZE];
+    unsigned char *rtcp = packet + sizeof(ab_rtsp_interleaved_frame_t);
+    if (format_sender_report(rtsp, client, AB_RTSP_TRACK_VIDEO,
+        monotonic_us(), ab_rtcp_ntp_now(), rtcp) < 0)
+        return;
+
+    ab_rtcp_bye(RTSP_VIDEO_SSRC, rtcp + AB_RTCP_SR_SIZE, AB_RTCP_BYE_SIZE);
+    print_sock_info(client->sock, "end of stream.");
+    send_rtcp_to_client(rtsp, client, &client->tracks[AB_RTSP_TRACK_VIDEO],
+        packet, AB_RTCP_SR_SIZE + AB_RTCP_BYE_SIZE);
+}
+
+/*
+ * 定时器每RTSP_SESSION_TICK_MS触发一次，发送各点播、时移会话到期的帧
+ */
+static void send_sessions(T rtsp) {
+    uint64_t expirations;
+    if (read(rtsp->session_timer_fd, &expirations, sizeof(expirations)) < 0)
+        return;
+
+    uint64_t now_us = monotonic_us();
+    bool playing = false;
+    for (list_t node = rtsp->clients; node; node = node->rest) {
+        ab_rtsp_client_t *client = node->first;
+        if (live_viewer(client) || !client->ready || NULL == client->sock)
+            continue;
+        if (client->vod ? !ab_rtsp_vod_playing(client->vod) :
+            !ab_rtsp_timeshift_playing(client->timeshift))
+            continue;
+        playing = true;
+
+        // frames wait for a congested TCP viewer instead of being dropped
+        if (AB_RTSP_OVER_TCP == client->method &&
+            congestion_level(rtsp, client) != AB_RTSP_DROP_NONE)
+            continue;
+
+        if (client->timeshift) {
+            ab_rtsp_timeshift_send(client->timeshift, now_us, RTSP_SESSION_MAX_BURST);
+            continue;
+        }
+        if (ab_rtsp_vod_send(client->vod, now_us, RTSP_SESSION_MAX_BURST) ==
+            AB_RTSP_VOD_END && client->sock) {
+            send_vod_bye(rtsp, client);
+            client->ready = false;
+        }
     }
 
-    return len;
+    if (!playing)
+        arm_session_timer(rtsp, false);
+}
+
+static void send_reports(T rtsp) {
+    uint64_t now = monotonic_ms();
+    if (now - rtsp->last_report_ms < RTSP_SR_INTERVAL_MS)
+        return;
+    rtsp->last_report_ms = now;
+
+    for (list_t node = rtsp->clients; node; node = node->rest) {
+        ab_rtsp_client_t *client = node->first;
+        if (client->ready && client->sock)
+            send_sender_reports(rtsp, client);
+    }
 }
 
-static void recv_client_msg(ab_rtsp_client_t *client) {
+static void recv_client_msg(T rtsp, ab_rtsp_client_t *client) {
+    assert(rtsp);
     assert(client);
 
-    char request[4096];
-    memset(request, 0, sizeof(request));
-    int nread = ab_socket_recv(client->sock, (unsigned char *) request, sizeof(request));
+    unsigned int space = 0;
+    char *buf = ab_rtsp_parser_buffer(client->parser, &space);
+    int nread = ab_socket_recv(client->sock, (unsigned char *) buf, space);
     if (nread < 0) {
         AB_LOGGER_ERROR("return %d, %s.\n", nread, strerror(errno));
+        return;
     } else if (0 == nread) {
-        print_sock_info(client->sock, "close connection.");
-        ab_socket_free(&client->sock);
-    } else {
-        AB_LOGGER_DEBUG("request:\n%s\n", request);
-        const unsigned int response_size = 1024;
-        char response[response_size];
-        memset(response, 0, response_size);
-        int len = process_client_request(client, request, nread,
-            response, response_size);
-        AB_LOGGER_DEBUG("response:\n%s\n", response);
-        if (len > 0) {
-            int nsend = ab_socket_send(client->sock, (unsigned char *) response, len);
-            if (nsend != len) {
-                AB_LOGGER_DEBUG("ab_socket_send error.\n");
+        close_client(rtsp, client, "close connection.");
+        return;
+    }
+
+    ab_rtsp_parser_commit(client->parser, nread);
+
+    // a segment may carry several pipelined requests and interleaved frames
+    ab_rtsp_message_t request;
+    int ret;
+    while ((ret = ab_rtsp_parser_next(client->parser, &request)) !=
+        AB_RTSP_PARSE_NEED_MORE) {
+        if (AB_RTSP_PARSE_ERROR == ret) {
+            close_client(rtsp, client, "bad request, close connection.");
+            return;
+        } else if (AB_RTSP_PARSE_INTERLEAVED == ret) {
+            // RTCP receiver reports from TCP viewers prove they are alive
+            if (is_rtcp_channel(client, request.channel) &&
+                is_rtcp_report((const unsigned char *) request.payload.data,
+                    request.payload.len)) {
+                refresh_session(rtsp, client);
+                update_receiver_stats(rtsp, client,
+                    (const unsigned char *) request.payload.data, request.payload.len);
             }
+            continue;
+        }
+
+        AB_LOGGER_DEBUG("request:\n%.*s\n",
+            (int) (request.body.data + request.body.len -
+                ab_rtsp_message_method(&request)->data),
+            ab_rtsp_message_method(&request)->data);
+        // DESCRIBE carries the SDP with base64 parameter sets
+        char response[RTSP_RESPONSE_MAX_SIZE];
+        int len = process_client_request(rtsp, client, &request,
+            response, sizeof(response));
+        AB_LOGGER_DEBUG("response:\n%.*s\n", len, response);
+        if (len > 0 && send_response(rtsp, client, response, len) < 0)
+            return;
+    }
+}
+
+/*
+ * UDP viewers send RTCP to our RTCP port, match them by address and port
+ */
+static void recv_rtcp_report(T rtsp) {
+    char addr[32];
+    unsigned short port = 0;
+    unsigned char buf[1500];
+    int len = ab_udp_client_recv(rtsp->rtcp_udp_srv,
+        addr, sizeof(addr), &port, buf, sizeof(buf), 0);
+    if (len <= 0 || !is_rtcp_report(buf, len))
+        return;
+
+    list_t node = rtsp->clients;
+    while (node) {
+        ab_rtsp_client_t *client = node->first;
+        if (client->sock && AB_RTSP_OVER_UDP == client->method &&
+            is_rtcp_channel(client, port)) {
+            char client_addr[32];
+            ab_socket_addr(client->sock, client_addr, sizeof(client_addr));
+            if (strcmp(client_addr, addr) == 0) {
+                refresh_session(rtsp, client);
+                update_receiver_stats(rtsp, client, buf, len);
+            }
+        }
+        node = node->rest;
+    }
+}
+
+/*
+ * 参数集拷贝出来，SDP和ab_sps_info_t与直播的格式一样
+ */
+static void init_vod_file(T rtsp, ab_rtsp_vod_file_t *file,
+    const char *name, ab_file_source_t source) {
+    snprintf(file->name, sizeof(file->name), "%s", name);
+    file->source = source;
+
+    for (int i = 0; i < AB_NALU_PARAMETER_SET_COUNT; ++i) {
+        unsigned int len = 0;
+        const unsigned char *data = ab_file_source_parameter_set(source, i, &len);
+        if (NULL == data || 0 == len)
+            continue;
+
+        file->parameter_sets[i].data = ALLOC(len);
+        memcpy(file->parameter_sets[i].data, data, len);
+        file->parameter_sets[i].size = len;
+        file->parameter_sets[i].used = len;
+    }
+
+    const ab_buffer_t *sps = &file->parameter_sets[AB_NALU_PARAMETER_SET_SPS];
+    file->sps_valid = sps->used > 0 &&
+        ab_sps_parse(rtsp->video_codec, sps->data, sps->used, &file->sps_info) == 0;
+    ab_file_source_frame_duration(source,
+        &file->frame_duration_num, &file->frame_duration_den);
+}
+
+/*
+ * 点播、时移会话共用的定时器，第一次用到时创建
+ */
+static int open_session_timer(T rtsp) {
+    if (rtsp->session_timer_fd >= 0)
+        return 0;
+
+    rtsp->session_timer_fd = timerfd_create(CLOCK_MONOTONIC,
+        TFD_NONBLOCK | TFD_CLOEXEC);
+    if (rtsp->session_timer_fd < 0) {
+        AB_LOGGER_ERROR("timerfd_create failed, %s.\n", strerror(errno));
+        return -1;
+    }
+
+    ab_rtsp_watch_fd(rtsp, rtsp->session_timer_fd, &rtsp->session_io);
+    return 0;
+}
+
+int ab_rtsp_server_add_vod(T rtsp, const char *name, ab_file_source_t source) {
+    assert(rtsp);
+    assert(name);
+    assert(source);
+
+    if (ab_file_source_codec(source) != rtsp->video_codec ||
+        0 == ab_file_source_frame_count(source) ||
+        '\0' == name[0] || strchr(name, '/') != NULL ||
+        strlen(name) >= sizeof(rtsp->vod_files[0].name))
+        return -1;
+
+    int result = 0;
+    pthread_mutex_lock(&rtsp->mutex);
+    if (rtsp->vod_file_count >= RTSP_MAX_VOD_FILES) {
+        result = -1;
+    } else {
+        for (unsigned int i = 0; i < rtsp->vod_file_count; ++i) {
+            if (strcmp(rtsp->vod_files[i].name, name) == 0)
+                result = -1;
         }
     }
+
+    if (0 == result)
+        result = open_session_timer(rtsp);
+
+    if (0 == result) {
+        init_vod_file(rtsp, &rtsp->vod_files[rtsp->vod_file_count++], name, source);
+        AB_LOGGER_INFO("vod \"%s\", %u frames, %.3f s.\n", name,
+            ab_file_source_frame_count(source),
+            ab_file_source_duration_us(source) / 1000000.0);
+    }
+    pthread_mutex_unlock(&rtsp->mutex);
+
+    return result;
+}
+
+int ab_rtsp_server_set_timeshift(T rtsp, unsigned int size,
+    unsigned int max_frames) {
+    assert(rtsp);
+
+    if (0 == size || 0 == max_frames)
+        return -1;
+
+    // the ingest thread appends to rtsp->dvr under ingest_mutex only
+    pthread_mutex_lock(&rtsp->ingest_mutex);
+    pthread_mutex_lock(&rtsp->mutex);
+    int result = rtsp->dvr ? -1 : open_session_timer(rtsp);
+    if (0 == result) {
+        rtsp->dvr = ab_rtsp_dvr_new(size, max_frames);
+        AB_LOGGER_INFO("timeshift %u bytes, %u frames.\n", size, max_frames);
+    }
+    pthread_mutex_unlock(&rtsp->mutex);
+    pthread_mutex_unlock(&rtsp->ingest_mutex);
+
+    return result;
 }
 
 void *event_looper_cb(void *arg) {
     assert(arg);
 
     T rtsp = (T) arg;
+    struct epoll_event events[RTSP_MAX_EVENTS];
 
     while (!rtsp->quit) {
-        fd_set rfds;
-        int max_fd = -1;
+        // wakes up at least twice per timer wheel tick
+        int nums = epoll_wait(rtsp->epoll_fd, events, RTSP_MAX_EVENTS,
+            RTSP_TIMER_TICK_MS / 2);
+        if (nums < 0) {
+            if (EINTR == errno)
+                continue;
+            break;
+        }
 
-        FD_ZERO(&rfds);
         pthread_mutex_lock(&rtsp->mutex);
-        list_t client = rtsp->clients;
-        while (client) {
-            ab_rtsp_client_t *rtsp_client = client->first;
-            int fd = ab_socket_fd(rtsp_client->sock);
-            FD_SET(fd, &rfds);
-            if (fd > max_fd) {
-                max_fd = fd;
+        for (int i = 0; i < nums; ++i) {
+            ab_rtsp_io_t *io = (ab_rtsp_io_t *) events[i].data.ptr;
+            if (AB_RTSP_IO_LISTENER == io->kind ||
+                AB_RTSP_IO_METRICS_LISTENER == io->kind) {
+                // new viewers are served from this very wakeup
+                ab_rtsp_listener_t *listener = (ab_rtsp_listener_t *) io->object;
+                if (listener->tcp_srv)
+                    ab_tcp_server_accept(listener->tcp_srv);
+            } else if (AB_RTSP_IO_RTCP == io->kind) {
+                recv_rtcp_report(rtsp);
+            } else if (AB_RTSP_IO_SESSIONS == io->kind) {
+                send_sessions(rtsp);
+            } else if (AB_RTSP_IO_METRICS == io->kind) {
+                ab_rtsp_metrics_conn_t *conn = (ab_rtsp_metrics_conn_t *) io->object;
+                if (conn->sock)
+                    ab_rtsp_process_metrics_conn(rtsp, conn);
+            } else {
+                // closed clients stay in the list until update_clients_list
+                ab_rtsp_client_t *client = (ab_rtsp_client_t *) io->object;
+                if (client->sock && (events[i].events & EPOLLOUT))
+                    drain_backlog(rtsp, client);
+                if (client->sock && (events[i].events & ~EPOLLOUT))
+                    recv_client_msg(rtsp, client);
             }
-            client = client->rest;
         }
-        pthread_mutex_unlock(&rtsp->mutex);
 
-        if (-1 == max_fd) {
-            usleep(50 * 1000);
-        } else {
-            struct timeval timeout;
-            timeout.tv_sec = 0;
-            timeout.tv_usec = 50 * 1000;
-            int nums = select(max_fd + 1, &rfds, NULL, NULL, &timeout);
-            if (nums < 0) {
-                break;
-            } else if (0 == nums) {
-                continue;
-            }
-
-            pthread_mutex_lock(&rtsp->mutex);
-            list_t client = rtsp->clients;
-            while (client) {
-                ab_rtsp_client_t *rtsp_client = client->first;
-                int fd = ab_socket_fd(rtsp_client->sock);
-                if (FD_ISSET(fd, &rfds)) {
-                    recv_client_msg(rtsp_client);
-                }
-
-                client = client->rest;
-            }
-            rtsp->clients = update_clients_list(rtsp->clients);
-            pthread_mutex_unlock(&rtsp->mutex);
-        }
+        // expired sessions close their connections here
+        ab_timer_wheel_advance(rtsp->timers);
+        send_reports(rtsp);
+        rtsp->clients = update_clients_list(rtsp->clients);
+        rtsp->metrics_conns = ab_rtsp_update_metrics_conns(rtsp->metrics_conns);
+        pthread_mutex_unlock(&rtsp->mutex);
     }
 
     return NULL;
-}
\ No newline at end of file
+}
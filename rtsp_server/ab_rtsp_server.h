@@ -12,17 +12,292 @@
 extern "C" {
 #endif
 
+#include "ab_rtp_pacer.h"
+#include "ab_file_source.h"
+
+#include "ab_base/ab_histogram.h"
+
+#include "ab_net/ab_socket.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * 多进程：一个推流进程把打包好的视频RTP写入共享内存包环，
+ * 最多AB_RTSP_MAX_WORKERS个worker进程用SO_REUSEPORT共用RTSP端口，各自服务一部分观看端
+ */
+#define AB_RTSP_MAX_WORKERS     64
+
 #define T ab_rtsp_server_t
 typedef struct T *T;
 
+/*
+ * 从码流SPS中解析出的视频信息
+ */
+typedef struct ab_rtsp_video_info_t {
+    unsigned int    width;
+    unsigned int    height;
+    unsigned int    profile_idc;
+    unsigned int    level_idc;
+    bool            timing_info;        // SPS带VUI timing_info
+    double          frame_rate;         // 打时间戳用的帧率，没有timing_info时为25
+} ab_rtsp_video_info_t;
+
+/*
+ * 一路流(视频或音频)各阶段的延时，微秒，从创建起累计
+ * 起点是把该NAL/ADTS帧交给打包器的那次ab_rtsp_server_send(_audio)调用
+ */
+typedef struct ab_rtsp_latency_stats_t {
+    ab_histogram_summary_t packetize;   // 调用 -> 打包器输出RTP包
+    ab_histogram_summary_t send;        // RTP包 -> 最后一个观看端的send()返回，含平滑发送排队
+    ab_histogram_summary_t total;       // 调用 -> 最后一个观看端的send()返回
+} ab_rtsp_latency_stats_t;
+
+/*
+ * 服务端累计计数，从创建起单调增加(connections、viewers、pacer_queue为当前值)
+ */
+typedef struct ab_rtsp_stats_t {
+    // ingest
+    uint64_t        ingest_bytes;       // ab_rtsp_server_send的字节数
+    uint64_t        nal_units;
+    uint64_t        frames;             // 视频访问单元
+    uint64_t        key_frames;
+    uint64_t        audio_bytes;        // ab_rtsp_server_send_audio的字节数
+    uint64_t        audio_frames;       // AAC AU
+
+    // packetize
+    uint64_t        rtp_packets;        // 视频
+    uint64_t        rtp_bytes;
+    uint64_t        audio_packets;
+    uint64_t        fec_packets;
+
+    // send, over all viewers
+    uint64_t        sent_packets;
+    uint64_t        sent_bytes;
+    uint64_t        send_errors;
+    uint64_t        dropped_packets;    // 拥塞丢弃
+
+    uint64_t        accepted;           // RTSP连接
+    uint64_t        rtcp_reports;       // 收到的RTCP RR/SR
+
+    unsigned int    connections;
+    unsigned int    viewers;            // PLAY之后的连接
+    unsigned int    pacer_queue;        // 平滑发送队列中的包，未开启时为0
+
+    ab_rtsp_latency_stats_t latency[2]; // 0: 视频，1: 音频；没有观看端的包不计入send/total
+} ab_rtsp_stats_t;
+
+/*
+ * 观看端一个轨道的计数，丢包、抖动、RTT来自其RTCP接收报告
+ */
+typedef struct ab_rtsp_track_stats_t {
+    bool            setup;
+    uint64_t        packets;
+    uint64_t        bytes;
+    unsigned int    fraction_lost;      // 最近一个报告间隔，x/256
+    int32_t         cumulative_lost;
+    uint32_t        jitter;             // RTP时间戳单位
+    unsigned int    rtt_us;             // 0: 还没有带LSR的报告
+} ab_rtsp_track_stats_t;
+
+typedef struct ab_rtsp_viewer_stats_t {
+    char            addr[48];
+    unsigned short  port;
+    bool            tcp;                // RTP over TCP
+    bool            playing;
+    uint64_t        dropped;            // 拥塞丢弃的包
+    uint64_t        send_errors;
+    int             send_queue;         // TCP发送队列中的字节，不支持时为-1
+    ab_rtsp_track_stats_t tracks[2];    // 0: 视频，1: 音频
+} ab_rtsp_viewer_stats_t;
+
 /*
  * video_codec: 1(H.264)、2(H.265)  
+ * port为0时不监听RTSP，只打包，如多进程的推流进程
  */
 extern T    ab_rtsp_server_new(unsigned short port, int video_codec);
+/*
+ * 多进程的worker：RTSP端口设置SO_REUSEPORT，与其他worker共用；
+ * RTP/RTCP用20001/20002之后各自的一对端口，RTCP回到服务它的worker
+ * worker: 0~AB_RTSP_MAX_WORKERS-1，进程间不能重复
+ */
+extern T    ab_rtsp_server_new_worker(unsigned short port, int video_codec,
+    unsigned int worker);
 extern void ab_rtsp_server_free(T *rtsp);
 
 extern int  ab_rtsp_server_send(T rtsp, const char *data, unsigned int data_len);
 
+/*
+ * 发送一个完整的NALU(不含起始码)，不经过拼接缓存，可直接传入mmap的数据
+ * 一帧发完后调用ab_rtsp_server_send(rtsp, NULL, 0)；不要与有数据的
+ * ab_rtsp_server_send交替使用
+ */
+extern int  ab_rtsp_server_send_nalu(T rtsp, const unsigned char *nalu,
+    unsigned int nalu_len);
+
+/*
+ * 转发：rtp为拉流收到的一个完整视频RTP包，编码须与video_codec相同
+ * 只改写SSRC、序列号、时间戳和负载类型，分片、聚合原样转发，不解包再打包；
+ * 单NALU和聚合包中的参数集用于生成SDP，标记位或时间戳变化结束一帧
+ * 不要与ab_rtsp_server_send(_nalu)混用；转发的流不进入时移缓冲
+ * return: 不是H.264/H.265的RTP包返回-1
+ */
+extern int  ab_rtsp_server_send_rtp(T rtsp, const unsigned char *rtp,
+    unsigned int rtp_len);
+
+/*
+ * RTP/UDP推流：编码器把视频RTP推到port，按序列号重排(64包/20ms窗口)后
+ * 由接收线程按ab_rtsp_server_send_rtp转发；rtcp-mux的RTCP忽略
+ * port为0时关闭；不要与其他推流接口同时使用
+ * return: 端口绑定失败返回-1
+ */
+extern int  ab_rtsp_server_set_rtp_ingest(T rtsp, unsigned short port);
+
+/*
+ * 共享内存推流：编码器进程用ab_shm_ring_create(name)/ab_shm_ring_write写入
+ * 不含起始码的NALU，timestamp为微秒，一帧的最后一个NALU带AB_SHM_RING_FRAME_END；
+ * 接收线程在共享内存上原地打包，不拷贝；从关键帧开始，写者重启或被覆盖后
+ * 丢弃到下一个关键帧，共享内存还不存在时后台重试
+ * name为NULL时关闭；不要与其他推流接口同时使用
+ */
+extern int  ab_rtsp_server_set_shm_ingest(T rtsp, const char *name);
+
+/*
+ * 推流进程：发给观看端的每个视频RTP包(不含FEC)同时写入共享内存包环，
+ * 关键帧的第一个包带AB_SHM_RING_KEY，一帧的最后一个包(标记位)带AB_SHM_RING_FRAME_END
+ * 在推流前调用；size见ab_shm_ring_create，至少能放下几个关键帧
+ * name为NULL时关闭
+ * return: 创建共享内存失败返回-1
+ */
+extern int  ab_rtsp_server_set_packet_ring(T rtsp, const char *name,
+    unsigned int size);
+/*
+ * worker进程：接收线程从包环按ab_rtsp_server_send_rtp转发，不再打包；
+ * 从关键帧开始，推流进程重启或被覆盖后丢弃到下一个关键帧，序列号和
+ * 时间戳对观看端保持连续；包环还不存在时后台重试
+ * name为NULL时关闭；不要与其他推流接口同时使用
+ */
+extern int  ab_rtsp_server_set_packet_ring_ingest(T rtsp, const char *name);
+
+/*
+ * AAC音频轨(SDP track1)，在观看端连接前调用
+ * sample_rate/channels: 预设值，ADTS头与之不同时以ADTS头为准
+ * max_aus: 每个RTP包最多聚合的AU数，1~8，每多一个多约20ms延时
+ * sample_rate为0时关闭音频轨
+ * 与ab_rtsp_server_send_audio互斥
+ */
+extern int  ab_rtsp_server_set_audio(T rtsp, unsigned int sample_rate,
+    unsigned int channels, unsigned int max_aus);
+
+/*
+ * ADTS流，可任意切分；data为NULL时发送已聚合的AU
+ * 可与ab_rtsp_server_send在不同线程调用
+ */
+extern int  ab_rtsp_server_send_audio(T rtsp, const char *data, unsigned int data_len);
+
+/*
+ * UDP观看端的XOR FEC(RFC 5109)
+ * idr_group: 关键帧(含参数集)每多少个RTP包生成一个FEC包
+ * group: 其他帧每多少个RTP包生成一个FEC包
+ * 取值1~16，0表示不保护；两者都为0时关闭FEC
+ * FEC包用自己的SSRC和序列号，与视频同一端口，按负载类型区分
+ * 推流中可以调用，与ab_rtsp_server_send互斥
+ */
+extern int  ab_rtsp_server_set_fec(T rtsp, int idr_group, int group);
+
+/*
+ * 平滑发送：每帧的RTP包均匀分布在帧间隔的spread_percent%内发出
+ * pacer: 多个流可共享一个调度线程，NULL时使用私有线程
+ * spread_percent: 1~100，0表示关闭
+ * 推流中可以调用，与ab_rtsp_server_send、ab_rtsp_server_send_audio互斥
+ */
+extern int  ab_rtsp_server_set_pacing(T rtsp, ab_rtp_pacer_t pacer,
+    unsigned int spread_percent);
+extern int  ab_rtsp_server_pacing_stats(T rtsp, ab_rtp_pacer_stats_t *stats);
+
+/*
+ * return: 还没有收到SPS返回-1，此时只有frame_rate有效
+ */
+extern int  ab_rtsp_server_video_info(T rtsp, ab_rtsp_video_info_t *info);
+
+/*
+ * RTSP端口的监听方式，在观看端连接前调用
+ * backlog: accept队列长度，<=0时为SOMAXCONN，默认SOMAXCONN
+ * listeners: 1~16，大于1时用SO_REUSEPORT打开多个监听socket，
+ * 每个都有自己的accept队列，重连风暴时不容易丢SYN
+ * 监听socket数变化时原来的socket被关闭，其中未接受的连接会被重置
+ */
+extern int  ab_rtsp_server_set_listen(T rtsp, int backlog, unsigned int listeners);
+
+/*
+ * 按用途(AB_SOCKET_ROLE_*)设置套接字选项，整组替换默认值
+ * CONTROL: 之后接入的和已连接的RTSP连接，默认TCP_NODELAY、发送超时2s、
+ * TCP_USER_TIMEOUT 10s；响应发送超时后连接被关闭；
+ * RTP over TCP不等待，发送缓冲区满时丢包并跳到下一个关键帧
+ * RTP: 发送UDP媒体的socket，默认发送缓冲4MB、DSCP AF41；
+ * RTP over TCP的连接也按这里的TOS/PRIORITY标记
+ * RTCP: 接收RTCP的socket，默认接收缓冲1MB
+ * return: 某项设置失败返回-1，其余项仍然生效
+ */
+extern int  ab_rtsp_server_set_socket_options(T rtsp, int role,
+    const ab_socket_options_t *options);
+extern int  ab_rtsp_server_socket_options(T rtsp, int role,
+    ab_socket_options_t *options);
+
+/*
+ * TCP观看端发送队列积压时的丢帧策略，按socket发送缓冲区的占用百分比；
+ * UDP观看端没有本地发送队列可看，不丢
+ * discard_percent: 超过时丢弃H.264非参考帧、H.265 sub-layer non-reference图像
+ * 和TemporalId > 0的图像，默认25；H.265丢了某个sub-layer的参考图像后，
+ * 该层及以上一直丢到下一个IRAP或者能切换上去的TSA/STSA
+ * skip_percent: 超过时丢弃所有包直到下一个IDR，默认50
+ * 0表示不启用该级
+ */
+extern int  ab_rtsp_server_set_drop_policy(T rtsp,
+    unsigned int discard_percent, unsigned int skip_percent);
+
+/*
+ * 超过seconds秒没有任何请求(OPTIONS、GET_PARAMETER等)或RTCP报告的会话
+ * 被关闭，默认60，0表示不超时
+ */
+extern int  ab_rtsp_server_set_session_timeout(T rtsp, unsigned int seconds);
+
+/*
+ * 计数器快照，计数器按线程分片，读取不阻塞发送
+ * latency的p50/p99/p999来自无锁直方图，误差不超过1/64
+ */
+extern int  ab_rtsp_server_stats(T rtsp, ab_rtsp_stats_t *stats);
+/*
+ * 最多取max_viewers个观看端
+ * return: 取到的个数
+ */
+extern int  ab_rtsp_server_viewer_stats(T rtsp,
+    ab_rtsp_viewer_stats_t *viewers, unsigned int max_viewers);
+
+/*
+ * 在port上提供Prometheus文本格式的指标(GET /metrics)，由事件循环处理
+ * port为0时关闭
+ */
+extern int  ab_rtsp_server_set_metrics_port(T rtsp, unsigned short port);
+
+/*
+ * 点播：url路径最后一段(不含/trackN)为name的请求从source播放，只有视频轨
+ * 每个会话有自己的播放位置，PLAY的Range: npt=定位到之前最近的关键帧，
+ * 支持PAUSE；所有会话共享source的mmap
+ * source的编码须与直播相同，在ab_rtsp_server_free之后由调用者关闭
+ * 最多16个文件，name不能重复、不能含'/'
+ */
+extern int  ab_rtsp_server_add_vod(T rtsp, const char *name, ab_file_source_t source);
+
+/*
+ * 直播时移：在内存里保留最近size字节、最多max_frames帧的视频，只有视频轨
+ * PLAY的Range: npt=N-从N秒前开始(npt=0-、now-为直播)，clock=从该UTC时刻开始，
+ * 都定位到之前最近的关键帧；PAUSE后PLAY从暂停处继续
+ * 在推流之前调用一次
+ */
+extern int  ab_rtsp_server_set_timeshift(T rtsp, unsigned int size,
+    unsigned int max_frames);
+
 #undef T
 
 #ifdef __cplusplus
@@ -0,0 +1,479 @@
+/*
+ * ab_rtsp_server_def.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ *
+ * ab_rtsp_server.c、ab_rtsp_ingest.c和ab_rtsp_stats.c共用的内部定义，不对外
+ */
+
+#ifndef AB_RTSP_SERVER_DEF_H_
+#define AB_RTSP_SERVER_DEF_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ab_rtsp_server.h"
+#include "ab_rtp_pacer.h"
+#include "ab_rtsp_parser.h"
+#include "ab_rtsp_response.h"
+#include "ab_rtsp_session.h"
+#include "ab_rtsp_vod.h"
+#include "ab_rtsp_dvr.h"
+#include "ab_rtsp_timeshift.h"
+#include "ab_udp_source.h"
+#include "ab_shm_source.h"
+
+#include "ab_base/ab_list.h"
+#include "ab_base/ab_timer_wheel.h"
+#include "ab_base/ab_counter.h"
+#include "ab_base/ab_histogram.h"
+
+#include "ab_net/ab_socket.h"
+#include "ab_net/ab_tcp_server.h"
+#include "ab_net/ab_udp_client.h"
+
+#include "ab_rtp/ab_rtp_def.h"
+#include "ab_rtp/ab_rtp_fec.h"
+#include "ab_rtp/ab_rtp_packetizer.h"
+#include "ab_rtp/ab_rtp_aac_packetizer.h"
+#include "ab_rtp/ab_aac.h"
+#include "ab_rtp/ab_nalu.h"
+#include "ab_rtp/ab_sps.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <arpa/inet.h>
+
+#define T ab_rtsp_server_t
+
+#define RTSP_MAX_LISTENERS              16
+#define RTSP_VIDEO_SSRC                 0x88923423
+#define RTSP_METRICS_REQUEST_SIZE       1024
+#define RTSP_STAMP_RING_SIZE            2048    // > pacer queue, by RTP sequence
+#define RTSP_STAMP_US_BITS              48
+#define RTSP_STAMP_US_MASK              ((UINT64_C(1) << RTSP_STAMP_US_BITS) - 1)
+#define RTSP_MAX_VOD_FILES              16
+
+enum ab_rtp_packet_kind_t {
+    AB_RTP_PACKET_MEDIA = 0,            // interleaved frame + RTP
+    AB_RTP_PACKET_FEC,                  // RTP only, UDP viewers
+    AB_RTP_PACKET_AUDIO                 // interleaved frame + RTP, never dropped
+};
+
+// flags or'ed into the packet kind, they travel through the pacer as its tag
+#define AB_RTP_PACKET_KIND_MASK         0x0f
+#define AB_RTP_PACKET_KEY               0x10
+#define AB_RTP_PACKET_NALU_START        0x20
+#define AB_RTP_PACKET_DISCARDABLE       0x40    // non-reference or TemporalId > 0
+#define AB_RTP_PACKET_TSA               0x80    // H.265 up-switch to any higher sub-layer
+#define AB_RTP_PACKET_STSA              0x100   // H.265 up-switch to this sub-layer
+// the highest TemporalId in the packet, the lowest one dropping it breaks
+#define AB_RTP_PACKET_TID_SHIFT         12
+#define AB_RTP_PACKET_BREAKS_SHIFT      16
+#define AB_RTP_PACKET_TID(tag)          (((tag) >> AB_RTP_PACKET_TID_SHIFT) & 0x07)
+#define AB_RTP_PACKET_BREAKS(tag)       (((tag) >> AB_RTP_PACKET_BREAKS_SHIFT) & 0x07)
+// TemporalId is 0~6
+#define AB_RTSP_TID_NONE                7
+
+// hot path counters, summed over threads by ab_rtsp_server_stats
+enum ab_rtsp_counter_id_t {
+    AB_RTSP_COUNTER_INGEST_BYTES = 0,
+    AB_RTSP_COUNTER_NAL_UNITS,
+    AB_RTSP_COUNTER_FRAMES,
+    AB_RTSP_COUNTER_KEY_FRAMES,
+    AB_RTSP_COUNTER_AUDIO_BYTES,
+    AB_RTSP_COUNTER_AUDIO_FRAMES,
+    AB_RTSP_COUNTER_RTP_PACKETS,
+    AB_RTSP_COUNTER_RTP_BYTES,
+    AB_RTSP_COUNTER_AUDIO_PACKETS,
+    AB_RTSP_COUNTER_FEC_PACKETS,
+    AB_RTSP_COUNTER_SENT_PACKETS,
+    AB_RTSP_COUNTER_SENT_BYTES,
+    AB_RTSP_COUNTER_SEND_ERRORS,
+    AB_RTSP_COUNTER_DROPPED_PACKETS,
+    AB_RTSP_COUNTER_ACCEPTED,
+    AB_RTSP_COUNTER_RTCP_REPORTS,
+    AB_RTSP_COUNTER_COUNT
+};
+
+enum ab_rtsp_drop_level_t {
+    AB_RTSP_DROP_NONE = 0,
+    AB_RTSP_DROP_DISCARDABLE,           // drop discardable NAL units
+    AB_RTSP_DROP_UNTIL_KEY              // drop everything up to the next IDR
+};
+
+enum ab_rtsp_over_method_t {
+    AB_RTSP_OVER_NONE = 0,
+    AB_RTSP_OVER_TCP,
+    AB_RTSP_OVER_UDP
+};
+
+enum ab_video_codec_t {                 // same values as @ab_nalu_codec_t
+    AB_VIDEO_CODEC_NONE = 0,
+    AB_VIDEO_CODEC_H264,
+    AB_VIDEO_CODEC_H265
+};
+
+enum ab_rtsp_track_t {                  // SDP a=control:track0/track1
+    AB_RTSP_TRACK_VIDEO = 0,
+    AB_RTSP_TRACK_AUDIO,
+    AB_RTSP_TRACK_COUNT
+};
+
+enum ab_rtsp_latency_id_t {
+    AB_RTSP_LATENCY_PACKETIZE = 0,      // ingest call -> RTP packet
+    AB_RTSP_LATENCY_SEND,               // RTP packet -> last viewer written
+    AB_RTSP_LATENCY_TOTAL,
+    AB_RTSP_LATENCY_COUNT
+};
+
+enum ab_rtsp_io_kind_t {
+    AB_RTSP_IO_LISTENER = 0,
+    AB_RTSP_IO_RTCP,
+    AB_RTSP_IO_CLIENT,
+    AB_RTSP_IO_METRICS_LISTENER,
+    AB_RTSP_IO_METRICS,
+    AB_RTSP_IO_SESSIONS                 // timerfd pacing VOD and timeshift sessions
+};
+
+// epoll_event.data.ptr, lives as long as the server or the client
+typedef struct ab_rtsp_io_t {
+    int             kind;               // @ab_rtsp_io_kind_t
+    void           *object;
+} ab_rtsp_io_t;
+
+typedef struct ab_rtsp_listener_t {
+    ab_rtsp_io_t    io;
+    ab_tcp_server_t tcp_srv;            // NULL when the slot is unused
+} ab_rtsp_listener_t;
+
+typedef struct ab_rtsp_interleaved_frame_t {
+    uint8_t         dollar_sign;        // '$' or 0x24
+    uint8_t         channel_identifier; // 0x00(Video RTP)、0x01(Video RTCP)、
+                                        // 0x02(Audio RTP)、0x03(Audio RTCP)
+    uint16_t        data_length;        // RTP length
+} ab_rtsp_interleaved_frame_t;
+
+typedef struct ab_buffer_t {
+    unsigned char  *data;
+    int             size;
+    int             used;
+} ab_buffer_t;
+
+enum ab_rtsp_response_id_t {
+    AB_RTSP_RESPONSE_OPTIONS = 0,
+    AB_RTSP_RESPONSE_PLAY,
+    AB_RTSP_RESPONSE_OK,                // TEARDOWN, GET_PARAMETER, PAUSE
+    AB_RTSP_RESPONSE_NOT_SUPPORTED,
+    AB_RTSP_RESPONSE_SESSION_NOT_FOUND,
+    AB_RTSP_RESPONSE_NOT_FOUND,         // SETUP of a track we do not have
+    AB_RTSP_RESPONSE_INVALID_RANGE,     // nothing buffered to shift to
+    AB_RTSP_RESPONSE_COUNT
+};
+
+typedef struct ab_rtsp_transport_t {
+    bool            setup;              // SETUP received for this track
+    unsigned short  rtp_chn_port;       // client_port or interleaved channel
+    unsigned short  rtcp_chn_port;
+    ab_rtsp_track_stats_t stats;        // sent, and the viewer's RTCP reports
+} ab_rtsp_transport_t;
+
+// RTP timestamp of the newest packet sent and when, for sender reports
+typedef struct ab_rtsp_clock_t {
+    bool            valid;
+    uint32_t        timestamp;
+    uint64_t        at_us;              // CLOCK_MONOTONIC
+} ab_rtsp_clock_t;
+
+// when a packet was ingested and packetized, written by the ingest thread and
+// read by whichever thread sends it; both carry the RTP sequence number in
+// the top bits, a slot reused by a newer packet no longer matches
+typedef struct ab_rtsp_stamp_t {
+    uint64_t        ingest;             // seq << 48 | CLOCK_MONOTONIC us
+    uint64_t        packetized;
+} ab_rtsp_stamp_t;
+
+// one HTTP request, served from the event loop and closed
+typedef struct ab_rtsp_metrics_conn_t {
+    ab_rtsp_io_t    io;
+    ab_socket_t     sock;               // NULL once closed
+    uint64_t        accepted_ms;
+    char            request[RTSP_METRICS_REQUEST_SIZE];
+    unsigned int    request_len;
+    char           *response;           // NULL while reading the request
+    unsigned int    response_len;
+    unsigned int    sent;
+} ab_rtsp_metrics_conn_t;
+
+// a file registered by ab_rtsp_server_add_vod, its SDP is described like the
+// live stream's but from the file's parameter sets
+typedef struct ab_rtsp_vod_file_t {
+    char            name[64];
+    ab_file_source_t source;
+    ab_buffer_t     parameter_sets[AB_NALU_PARAMETER_SET_COUNT];
+    ab_sps_info_t   sps_info;
+    bool            sps_valid;
+    uint64_t        frame_duration_num;
+    uint64_t        frame_duration_den;
+    ab_rtsp_response_t describe;
+    char            describe_url[128];
+} ab_rtsp_vod_file_t;
+
+typedef struct ab_rtsp_client_t {
+    T               server;
+    ab_rtsp_io_t    io;
+    ab_socket_t     sock;
+    ab_rtsp_parser_t parser;
+    int             video_codec;        // @ab_video_codec_t
+
+    bool            ready;              // 准备就绪为true（收到play)，否则为false
+    int             method;
+
+    ab_rtsp_transport_t tracks[AB_RTSP_TRACK_COUNT];
+
+    ab_rtsp_session_t *session;         // NULL before SETUP
+    char            session_line[64];   // "Session: id;timeout=60\r\n"
+    unsigned int    session_line_len;
+
+    bool            wait_key;           // skipping up to the next IDR
+    bool            dropping;           // current NAL unit, all fragments
+    uint8_t         drop_tid;           // this sub-layer and above lost a reference
+    uint16_t        seq_offset;         // dropped packets, hidden from the viewer
+    ab_buffer_t     backlog;            // unsent frame tail and queued responses
+    bool            writable;           // EPOLLOUT watched while backlog is not empty
+    unsigned long   dropped;
+    unsigned long   send_errors;
+
+    // on demand or timeshifted, these packetize for the one viewer and the
+    // live stream is not sent to it
+    ab_rtsp_vod_file_t *vod_file;
+    ab_rtsp_vod_t   vod;
+    ab_rtsp_timeshift_t timeshift;
+    ab_rtsp_clock_t session_clock;
+} ab_rtsp_client_t;
+
+struct T {
+    // the event loop accepts, reads requests and RTCP from one epoll set
+    int             epoll_fd;
+    unsigned short  port;               // 0: no RTSP listener
+    bool            reuse_port;         // a worker shares the port with its siblings
+    ab_rtsp_listener_t listeners[RTSP_MAX_LISTENERS];
+    unsigned int    listener_count;
+    ab_rtsp_io_t    rtcp_io;
+    list_t          clients;
+
+    ab_rtsp_listener_t metrics_listener;    // tcp_srv NULL when disabled
+    list_t          metrics_conns;
+
+    ab_udp_client_t rtp_udp_srv;
+    ab_udp_client_t rtcp_udp_srv;
+    unsigned short  rtp_server_port;    // sent in the SETUP response
+    unsigned short  rtcp_server_port;
+    ab_socket_options_t socket_options[AB_SOCKET_ROLE_COUNT];
+
+    ab_rtsp_session_table_t sessions;
+    ab_timer_wheel_t timers;            // session expiry, driven by the event loop
+    unsigned int    session_timeout;    // seconds, 0 never expires
+
+    int             video_codec;        // @ab_video_codec_t
+
+    // fixed responses, only CSeq and Session are patched in
+    ab_rtsp_response_t responses[AB_RTSP_RESPONSE_COUNT];
+
+    // DESCRIBE response for describe_url, rendered again only when the
+    // url, FEC or a parameter set changes
+    ab_rtsp_response_t describe;
+    char            describe_url[128];
+    long            sdp_session_id;
+    unsigned int    sdp_version;
+
+    // latest parameter sets seen in the stream, @ab_nalu_parameter_set_t
+    ab_buffer_t     parameter_sets[AB_NALU_PARAMETER_SET_COUNT];
+    ab_sps_info_t   sps_info;
+    bool            sps_valid;
+
+    ab_rtsp_vod_file_t vod_files[RTSP_MAX_VOD_FILES];
+    unsigned int    vod_file_count;
+    ab_rtsp_dvr_t   dvr;                // timeshift buffer, NULL when disabled
+
+    int             session_timer_fd;   // -1 until VOD or timeshift is enabled
+    ab_rtsp_io_t    session_io;
+    bool            session_timer_armed;
+
+    pthread_mutex_t mutex;
+    // held by the video ingest calls and by the setters that replace the
+    // state they use; taken before mutex, never the other way round
+    pthread_mutex_t ingest_mutex;
+    // the same for the audio ingest, between ingest_mutex and mutex
+    pthread_mutex_t audio_mutex;
+
+    bool            quit;
+    pthread_t       event_looper_thd;
+
+    ab_rtp_packetizer_t packetizer;
+    uint32_t        timestamp;
+    // frame duration in seconds = num / den, from the SPS timing info
+    uint64_t        frame_duration_num;
+    uint64_t        frame_duration_den;
+    uint64_t        timestamp_remainder;    // 90 kHz ticks * den not yet added
+    bool            au_has_vcl;         // current access unit has a slice
+    bool            au_key;             // and one of them is IDR/IRAP
+
+    // relayed RTP (ab_rtsp_server_send_rtp) keeps the source's numbering,
+    // shifted onto ours; rebased when the source SSRC changes or its clock jumps
+    ab_buffer_t     relay_buffer;       // interleaved headroom + packet
+    bool            relay_started;
+    uint32_t        relay_ssrc;
+    uint16_t        relay_seq_offset;
+    uint16_t        relay_next_seq;
+    uint32_t        relay_timestamp_offset;
+    uint32_t        relay_last_timestamp;   // source clock
+    bool            relay_in_frame;     // packets sent since the last frame end
+    ab_udp_source_t udp_source;         // RTP/UDP ingest, NULL when disabled
+
+    // shared memory ingest stamps frames with the encoder's clock, shifted
+    // onto ours; rebased after a discontinuity or when that clock jumps
+    ab_shm_source_t shm_source;         // NULL when disabled
+    bool            shm_clock;          // rtp_send_nalu takes shm_timestamp
+    bool            shm_started;
+    bool            shm_wait_key;       // drop records until a key NAL unit
+    uint32_t        shm_timestamp_offset;
+    uint32_t        shm_timestamp;      // of the NAL unit being sent, ours
+
+    // multi-process: the ingest process broadcasts every video packet it
+    // sends, workers relay them from the ring
+    ab_shm_ring_t   packet_ring;        // NULL when disabled
+    bool            packet_ring_frame_start;    // the next packet starts a frame
+    bool            packet_ring_in_frame;       // packets written since the frame end
+    ab_shm_source_t ring_source;        // worker side, NULL when disabled
+    bool            ring_wait_key;      // drop packets until a key frame
+
+    ab_buffer_t     cache;
+
+    ab_rtp_fec_encoder_t fec_encoder;   // NULL when FEC is disabled
+    int             fec_idr_group;
+    int             fec_group;
+    ab_buffer_t     fec_buffer;
+    int             fec_payload_type;   // 0 when FEC is disabled, under mutex for DESCRIBE
+
+    // AAC track, disabled while aac_packetizer is NULL; audio_mutex, and
+    // mutex too for audio_config, which also tells the RTSP side it is on
+    ab_rtp_aac_packetizer_t aac_packetizer;
+    ab_aac_config_t audio_config;
+    uint32_t        audio_timestamp;
+    ab_buffer_t     audio_cache;        // ADTS bytes not yet framed
+
+    ab_rtp_pacer_t  pacer;
+    bool            own_pacer;
+    ab_rtp_pacer_stream_t pacer_stream; // NULL when pacing is disabled
+    ab_rtp_pacer_stream_t audio_pacer_stream;   // on the same pacer
+    // packets in each pacer stream, kept here so stats taken under mutex
+    // never wait for a stream lock
+    unsigned int    pacer_queued[AB_RTSP_TRACK_COUNT];
+    unsigned int    frame_interval_us;
+    unsigned int    pacing_percent;
+
+    unsigned int    discard_percent;    // of the viewer's socket send buffer
+    unsigned int    skip_percent;
+
+    ab_counter_t    counters;           // @ab_rtsp_counter_id_t
+    ab_rtsp_clock_t clocks[AB_RTSP_TRACK_COUNT];
+    uint64_t        last_report_ms;     // sender reports
+
+    // @ab_rtsp_latency_id_t per track
+    ab_histogram_t  latency[AB_RTSP_TRACK_COUNT][AB_RTSP_LATENCY_COUNT];
+    ab_rtsp_stamp_t stamps[AB_RTSP_TRACK_COUNT][RTSP_STAMP_RING_SIZE];
+    uint64_t        ingest_us;          // the ab_rtsp_server_send call in progress
+    uint64_t        audio_ingest_us;    // the ab_rtsp_server_send_audio call
+};
+
+static inline uint64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static inline uint64_t monotonic_ms(void) {
+    return monotonic_us() / 1000;
+}
+
+static inline void add_counter(T rtsp, int id, uint64_t n) {
+    ab_counter_add(rtsp->counters, id, n);
+}
+
+static inline uint16_t packet_sequence(const unsigned char *rtp) {
+    return ntohs(((const ab_rtp_header_t *) rtp)->seq);
+}
+
+/* ab_rtsp_server.c */
+
+/*
+ * 水平触发，客户端、监听socket和RTCP共用一个epoll
+ */
+extern void ab_rtsp_watch_fd(T rtsp, int fd, ab_rtsp_io_t *io);
+
+/*
+ * 把打包好的包写给所有观看端
+ * data: media/audio含interleaved头，FEC不含
+ * tag: @ab_rtp_packet_kind_t，或上AB_RTP_PACKET_*标志
+ */
+extern void ab_rtsp_send_packet(T rtsp,
+    const unsigned char *data, unsigned int data_len, int tag);
+
+extern void ab_rtsp_fill_interleaved_frame(
+    ab_rtsp_interleaved_frame_t *interleaved_frame,
+    uint8_t channel, unsigned short data_len);
+
+/*
+ * 参数集或音频配置变化后SDP需要重新生成，调用者持有rtsp->mutex
+ */
+extern void ab_rtsp_invalidate_describe(T rtsp);
+
+/* ab_rtsp_ingest.c */
+
+/*
+ * 视频/音频打包器的输出回调，user_data为T
+ */
+extern void ab_rtsp_video_packet_cb(unsigned char *rtp, unsigned int rtp_len,
+    const ab_rtp_packet_info_t *info, void *user_data);
+extern void ab_rtsp_audio_packet_cb(unsigned char *rtp, unsigned int rtp_len,
+    void *user_data);
+
+/* ab_rtsp_stats.c */
+
+/*
+ * 在打包器回调中调用，rtp不含interleaved头
+ */
+extern void ab_rtsp_stamp_packet(T rtsp, int track,
+    const unsigned char *rtp, uint64_t ingest_us);
+
+/*
+ * 包已写给所有观看端，data含interleaved头
+ */
+extern void ab_rtsp_record_sent(T rtsp, int track, const unsigned char *data);
+
+extern void ab_rtsp_free_metrics_conn(ab_rtsp_metrics_conn_t *conn);
+
+/*
+ * 事件循环中连接可读/可写时调用
+ */
+extern void ab_rtsp_process_metrics_conn(T rtsp, ab_rtsp_metrics_conn_t *conn);
+
+/*
+ * 释放已关闭的连接，关闭没有发完请求的空闲连接
+ * return: 新的链表头
+ */
+extern list_t ab_rtsp_update_metrics_conns(list_t head);
+
+#undef T
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_RTSP_SERVER_DEF_H_
@@ -0,0 +1,172 @@
+/*
+ * ab_rtsp_session.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_rtsp_session.h"
+
+#include "ab_base/ab_mem.h"
+#include "ab_base/ab_assert.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#define T ab_rtsp_session_table_t
+
+struct T {
+    ab_rtsp_session_t **buckets;
+    unsigned int    bucket_count;
+    unsigned int    count;
+
+    int             random_fd;
+    uint64_t        fallback_state;
+};
+
+T ab_rtsp_session_table_new(unsigned int buckets) {
+    assert(buckets > 0);
+
+    T table;
+    NEW0(table);
+
+    table->bucket_count = buckets;
+    table->buckets      = CALLOC(buckets, sizeof(ab_rtsp_session_t *));
+    table->random_fd    = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    table->fallback_state = ((uint64_t) ts.tv_sec << 32) ^ ts.tv_nsec ^
+        ((uint64_t) getpid() << 16) ^ (uintptr_t) table;
+
+    return table;
+}
+
+void ab_rtsp_session_table_free(T *table) {
+    assert(table && *table);
+
+    for (unsigned int i = 0; i < (*table)->bucket_count; ++i) {
+        while ((*table)->buckets[i]) {
+            ab_rtsp_session_t *session = (*table)->buckets[i];
+            (*table)->buckets[i] = session->next;
+            FREE(session);
+        }
+    }
+
+    if ((*table)->random_fd >= 0)
+        close((*table)->random_fd);
+    FREE((*table)->buckets);
+    FREE(*table);
+}
+
+static uint64_t random_key(T table) {
+    uint64_t key = 0;
+    if (table->random_fd >= 0 &&
+        read(table->random_fd, &key, sizeof(key)) == sizeof(key))
+        return key;
+
+    // splitmix64, only if /dev/urandom is unavailable
+    uint64_t z = (table->fallback_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/*
+ * return: 非法ID返回false
+ */
+static bool parse_key(const char *id, unsigned int id_len, uint64_t *key) {
+    if (id_len < AB_RTSP_SESSION_ID_SIZE)
+        return false;
+    // "id;timeout=60"
+    if (id_len > AB_RTSP_SESSION_ID_SIZE && id[AB_RTSP_SESSION_ID_SIZE] != ';' &&
+        id[AB_RTSP_SESSION_ID_SIZE] != ' ')
+        return false;
+
+    uint64_t value = 0;
+    for (int i = 0; i < AB_RTSP_SESSION_ID_SIZE; ++i) {
+        char c = id[i];
+        int digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else
+            return false;
+        value = (value << 4) | digit;
+    }
+
+    *key = value;
+    return true;
+}
+
+static ab_rtsp_session_t *find_key(T table, uint64_t key) {
+    ab_rtsp_session_t *session = table->buckets[key % table->bucket_count];
+    while (session && session->key != key)
+        session = session->next;
+    return session;
+}
+
+ab_rtsp_session_t *ab_rtsp_session_table_add(T table, void *user_data) {
+    assert(table);
+
+    uint64_t key;
+    do {
+        key = random_key(table);
+    } while (find_key(table, key));
+
+    ab_rtsp_session_t *session;
+    NEW0(session);
+
+    session->key        = key;
+    session->user_data  = user_data;
+    session->timer      = NULL;
+    snprintf(session->id, sizeof(session->id), "%016llx", (unsigned long long) key);
+
+    unsigned int bucket = key % table->bucket_count;
+    session->next = table->buckets[bucket];
+    table->buckets[bucket] = session;
+    ++table->count;
+
+    return session;
+}
+
+ab_rtsp_session_t *ab_rtsp_session_table_find(T table,
+    const char *id, unsigned int id_len) {
+    assert(table);
+    assert(id);
+
+    uint64_t key;
+    if (!parse_key(id, id_len, &key))
+        return NULL;
+
+    return find_key(table, key);
+}
+
+void ab_rtsp_session_table_remove(T table, ab_rtsp_session_t **session) {
+    assert(table);
+    assert(session && *session);
+
+    ab_rtsp_session_t **node = &table->buckets[(*session)->key % table->bucket_count];
+    while (*node) {
+        if (*node == *session) {
+            *node = (*session)->next;
+            --table->count;
+            break;
+        }
+        node = &(*node)->next;
+    }
+
+    FREE(*session);
+}
+
+unsigned int ab_rtsp_session_table_count(T table) {
+    assert(table);
+    return table->count;
+}
@@ -0,0 +1,57 @@
+/*
+ * ab_rtsp_session.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_RTSP_SESSION_H_
+#define AB_RTSP_SESSION_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ab_base/ab_timer_wheel.h"
+
+#include <stdint.h>
+
+#define AB_RTSP_SESSION_ID_SIZE     16
+
+typedef struct ab_rtsp_session_t {
+    char            id[AB_RTSP_SESSION_ID_SIZE + 1];    // 64位随机数的十六进制
+    uint64_t        key;
+    void           *user_data;
+    ab_timer_t      timer;              // 超时定时器，由使用者管理
+    struct ab_rtsp_session_t *next;     // hash chain
+} ab_rtsp_session_t;
+
+/*
+ * 以随机ID为键的session哈希表
+ */
+#define T ab_rtsp_session_table_t
+typedef struct T *T;
+
+extern T    ab_rtsp_session_table_new(unsigned int buckets);
+extern void ab_rtsp_session_table_free(T *table);
+
+/*
+ * 生成不重复的随机ID
+ */
+extern ab_rtsp_session_t *ab_rtsp_session_table_add(T table, void *user_data);
+/*
+ * id: Session头域的值，可带";timeout="等参数
+ */
+extern ab_rtsp_session_t *ab_rtsp_session_table_find(T table,
+    const char *id, unsigned int id_len);
+extern void ab_rtsp_session_table_remove(T table, ab_rtsp_session_t **session);
+
+extern unsigned int ab_rtsp_session_table_count(T table);
+
+#undef T
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_RTSP_SESSION_H_
@@ -0,0 +1,323 @@
+/*
+ * ab_rtsp_stats.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ *
+ * 时延打点、统计汇总和metrics端口
+ */
+
+#include "ab_rtsp_server_def.h"
+#include "ab_rtsp_metrics.h"
+
+#include "ab_base/ab_mem.h"
+#include "ab_base/ab_assert.h"
+
+#include "ab_log/ab_logger.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <errno.h>
+#include <sys/epoll.h>
+
+#define T ab_rtsp_server_t
+
+#define RTSP_METRICS_TIMEOUT_MS         5000
+
+/*
+ * 在打包器回调中调用，rtp不含interleaved头
+ */
+void ab_rtsp_stamp_packet(T rtsp, int track,
+    const unsigned char *rtp, uint64_t ingest_us) {
+    uint64_t now_us = monotonic_us();
+    ab_histogram_record(rtsp->latency[track][AB_RTSP_LATENCY_PACKETIZE],
+        now_us - ingest_us);
+
+    uint16_t seq = packet_sequence(rtp);
+    uint64_t key = (uint64_t) seq << RTSP_STAMP_US_BITS;
+    ab_rtsp_stamp_t *stamp = &rtsp->stamps[track][seq % RTSP_STAMP_RING_SIZE];
+    __atomic_store_n(&stamp->ingest, key | (ingest_us & RTSP_STAMP_US_MASK),
+        __ATOMIC_RELAXED);
+    __atomic_store_n(&stamp->packetized, key | (now_us & RTSP_STAMP_US_MASK),
+        __ATOMIC_RELEASE);
+}
+
+/*
+ * 包已写给所有观看端，data含interleaved头
+ */
+void ab_rtsp_record_sent(T rtsp, int track, const unsigned char *data) {
+    uint16_t seq = packet_sequence(data + sizeof(ab_rtsp_interleaved_frame_t));
+    const ab_rtsp_stamp_t *stamp = &rtsp->stamps[track][seq % RTSP_STAMP_RING_SIZE];
+    uint64_t packetized = __atomic_load_n(&stamp->packetized, __ATOMIC_ACQUIRE);
+    uint64_t ingest     = __atomic_load_n(&stamp->ingest, __ATOMIC_RELAXED);
+    if (packetized >> RTSP_STAMP_US_BITS != seq || ingest >> RTSP_STAMP_US_BITS != seq)
+        return;
+
+    uint64_t now_us = monotonic_us();
+    ab_histogram_record(rtsp->latency[track][AB_RTSP_LATENCY_SEND],
+        (now_us - packetized) & RTSP_STAMP_US_MASK);
+    ab_histogram_record(rtsp->latency[track][AB_RTSP_LATENCY_TOTAL],
+        (now_us - ingest) & RTSP_STAMP_US_MASK);
+}
+
+/*
+ * 调用者持有rtsp->mutex
+ */
+static void collect_stats(T rtsp, ab_rtsp_stats_t *stats) {
+    uint64_t values[AB_RTSP_COUNTER_COUNT];
+    ab_counter_snapshot(rtsp->counters, values, AB_RTSP_COUNTER_COUNT);
+
+    memset(stats, 0, sizeof(*stats));
+    stats->ingest_bytes     = values[AB_RTSP_COUNTER_INGEST_BYTES];
+    stats->nal_units        = values[AB_RTSP_COUNTER_NAL_UNITS];
+    stats->frames           = values[AB_RTSP_COUNTER_FRAMES];
+    stats->key_frames       = values[AB_RTSP_COUNTER_KEY_FRAMES];
+    stats->audio_bytes      = values[AB_RTSP_COUNTER_AUDIO_BYTES];
+    stats->audio_frames     = values[AB_RTSP_COUNTER_AUDIO_FRAMES];
+    stats->rtp_packets      = values[AB_RTSP_COUNTER_RTP_PACKETS];
+    stats->rtp_bytes        = values[AB_RTSP_COUNTER_RTP_BYTES];
+    stats->audio_packets    = values[AB_RTSP_COUNTER_AUDIO_PACKETS];
+    stats->fec_packets      = values[AB_RTSP_COUNTER_FEC_PACKETS];
+    stats->sent_packets     = values[AB_RTSP_COUNTER_SENT_PACKETS];
+    stats->sent_bytes       = values[AB_RTSP_COUNTER_SENT_BYTES];
+    stats->send_errors      = values[AB_RTSP_COUNTER_SEND_ERRORS];
+    stats->dropped_packets  = values[AB_RTSP_COUNTER_DROPPED_PACKETS];
+    stats->accepted         = values[AB_RTSP_COUNTER_ACCEPTED];
+    stats->rtcp_reports     = values[AB_RTSP_COUNTER_RTCP_REPORTS];
+
+    for (list_t node = rtsp->clients; node; node = node->rest) {
+        ab_rtsp_client_t *client = node->first;
+        if (NULL == client->sock)
+            continue;
+        ++stats->connections;
+        if (client->ready)
+            ++stats->viewers;
+    }
+
+    for (int i = 0; i < AB_RTSP_TRACK_COUNT; ++i)
+        stats->pacer_queue += __atomic_load_n(&rtsp->pacer_queued[i], __ATOMIC_RELAXED);
+
+    for (int i = 0; i < AB_RTSP_TRACK_COUNT; ++i) {
+        ab_rtsp_latency_stats_t *latency = &stats->latency[i];
+        ab_histogram_summary(rtsp->latency[i][AB_RTSP_LATENCY_PACKETIZE],
+            &latency->packetize);
+        ab_histogram_summary(rtsp->latency[i][AB_RTSP_LATENCY_SEND], &latency->send);
+        ab_histogram_summary(rtsp->latency[i][AB_RTSP_LATENCY_TOTAL], &latency->total);
+    }
+}
+
+static unsigned int collect_viewer_stats(T rtsp,
+    ab_rtsp_viewer_stats_t *viewers, unsigned int max_viewers) {
+    unsigned int count = 0;
+    for (list_t node = rtsp->clients; node && count < max_viewers; node = node->rest) {
+        ab_rtsp_client_t *client = node->first;
+        if (NULL == client->sock)
+            continue;
+
+        ab_rtsp_viewer_stats_t *viewer = &viewers[count++];
+        memset(viewer, 0, sizeof(*viewer));
+        ab_socket_addr(client->sock, viewer->addr, sizeof(viewer->addr));
+        ab_socket_port(client->sock, &viewer->port);
+        viewer->tcp         = AB_RTSP_OVER_TCP == client->method;
+        viewer->playing     = client->ready;
+        viewer->dropped     = client->dropped;
+        viewer->send_errors = client->send_errors;
+        viewer->send_queue  = ab_socket_send_queue(client->sock);
+        for (int i = 0; i < AB_RTSP_TRACK_COUNT; ++i) {
+            viewer->tracks[i]       = client->tracks[i].stats;
+            viewer->tracks[i].setup = client->tracks[i].setup;
+        }
+    }
+    return count;
+}
+
+int ab_rtsp_server_stats(T rtsp, ab_rtsp_stats_t *stats) {
+    assert(rtsp);
+    assert(stats);
+
+    pthread_mutex_lock(&rtsp->mutex);
+    collect_stats(rtsp, stats);
+    pthread_mutex_unlock(&rtsp->mutex);
+
+    return 0;
+}
+
+int ab_rtsp_server_viewer_stats(T rtsp,
+    ab_rtsp_viewer_stats_t *viewers, unsigned int max_viewers) {
+    assert(rtsp);
+    assert(viewers || 0 == max_viewers);
+
+    pthread_mutex_lock(&rtsp->mutex);
+    unsigned int count = collect_viewer_stats(rtsp, viewers, max_viewers);
+    pthread_mutex_unlock(&rtsp->mutex);
+
+    return count;
+}
+
+void ab_rtsp_free_metrics_conn(ab_rtsp_metrics_conn_t *conn) {
+    if (conn->sock)
+        ab_socket_free(&conn->sock);
+    if (conn->response)
+        FREE(conn->response);
+    FREE(conn);
+}
+
+static void close_metrics_conn(ab_rtsp_metrics_conn_t *conn) {
+    if (conn->sock)
+        ab_socket_free(&conn->sock);
+}
+
+static void metrics_accept_func(void *sock, void *user_data) {
+    T rtsp = (T) user_data;
+
+    ab_rtsp_metrics_conn_t *conn;
+    NEW0(conn);
+    conn->io.kind       = AB_RTSP_IO_METRICS;
+    conn->io.object     = conn;
+    conn->sock          = sock;
+    conn->accepted_ms   = monotonic_ms();
+
+    rtsp->metrics_conns = list_push(rtsp->metrics_conns, conn);
+    ab_rtsp_watch_fd(rtsp, ab_socket_fd(sock), &conn->io);
+}
+
+/*
+ * 状态行、头部和指标一次渲染好，之后按可写事件发送
+ */
+static void render_metrics(T rtsp, ab_rtsp_metrics_conn_t *conn, int request) {
+    ab_rtsp_stats_t stats;
+    collect_stats(rtsp, &stats);
+
+    unsigned int max_viewers = stats.connections;
+    ab_rtsp_viewer_stats_t *viewers = max_viewers ?
+        CALLOC(max_viewers, sizeof(ab_rtsp_viewer_stats_t)) : NULL;
+    unsigned int viewer_count = collect_viewer_stats(rtsp, viewers, max_viewers);
+
+    const unsigned int header_size = 256;
+    unsigned int size = 8192 + viewer_count * 2048;
+    char *response = NULL;
+    int body_len = 0;
+    while (true) {
+        response = ALLOC(header_size + size);
+        if (AB_RTSP_METRICS_GET == request)
+            body_len = ab_rtsp_metrics_render(&stats, viewers, viewer_count,
+                response + header_size, size);
+        if (body_len >= 0)
+            break;
+        FREE(response);
+        size *= 2;
+    }
+    if (viewers)
+        FREE(viewers);
+
+    // the header goes right in front of the body
+    char header[256];
+    int header_len = ab_rtsp_metrics_http_header(request, body_len,
+        header, sizeof(header));
+    assert(header_len > 0 && header_len <= (int) header_size);
+    memcpy(response + header_size - header_len, header, header_len);
+
+    conn->response      = response;
+    conn->sent          = header_size - header_len;
+    conn->response_len  = header_size + body_len;
+}
+
+static void send_metrics(T rtsp, ab_rtsp_metrics_conn_t *conn) {
+    while (conn->sent < conn->response_len) {
+        int nsend = ab_socket_send(conn->sock,
+            (unsigned char *) conn->response + conn->sent,
+            conn->response_len - conn->sent);
+        if (nsend <= 0) {
+            if (nsend < 0 && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+                // the rest when the socket is writable again
+                struct epoll_event event;
+                memset(&event, 0, sizeof(event));
+                event.events    = EPOLLOUT;
+                event.data.ptr  = &conn->io;
+                epoll_ctl(rtsp->epoll_fd, EPOLL_CTL_MOD, ab_socket_fd(conn->sock), &event);
+                return;
+            }
+            break;
+        }
+        conn->sent += nsend;
+    }
+    close_metrics_conn(conn);
+}
+
+void ab_rtsp_process_metrics_conn(T rtsp, ab_rtsp_metrics_conn_t *conn) {
+    if (conn->response) {
+        send_metrics(rtsp, conn);
+        return;
+    }
+
+    int nread = ab_socket_recv(conn->sock,
+        (unsigned char *) conn->request + conn->request_len,
+        sizeof(conn->request) - conn->request_len);
+    if (nread < 0 && (EAGAIN == errno || EWOULDBLOCK == errno))
+        return;
+    if (nread <= 0) {
+        close_metrics_conn(conn);
+        return;
+    }
+    conn->request_len += nread;
+
+    int request = ab_rtsp_metrics_parse_request(conn->request, conn->request_len);
+    if (AB_RTSP_METRICS_NEED_MORE == request) {
+        if (conn->request_len < sizeof(conn->request))
+            return;
+        request = AB_RTSP_METRICS_BAD_REQUEST;
+    }
+
+    render_metrics(rtsp, conn, request);
+    send_metrics(rtsp, conn);
+}
+
+/*
+ * 释放已关闭的连接，关闭没有发完请求的空闲连接
+ */
+list_t ab_rtsp_update_metrics_conns(list_t head) {
+    uint64_t now = monotonic_ms();
+    list_t result = NULL;
+    while (head) {
+        ab_rtsp_metrics_conn_t *conn;
+        head = list_pop(head, (void **) &conn);
+        if (conn->sock && now - conn->accepted_ms >= RTSP_METRICS_TIMEOUT_MS)
+            close_metrics_conn(conn);
+        if (conn->sock)
+            result = list_push(result, conn);
+        else
+            ab_rtsp_free_metrics_conn(conn);
+    }
+    return result;
+}
+
+int ab_rtsp_server_set_metrics_port(T rtsp, unsigned short port) {
+    assert(rtsp);
+
+    int result = 0;
+    pthread_mutex_lock(&rtsp->mutex);
+    if (rtsp->metrics_listener.tcp_srv)
+        ab_tcp_server_free(&rtsp->metrics_listener.tcp_srv);
+
+    if (port != 0) {
+        ab_tcp_server_t tcp_srv = ab_tcp_server_listen(port, 0, false,
+            metrics_accept_func, rtsp);
+        if (tcp_srv) {
+            // scrapes never block the event loop
+            ab_tcp_server_set_nonblock(tcp_srv, true);
+            rtsp->metrics_listener.io.kind      = AB_RTSP_IO_METRICS_LISTENER;
+            rtsp->metrics_listener.io.object    = &rtsp->metrics_listener;
+            rtsp->metrics_listener.tcp_srv      = tcp_srv;
+            ab_rtsp_watch_fd(rtsp, ab_tcp_server_fd(tcp_srv), &rtsp->metrics_listener.io);
+        } else {
+            AB_LOGGER_ERROR("metrics on port %u failed, %s.\n", port, strerror(errno));
+            result = -1;
+        }
+    }
+    pthread_mutex_unlock(&rtsp->mutex);
+
+    return result;
+}
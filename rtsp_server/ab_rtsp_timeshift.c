@@ -0,0 +1,237 @@
+/*
+ * ab_rtsp_timeshift.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_rtsp_timeshift.h"
+
+#include "ab_base/ab_mem.h"
+#include "ab_base/ab_assert.h"
+
+#include "ab_rtp/ab_rtp_def.h"
+
+#include "ab_log/ab_logger.h"
+
+#include <string.h>
+
+#define TIMESHIFT_MAX_LAG_US    1000000
+#define TIMESHIFT_FRAME_TICKS   3600    // 25 fps, until two frames were sent
+
+#define T ab_rtsp_timeshift_t
+
+struct T {
+    ab_rtsp_dvr_t   dvr;                // shared with the live stream
+    ab_rtp_packetizer_t packetizer;
+
+    uint64_t        cursor;             // next frame number
+    ab_rtsp_dvr_frame_t frame;          // the cursor's frame, once copied out
+    bool            have_frame;
+    unsigned char  *frame_buf;
+    unsigned int    frame_buf_size;
+
+    bool            playing;
+    // the frame with live timestamp anchor_live is due at anchor_us and goes
+    // out with anchor_timestamp; set by the first frame after play or seek
+    bool            anchored;
+    uint64_t        anchor_us;
+    uint32_t        anchor_live;
+    uint32_t        anchor_timestamp;
+
+    // output timeline, continuous over seeks
+    bool            sent;
+    uint32_t        last_live;
+    uint32_t        last_timestamp;
+    uint32_t        frame_ticks;        // between the last two frames sent
+};
+
+T ab_rtsp_timeshift_new(ab_rtsp_dvr_t dvr, int codec, uint32_t ssrc,
+    unsigned int max_payload,
+    void (*cb)(unsigned char *, unsigned int, const ab_rtp_packet_info_t *, void *),
+    void *user_data) {
+    assert(dvr);
+
+    T timeshift;
+    NEW0(timeshift);
+    timeshift->dvr          = dvr;
+    timeshift->packetizer   = ab_rtp_packetizer_new(codec, RTP_PAYLOAD_TYPE_H264,
+        ssrc, max_payload, cb, user_data);
+    timeshift->cursor       = ab_rtsp_dvr_live(dvr);
+    timeshift->have_frame   = false;
+    timeshift->frame_buf    = NULL;
+    timeshift->frame_buf_size = 0;
+    timeshift->playing      = false;
+    timeshift->anchored     = false;
+    timeshift->sent         = false;
+    timeshift->last_live    = 0;
+    timeshift->last_timestamp = 0;
+    timeshift->frame_ticks  = TIMESHIFT_FRAME_TICKS;
+
+    return timeshift;
+}
+
+void ab_rtsp_timeshift_free(T *timeshift) {
+    assert(timeshift && *timeshift);
+
+    ab_rtp_packetizer_free(&(*timeshift)->packetizer);
+    if ((*timeshift)->frame_buf)
+        FREE((*timeshift)->frame_buf);
+    FREE(*timeshift);
+}
+
+static void move_to(T timeshift, uint64_t number) {
+    timeshift->cursor       = number;
+    timeshift->have_frame   = false;
+    timeshift->anchored     = false;
+}
+
+int ab_rtsp_timeshift_seek_npt(T timeshift, uint64_t npt_us) {
+    assert(timeshift);
+
+    uint64_t number;
+    if (ab_rtsp_dvr_find_npt(timeshift->dvr, npt_us, &number) < 0)
+        return -1;
+    move_to(timeshift, number);
+    return 0;
+}
+
+int ab_rtsp_timeshift_seek_clock(T timeshift, uint64_t wall_us) {
+    assert(timeshift);
+
+    uint64_t number;
+    if (ab_rtsp_dvr_find_clock(timeshift->dvr, wall_us, &number) < 0)
+        return -1;
+    move_to(timeshift, number);
+    return 0;
+}
+
+int ab_rtsp_timeshift_position(T timeshift, uint64_t *npt_us, uint64_t *wall_us) {
+    assert(timeshift);
+    return ab_rtsp_dvr_position(timeshift->dvr, timeshift->cursor, npt_us, wall_us);
+}
+
+void ab_rtsp_timeshift_play(T timeshift) {
+    assert(timeshift);
+
+    timeshift->playing  = true;
+    timeshift->anchored = false;
+}
+
+void ab_rtsp_timeshift_pause(T timeshift) {
+    assert(timeshift);
+    timeshift->playing = false;
+}
+
+bool ab_rtsp_timeshift_playing(T timeshift) {
+    assert(timeshift);
+    return timeshift->playing;
+}
+
+uint16_t ab_rtsp_timeshift_sequence(T timeshift) {
+    assert(timeshift);
+    return ab_rtp_packetizer_sequence(timeshift->packetizer);
+}
+
+uint32_t ab_rtsp_timeshift_timestamp(T timeshift) {
+    assert(timeshift);
+
+    if (!timeshift->sent)
+        return 0;
+    if (timeshift->anchored && timeshift->have_frame)
+        return timeshift->anchor_timestamp +
+            (timeshift->frame.timestamp - timeshift->anchor_live);
+    return timeshift->last_timestamp + timeshift->frame_ticks;
+}
+
+/*
+ * 拷贝出cursor帧，缓冲区不够时按帧大小重新分配
+ * return: @ab_rtsp_dvr_result_t
+ */
+static int load_frame(T timeshift) {
+    if (timeshift->have_frame)
+        return AB_RTSP_DVR_OK;
+
+    int ret = ab_rtsp_dvr_read(timeshift->dvr, timeshift->cursor, &timeshift->frame,
+        timeshift->frame_buf, timeshift->frame_buf_size);
+    if (AB_RTSP_DVR_NO_SPACE == ret) {
+        if (timeshift->frame_buf)
+            FREE(timeshift->frame_buf);
+        timeshift->frame_buf_size   = timeshift->frame.size;
+        timeshift->frame_buf        = ALLOC(timeshift->frame_buf_size);
+        ret = ab_rtsp_dvr_read(timeshift->dvr, timeshift->cursor, &timeshift->frame,
+            timeshift->frame_buf, timeshift->frame_buf_size);
+    }
+
+    timeshift->have_frame = AB_RTSP_DVR_OK == ret;
+    return ret;
+}
+
+/*
+ * 第一帧接着已发出的时间线，之后按直播时间戳的间隔
+ */
+static void anchor(T timeshift, uint64_t now_us) {
+    uint32_t timestamp = ab_rtsp_timeshift_timestamp(timeshift);
+    timeshift->anchored         = true;
+    timeshift->anchor_us        = now_us;
+    timeshift->anchor_live      = timeshift->frame.timestamp;
+    timeshift->anchor_timestamp = timestamp;
+}
+
+static uint64_t due_us(T timeshift) {
+    uint32_t ticks = timeshift->frame.timestamp - timeshift->anchor_live;
+    return timeshift->anchor_us + (uint64_t) ticks * 1000000 / 90000;
+}
+
+static void send_frame(T timeshift) {
+    uint32_t timestamp = timeshift->anchor_timestamp +
+        (timeshift->frame.timestamp - timeshift->anchor_live);
+
+    const unsigned char *pos = timeshift->frame_buf;
+    for (unsigned int i = 0; i < timeshift->frame.nalu_count; ++i) {
+        uint32_t nalu_len;
+        memcpy(&nalu_len, pos, sizeof(nalu_len));
+        pos += sizeof(nalu_len);
+        ab_rtp_packetizer_push(timeshift->packetizer, pos, nalu_len, timestamp);
+        pos += nalu_len;
+    }
+    ab_rtp_packetizer_flush(timeshift->packetizer, true);
+
+    if (timeshift->sent && timeshift->frame.timestamp != timeshift->last_live)
+        timeshift->frame_ticks = timeshift->frame.timestamp - timeshift->last_live;
+    timeshift->sent             = true;
+    timeshift->last_live        = timeshift->frame.timestamp;
+    timeshift->last_timestamp   = timestamp;
+
+    ++timeshift->cursor;
+    timeshift->have_frame = false;
+}
+
+void ab_rtsp_timeshift_send(T timeshift, uint64_t now_us, unsigned int max_frames) {
+    assert(timeshift);
+
+    for (unsigned int sent = 0; timeshift->playing && sent < max_frames; ++sent) {
+        int ret = load_frame(timeshift);
+        if (AB_RTSP_DVR_EVICTED == ret) {
+            // paused or too slow for the window, restart at its oldest key frame
+            uint64_t number;
+            if (ab_rtsp_dvr_find_npt(timeshift->dvr, UINT64_MAX / 90000, &number) < 0)
+                return;
+            AB_LOGGER_DEBUG("timeshift frame %llu overwritten, skip to %llu.\n",
+                (unsigned long long) timeshift->cursor, (unsigned long long) number);
+            move_to(timeshift, number);
+            ret = load_frame(timeshift);
+        }
+        // caught up with the live stream
+        if (ret != AB_RTSP_DVR_OK)
+            return;
+
+        if (!timeshift->anchored ||
+            now_us > due_us(timeshift) + TIMESHIFT_MAX_LAG_US)
+            anchor(timeshift, now_us);
+        if (due_us(timeshift) > now_us)
+            return;
+
+        send_frame(timeshift);
+    }
+}
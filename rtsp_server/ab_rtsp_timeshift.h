@@ -0,0 +1,73 @@
+/*
+ * ab_rtsp_timeshift.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_RTSP_TIMESHIFT_H_
+#define AB_RTSP_TIMESHIFT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ab_rtsp_dvr.h"
+
+#include "ab_rtp/ab_rtp_packetizer.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * 一个时移会话：在直播的时移缓存中有自己的播放位置、打包器和RTP时间线
+ * 追上直播后随新写入的帧继续播放；位置被覆盖时跳到缓存中最老的关键帧
+ * 非线程安全，由服务端事件循环驱动
+ */
+#define T ab_rtsp_timeshift_t
+typedef struct T *T;
+
+/*
+ * cb: 同ab_rtp_packetizer_new，在ab_rtsp_timeshift_send中回调
+ */
+extern T    ab_rtsp_timeshift_new(ab_rtsp_dvr_t dvr, int codec, uint32_t ssrc,
+    unsigned int max_payload,
+    void (*cb)(unsigned char *, unsigned int, const ab_rtp_packet_info_t *, void *),
+    void *user_data);
+extern void ab_rtsp_timeshift_free(T *timeshift);
+
+/*
+ * 定位到比直播早npt_us处或wall_us(CLOCK_REALTIME)处之前最近的关键帧，
+ * 超出缓存时为缓存中最老的关键帧
+ * return: 缓存中还没有关键帧返回-1
+ */
+extern int  ab_rtsp_timeshift_seek_npt(T timeshift, uint64_t npt_us);
+extern int  ab_rtsp_timeshift_seek_clock(T timeshift, uint64_t wall_us);
+/*
+ * 下一帧比直播早多少、写入时间
+ * return: 缓存为空返回-1
+ */
+extern int  ab_rtsp_timeshift_position(T timeshift, uint64_t *npt_us, uint64_t *wall_us);
+
+extern void ab_rtsp_timeshift_play(T timeshift);
+extern void ab_rtsp_timeshift_pause(T timeshift);
+extern bool ab_rtsp_timeshift_playing(T timeshift);
+
+/*
+ * RTP-Info: 下一个包的序号和下一帧的时间戳
+ */
+extern uint16_t ab_rtsp_timeshift_sequence(T timeshift);
+extern uint32_t ab_rtsp_timeshift_timestamp(T timeshift);
+
+/*
+ * 发送到now_us为止到期的帧，最多max_frames帧；落后超过1s时从当前帧重新计时
+ */
+extern void ab_rtsp_timeshift_send(T timeshift, uint64_t now_us, unsigned int max_frames);
+
+#undef T
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_RTSP_TIMESHIFT_H_
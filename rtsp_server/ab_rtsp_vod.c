@@ -0,0 +1,345 @@
+/*
+ * ab_rtsp_vod.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_rtsp_vod.h"
+
+#include "ab_base/ab_mem.h"
+#include "ab_base/ab_assert.h"
+
+#include "ab_rtp/ab_rtp_def.h"
+
+#include <math.h>
+
+#define VOD_MAX_LAG_US      1000000
+#define VOD_KEY_ONLY_SCALE  2.0         // above this only key frames are sent
+#define VOD_MAX_SCALE       32.0
+#define VOD_MIN_SCALE       (1.0 / 32)
+
+#define T ab_rtsp_vod_t
+
+struct T {
+    ab_file_source_t source;            // shared, read only
+    ab_rtp_packetizer_t packetizer;
+
+    unsigned int    cursor;             // next frame to send
+    bool            at_end;             // nothing left in [first_frame, end_frame)
+    unsigned int    first_frame;        // lower bound when playing backwards
+    unsigned int    end_frame;          // exclusive
+    uint64_t        frame_duration_num;
+    uint64_t        frame_duration_den;
+
+    double          scale;              // npt rate, negative plays backwards
+    double          speed;              // delivery rate, timestamps unchanged
+    bool            key_only;
+
+    bool            playing;
+    // anchor_frame is due at anchor_us and carries anchor_timestamp, later
+    // frames follow at their npt distance divided by the scale
+    uint64_t        anchor_us;          // CLOCK_MONOTONIC
+    unsigned int    anchor_frame;
+    uint32_t        anchor_timestamp;
+};
+
+T ab_rtsp_vod_new(ab_file_source_t source, uint32_t ssrc,
+    unsigned int max_payload,
+    void (*cb)(unsigned char *, unsigned int, const ab_rtp_packet_info_t *, void *),
+    void *user_data) {
+    assert(source);
+
+    T vod;
+    NEW0(vod);
+    vod->source         = source;
+    vod->packetizer     = ab_rtp_packetizer_new(ab_file_source_codec(source),
+        RTP_PAYLOAD_TYPE_H264, ssrc, max_payload, cb, user_data);
+    vod->cursor         = 0;
+    vod->at_end         = false;
+    vod->first_frame    = 0;
+    vod->end_frame      = ab_file_source_frame_count(source);
+    ab_file_source_frame_duration(source, &vod->frame_duration_num,
+        &vod->frame_duration_den);
+    vod->scale          = 1.0;
+    vod->speed          = 1.0;
+    vod->key_only       = false;
+    vod->playing        = false;
+    vod->anchor_us      = 0;
+    vod->anchor_frame   = 0;
+    vod->anchor_timestamp = 0;
+
+    return vod;
+}
+
+void ab_rtsp_vod_free(T *vod) {
+    assert(vod && *vod);
+
+    ab_rtp_packetizer_free(&(*vod)->packetizer);
+    FREE(*vod);
+}
+
+static uint64_t frame_ticks(T vod, unsigned int frame) {
+    return (uint64_t) frame * vod->frame_duration_num * 90000 /
+        vod->frame_duration_den;
+}
+
+/*
+ * 时间换算成帧号，round_up时取不早于该时间的帧
+ */
+static unsigned int frame_at(T vod, uint64_t us, bool round_up) {
+    uint64_t unit = vod->frame_duration_num * 1000000;
+    uint64_t frame = us * vod->frame_duration_den / unit;
+    if (round_up && frame * unit < us * vod->frame_duration_den)
+        ++frame;
+
+    unsigned int count = ab_file_source_frame_count(vod->source);
+    return frame < count ? frame : count;
+}
+
+/*
+ * 与anchor_frame的npt距离，按|scale|换算成输出时间轴上的90kHz
+ */
+static uint64_t ticks_from_anchor(T vod, unsigned int frame) {
+    uint64_t a = frame_ticks(vod, vod->anchor_frame);
+    uint64_t b = frame_ticks(vod, frame);
+    uint64_t distance = a > b ? a - b : b - a;
+    if (1.0 == vod->scale || -1.0 == vod->scale)
+        return distance;
+    return (uint64_t) llround(distance / fabs(vod->scale));
+}
+
+static uint32_t timestamp_of(T vod, unsigned int frame) {
+    return vod->anchor_timestamp + (uint32_t) ticks_from_anchor(vod, frame);
+}
+
+/*
+ * 下一帧的时间戳；播完时cursor停在最后发出的帧上，再加一帧的间隔
+ */
+static uint32_t next_timestamp(T vod) {
+    uint32_t timestamp = timestamp_of(vod, vod->cursor);
+    if (vod->at_end) {
+        timestamp += (uint32_t) llround(90000.0 * vod->frame_duration_num /
+            vod->frame_duration_den / fabs(vod->scale));
+    }
+    return timestamp;
+}
+
+static uint64_t due_us(T vod, unsigned int frame) {
+    uint64_t ticks = ticks_from_anchor(vod, frame);
+    return vod->anchor_us + (uint64_t) (ticks * 1000000 / 90000 / vod->speed);
+}
+
+/*
+ * 以cursor为新的锚点，之前发出的时间戳不受影响
+ */
+static void reanchor(T vod, uint64_t now_us) {
+    vod->anchor_timestamp   = next_timestamp(vod);
+    vod->anchor_frame       = vod->cursor;
+    vod->anchor_us          = now_us;
+}
+
+/*
+ * 只发关键帧时cursor落到关键帧上：正放向后找，倒放向前找
+ */
+static void align_cursor(T vod) {
+    if (vod->at_end || !vod->key_only)
+        return;
+
+    if (vod->scale > 0) {
+        vod->cursor = ab_file_source_next_key_frame(vod->source, vod->cursor);
+        if (vod->cursor >= vod->end_frame)
+            vod->at_end = true;
+    } else {
+        vod->cursor = ab_file_source_key_frame(vod->source, vod->cursor);
+        if (vod->cursor < vod->first_frame)
+            vod->at_end = true;
+    }
+}
+
+static void advance(T vod) {
+    if (vod->scale > 0) {
+        unsigned int next = vod->cursor + 1;
+        if (vod->key_only)
+            next = ab_file_source_next_key_frame(vod->source, next);
+        if (next >= vod->end_frame)
+            vod->at_end = true;
+        else
+            vod->cursor = next;
+    } else {
+        unsigned int key = vod->key_only && vod->cursor > 0 ?
+            ab_file_source_key_frame(vod->source, vod->cursor - 1) : vod->cursor - 1;
+        if (0 == vod->cursor || key < vod->first_frame || key >= vod->cursor)
+            vod->at_end = true;
+        else
+            vod->cursor = key;
+    }
+}
+
+uint64_t ab_rtsp_vod_seek(T vod, uint64_t start_us, uint64_t end_us) {
+    assert(vod);
+
+    unsigned int count = ab_file_source_frame_count(vod->source);
+    unsigned int frame = frame_at(vod, start_us, false);
+    if (frame >= count)
+        frame = count - 1;
+    frame = ab_file_source_key_frame(vod->source, frame);
+
+    // the first frame after the seek follows the last one sent
+    uint32_t next = ab_rtsp_vod_timestamp(vod);
+
+    if (vod->scale > 0) {
+        vod->first_frame    = frame;
+        vod->end_frame      = end_us > 0 ? frame_at(vod, end_us, true) : count;
+        if (vod->end_frame <= frame)
+            vod->end_frame = frame + 1;
+    } else {
+        vod->first_frame    = end_us > 0 ? frame_at(vod, end_us, false) : 0;
+        vod->end_frame      = count;
+        if (vod->first_frame > frame)
+            vod->first_frame = frame;
+    }
+    vod->cursor     = frame;
+    vod->at_end     = false;
+
+    vod->anchor_frame       = frame;
+    vod->anchor_timestamp   = next;
+    return ab_file_source_frame_time_us(vod->source, frame);
+}
+
+double ab_rtsp_vod_set_scale(T vod, double scale) {
+    assert(vod);
+
+    double magnitude = fabs(scale);
+    if (magnitude < VOD_MIN_SCALE)
+        magnitude = 1.0;
+    else if (magnitude > VOD_MAX_SCALE)
+        magnitude = VOD_MAX_SCALE;
+    scale = scale < 0 ? -magnitude : magnitude;
+
+    // keep the timestamps of what was sent, the new rate starts at the cursor
+    vod->anchor_timestamp   = next_timestamp(vod);
+    vod->anchor_frame       = vod->cursor;
+
+    // a change of direction opens the range in the new direction
+    if ((scale > 0) != (vod->scale > 0)) {
+        if (scale > 0) {
+            vod->end_frame = ab_file_source_frame_count(vod->source);
+            if (vod->at_end && vod->cursor + 1 < vod->end_frame)
+                ++vod->cursor;
+        } else {
+            vod->first_frame = 0;
+            if (vod->at_end && vod->cursor > 0)
+                --vod->cursor;
+        }
+        vod->at_end = vod->cursor >= vod->end_frame;
+    }
+
+    // frames only decode forwards, backwards it has to be key frames
+    vod->scale      = scale;
+    vod->key_only   = magnitude > VOD_KEY_ONLY_SCALE || scale < 0;
+    return scale;
+}
+
+double ab_rtsp_vod_set_speed(T vod, double speed) {
+    assert(vod);
+
+    if (!(speed >= VOD_MIN_SCALE))
+        speed = 1.0;
+    else if (speed > VOD_MAX_SCALE)
+        speed = VOD_MAX_SCALE;
+
+    vod->speed = speed;
+    return speed;
+}
+
+double ab_rtsp_vod_scale(T vod) {
+    assert(vod);
+    return vod->scale;
+}
+
+double ab_rtsp_vod_speed(T vod) {
+    assert(vod);
+    return vod->speed;
+}
+
+uint64_t ab_rtsp_vod_position_us(T vod) {
+    assert(vod);
+    if (vod->at_end)
+        return ab_rtsp_vod_end_us(vod);
+    return ab_file_source_frame_time_us(vod->source, vod->cursor);
+}
+
+uint64_t ab_rtsp_vod_end_us(T vod) {
+    assert(vod);
+    return ab_file_source_frame_time_us(vod->source,
+        vod->scale > 0 ? vod->end_frame : vod->first_frame);
+}
+
+void ab_rtsp_vod_play(T vod, uint64_t now_us) {
+    assert(vod);
+
+    align_cursor(vod);
+    reanchor(vod, now_us);
+    vod->playing = !vod->at_end;
+}
+
+void ab_rtsp_vod_pause(T vod) {
+    assert(vod);
+    vod->playing = false;
+}
+
+bool ab_rtsp_vod_playing(T vod) {
+    assert(vod);
+    return vod->playing;
+}
+
+uint16_t ab_rtsp_vod_sequence(T vod) {
+    assert(vod);
+    return ab_rtp_packetizer_sequence(vod->packetizer);
+}
+
+uint32_t ab_rtsp_vod_timestamp(T vod) {
+    assert(vod);
+    return next_timestamp(vod);
+}
+
+static void send_frame(T vod, unsigned int index) {
+    const ab_file_source_frame_t *frame = ab_file_source_frame(vod->source, index);
+    uint32_t timestamp = timestamp_of(vod, index);
+
+    for (unsigned int i = 0; i < frame->nalu_count; ++i) {
+        unsigned int nalu_len = 0;
+        const unsigned char *nalu = ab_file_source_nalu(vod->source,
+            frame->first_nalu + i, &nalu_len);
+        if (nalu_len > 0)
+            ab_rtp_packetizer_push(vod->packetizer, nalu, nalu_len, timestamp);
+    }
+    ab_rtp_packetizer_flush(vod->packetizer, true);
+}
+
+int ab_rtsp_vod_send(T vod, uint64_t now_us, unsigned int max_frames) {
+    assert(vod);
+
+    if (!vod->playing)
+        return AB_RTSP_VOD_PLAYING;
+
+    // a stalled viewer does not get the backlog in one burst
+    if (now_us > due_us(vod, vod->cursor) + VOD_MAX_LAG_US)
+        reanchor(vod, now_us);
+
+    for (unsigned int sent = 0; sent < max_frames && !vod->at_end; ++sent) {
+        if (due_us(vod, vod->cursor) > now_us)
+            break;
+
+        unsigned int frame = vod->cursor;
+        advance(vod);
+        send_frame(vod, frame);
+    }
+
+    if (vod->at_end) {
+        vod->playing = false;
+        return AB_RTSP_VOD_END;
+    }
+    return AB_RTSP_VOD_PLAYING;
+}
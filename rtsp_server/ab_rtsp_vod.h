@@ -0,0 +1,96 @@
+/*
+ * ab_rtsp_vod.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_RTSP_VOD_H_
+#define AB_RTSP_VOD_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ab_file_source.h"
+
+#include "ab_rtp/ab_rtp_packetizer.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum ab_rtsp_vod_result_t {
+    AB_RTSP_VOD_PLAYING = 0,
+    AB_RTSP_VOD_END                     // 到达文件或Range结束位置，已暂停
+};
+
+/*
+ * 一个点播会话：自己的播放位置、打包器和RTP时间线
+ * 多个会话共享同一个文件源，NALU直接从mmap打包
+ * 非线程安全，由服务端事件循环驱动
+ */
+#define T ab_rtsp_vod_t
+typedef struct T *T;
+
+/*
+ * cb: 同ab_rtp_packetizer_new，在ab_rtsp_vod_send中回调
+ */
+extern T    ab_rtsp_vod_new(ab_file_source_t source, uint32_t ssrc,
+    unsigned int max_payload,
+    void (*cb)(unsigned char *, unsigned int, const ab_rtp_packet_info_t *, void *),
+    void *user_data);
+extern void ab_rtsp_vod_free(T *vod);
+
+/*
+ * 定位到start_us及之前最近的关键帧；end_us为0时播放到文件结束(倒放时为开头)
+ * RTP时间戳接着之前发送的帧继续增长
+ * return: 实际的开始位置(us)
+ */
+extern uint64_t ab_rtsp_vod_seek(T vod, uint64_t start_us, uint64_t end_us);
+/*
+ * Scale(RFC 2326 12.34): npt的播放速率，负数倒放，|scale|大于2或倒放时只发关键帧，
+ * 时间戳按输出的时间轴重写(npt距离/|scale|)，播放器照常按时间戳显示
+ * 范围1/32~32，超出时截断，0当作1；在ab_rtsp_vod_play之前调用
+ * return: 实际使用的scale
+ */
+extern double ab_rtsp_vod_set_scale(T vod, double scale);
+/*
+ * Speed(RFC 2326 12.35): 发送速率，时间戳不变，范围1/32~32
+ * return: 实际使用的speed
+ */
+extern double ab_rtsp_vod_set_speed(T vod, double speed);
+extern double ab_rtsp_vod_scale(T vod);
+extern double ab_rtsp_vod_speed(T vod);
+
+/*
+ * 下一帧的位置，倒放时结束位置在开始之前
+ */
+extern uint64_t ab_rtsp_vod_position_us(T vod);
+extern uint64_t ab_rtsp_vod_end_us(T vod);
+
+/*
+ * 从now_us开始按帧率发送下一帧
+ */
+extern void ab_rtsp_vod_play(T vod, uint64_t now_us);
+extern void ab_rtsp_vod_pause(T vod);
+extern bool ab_rtsp_vod_playing(T vod);
+
+/*
+ * RTP-Info: 下一个包的序号和下一帧的时间戳
+ */
+extern uint16_t ab_rtsp_vod_sequence(T vod);
+extern uint32_t ab_rtsp_vod_timestamp(T vod);
+
+/*
+ * 发送到now_us为止到期的帧，最多max_frames帧；落后超过1s时从当前帧重新计时
+ * return: @ab_rtsp_vod_result_t
+ */
+extern int  ab_rtsp_vod_send(T vod, uint64_t now_us, unsigned int max_frames);
+
+#undef T
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_RTSP_VOD_H_
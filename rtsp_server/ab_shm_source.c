@@ -0,0 +1,122 @@
+/*
+ * ab_shm_source.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#include "ab_shm_source.h"
+
+#include "ab_base/ab_mem.h"
+#include "ab_base/ab_assert.h"
+
+#include "ab_log/ab_logger.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define SHM_SOURCE_WAIT_MS      100     // also how soon close() is noticed
+
+#define T ab_shm_source_t
+
+struct T {
+    char           *name;
+    ab_shm_ring_t   ring;               // owned by the receiving thread
+
+    void           *user_data;
+    void          (*callback)(const ab_shm_ring_record_t *, void *);
+
+    // stats are written by the receiving thread and read under the mutex
+    pthread_mutex_t mutex;
+    ab_shm_source_stats_t stats;
+
+    bool            quit;
+    pthread_t       recv_thd;
+};
+
+static void *recv_thd_cb(void *arg);
+
+T ab_shm_source_open(const char *name,
+    void (*cb)(const ab_shm_ring_record_t *, void *), void *user_data) {
+    assert(name);
+    assert(cb);
+
+    T source;
+    NEW0(source);
+    source->name        = ALLOC(strlen(name) + 1);
+    strcpy(source->name, name);
+    source->callback    = cb;
+    source->user_data   = user_data;
+    pthread_mutex_init(&source->mutex, NULL);
+
+    source->quit        = false;
+    pthread_create(&source->recv_thd, NULL, recv_thd_cb, source);
+
+    return source;
+}
+
+void ab_shm_source_close(T *source) {
+    assert(source && *source);
+
+    __atomic_store_n(&(*source)->quit, true, __ATOMIC_RELEASE);
+    pthread_join((*source)->recv_thd, NULL);
+
+    if ((*source)->ring)
+        ab_shm_ring_close(&(*source)->ring);
+    pthread_mutex_destroy(&(*source)->mutex);
+    FREE((*source)->name);
+    FREE(*source);
+}
+
+void ab_shm_source_stats(T source, ab_shm_source_stats_t *stats) {
+    assert(source);
+    assert(stats);
+
+    pthread_mutex_lock(&source->mutex);
+    *stats = source->stats;
+    pthread_mutex_unlock(&source->mutex);
+}
+
+void *recv_thd_cb(void *arg) {
+    T source = (T) arg;
+
+    while (!__atomic_load_n(&source->quit, __ATOMIC_ACQUIRE)) {
+        if (NULL == source->ring) {
+            source->ring = ab_shm_ring_open(source->name);
+            if (NULL == source->ring) {
+                usleep(AB_SHM_SOURCE_RETRY_MS * 1000);
+                continue;
+            }
+            AB_LOGGER_INFO("shared memory %s opened.\n", source->name);
+            pthread_mutex_lock(&source->mutex);
+            ++source->stats.opens;
+            pthread_mutex_unlock(&source->mutex);
+        }
+
+        ab_shm_ring_record_t record;
+        int result = ab_shm_ring_read(source->ring, &record, SHM_SOURCE_WAIT_MS);
+        if (result < 0) {
+            AB_LOGGER_INFO("shared memory %s was replaced, reopen.\n", source->name);
+            ab_shm_ring_close(&source->ring);
+            continue;
+        }
+        if (0 == result)
+            continue;
+
+        source->callback(&record, source->user_data);
+        bool intact = ab_shm_ring_release(source->ring);
+
+        pthread_mutex_lock(&source->mutex);
+        ++source->stats.records;
+        source->stats.bytes += record.len;
+        if (record.discontinuity)
+            ++source->stats.discontinuities;
+        if (!intact)
+            ++source->stats.torn;
+        pthread_mutex_unlock(&source->mutex);
+    }
+
+    return NULL;
+}
@@ -0,0 +1,56 @@
+/*
+ * ab_shm_source.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_SHM_SOURCE_H_
+#define AB_SHM_SOURCE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ab_base/ab_shm_ring.h"
+
+#include <stdint.h>
+
+typedef struct ab_shm_source_stats_t {
+    uint64_t        records;
+    uint64_t        bytes;
+    uint64_t        discontinuities;    // 写者重启或被覆盖
+    uint64_t        torn;               // 回调期间被写者覆盖的记录
+    uint64_t        opens;              // 打开(含重新打开)共享内存的次数
+} ab_shm_source_stats_t;
+
+/*
+ * 共享内存推流输入：编码器进程用ab_shm_ring_create/ab_shm_ring_write写NALU，
+ * 接收线程在共享内存上原地回调，不拷贝
+ * 共享内存还不存在、被删除或重建时，每AB_SHM_SOURCE_RETRY_MS重新打开
+ */
+#define AB_SHM_SOURCE_RETRY_MS  200
+
+#define T ab_shm_source_t
+typedef struct T *T;
+
+/*
+ * name: 写者ab_shm_ring_create的名字
+ * cb: record->data指向共享内存，回调返回后失效
+ */
+extern T    ab_shm_source_open(const char *name,
+    void (*cb)(const ab_shm_ring_record_t *, void *), void *user_data);
+/*
+ * 返回时接收线程已经退出，不再回调
+ */
+extern void ab_shm_source_close(T *source);
+
+extern void ab_shm_source_stats(T source, ab_shm_source_stats_t *stats);
+
+#undef T
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_SHM_SOURCE_H_
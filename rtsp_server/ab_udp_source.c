@@ -0,0 +1,159 @@
+/*
+ * ab_udp_source.c
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#define _GNU_SOURCE                     // recvmmsg
+
+#include "ab_udp_source.h"
+
+#include "ab_base/ab_mem.h"
+#include "ab_base/ab_assert.h"
+
+#include "ab_log/ab_logger.h"
+
+#include "ab_net/ab_socket.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#define UDP_SOURCE_BATCH        32
+#define UDP_SOURCE_PACKET_SIZE  4096
+#define UDP_SOURCE_POLL_MS      5       // also how often reorder gaps time out
+
+#define T ab_udp_source_t
+
+struct T {
+    ab_socket_t     sock;
+    ab_rtp_reorder_t reorder;
+
+    // held by the receiving thread for a whole batch, stats take it too
+    pthread_mutex_t mutex;
+    ab_udp_source_stats_t stats;
+
+    unsigned char  *buffers;            // UDP_SOURCE_BATCH * UDP_SOURCE_PACKET_SIZE
+
+    bool            quit;
+    pthread_t       recv_thd;
+};
+
+static void *recv_thd_cb(void *arg);
+
+static uint64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+T ab_udp_source_open(unsigned short port, unsigned int window,
+    unsigned int max_delay_us,
+    void (*cb)(const unsigned char *, unsigned int, void *), void *user_data) {
+    assert(cb);
+
+    ab_socket_t sock = ab_socket_new(AB_SOCKET_UDP_INET);
+    if (NULL == sock)
+        return NULL;
+    ab_socket_reuse_addr(sock);
+    if (ab_socket_bind(sock, NULL, port) != 0) {
+        AB_LOGGER_ERROR("bind udp port %u failed, %s.\n", port, strerror(errno));
+        ab_socket_free(&sock);
+        return NULL;
+    }
+
+    // a key frame arrives as a burst, same as a pulling client's RTP socket
+    ab_socket_set_recv_buffer(sock, 4 * 1024 * 1024);
+
+    T source;
+    NEW0(source);
+    source->sock    = sock;
+    source->reorder = ab_rtp_reorder_new(window, max_delay_us, cb, user_data);
+    source->buffers = ALLOC(UDP_SOURCE_BATCH * UDP_SOURCE_PACKET_SIZE);
+    pthread_mutex_init(&source->mutex, NULL);
+
+    source->quit    = false;
+    pthread_create(&source->recv_thd, NULL, recv_thd_cb, source);
+
+    return source;
+}
+
+void ab_udp_source_close(T *source) {
+    assert(source && *source);
+
+    __atomic_store_n(&(*source)->quit, true, __ATOMIC_RELEASE);
+    pthread_join((*source)->recv_thd, NULL);
+
+    pthread_mutex_destroy(&(*source)->mutex);
+    ab_rtp_reorder_free(&(*source)->reorder);
+    ab_socket_free(&(*source)->sock);
+    FREE((*source)->buffers);
+    FREE(*source);
+}
+
+void ab_udp_source_stats(T source, ab_udp_source_stats_t *stats) {
+    assert(source);
+    assert(stats);
+
+    pthread_mutex_lock(&source->mutex);
+    *stats = source->stats;
+    ab_rtp_reorder_stats(source->reorder, &stats->reorder);
+    pthread_mutex_unlock(&source->mutex);
+}
+
+/*
+ * RTP版本2；rtcp-mux时RTCP的第二字节在192~223(RFC 5761 4)
+ */
+static bool is_rtp(const unsigned char *data, unsigned int len) {
+    return len > 12 && 2 == (data[0] >> 6) && (data[1] < 192 || data[1] > 223);
+}
+
+void *recv_thd_cb(void *arg) {
+    T source = (T) arg;
+
+    struct mmsghdr msgs[UDP_SOURCE_BATCH];
+    struct iovec iovs[UDP_SOURCE_BATCH];
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < UDP_SOURCE_BATCH; ++i) {
+        iovs[i].iov_base            = source->buffers + i * UDP_SOURCE_PACKET_SIZE;
+        iovs[i].iov_len             = UDP_SOURCE_PACKET_SIZE;
+        msgs[i].msg_hdr.msg_iov     = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen  = 1;
+    }
+
+    struct pollfd pfd;
+    pfd.fd      = ab_socket_fd(source->sock);
+    pfd.events  = POLLIN;
+
+    while (!__atomic_load_n(&source->quit, __ATOMIC_ACQUIRE)) {
+        int ready = poll(&pfd, 1, UDP_SOURCE_POLL_MS);
+        int count = ready > 0 ?
+            recvmmsg(pfd.fd, msgs, UDP_SOURCE_BATCH, MSG_DONTWAIT, NULL) : 0;
+        uint64_t now_us = monotonic_us();
+
+        pthread_mutex_lock(&source->mutex);
+        if (count > 0)
+            ++source->stats.batches;
+        for (int i = 0; i < count; ++i) {
+            const unsigned char *data = iovs[i].iov_base;
+            unsigned int len = msgs[i].msg_len;
+            ++source->stats.datagrams;
+            source->stats.bytes += len;
+
+            if ((msgs[i].msg_hdr.msg_flags & MSG_TRUNC) || !is_rtp(data, len)) {
+                ++source->stats.ignored;
+                continue;
+            }
+            ab_rtp_reorder_push(source->reorder, data, len, now_us);
+        }
+        ab_rtp_reorder_poll(source->reorder, now_us);
+        pthread_mutex_unlock(&source->mutex);
+    }
+
+    return NULL;
+}
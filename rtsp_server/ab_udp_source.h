@@ -0,0 +1,54 @@
+/*
+ * ab_udp_source.h
+ *
+ *  Created on: 2026年10月18日
+ *      Author: ljm
+ */
+
+#ifndef AB_UDP_SOURCE_H_
+#define AB_UDP_SOURCE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ab_rtp/ab_rtp_reorder.h"
+
+#include <stdint.h>
+
+typedef struct ab_udp_source_stats_t {
+    uint64_t        datagrams;
+    uint64_t        bytes;
+    uint64_t        batches;            // 收到包的recvmmsg调用
+    uint64_t        ignored;            // 不是RTP、RTCP(rtcp-mux)或被截断
+    ab_rtp_reorder_stats_t reorder;
+} ab_udp_source_stats_t;
+
+/*
+ * RTP/UDP推流输入：编码器把RTP推到port，接收线程用recvmmsg批量收包，
+ * 按序列号重排后在该线程回调完整的RTP包
+ */
+#define T ab_udp_source_t
+typedef struct T *T;
+
+/*
+ * window: 重排窗口(包)，2的幂；max_delay_us: 缺包最多等待的时间
+ * return: 端口绑定失败返回NULL
+ */
+extern T    ab_udp_source_open(unsigned short port, unsigned int window,
+    unsigned int max_delay_us,
+    void (*cb)(const unsigned char *, unsigned int, void *), void *user_data);
+/*
+ * 返回时接收线程已经退出，不再回调
+ */
+extern void ab_udp_source_close(T *source);
+
+extern void ab_udp_source_stats(T source, ab_udp_source_stats_t *stats);
+
+#undef T
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AB_UDP_SOURCE_H_
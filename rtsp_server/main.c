@@ -1,14 +1,24 @@
 #include "ab_rtsp_server.h"
+#include "ab_file_source.h"
 
-#include "ab_base/ab_mem.h"
+#include "ab_rtp/ab_aac.h"
+
+#include "ab_base/ab_shm_ring.h"
 
 #include "ab_log/ab_logger.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
 #include <unistd.h>
 #include <string.h>
+#include <time.h>
 #include <sys/signal.h>
+#include <sys/wait.h>
+
+#define PACKET_RING_NAME    "/ab_rtsp_packets"
+#define PACKET_RING_SIZE    (16 * 1024 * 1024)
+#define WORKER_RESPAWN_MS   1000    // a child that keeps crashing is not a busy loop
 
 static bool g_quit = true;
 
@@ -17,56 +27,275 @@ static void signal_catch(int signal_num) {
         g_quit = true;
 }
 
+/*
+ * 发送一个ADTS帧，文件结束时从头开始
+ * return: 帧时长(us)，文件不是ADTS返回0
+ */
+static unsigned int send_adts_frame(ab_rtsp_server_t rtsp, FILE *file) {
+    unsigned char frame[AB_AAC_ADTS_MAX_FRAME_SIZE];
+    ab_aac_adts_header_t header;
+
+    if (fread(frame, 1, AB_AAC_ADTS_HEADER_SIZE, file) != AB_AAC_ADTS_HEADER_SIZE) {
+        fseek(file, 0, SEEK_SET);
+        if (fread(frame, 1, AB_AAC_ADTS_HEADER_SIZE, file) != AB_AAC_ADTS_HEADER_SIZE)
+            return 0;
+    }
+    if (ab_aac_adts_parse(frame, AB_AAC_ADTS_HEADER_SIZE, &header) < 0)
+        return 0;
+
+    unsigned int rest = header.frame_len - AB_AAC_ADTS_HEADER_SIZE;
+    if (fread(frame + AB_AAC_ADTS_HEADER_SIZE, 1, rest, file) != rest)
+        return 0;
+
+    ab_rtsp_server_send_audio(rtsp, (const char *) frame, header.frame_len);
+    return (unsigned long) AB_AAC_FRAME_SAMPLES * 1000000 / header.config.sample_rate;
+}
+
+/*
+ * 一帧的NALU直接从mmap发出
+ */
+static void send_frame(ab_rtsp_server_t rtsp, ab_file_source_t source,
+    unsigned int index) {
+    const ab_file_source_frame_t *frame = ab_file_source_frame(source, index);
+    for (unsigned int i = 0; i < frame->nalu_count; ++i) {
+        unsigned int nalu_len = 0;
+        const unsigned char *nalu = ab_file_source_nalu(source,
+            frame->first_nalu + i, &nalu_len);
+        if (nalu_len > 0)
+            ab_rtsp_server_send_nalu(rtsp, nalu, nalu_len);
+    }
+    ab_rtsp_server_send(rtsp, NULL, 0);
+}
+
+/*
+ * 按绝对时间睡眠，发送耗时不会累积成漂移
+ */
+static void sleep_until(const struct timespec *start, unsigned long elapsed_us) {
+    struct timespec deadline = *start;
+    deadline.tv_sec += elapsed_us / 1000000;
+    deadline.tv_nsec += (elapsed_us % 1000000) * 1000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+}
+
+static void wait_quit(void) {
+    while (!g_quit)
+        sleep(1);
+}
+
+/*
+ * 按帧率循环推送文件，直到SIGINT；audio在返回前关闭
+ */
+static void run_file(ab_rtsp_server_t rtsp, ab_file_source_t source, FILE *audio) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    unsigned int frame = 0;
+    unsigned long loop_us = 0;      // the file restarts at the end
+    unsigned long audio_us = 0;
+    while (!g_quit) {
+        unsigned long elapsed_us = loop_us +
+            ab_file_source_frame_time_us(source, frame);
+        sleep_until(&start, elapsed_us);
+
+        // audio keeps pace with the video frames
+        while (audio && audio_us <= elapsed_us) {
+            unsigned int duration = send_adts_frame(rtsp, audio);
+            if (0 == duration) {
+                fclose(audio);
+                audio = NULL;
+                break;
+            }
+            audio_us += duration;
+        }
+
+        send_frame(rtsp, source, frame);
+        if (++frame == ab_file_source_frame_count(source)) {
+            frame = 0;
+            loop_us += ab_file_source_duration_us(source);
+        }
+    }
+
+    if (audio)
+        fclose(audio);
+}
+
+/*
+ * 推流直到SIGINT：source为NULL时由编码器推
+ * in: udp:<port>推RTP，shm:<name>写共享内存
+ */
+static void run_stream(ab_rtsp_server_t rtsp, const char *in,
+    ab_file_source_t source, FILE *audio) {
+    if (source) {
+        AB_LOGGER_INFO("RTSP server startup.\n");
+        run_file(rtsp, source, audio);
+    } else {
+        int result = strncmp(in, "udp:", 4) == 0 ?
+            ab_rtsp_server_set_rtp_ingest(rtsp, atoi(in + 4)) :
+            ab_rtsp_server_set_shm_ingest(rtsp, in + 4);
+        if (result != 0)
+            return;
+        AB_LOGGER_INFO("RTSP server startup, ingest from %s.\n", in);
+        wait_quit();
+    }
+    AB_LOGGER_INFO("RTSP server quit.\n");
+}
+
+/*
+ * worker < 0: 推流子进程，打包后写入包环，不监听
+ * worker >= 0: 共用554端口，从包环转发给自己的观看端
+ * return: 子进程的pid，失败返回-1
+ */
+static pid_t spawn_child(const char *in, ab_file_source_t source,
+    int video_codec, int worker) {
+    pid_t pid = fork();
+    if (pid != 0)
+        return pid;
+
+    ab_rtsp_server_t rtsp;
+    if (worker < 0) {
+        rtsp = ab_rtsp_server_new(0, video_codec);
+        if (0 == ab_rtsp_server_set_packet_ring(rtsp, PACKET_RING_NAME, PACKET_RING_SIZE))
+            run_stream(rtsp, in, source, NULL);
+        else
+            AB_LOGGER_ERROR("packet ring %s failed.\n", PACKET_RING_NAME);
+    } else {
+        rtsp = ab_rtsp_server_new_worker(554, video_codec, worker);
+        if (source)
+            ab_rtsp_server_add_vod(rtsp, "vod", source);
+        ab_rtsp_server_set_packet_ring_ingest(rtsp, PACKET_RING_NAME);
+        AB_LOGGER_INFO("RTSP worker %d startup.\n", worker);
+        wait_quit();
+    }
+    ab_rtsp_server_free(&rtsp);
+    _exit(0);
+}
+
+/*
+ * 多进程：children[0]是推流进程，其余是worker；退出(崩溃)的子进程
+ * 隔WORKER_RESPAWN_MS重新拉起，只影响它自己的观看端，直到SIGINT
+ */
+static void run_workers(const char *in, ab_file_source_t source,
+    int video_codec, unsigned int workers) {
+    pid_t children[AB_RTSP_MAX_WORKERS + 1];
+    struct timespec spawned[AB_RTSP_MAX_WORKERS + 1];
+    unsigned int count = workers + 1;
+
+    for (unsigned int i = 0; i < count; ++i) {
+        children[i] = spawn_child(in, source, video_codec, (int) i - 1);
+        clock_gettime(CLOCK_MONOTONIC, &spawned[i]);
+    }
+    AB_LOGGER_INFO("RTSP server startup, %u workers.\n", workers);
+
+    while (!g_quit) {
+        int status;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            for (unsigned int i = 0; i < count; ++i) {
+                if (children[i] != pid)
+                    continue;
+                if (0 == i)
+                    AB_LOGGER_ERROR("ingest (pid %d) exited, status 0x%x.\n", pid, status);
+                else
+                    AB_LOGGER_ERROR("worker %u (pid %d) exited, status 0x%x.\n",
+                        i - 1, pid, status);
+                children[i] = -1;
+            }
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        for (unsigned int i = 0; i < count; ++i) {
+            long since_ms = (now.tv_sec - spawned[i].tv_sec) * 1000 +
+                (now.tv_nsec - spawned[i].tv_nsec) / 1000000;
+            if (children[i] > 0 || since_ms < WORKER_RESPAWN_MS)
+                continue;
+            children[i] = spawn_child(in, source, video_codec, (int) i - 1);
+            spawned[i]  = now;
+        }
+
+        usleep(100 * 1000);
+    }
+
+    for (unsigned int i = 0; i < count; ++i) {
+        if (children[i] > 0)
+            kill(children[i], SIGINT);
+    }
+    for (unsigned int i = 0; i < count; ++i) {
+        if (children[i] > 0)
+            waitpid(children[i], NULL, 0);
+    }
+    ab_shm_ring_unlink(PACKET_RING_NAME);
+
+    AB_LOGGER_INFO("RTSP server quit.\n");
+}
+
+/*
+ * rtsp_push [-w workers] <in> [audio_file|h264|h265]
+ * in: 文件，或udp:<port>、shm:<name>由编码器推流
+ * -w: 多进程，不带音频和时移
+ */
 int main(int argc, char *argv[]) {
+    unsigned int workers = 0;
+    if (argc > 2 && strcmp(argv[1], "-w") == 0) {
+        workers = atoi(argv[2]);
+        if (workers < 1 || workers > AB_RTSP_MAX_WORKERS)
+            return -1;
+        argc -= 2;
+        argv += 2;
+    }
     if (argc < 2)
         return -1;
 
     const char *in_file = argv[1];
+    const char *audio_file = argc > 2 ? argv[2] : NULL;
 
     signal(SIGINT, signal_catch);
 
     ab_logger_init(AB_LOGGER_OUTPUT_TO_STDOUT, ".", "log", 100, 1024 * 1024);
     AB_LOGGER_INFO("startup.\n");
 
+    // udp:<port>|shm:<name> h264|h265, the encoder pushes instead of a file
+    bool ingest = strncmp(in_file, "udp:", 4) == 0 || strncmp(in_file, "shm:", 4) == 0;
     int video_codec = 0;
-    if (strstr(in_file, ".h264"))
+    if (ingest)
+        video_codec = audio_file && strstr(audio_file, "265") ? 2 : 1;
+    else if (strstr(in_file, ".h264"))
         video_codec = 1;
     else if (strstr(in_file, ".h265"))
         video_codec = 2;
 
-    if (video_codec != 0) {
+    ab_file_source_t source = NULL;
+    if (!ingest && video_codec != 0)
+        source = ab_file_source_open(in_file, video_codec);
+
+    g_quit = false;
+    if (workers > 0 && (ingest || source)) {
+        run_workers(in_file, source, video_codec, workers);
+    } else if (ingest || source) {
         ab_rtsp_server_t rtsp = ab_rtsp_server_new(554, video_codec);
 
-        AB_LOGGER_INFO("RTSP server startup.\n");
+        FILE *audio = NULL;
+        if (source) {
+            // rtsp://host/vod plays the same file on demand, from one shared mmap
+            ab_rtsp_server_add_vod(rtsp, "vod", source);
+            // the last 64 MB or 30 minutes at 25 fps of the live stream, Range: npt=N-
+            ab_rtsp_server_set_timeshift(rtsp, 64 * 1024 * 1024, 30 * 60 * 25);
 
-        g_quit = false;
-        int nread = 0;
-        const unsigned int data_buf_size = 10 * 1024;
-        char *data_buf = (char *) ALLOC(data_buf_size);
-        FILE *file = fopen(in_file, "rb");
-        while (!g_quit) {
-            if (file != NULL) {
-                nread = fread(data_buf, 1, data_buf_size, file);
-                if (nread > 0) {
-                    ab_rtsp_server_send(rtsp, data_buf, nread);
-                } else {
-                    ab_rtsp_server_send(rtsp, NULL, 0);
-                    fseek(file, 0, SEEK_SET);
-                }
-            }
-            usleep(40 * 1000);
+            audio = audio_file ? fopen(audio_file, "rb") : NULL;
+            if (audio)
+                ab_rtsp_server_set_audio(rtsp, 44100, 2, 2);
         }
 
-        FREE(data_buf);
-        data_buf = NULL;
-
-        fclose(file);
-
-        AB_LOGGER_INFO("RTSP server quit.\n");
-
+        run_stream(rtsp, in_file, source, audio);
         ab_rtsp_server_free(&rtsp);
     }
 
+    if (source)
+        ab_file_source_close(&source);
+
     AB_LOGGER_INFO("shutdown.\n");
     ab_logger_deinit();
 